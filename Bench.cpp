@@ -0,0 +1,637 @@
+/*
+ * This file is part of the VanitySearch distribution (https://github.com/JeanLucPons/VanitySearch).
+ * Copyright (c) 2019 Jean Luc PONS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Bench.h"
+#include "Vanity.h"
+#include "IntGroup.h"
+#include "Timer.h"
+#include <string.h>
+#include <stdio.h>
+#ifdef WIN64
+#include <intrin.h>
+#endif
+
+// Number of CPU_GRP_SIZE groups walked per CPU engine, the key budget is
+// 6*CPU_GRP_SIZE keys per group (point + 2 endos, each with its symmetric)
+#define BENCH_CPU_GROUPS 256
+
+// Kernel launches per GPU engine (after warmup)
+#define BENCH_GPU_WARMUP 4
+#define BENCH_GPU_RUNS   32
+
+typedef struct {
+
+  std::string engine;
+  uint64_t keys;
+  double totalTime;
+  double kernelTime;  // EC group walk (CPU engines) or kernel wait (GPU)
+  double pcieTime;    // Output drain (GPU engines only)
+  double checkTime;   // hash160 + prefix lookup (CPU), host side decode (GPU)
+
+} BENCH_ROW;
+
+// Generator table, same layout as the one FindKeyCPU uses
+static Point bGn[CPU_GRP_SIZE / 2];
+static Point b2Gn;
+
+// Dummy first level lookup, filled at runtime so the table reads are not
+// folded away, no entry is ever set so nothing matches
+static bool benchPrefixUsed[_64K];
+
+static void buildGnTable(Secp256K1 *secp) {
+
+  Point g = secp->G;
+  bGn[0] = g;
+  g = secp->DoubleDirect(g);
+  bGn[1] = g;
+  for (int i = 2; i < CPU_GRP_SIZE / 2; i++) {
+    g = secp->AddDirect(g, secp->G);
+    bGn[i] = g;
+  }
+  b2Gn = secp->DoubleDirect(bGn[CPU_GRP_SIZE / 2 - 1]);
+
+}
+
+// One batch of the FindKeyCPU group walk, advances startP by CPU_GRP_SIZE*G
+// and fills pts with the CPU_GRP_SIZE points around the old center
+static void walkGroup(IntGroup *grp, Int *dx, Point *pts, Point &startP) {
+
+  Int dy;
+  Int dyn;
+  Int _s;
+  Int _p;
+  Point pp;
+  Point pn;
+
+  int i;
+  int hLength = (CPU_GRP_SIZE / 2 - 1);
+
+  for (i = 0; i < hLength; i++) {
+    dx[i].ModSub(&bGn[i].x, &startP.x);
+  }
+  dx[i].ModSub(&bGn[i].x, &startP.x);  // For the first point
+  dx[i+1].ModSub(&b2Gn.x, &startP.x);  // For the next center point
+
+  grp->ModInv();
+
+  pts[CPU_GRP_SIZE/2] = startP;
+
+  for (i = 0; i < hLength; i++) {
+
+    pp = startP;
+    pn = startP;
+
+    // P = startP + i*G
+    dy.ModSub(&bGn[i].y, &pp.y);
+
+    _s.ModMulK1(&dy, &dx[i]);
+    _p.ModSquareK1(&_s);
+
+    pp.x.ModNeg();
+    pp.x.ModAdd(&_p);
+    pp.x.ModSub(&bGn[i].x);
+
+    pp.y.ModSub(&bGn[i].x, &pp.x);
+    pp.y.ModMulK1(&_s);
+    pp.y.ModSub(&bGn[i].y);
+
+    // P = startP - i*G
+    dyn.Set(&bGn[i].y);
+    dyn.ModNeg();
+    dyn.ModSub(&pn.y);
+
+    _s.ModMulK1(&dyn, &dx[i]);
+    _p.ModSquareK1(&_s);
+
+    pn.x.ModNeg();
+    pn.x.ModAdd(&_p);
+    pn.x.ModSub(&bGn[i].x);
+
+    pn.y.ModSub(&bGn[i].x, &pn.x);
+    pn.y.ModMulK1(&_s);
+    pn.y.ModAdd(&bGn[i].y);
+
+    pts[CPU_GRP_SIZE/2 + (i+1)] = pp;
+    pts[CPU_GRP_SIZE/2 - (i+1)] = pn;
+
+  }
+
+  // First point (startP - (GRP_SIZE/2)*G)
+  pn = startP;
+  dyn.Set(&bGn[i].y);
+  dyn.ModNeg();
+  dyn.ModSub(&pn.y);
+
+  _s.ModMulK1(&dyn, &dx[i]);
+  _p.ModSquareK1(&_s);
+
+  pn.x.ModNeg();
+  pn.x.ModAdd(&_p);
+  pn.x.ModSub(&bGn[i].x);
+
+  pn.y.ModSub(&bGn[i].x, &pn.x);
+  pn.y.ModMulK1(&_s);
+  pn.y.ModAdd(&bGn[i].y);
+
+  pts[0] = pn;
+
+  // Next start point (startP + GRP_SIZE*G)
+  pp = startP;
+  dy.ModSub(&b2Gn.y, &pp.y);
+
+  _s.ModMulK1(&dy, &dx[i+1]);
+  _p.ModSquareK1(&_s);
+
+  pp.x.ModNeg();
+  pp.x.ModAdd(&_p);
+  pp.x.ModSub(&b2Gn.x);
+
+  pp.y.ModSub(&b2Gn.x, &pp.x);
+  pp.y.ModMulK1(&_s);
+  pp.y.ModSub(&b2Gn.y);
+  startP = pp;
+
+}
+
+static uint64_t lookupHashes(uint8_t (*h)[20], int n) {
+
+  uint64_t matches = 0;
+  for (int g = 0; g < n; g++) {
+    prefix_t pr = *(prefix_t *)h[g];
+    if (benchPrefixUsed[pr])
+      matches++;
+  }
+  return matches;
+
+}
+
+// CPU vanity engines, same hash dispatch as checkAddresses/checkAddressesSSE/
+// checkAddressesWide: 6 hash160 per point (point + 2 endos, each +- y)
+// width: 1 (scalar), 4 (SSE), 8 (AVX2), 16 (AVX512)
+static void benchCPUVanity(Secp256K1 *secp, Int &beta, Int &beta2,
+                           const char *name, int width, std::vector<BENCH_ROW> &rows) {
+
+  IntGroup *grp = new IntGroup(CPU_GRP_SIZE/2+1);
+  Int dx[CPU_GRP_SIZE/2+1];
+  Point pts[CPU_GRP_SIZE];
+  grp->Set(dx);
+
+  Int key;
+  key.Rand(256);
+  Point startP = secp->ComputePublicKey(&key);
+
+  uint8_t h[16][20];
+  Point pt[16];
+  Point pte1[16];
+  Point pte2[16];
+  uint64_t matches = 0;
+
+  BENCH_ROW r;
+  r.engine = name;
+  r.keys = 6ULL * CPU_GRP_SIZE * BENCH_CPU_GROUPS;
+  r.kernelTime = 0.0;
+  r.pcieTime = 0.0;
+  r.checkTime = 0.0;
+
+  double tStart = Timer::get_tick();
+
+  for (int run = 0; run < BENCH_CPU_GROUPS; run++) {
+
+    double t0 = Timer::get_tick();
+    walkGroup(grp, dx, pts, startP);
+    double t1 = Timer::get_tick();
+    r.kernelTime += t1 - t0;
+
+    for (int i = 0; i < CPU_GRP_SIZE; i += width) {
+
+      for (int g = 0; g < width; g++)
+        pt[g] = pts[i + g];
+
+      // Point, endomorphism #1 (beta*x, y), endomorphism #2 (beta2*x, y)
+      for (int g = 0; g < width; g++) {
+        pte1[g].x.ModMulK1(&pt[g].x, &beta);
+        pte1[g].y.Set(&pt[g].y);
+        pte2[g].x.ModMulK1(&pt[g].x, &beta2);
+        pte2[g].y.Set(&pt[g].y);
+      }
+
+      for (int sym = 0; sym < 2; sym++) {
+
+        if (sym) {
+          // Curve symmetry: if (x,y) = k*G, then (x,-y) is -k*G
+          for (int g = 0; g < width; g++) {
+            pt[g].y.ModNeg();
+            pte1[g].y.ModNeg();
+            pte2[g].y.ModNeg();
+          }
+        }
+
+        switch (width) {
+          case 16:
+            secp->GetHash160x16(P2PKH, true, pt, h);
+            matches += lookupHashes(h, 16);
+            secp->GetHash160x16(P2PKH, true, pte1, h);
+            matches += lookupHashes(h, 16);
+            secp->GetHash160x16(P2PKH, true, pte2, h);
+            matches += lookupHashes(h, 16);
+            break;
+          case 8:
+            secp->GetHash160x8(P2PKH, true, pt, h);
+            matches += lookupHashes(h, 8);
+            secp->GetHash160x8(P2PKH, true, pte1, h);
+            matches += lookupHashes(h, 8);
+            secp->GetHash160x8(P2PKH, true, pte2, h);
+            matches += lookupHashes(h, 8);
+            break;
+          case 4:
+            secp->GetHash160(P2PKH, true, pt[0], pt[1], pt[2], pt[3], h[0], h[1], h[2], h[3]);
+            matches += lookupHashes(h, 4);
+            secp->GetHash160(P2PKH, true, pte1[0], pte1[1], pte1[2], pte1[3], h[0], h[1], h[2], h[3]);
+            matches += lookupHashes(h, 4);
+            secp->GetHash160(P2PKH, true, pte2[0], pte2[1], pte2[2], pte2[3], h[0], h[1], h[2], h[3]);
+            matches += lookupHashes(h, 4);
+            break;
+          default:
+            secp->GetHash160(P2PKH, true, pt[0], h[0]);
+            matches += lookupHashes(h, 1);
+            secp->GetHash160(P2PKH, true, pte1[0], h[0]);
+            matches += lookupHashes(h, 1);
+            secp->GetHash160(P2PKH, true, pte2[0], h[0]);
+            matches += lookupHashes(h, 1);
+            break;
+        }
+
+      }
+
+    }
+
+    r.checkTime += Timer::get_tick() - t1;
+    key.Add((uint64_t)CPU_GRP_SIZE);
+
+  }
+
+  r.totalTime = Timer::get_tick() - tStart;
+  if (matches)
+    printf("# benchCPUVanity: unexpected match count %llu\n", (unsigned long long)matches);
+  rows.push_back(r);
+
+  delete grp;
+
+}
+
+// CPU stego engine, same shape as checkStegoMaskAll: 2 endo multiplications
+// and 6 masked X compares per point (the symmetric points share their X)
+static void benchCPUStego(Secp256K1 *secp, Int &beta, Int &beta2,
+                          std::vector<BENCH_ROW> &rows) {
+
+  IntGroup *grp = new IntGroup(CPU_GRP_SIZE/2+1);
+  Int dx[CPU_GRP_SIZE/2+1];
+  Point pts[CPU_GRP_SIZE];
+  grp->Set(dx);
+
+  Int key;
+  key.Rand(256);
+  Point startP = secp->ComputePublicKey(&key);
+
+  // Unreachable target: random value, full mask
+  Int tgt;
+  tgt.Rand(256);
+  uint64_t value[4];
+  uint64_t mask[4];
+  for (int j = 0; j < 4; j++) {
+    value[j] = tgt.bits64[j];
+    mask[j] = 0xFFFFFFFFFFFFFFFFULL;
+  }
+
+  Int xe1;
+  Int xe2;
+  uint64_t matches = 0;
+
+  BENCH_ROW r;
+  r.engine = "stego_cpu";
+  r.keys = 6ULL * CPU_GRP_SIZE * BENCH_CPU_GROUPS;
+  r.kernelTime = 0.0;
+  r.pcieTime = 0.0;
+  r.checkTime = 0.0;
+
+  double tStart = Timer::get_tick();
+
+  for (int run = 0; run < BENCH_CPU_GROUPS; run++) {
+
+    double t0 = Timer::get_tick();
+    walkGroup(grp, dx, pts, startP);
+    double t1 = Timer::get_tick();
+    r.kernelTime += t1 - t0;
+
+    for (int i = 0; i < CPU_GRP_SIZE; i++) {
+
+      xe1.ModMulK1(&pts[i].x, &beta);
+      xe2.ModMulK1(&pts[i].x, &beta2);
+
+      bool hit = true;
+      for (int j = 0; j < 4 && hit; j++)
+        hit = (pts[i].x.bits64[j] & mask[j]) == value[j];
+      if (hit) matches++;
+      hit = true;
+      for (int j = 0; j < 4 && hit; j++)
+        hit = (xe1.bits64[j] & mask[j]) == value[j];
+      if (hit) matches++;
+      hit = true;
+      for (int j = 0; j < 4 && hit; j++)
+        hit = (xe2.bits64[j] & mask[j]) == value[j];
+      if (hit) matches++;
+
+    }
+
+    r.checkTime += Timer::get_tick() - t1;
+    key.Add((uint64_t)CPU_GRP_SIZE);
+
+  }
+
+  r.totalTime = Timer::get_tick() - tStart;
+  if (matches)
+    printf("# benchCPUStego: unexpected match count %llu\n", (unsigned long long)matches);
+  rows.push_back(r);
+
+  delete grp;
+
+}
+
+#ifdef WITHGPU
+
+#define BENCH_GPU_VANITY  0
+#define BENCH_GPU_STEGO   1
+#define BENCH_GPU_SIG     2
+#define BENCH_GPU_SCHNORR 3
+#define BENCH_GPU_TAPROOT 4
+#define BENCH_GPU_TXID    5
+
+static const char *benchGPUNames[] =
+  {"vanity_gpu", "stego_gpu", "sig_gpu", "schnorr_gpu", "taproot_gpu", "txid_gpu"};
+
+// Random base keys, starting points computed with one batched inversion per
+// CPU_GRP_SIZE chunk (same scheme as getGPUStartingKeys)
+static void buildStartingKeys(Secp256K1 *secp, int nbThread, int groupSize,
+                              Int *keys, Point *p) {
+
+  Int z[CPU_GRP_SIZE];
+
+  for (int i = 0; i < nbThread; i++)
+    keys[i].Rand(256);
+
+  for (int i = 0; i < nbThread; i += CPU_GRP_SIZE) {
+
+    int n = nbThread - i;
+    if (n > CPU_GRP_SIZE) n = CPU_GRP_SIZE;
+
+    for (int j = 0; j < n; j++) {
+      Int k(keys + i + j);
+      // Starting key is at the middle of the group
+      k.Add((uint64_t)(groupSize / 2));
+      p[i + j] = secp->ComputePublicKeyProjective(&k);
+      z[j].Set(&p[i + j].z);
+    }
+
+    IntGroup grp(n);
+    grp.Set(z);
+    grp.ModInv();
+
+    for (int j = 0; j < n; j++) {
+      p[i + j].x.ModMulK1(&p[i + j].x, &z[j]);
+      p[i + j].y.ModMulK1(&p[i + j].y, &z[j]);
+      p[i + j].z.SetInt32(1);
+    }
+
+  }
+
+}
+
+static void benchGPUMode(Secp256K1 *secp, int mode, std::vector<int> &gpuId,
+                         std::vector<int> &gridSize, std::vector<BENCH_ROW> &rows) {
+
+  GPUEngine g(gpuId, gridSize, 65536, false);
+  int nbThread = g.GetNbThread();
+  int groupSize = g.GetGroupSize();
+  printf("# %s: %s (%d threads)\n", benchGPUNames[mode], g.deviceName.c_str(), nbThread);
+
+  g.SetSearchMode(SEARCH_COMPRESSED);
+  g.SetSearchType(P2PKH);
+
+  // Unreachable targets so the output path is exercised at its real hit rate
+  Int tgt;
+  tgt.Rand(256);
+  uint64_t value[4];
+  uint64_t mask[4];
+  for (int j = 0; j < 4; j++) {
+    value[j] = tgt.bits64[j];
+    mask[j] = 0xFFFFFFFFFFFFFFFFULL;
+  }
+
+  Int sigD;
+  Int sigZ;
+  uint8_t rawTx[128];
+
+  switch (mode) {
+
+    case BENCH_GPU_VANITY: {
+      std::vector<prefix_t> prefs;
+      prefs.push_back((prefix_t)(tgt.bits64[0] & 0xFFFF));
+      g.SetPrefix(prefs);
+      break;
+    }
+
+    case BENCH_GPU_STEGO:
+    case BENCH_GPU_TAPROOT:
+      g.SetStegoTarget(value, mask);
+      break;
+
+    case BENCH_GPU_SIG:
+    case BENCH_GPU_SCHNORR: {
+      sigD.Rand(256);
+      sigZ.Rand(256);
+      Point pub = secp->ComputePublicKey(&sigD);
+      g.SetSigParams(sigD.bits64, sigZ.bits64, pub.x.bits64,
+                     mode == BENCH_GPU_SCHNORR);
+      break;
+    }
+
+    case BENCH_GPU_TXID:
+      for (int i = 0; i < (int)sizeof(rawTx); i++)
+        rawTx[i] = (uint8_t)(tgt.bits64[i & 3] >> ((i & 7) * 8));
+      g.SetTxidTarget(value, mask);
+      g.SetRawTx(rawTx, (int)sizeof(rawTx), (int)sizeof(rawTx) - 4, 4);
+      break;
+
+  }
+
+  Int *keys = new Int[nbThread];
+  Point *p = new Point[nbThread];
+  buildStartingKeys(secp, nbThread, groupSize, keys, p);
+  bool sigKeys = (mode == BENCH_GPU_SIG || mode == BENCH_GPU_SCHNORR);
+  bool ok = g.SetKeys(p, sigKeys ? keys : NULL);
+
+  std::vector<ITEM> found;
+  uint64_t keysPerLaunch;
+  if (mode == BENCH_GPU_TAPROOT || mode == BENCH_GPU_TXID)
+    keysPerLaunch = (uint64_t)nbThread * g.GetNbStep();
+  else
+    keysPerLaunch = 6ULL * STEP_SIZE * g.GetNbStep() * nbThread;
+
+  double tStart = 0.0;
+  for (int run = 0; run < BENCH_GPU_WARMUP + BENCH_GPU_RUNS && ok; run++) {
+
+    if (run == BENCH_GPU_WARMUP) {
+      g.ResetTimings();
+      tStart = Timer::get_tick();
+    }
+
+    found.clear();
+    switch (mode) {
+      case BENCH_GPU_VANITY:
+        ok = g.Launch(found);
+        break;
+      case BENCH_GPU_STEGO:
+        ok = g.LaunchStego(found);
+        break;
+      case BENCH_GPU_SIG:
+      case BENCH_GPU_SCHNORR:
+        ok = g.LaunchSig(found);
+        break;
+      case BENCH_GPU_TAPROOT:
+        ok = g.LaunchTaproot(found);
+        break;
+      case BENCH_GPU_TXID:
+        ok = g.LaunchTxid(found);
+        break;
+    }
+
+  }
+  double tEnd = Timer::get_tick();
+
+  delete[] keys;
+  delete[] p;
+
+  if (!ok) {
+    printf("# %s: launch failed, skipped\n", benchGPUNames[mode]);
+    return;
+  }
+
+  BENCH_ROW r;
+  r.engine = benchGPUNames[mode];
+  r.keys = keysPerLaunch * BENCH_GPU_RUNS;
+  r.totalTime = tEnd - tStart;
+  g.GetTimings(&r.kernelTime, &r.pcieTime);
+  // Host side decode and launch overhead is what is left of the wall time
+  r.checkTime = r.totalTime - r.kernelTime - r.pcieTime;
+  if (r.checkTime < 0) r.checkTime = 0.0;
+  rows.push_back(r);
+
+}
+
+#endif
+
+static void report(std::vector<BENCH_ROW> &rows, std::string outputFile) {
+
+  printf("engine,keys,total_s,kernel_s,pcie_s,check_s,mkeys\n");
+  for (int i = 0; i < (int)rows.size(); i++) {
+    BENCH_ROW &r = rows[i];
+    printf("%s,%llu,%.3f,%.3f,%.3f,%.3f,%.2f\n",
+           r.engine.c_str(), (unsigned long long)r.keys,
+           r.totalTime, r.kernelTime, r.pcieTime, r.checkTime,
+           (double)r.keys / r.totalTime / 1000000.0);
+  }
+
+  if (outputFile.length() > 0) {
+    FILE *f = fopen(outputFile.c_str(), "w");
+    if (f == NULL) {
+      printf("Cannot open %s for writing\n", outputFile.c_str());
+      return;
+    }
+    fprintf(f, "[\n");
+    for (int i = 0; i < (int)rows.size(); i++) {
+      BENCH_ROW &r = rows[i];
+      fprintf(f, "  {\"engine\":\"%s\",\"keys\":%llu,\"total_s\":%.3f,"
+                 "\"kernel_s\":%.3f,\"pcie_s\":%.3f,\"check_s\":%.3f,\"mkeys\":%.2f}%s\n",
+              r.engine.c_str(), (unsigned long long)r.keys,
+              r.totalTime, r.kernelTime, r.pcieTime, r.checkTime,
+              (double)r.keys / r.totalTime / 1000000.0,
+              (i + 1 < (int)rows.size()) ? "," : "");
+    }
+    fprintf(f, "]\n");
+    fclose(f);
+    printf("# JSON report written to %s\n", outputFile.c_str());
+  }
+
+}
+
+void RunBench(Secp256K1 *secp, bool useGpu, std::vector<int> gpuId,
+              std::vector<int> gridSize, std::string outputFile) {
+
+  std::vector<BENCH_ROW> rows;
+
+  // Widest hash pipeline supported by the CPU (AVX512 > AVX2 > SSE)
+  bool hasAVX2;
+  bool hasAVX512;
+#ifdef WIN64
+  {
+    int info[4];
+    __cpuidex(info, 7, 0);
+    hasAVX2 = ((info[1] >> 5) & 1);
+    hasAVX512 = ((info[1] >> 16) & 1);
+  }
+#else
+  hasAVX2 = __builtin_cpu_supports("avx2");
+  hasAVX512 = __builtin_cpu_supports("avx512f");
+#endif
+
+  Int beta;
+  Int beta2;
+  beta.SetBase16("7ae96a2b657c07106e64479eac3434e99cf0497512f58995c1396c28719501ee");
+  beta2.SetBase16("851695d49a83f8ef919bb86153cbcb16630fb68aed0a766a3ec693d68e6afa40");
+
+  buildGnTable(secp);
+  memset(benchPrefixUsed, 0, sizeof(benchPrefixUsed));
+
+  printf("# VanitySearch benchmark, %llu keys per CPU engine, %d launches per GPU engine\n",
+         6ULL * CPU_GRP_SIZE * BENCH_CPU_GROUPS, BENCH_GPU_RUNS);
+
+  benchCPUVanity(secp, beta, beta2, "vanity_cpu", 1, rows);
+  benchCPUVanity(secp, beta, beta2, "vanity_cpu_sse", 4, rows);
+  if (hasAVX2)
+    benchCPUVanity(secp, beta, beta2, "vanity_cpu_avx2", 8, rows);
+  if (hasAVX512)
+    benchCPUVanity(secp, beta, beta2, "vanity_cpu_avx512", 16, rows);
+  benchCPUStego(secp, beta, beta2, rows);
+
+  if (useGpu) {
+#ifdef WITHGPU
+    if (gridSize.size() == 0) {
+      for (int i = 0; i < (int)gpuId.size(); i++) {
+        gridSize.push_back(-1);
+        gridSize.push_back(128);
+      }
+    }
+    for (int mode = BENCH_GPU_VANITY; mode <= BENCH_GPU_TXID; mode++)
+      benchGPUMode(secp, mode, gpuId, gridSize, rows);
+#else
+    printf("# GPU code not compiled, use -DWITHGPU when compiling.\n");
+#endif
+  }
+
+  report(rows, outputFile);
+
+}
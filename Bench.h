@@ -0,0 +1,32 @@
+/*
+ * This file is part of the VanitySearch distribution (https://github.com/JeanLucPons/VanitySearch).
+ * Copyright (c) 2019 Jean Luc PONS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BENCHH
+#define BENCHH
+
+#include <string>
+#include <vector>
+#include "SECP256k1.h"
+
+// Built-in benchmark harness (-bench)
+// Exercises each engine against an unreachable target for a fixed key budget
+// and emits a CSV report on stdout (and JSON to the -o file when given) so
+// that throughput regressions can be tracked across releases
+void RunBench(Secp256K1 *secp, bool useGpu, std::vector<int> gpuId,
+              std::vector<int> gridSize, std::string outputFile);
+
+#endif // BENCHH
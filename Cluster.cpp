@@ -0,0 +1,538 @@
+/*
+ * This file is part of the VanitySearch distribution (https://github.com/JeanLucPons/VanitySearch).
+ * Copyright (c) 2019 Jean Luc PONS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Cluster.h"
+#include "Timer.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef WIN64
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#define CLOSESOCKET(s) closesocket(s)
+typedef int socklen_t;
+#else
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <errno.h>
+#define CLOSESOCKET(s) close(s)
+#endif
+
+using namespace std;
+
+// ----------------------------------------------------------------------------
+
+static void socketStartup() {
+
+#ifdef WIN64
+  static bool done = false;
+  if (!done) {
+    WSADATA wsa;
+    WSAStartup(MAKEWORD(2, 2), &wsa);
+    done = true;
+  }
+#endif
+
+}
+
+// ----------------------------------------------------------------------------
+// Coordinator
+// ----------------------------------------------------------------------------
+
+ClusterCoordinator::ClusterCoordinator(int port, Int &baseKey, uint64_t leaseKeys,
+                                       std::string outputFile, double leaseTimeout) {
+
+  this->port = port;
+  this->baseKey.Set(&baseKey);
+  this->leaseKeys = leaseKeys;
+  this->outputFile = outputFile;
+  this->leaseTimeout = leaseTimeout;
+  this->listenSock = -1;
+  this->nextSlab = 0;
+  this->nextLeaseId = 1;
+
+}
+
+Int ClusterCoordinator::leaseStart(uint64_t slab) {
+
+  // Slab n starts at baseKey + n*2^72, 256 thread slots of 2^64 keys
+  Int off;
+  off.SetInt32(0);
+  off.SetQWord(0, slab);
+  off.ShiftL(72);
+  Int start(&baseKey);
+  start.Add(&off);
+  return start;
+
+}
+
+void ClusterCoordinator::sendLease(int sock) {
+
+  uint64_t slab;
+  if (pending.size() > 0) {
+    slab = pending.back();
+    pending.pop_back();
+  } else {
+    slab = nextSlab++;
+  }
+
+  LEASE_STATE l;
+  l.id = nextLeaseId++;
+  l.slab = slab;
+  l.sock = sock;
+  l.lastSeen = Timer::get_tick();
+  l.keysDone = 0;
+  active.push_back(l);
+
+  Int start = leaseStart(slab);
+  char line[256];
+  sprintf(line, "LEASE %llu %s %llu\n", (unsigned long long)l.id,
+    start.GetBase16().c_str(), (unsigned long long)leaseKeys);
+  send(sock, line, (int)strlen(line), 0);
+
+  printf("Lease %llu: slab %llu (%s)\n", (unsigned long long)l.id,
+    (unsigned long long)slab, start.GetBase16().c_str());
+
+}
+
+void ClusterCoordinator::writeFound(char *addr, char *pAddr, char *pAddrHex) {
+
+  FILE *f = stdout;
+  bool needToClose = false;
+
+  if (outputFile.length() > 0) {
+    f = fopen(outputFile.c_str(), "a");
+    if (f == NULL) {
+      printf("Cannot open %s for writing\n", outputFile.c_str());
+      f = stdout;
+    } else {
+      needToClose = true;
+    }
+  }
+
+  // Same record shape as the worker's local output path, minus the address
+  // type prefix (only the worker knows its search type)
+  fprintf(f, "PubAddress: %s\n", addr);
+  fprintf(f, "Priv (WIF): %s\n", pAddr);
+  fprintf(f, "Priv (HEX): 0x%s\n", pAddrHex);
+
+  if (needToClose)
+    fclose(f);
+  else
+    fflush(f);
+
+}
+
+void ClusterCoordinator::handleLine(int sock, char *line) {
+
+  if (strncmp(line, "HELLO ", 6) == 0) {
+
+    sendLease(sock);
+
+  } else if (strncmp(line, "PROGRESS ", 9) == 0) {
+
+    unsigned long long id, done;
+    if (sscanf(line + 9, "%llu %llu", &id, &done) == 2) {
+      for (int i = 0; i < (int)active.size(); i++) {
+        if (active[i].id == id && active[i].sock == sock) {
+          active[i].lastSeen = Timer::get_tick();
+          active[i].keysDone = done;
+        }
+      }
+    }
+
+  } else if (strncmp(line, "DONE ", 5) == 0) {
+
+    unsigned long long id;
+    if (sscanf(line + 5, "%llu", &id) == 1) {
+      for (int i = 0; i < (int)active.size(); i++) {
+        if (active[i].id == id && active[i].sock == sock) {
+          printf("Lease %llu: done\n", id);
+          active.erase(active.begin() + i);
+          break;
+        }
+      }
+    }
+    sendLease(sock);
+
+  } else if (strncmp(line, "FOUND ", 6) == 0) {
+
+    char addr[128];
+    char pAddr[128];
+    char pAddrHex[128];
+    if (sscanf(line + 6, "%127s %127s %127s", addr, pAddr, pAddrHex) == 3) {
+      printf("Found: %s\n", addr);
+      writeFound(addr, pAddr, pAddrHex);
+    }
+
+  }
+
+}
+
+void ClusterCoordinator::dropClient(int clientIdx) {
+
+  int sock = clients[clientIdx].sock;
+
+  // Put the dead worker's leases back in the pending queue
+  for (int i = (int)active.size() - 1; i >= 0; i--) {
+    if (active[i].sock == sock) {
+      printf("Lease %llu: worker gone, slab %llu requeued\n",
+        (unsigned long long)active[i].id, (unsigned long long)active[i].slab);
+      pending.push_back(active[i].slab);
+      active.erase(active.begin() + i);
+    }
+  }
+
+  CLOSESOCKET(sock);
+  clients.erase(clients.begin() + clientIdx);
+
+}
+
+void ClusterCoordinator::checkTimeouts() {
+
+  double now = Timer::get_tick();
+
+  for (int i = (int)clients.size() - 1; i >= 0; i--) {
+    bool timedOut = false;
+    for (int j = 0; j < (int)active.size() && !timedOut; j++)
+      timedOut = (active[j].sock == clients[i].sock) &&
+                 (now - active[j].lastSeen > leaseTimeout);
+    if (timedOut)
+      dropClient(i);
+  }
+
+}
+
+void ClusterCoordinator::Run() {
+
+  socketStartup();
+
+  listenSock = (int)socket(AF_INET, SOCK_STREAM, 0);
+  if (listenSock < 0) {
+    printf("ClusterCoordinator: cannot create socket\n");
+    return;
+  }
+
+  int yes = 1;
+  setsockopt(listenSock, SOL_SOCKET, SO_REUSEADDR, (const char *)&yes, sizeof(yes));
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = INADDR_ANY;
+  addr.sin_port = htons((unsigned short)port);
+
+  if (bind(listenSock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+    printf("ClusterCoordinator: cannot bind port %d\n", port);
+    CLOSESOCKET(listenSock);
+    return;
+  }
+  if (listen(listenSock, 16) < 0) {
+    printf("ClusterCoordinator: cannot listen on port %d\n", port);
+    CLOSESOCKET(listenSock);
+    return;
+  }
+
+  printf("Coordinator listening on port %d (%llu Mkeys per lease, %.0fs timeout)\n",
+    port, (unsigned long long)(leaseKeys / 1000000ULL), leaseTimeout);
+
+#ifndef WIN64
+  setvbuf(stdout, NULL, _IONBF, 0);
+#endif
+
+  while (true) {
+
+    fd_set rd;
+    FD_ZERO(&rd);
+    FD_SET(listenSock, &rd);
+    int maxFd = listenSock;
+    for (int i = 0; i < (int)clients.size(); i++) {
+      FD_SET(clients[i].sock, &rd);
+      if (clients[i].sock > maxFd)
+        maxFd = clients[i].sock;
+    }
+
+    struct timeval tv;
+    tv.tv_sec = 1;
+    tv.tv_usec = 0;
+    int n = select(maxFd + 1, &rd, NULL, NULL, &tv);
+    if (n < 0) {
+#ifndef WIN64
+      if (errno == EINTR)
+        continue;
+#endif
+      printf("ClusterCoordinator: select failed\n");
+      break;
+    }
+
+    if (FD_ISSET(listenSock, &rd)) {
+      struct sockaddr_in peer;
+      socklen_t peerLen = sizeof(peer);
+      int s = (int)accept(listenSock, (struct sockaddr *)&peer, &peerLen);
+      if (s >= 0) {
+        printf("Worker connected from %s\n", inet_ntoa(peer.sin_addr));
+        CLIENT_STATE c;
+        c.sock = s;
+        clients.push_back(c);
+      }
+    }
+
+    for (int i = (int)clients.size() - 1; i >= 0; i--) {
+
+      if (!FD_ISSET(clients[i].sock, &rd))
+        continue;
+
+      char buff[1024];
+      int r = (int)recv(clients[i].sock, buff, sizeof(buff), 0);
+      if (r <= 0) {
+        dropClient(i);
+        continue;
+      }
+      clients[i].rxBuf.append(buff, r);
+
+      size_t eol;
+      while ((eol = clients[i].rxBuf.find('\n')) != string::npos) {
+        string line = clients[i].rxBuf.substr(0, eol);
+        clients[i].rxBuf.erase(0, eol + 1);
+        handleLine(clients[i].sock, (char *)line.c_str());
+      }
+
+    }
+
+    checkTimeouts();
+
+  }
+
+  CLOSESOCKET(listenSock);
+
+}
+
+// ----------------------------------------------------------------------------
+// Worker
+// ----------------------------------------------------------------------------
+
+ClusterWorker::ClusterWorker(std::string host, int port) {
+
+  this->host = host;
+  this->port = port;
+  this->sock = -1;
+  this->leaseId = 0;
+  this->hasLease = false;
+
+#ifdef WIN64
+  mutex = CreateMutex(NULL, FALSE, NULL);
+#else
+  mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+}
+
+void ClusterWorker::closeSock() {
+
+  if (sock >= 0) {
+    CLOSESOCKET(sock);
+    sock = -1;
+  }
+  hasLease = false;
+  rxBuf.clear();
+
+}
+
+bool ClusterWorker::connectCoordinator() {
+
+  socketStartup();
+
+  char portStr[16];
+  sprintf(portStr, "%d", port);
+
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+
+  struct addrinfo *res = NULL;
+  if (getaddrinfo(host.c_str(), portStr, &hints, &res) != 0 || res == NULL)
+    return false;
+
+  sock = (int)socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+  if (sock < 0) {
+    freeaddrinfo(res);
+    return false;
+  }
+
+  if (connect(sock, res->ai_addr, (socklen_t)res->ai_addrlen) < 0) {
+    freeaddrinfo(res);
+    closeSock();
+    return false;
+  }
+  freeaddrinfo(res);
+
+  // A LEASE answer normally comes back immediately, well below the
+  // coordinator side timeout
+#ifdef WIN64
+  DWORD tmo = 30000;
+  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (const char *)&tmo, sizeof(tmo));
+#else
+  struct timeval tmo;
+  tmo.tv_sec = 30;
+  tmo.tv_usec = 0;
+  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (const char *)&tmo, sizeof(tmo));
+#endif
+
+  char line[64];
+  sprintf(line, "HELLO %d\n", CLUSTER_PROTOCOL_VERSION);
+  if (!sendLine(line))
+    return false;
+
+  return true;
+
+}
+
+bool ClusterWorker::sendLine(std::string line) {
+
+  if (sock < 0)
+    return false;
+  if (send(sock, line.c_str(), (int)line.length(), 0) != (int)line.length()) {
+    closeSock();
+    return false;
+  }
+  return true;
+
+}
+
+bool ClusterWorker::readLine(std::string &line) {
+
+  size_t eol;
+  while ((eol = rxBuf.find('\n')) == string::npos) {
+    char buff[1024];
+    int r = (int)recv(sock, buff, sizeof(buff), 0);
+    if (r <= 0) {
+      closeSock();
+      return false;
+    }
+    rxBuf.append(buff, r);
+  }
+
+  line = rxBuf.substr(0, eol);
+  rxBuf.erase(0, eol + 1);
+  return true;
+
+}
+
+void ClusterWorker::NextLease(Int &start, uint64_t *nbKeys) {
+
+#ifdef WIN64
+  WaitForSingleObject(mutex, INFINITE);
+#else
+  pthread_mutex_lock(&mutex);
+#endif
+
+  bool printedWait = false;
+
+  while (true) {
+
+    if (sock < 0) {
+      if (!connectCoordinator()) {
+        if (!printedWait) {
+          printf("Waiting for coordinator at %s:%d...\n", host.c_str(), port);
+          printedWait = true;
+        }
+        Timer::SleepMillis(2000);
+        continue;
+      }
+    } else if (hasLease) {
+      char line[64];
+      sprintf(line, "DONE %llu\n", (unsigned long long)leaseId);
+      if (!sendLine(line))
+        continue;
+    }
+
+    string answer;
+    if (!readLine(answer))
+      continue;
+
+    unsigned long long id, keys;
+    char hex[128];
+    if (sscanf(answer.c_str(), "LEASE %llu %127s %llu", &id, hex, &keys) != 3) {
+      closeSock();
+      continue;
+    }
+
+    start.SetBase16(hex);
+    *nbKeys = keys;
+    leaseId = id;
+    hasLease = true;
+    break;
+
+  }
+
+#ifdef WIN64
+  ReleaseMutex(mutex);
+#else
+  pthread_mutex_unlock(&mutex);
+#endif
+
+}
+
+void ClusterWorker::Progress(uint64_t keysDone) {
+
+#ifdef WIN64
+  WaitForSingleObject(mutex, INFINITE);
+#else
+  pthread_mutex_lock(&mutex);
+#endif
+
+  if (sock >= 0 && hasLease) {
+    char line[64];
+    sprintf(line, "PROGRESS %llu %llu\n", (unsigned long long)leaseId,
+      (unsigned long long)keysDone);
+    sendLine(line);
+  }
+
+#ifdef WIN64
+  ReleaseMutex(mutex);
+#else
+  pthread_mutex_unlock(&mutex);
+#endif
+
+}
+
+void ClusterWorker::Found(std::string addr, std::string pAddr, std::string pAddrHex) {
+
+#ifdef WIN64
+  WaitForSingleObject(mutex, INFINITE);
+#else
+  pthread_mutex_lock(&mutex);
+#endif
+
+  if (sock >= 0)
+    sendLine("FOUND " + addr + " " + pAddr + " " + pAddrHex + "\n");
+
+#ifdef WIN64
+  ReleaseMutex(mutex);
+#else
+  pthread_mutex_unlock(&mutex);
+#endif
+
+}
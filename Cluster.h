@@ -0,0 +1,130 @@
+/*
+ * This file is part of the VanitySearch distribution (https://github.com/JeanLucPons/VanitySearch).
+ * Copyright (c) 2019 Jean Luc PONS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CLUSTERH
+#define CLUSTERH
+
+#include <string>
+#include <vector>
+#include "Int.h"
+#ifdef WIN64
+#include <Windows.h>
+#else
+#include <pthread.h>
+#endif
+
+// TCP range leasing for multi machine runs (-coordinator / -worker).
+//
+// The coordinator never searches, it carves key range leases out of the
+// seed derived base key and hands them to workers. A lease is a 2^72
+// aligned slab (256 thread slots of 2^64 keys each, the same layout a
+// standalone run spreads its threads over) plus a key budget after which
+// the worker asks for the next slab, so slabs never overlap regardless of
+// each worker's thread count. A lease whose worker stops reporting goes
+// back in the pending queue and a dead machine costs at most one lease of
+// double coverage.
+//
+// Line based ASCII protocol, worker initiated:
+//   worker:      HELLO <version>
+//   coordinator: LEASE <id> <startKeyHex> <nbKeys>
+//   worker:      PROGRESS <id> <keysDone>       (keep alive, every stats tick)
+//   worker:      DONE <id>                      (coordinator answers LEASE)
+//   worker:      FOUND <addr> <privWIF> <privHex>
+
+#define CLUSTER_PROTOCOL_VERSION 1
+
+class ClusterCoordinator {
+
+public:
+
+  ClusterCoordinator(int port, Int &baseKey, uint64_t leaseKeys, std::string outputFile,
+                     double leaseTimeout);
+  // Serve workers forever, returns only on a fatal socket error
+  void Run();
+
+private:
+
+  typedef struct {
+    int sock;
+    std::string rxBuf;
+  } CLIENT_STATE;
+
+  typedef struct {
+    uint64_t id;
+    uint64_t slab;        // Lease start is baseKey + slab*2^72
+    int sock;
+    double lastSeen;
+    uint64_t keysDone;
+  } LEASE_STATE;
+
+  void sendLease(int sock);
+  void handleLine(int sock, char *line);
+  void dropClient(int clientIdx);
+  void checkTimeouts();
+  void writeFound(char *addr, char *pAddr, char *pAddrHex);
+  Int leaseStart(uint64_t slab);
+
+  int port;
+  Int baseKey;
+  uint64_t leaseKeys;
+  std::string outputFile;
+  double leaseTimeout;
+
+  int listenSock;
+  uint64_t nextSlab;
+  uint64_t nextLeaseId;
+  std::vector<uint64_t> pending;      // Slabs returned by timed out workers
+  std::vector<LEASE_STATE> active;
+  std::vector<CLIENT_STATE> clients;
+
+};
+
+class ClusterWorker {
+
+public:
+
+  ClusterWorker(std::string host, int port);
+  // Blocks (and reconnects) until the coordinator hands out the next lease
+  void NextLease(Int &start, uint64_t *nbKeys);
+  // Keep alive, best effort: a failed send only marks the link down and the
+  // next NextLease reconnects
+  void Progress(uint64_t keysDone);
+  void Found(std::string addr, std::string pAddr, std::string pAddrHex);
+
+private:
+
+  bool connectCoordinator();
+  void closeSock();
+  bool sendLine(std::string line);
+  bool readLine(std::string &line);
+
+  std::string host;
+  int port;
+  int sock;
+  uint64_t leaseId;
+  bool hasLease;
+  std::string rxBuf;
+
+#ifdef WIN64
+  HANDLE mutex;
+#else
+  pthread_mutex_t mutex;
+#endif
+
+};
+
+#endif // CLUSTERH
@@ -0,0 +1,211 @@
+/*
+ * This file is part of the VanitySearch distribution (https://github.com/JeanLucPons/VanitySearch).
+ * Copyright (c) 2019 Jean Luc PONS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FIELDELEMENTH
+#define FIELDELEMENTH
+
+#include "Int.h"
+
+// Dedicated secp256k1 field element (P = 2^256 - 0x1000003D1)
+// Unlike the general purpose Int, values are kept in the relaxed range
+// [0,2^256) and only folded back through the 33 bit prime tail on a carry or
+// borrow, the canonical compare and subtract against P is paid once in
+// Normalize() instead of after every operation. Intended for the direct
+// (affine) point formulas where chains of adds/subs/muls run between two
+// inversions, elements are exactly 4 limbs (no NB64BLOCK padding)
+
+#define FE_FOLD 0x1000003D1ULL
+
+class FieldElement {
+
+public:
+
+  // Load from a canonically reduced Int (only the 4 low limbs are read)
+  void inline Set(Int *a) {
+    l[0] = a->bits64[0];
+    l[1] = a->bits64[1];
+    l[2] = a->bits64[2];
+    l[3] = a->bits64[3];
+  }
+
+  // Store to an Int, canonically reduced
+  void inline Get(Int *r) {
+    Normalize();
+    r->SetInt32(0);
+    r->bits64[0] = l[0];
+    r->bits64[1] = l[1];
+    r->bits64[2] = l[2];
+    r->bits64[3] = l[3];
+  }
+
+  // this = a + b
+  void inline Add(FieldElement *a, FieldElement *b) {
+    unsigned char c;
+    c = _addcarry_u64(0, a->l[0], b->l[0], l + 0);
+    c = _addcarry_u64(c, a->l[1], b->l[1], l + 1);
+    c = _addcarry_u64(c, a->l[2], b->l[2], l + 2);
+    c = _addcarry_u64(c, a->l[3], b->l[3], l + 3);
+    Fold(c);
+  }
+
+  // this = this + a
+  void inline Add(FieldElement *a) {
+    Add(this, a);
+  }
+
+  // this = a - b
+  void inline Sub(FieldElement *a, FieldElement *b) {
+    unsigned char c;
+    c = _subborrow_u64(0, a->l[0], b->l[0], l + 0);
+    c = _subborrow_u64(c, a->l[1], b->l[1], l + 1);
+    c = _subborrow_u64(c, a->l[2], b->l[2], l + 2);
+    c = _subborrow_u64(c, a->l[3], b->l[3], l + 3);
+    FoldSub(c);
+  }
+
+  // this = this - a
+  void inline Sub(FieldElement *a) {
+    Sub(this, a);
+  }
+
+  // this = -this
+  void inline Neg() {
+    unsigned char c;
+    c = _subborrow_u64(0, 0ULL, l[0], l + 0);
+    c = _subborrow_u64(c, 0ULL, l[1], l + 1);
+    c = _subborrow_u64(c, 0ULL, l[2], l + 2);
+    c = _subborrow_u64(c, 0ULL, l[3], l + 3);
+    FoldSub(c);
+  }
+
+  // this = a * b, same folding scheme as Int::ModMulK1 but on exactly 4
+  // limbs and accepting non canonical inputs
+  void inline MulK1(FieldElement *a, FieldElement *b) {
+
+    unsigned char c;
+    uint64_t ah, al;
+    uint64_t t[5];
+    uint64_t r512[8];
+    r512[5] = 0;
+    r512[6] = 0;
+    r512[7] = 0;
+
+    // 256*256 multiplier
+    umul4(a->l, b->l[0], r512);
+    umul4(a->l, b->l[1], t);
+    c = _addcarry_u64(0, r512[1], t[0], r512 + 1);
+    c = _addcarry_u64(c, r512[2], t[1], r512 + 2);
+    c = _addcarry_u64(c, r512[3], t[2], r512 + 3);
+    c = _addcarry_u64(c, r512[4], t[3], r512 + 4);
+    c = _addcarry_u64(c, r512[5], t[4], r512 + 5);
+    umul4(a->l, b->l[2], t);
+    c = _addcarry_u64(0, r512[2], t[0], r512 + 2);
+    c = _addcarry_u64(c, r512[3], t[1], r512 + 3);
+    c = _addcarry_u64(c, r512[4], t[2], r512 + 4);
+    c = _addcarry_u64(c, r512[5], t[3], r512 + 5);
+    c = _addcarry_u64(c, r512[6], t[4], r512 + 6);
+    umul4(a->l, b->l[3], t);
+    c = _addcarry_u64(0, r512[3], t[0], r512 + 3);
+    c = _addcarry_u64(c, r512[4], t[1], r512 + 4);
+    c = _addcarry_u64(c, r512[5], t[2], r512 + 5);
+    c = _addcarry_u64(c, r512[6], t[3], r512 + 6);
+    c = _addcarry_u64(c, r512[7], t[4], r512 + 7);
+
+    // Reduce from 512 to 320
+    umul4(r512 + 4, FE_FOLD, t);
+    c = _addcarry_u64(0, r512[0], t[0], r512 + 0);
+    c = _addcarry_u64(c, r512[1], t[1], r512 + 1);
+    c = _addcarry_u64(c, r512[2], t[2], r512 + 2);
+    c = _addcarry_u64(c, r512[3], t[3], r512 + 3);
+
+    // Reduce from 320 to 256
+    // No overflow possible here t[4]+c<=FE_FOLD
+    al = _umul128(t[4] + c, FE_FOLD, &ah);
+    c = _addcarry_u64(0, r512[0], al, l + 0);
+    c = _addcarry_u64(c, r512[1], ah, l + 1);
+    c = _addcarry_u64(c, r512[2], 0ULL, l + 2);
+    c = _addcarry_u64(c, r512[3], 0ULL, l + 3);
+    Fold(c);
+
+  }
+
+  // this = this * a
+  void inline MulK1(FieldElement *a) {
+    MulK1(this, a);
+  }
+
+  // this = a^2
+  void inline SquareK1(FieldElement *a) {
+    MulK1(a, a);
+  }
+
+  // Reduce to the canonical range [0,P), at most one subtract since values
+  // never exceed 2^256 < 2P
+  void inline Normalize() {
+    unsigned char c;
+    uint64_t t[4];
+    c = _subborrow_u64(0, l[0], 0xFFFFFFFEFFFFFC2FULL, t + 0);
+    c = _subborrow_u64(c, l[1], 0xFFFFFFFFFFFFFFFFULL, t + 1);
+    c = _subborrow_u64(c, l[2], 0xFFFFFFFFFFFFFFFFULL, t + 2);
+    c = _subborrow_u64(c, l[3], 0xFFFFFFFFFFFFFFFFULL, t + 3);
+    if (!c) {
+      l[0] = t[0];
+      l[1] = t[1];
+      l[2] = t[2];
+      l[3] = t[3];
+    }
+  }
+
+  uint64_t l[4];
+
+private:
+
+  // 4x1 limb multiplier (imm_umul without the NB64BLOCK padding)
+  static void inline umul4(const uint64_t *x, uint64_t y, uint64_t *dst) {
+    unsigned char c = 0;
+    uint64_t h, carry;
+    dst[0] = _umul128(x[0], y, &h); carry = h;
+    c = _addcarry_u64(c, _umul128(x[1], y, &h), carry, dst + 1); carry = h;
+    c = _addcarry_u64(c, _umul128(x[2], y, &h), carry, dst + 2); carry = h;
+    c = _addcarry_u64(c, _umul128(x[3], y, &h), carry, dst + 3); carry = h;
+    _addcarry_u64(c, 0ULL, carry, dst + 4);
+  }
+
+  // A carry out of bit 256 is worth FE_FOLD (2^256 = P + FE_FOLD)
+  void inline Fold(unsigned char c) {
+    while (c) {
+      c = _addcarry_u64(0, l[0], FE_FOLD, l + 0);
+      c = _addcarry_u64(c, l[1], 0ULL, l + 1);
+      c = _addcarry_u64(c, l[2], 0ULL, l + 2);
+      c = _addcarry_u64(c, l[3], 0ULL, l + 3);
+    }
+  }
+
+  // A borrow below 0 wrapped by 2^256, take FE_FOLD back out so the stored
+  // value is the +P representative
+  void inline FoldSub(unsigned char c) {
+    while (c) {
+      c = _subborrow_u64(0, l[0], FE_FOLD, l + 0);
+      c = _subborrow_u64(c, l[1], 0ULL, l + 1);
+      c = _subborrow_u64(c, l[2], 0ULL, l + 2);
+      c = _subborrow_u64(c, l[3], 0ULL, l + 3);
+    }
+  }
+
+};
+
+#endif // FIELDELEMENTH
@@ -23,6 +23,61 @@
 //
 // We use affine coordinates for elliptic curve point (ie Z=1)
 
+// -----------------------------------------------------------------------------------------
+// Per architecture tuning. The fatbin carries one cubin per target
+// architecture (see GENCODE in the Makefile) and the driver loads the one
+// matching the device's compute capability, so compile time __CUDA_ARCH__
+// branches are all the dispatch needed
+
+// Unroll factor of the delta x fill loop (HSIZE plain 256 bit subtracts),
+// Ampere and later have the instruction cache headroom for 8
+#if __CUDA_ARCH__ >= 800
+#define DX_UNROLL 8
+#else
+#define DX_UNROLL 4
+#endif
+
+// -----------------------------------------------------------------------------------------
+// Bloom filter stage for huge full hash160 target lists
+// hash160 is already uniform so the k indices are derived from it directly
+// (double hashing), the same function is used by the host to build the filter
+
+#define BLOOM_K 8
+
+__host__ __device__ static inline uint64_t BloomIdx(uint32_t *h, int j, uint64_t mask) {
+  uint64_t a = ((uint64_t)h[0] << 32) | h[1];
+  uint64_t b = ((uint64_t)h[2] << 32) | (h[3] ^ h[4]);
+  return (a + (uint64_t)(j + 1) * b) & mask;
+}
+
+__device__ static inline bool BloomCheck(uint32_t *h) {
+  for (int j = 0; j < BLOOM_K; j++) {
+    uint64_t idx = BloomIdx(h, j, _bloomMask);
+    if (((_bloom[idx >> 5] >> (idx & 31)) & 1) == 0)
+      return false;
+  }
+  return true;
+}
+
+// -----------------------------------------------------------------------------------------
+
+// Warp aggregated slot reservation, the matching lanes of a warp elect a
+// leader which performs a single atomicAdd for all of them. At high match
+// rates (huge -i lists, short prefixes) this removes the atomic convoy on
+// the output counter
+__device__ static inline uint32_t AtomicAddWarp(uint32_t *ctr) {
+
+  uint32_t mask = __activemask();
+  uint32_t lane = threadIdx.x & 31;
+  uint32_t leader = __ffs(mask) - 1;
+  uint32_t base;
+  if (lane == leader)
+    base = atomicAdd(ctr, __popc(mask));
+  base = __shfl_sync(mask, base, leader);
+  return base + __popc(mask & ((1u << lane) - 1));
+
+}
+
 __device__ __noinline__ void CheckPoint(uint32_t *_h, int32_t incr, int32_t endo, int32_t mode,prefix_t *prefix,
                                         uint32_t *lookup32, uint32_t maxFound, uint32_t *out,int type) {
 
@@ -43,7 +98,7 @@ __device__ __noinline__ void CheckPoint(uint32_t *_h, int32_t incr, int32_t endo
     // No lookup compute address and return
     char *pattern = (char *)lookup32;
     _GetAddress(type, _h, add);
-    if (_Match(add, pattern)) {
+    if (_psActive ? _MatchPatternSet(add) : _MatchCompiled(add, pattern)) {
       // found
       goto addItem;
     }
@@ -56,18 +111,49 @@ __device__ __noinline__ void CheckPoint(uint32_t *_h, int32_t incr, int32_t endo
 
     if (hit) {
 
+      if (_b32_nbPrefix > 0) {
+        // BECH32 refine: the whole character prefix maps to exact leading
+        // bits of hash160 (5 per char), match them against the union of
+        // targets so 16 bit slot collisions never leave the device
+        int t;
+        for (t = 0; t < _b32_nbPrefix; t++) {
+          if ((_h[0] & _b32_vm[t][2]) == _b32_vm[t][0] &&
+              (_h[1] & _b32_vm[t][3]) == _b32_vm[t][1])
+            break;
+        }
+        if (t == _b32_nbPrefix)
+          return;
+      }
+
       if (lookup32) {
         off = lookup32[pr0];
         l32 = _h[0];
         st = off;
         ed = off + hit - 1;
+        uint32_t edSlot = ed;
         while (st <= ed) {
           mi = (st + ed) / 2;
           lmi = lookup32[mi];
           if (l32 < lmi) {
             ed = mi - 1;
           } else if (l32 == lmi) {
-            // found
+            if (_fullHash) {
+              // Exact match list: compare the full hash160 of every target
+              // sharing this lPrefix, only true matches leave the device
+              uint32_t lo = mi;
+              while (lo > off && lookup32[lo - 1] == l32)
+                lo--;
+              for (; lo <= edSlot && lookup32[lo] == l32; lo++) {
+                uint32_t *t = _fullHash + (uint64_t)(lo - 65536) * 5;
+                if (t[0] == _h[0] && t[1] == _h[1] && t[2] == _h[2] &&
+                    t[3] == _h[3] && t[4] == _h[4])
+                  goto addItem;
+              }
+              return;
+            }
+            // found, the full hash must also pass the Bloom stage (if any)
+            if (_bloom && !BloomCheck(_h))
+              return;
             goto addItem;
           } else {
             st = mi + 1;
@@ -78,15 +164,15 @@ __device__ __noinline__ void CheckPoint(uint32_t *_h, int32_t incr, int32_t endo
 
     addItem:
 
-      pos = atomicAdd(out, 1);
+      pos = AtomicAddWarp(out);
       if (pos < maxFound) {
-        out[pos*ITEM_SIZE32 + 1] = tid;
-        out[pos*ITEM_SIZE32 + 2] = (uint32_t)(incr << 16) | (uint32_t)(mode << 15) | (uint32_t)(endo);
-        out[pos*ITEM_SIZE32 + 3] = _h[0];
-        out[pos*ITEM_SIZE32 + 4] = _h[1];
-        out[pos*ITEM_SIZE32 + 5] = _h[2];
-        out[pos*ITEM_SIZE32 + 6] = _h[3];
-        out[pos*ITEM_SIZE32 + 7] = _h[4];
+        out[pos*ITEM_SIZE32_VANITY + 1] = tid;
+        out[pos*ITEM_SIZE32_VANITY + 2] = (uint32_t)(incr << 16) | (uint32_t)(mode << 15) | (uint32_t)(endo);
+        out[pos*ITEM_SIZE32_VANITY + 3] = _h[0];
+        out[pos*ITEM_SIZE32_VANITY + 4] = _h[1];
+        out[pos*ITEM_SIZE32_VANITY + 5] = _h[2];
+        out[pos*ITEM_SIZE32_VANITY + 6] = _h[3];
+        out[pos*ITEM_SIZE32_VANITY + 7] = _h[4];
       }
 
     }
@@ -181,6 +267,44 @@ __device__ __noinline__ void CheckHashUncomp(prefix_t *prefix, uint64_t *px, uin
 
 }
 
+// SEARCH_BOTH variant, each candidate goes through the fused _GetHash160Both
+// instead of running the compressed and uncompressed pipelines back to back
+__device__ __noinline__ void CheckHashBoth(prefix_t *prefix, uint64_t *px, uint64_t *py, int32_t incr,
+                                           uint32_t *lookup32, uint32_t maxFound, uint32_t *out) {
+
+  uint32_t   hc[5];
+  uint32_t   hu[5];
+  uint64_t   pe1x[4];
+  uint64_t   pe2x[4];
+  uint64_t   pyn[4];
+  uint8_t    isOdd = (uint8_t)(py[0] & 1);
+
+  _GetHash160Both(px, py, isOdd, (uint8_t *)hc, (uint8_t *)hu);
+  CHECK_POINT(hc, incr, 0, true);
+  CHECK_POINT(hu, incr, 0, false);
+  _ModMult(pe1x, px, _beta);
+  _GetHash160Both(pe1x, py, isOdd, (uint8_t *)hc, (uint8_t *)hu);
+  CHECK_POINT(hc, incr, 1, true);
+  CHECK_POINT(hu, incr, 1, false);
+  _ModMult(pe2x, px, _beta2);
+  _GetHash160Both(pe2x, py, isOdd, (uint8_t *)hc, (uint8_t *)hu);
+  CHECK_POINT(hc, incr, 2, true);
+  CHECK_POINT(hu, incr, 2, false);
+
+  ModNeg256(pyn, py);
+
+  _GetHash160Both(px, pyn, !isOdd, (uint8_t *)hc, (uint8_t *)hu);
+  CHECK_POINT(hc, -incr, 0, true);
+  CHECK_POINT(hu, -incr, 0, false);
+  _GetHash160Both(pe1x, pyn, !isOdd, (uint8_t *)hc, (uint8_t *)hu);
+  CHECK_POINT(hc, -incr, 1, true);
+  CHECK_POINT(hu, -incr, 1, false);
+  _GetHash160Both(pe2x, pyn, !isOdd, (uint8_t *)hc, (uint8_t *)hu);
+  CHECK_POINT(hc, -incr, 2, true);
+  CHECK_POINT(hu, -incr, 2, false);
+
+}
+
 __device__ __noinline__ void CheckHashP2SHUncomp(prefix_t *prefix, uint64_t *px, uint64_t *py, int32_t incr,
   uint32_t *lookup32, uint32_t maxFound, uint32_t *out) {
 
@@ -211,48 +335,44 @@ __device__ __noinline__ void CheckHashP2SHUncomp(prefix_t *prefix, uint64_t *px,
 
 // -----------------------------------------------------------------------------------------
 
-__device__ __noinline__ void CheckHash(uint32_t mode, prefix_t *prefix, uint64_t *px, uint64_t *py, int32_t incr,
+// The search mode is a template parameter so that each kernel instantiation
+// only carries the code of the paths it can take, the compressed only
+// configuration pays nothing for the uncompressed hash pipeline
+
+template<uint32_t mode>
+__device__ __noinline__ void CheckHash(prefix_t *prefix, uint64_t *px, uint64_t *py, int32_t incr,
                                        uint32_t *lookup32, uint32_t maxFound, uint32_t *out) {
 
-  switch (mode) {
-  case SEARCH_COMPRESSED:
-    CheckHashComp(prefix, px, (uint8_t)(py[0] & 1), incr, lookup32, maxFound, out);
-    break;
-  case SEARCH_UNCOMPRESSED:
-    CheckHashUncomp(prefix, px, py, incr, lookup32, maxFound, out);
-    break;
-  case SEARCH_BOTH:
-    CheckHashComp(prefix, px, (uint8_t)(py[0] & 1), incr, lookup32, maxFound, out);
-    CheckHashUncomp(prefix, px, py, incr, lookup32, maxFound, out);
-    break;
+  if (mode == SEARCH_BOTH) {
+    CheckHashBoth(prefix, px, py, incr, lookup32, maxFound, out);
+  } else {
+    if (mode == SEARCH_COMPRESSED)
+      CheckHashComp(prefix, px, (uint8_t)(py[0] & 1), incr, lookup32, maxFound, out);
+    if (mode == SEARCH_UNCOMPRESSED)
+      CheckHashUncomp(prefix, px, py, incr, lookup32, maxFound, out);
   }
 
 }
 
-__device__ __noinline__ void CheckP2SHHash(uint32_t mode, prefix_t *prefix, uint64_t *px, uint64_t *py, int32_t incr,
+template<uint32_t mode>
+__device__ __noinline__ void CheckP2SHHash(prefix_t *prefix, uint64_t *px, uint64_t *py, int32_t incr,
   uint32_t *lookup32, uint32_t maxFound, uint32_t *out) {
 
-  switch (mode) {
-  case SEARCH_COMPRESSED:
-    CheckHashP2SHComp(prefix, px, (uint8_t)(py[0] & 1), incr, lookup32, maxFound, out);
-    break;
-  case SEARCH_UNCOMPRESSED:
-    CheckHashP2SHUncomp(prefix, px, py, incr, lookup32, maxFound, out);
-    break;
-  case SEARCH_BOTH:
+  if (mode == SEARCH_COMPRESSED || mode == SEARCH_BOTH)
     CheckHashP2SHComp(prefix, px, (uint8_t)(py[0] & 1), incr, lookup32, maxFound, out);
+  if (mode == SEARCH_UNCOMPRESSED || mode == SEARCH_BOTH)
     CheckHashP2SHUncomp(prefix, px, py, incr, lookup32, maxFound, out);
-    break;
-  }
 
 }
 
-#define CHECK_PREFIX(incr) CheckHash(mode, sPrefix, px, py, j*GRP_SIZE + (incr), lookup32, maxFound, out)
+#define CHECK_PREFIX(incr) CheckHash<mode>(sPrefix, px, py, incrBase + j*GRP_SIZE + (incr), lookup32, maxFound, out)
 
 // -----------------------------------------------------------------------------------------
 
-__device__ void ComputeKeys(uint32_t mode, uint64_t *startx, uint64_t *starty,
-                            prefix_t *sPrefix, uint32_t *lookup32, uint32_t maxFound, uint32_t *out) {
+template<uint32_t mode>
+__device__ void ComputeKeys(uint64_t *startx, uint64_t *starty,
+                            prefix_t *sPrefix, uint32_t *lookup32, uint32_t maxFound, uint32_t *out,
+                            uint32_t incrBase) {
 
   uint64_t dx[GRP_SIZE/2+1][4];
   uint64_t px[4];
@@ -281,6 +401,7 @@ __device__ void ComputeKeys(uint32_t mode, uint64_t *startx, uint64_t *starty,
 
     // Fill group with delta x
     uint32_t i;
+    #pragma unroll DX_UNROLL
     for (i = 0; i < HSIZE; i++)
       ModSub256(dx[i], Gx[i], sx);
     ModSub256(dx[i] , Gx[i], sx);  // For the first point
@@ -380,10 +501,12 @@ __device__ void ComputeKeys(uint32_t mode, uint64_t *startx, uint64_t *starty,
 
 // -----------------------------------------------------------------------------------------
 
-#define CHECK_PREFIX_P2SH(incr) CheckP2SHHash(mode, sPrefix, px, py, j*GRP_SIZE + (incr), lookup32, maxFound, out)
+#define CHECK_PREFIX_P2SH(incr) CheckP2SHHash<mode>(sPrefix, px, py, incrBase + j*GRP_SIZE + (incr), lookup32, maxFound, out)
 
-__device__ void ComputeKeysP2SH(uint32_t mode, uint64_t *startx, uint64_t *starty,
-  prefix_t *sPrefix, uint32_t *lookup32, uint32_t maxFound, uint32_t *out) {
+template<uint32_t mode>
+__device__ void ComputeKeysP2SH(uint64_t *startx, uint64_t *starty,
+  prefix_t *sPrefix, uint32_t *lookup32, uint32_t maxFound, uint32_t *out,
+  uint32_t incrBase) {
 
   uint64_t dx[GRP_SIZE / 2 + 1][4];
   uint64_t px[4];
@@ -412,6 +535,7 @@ __device__ void ComputeKeysP2SH(uint32_t mode, uint64_t *startx, uint64_t *start
 
     // Fill group with delta x
     uint32_t i;
+    #pragma unroll DX_UNROLL
     for (i = 0; i < HSIZE; i++)
       ModSub256(dx[i], Gx[i], sx);
     ModSub256(dx[i], Gx[i], sx);  // For the first point
@@ -517,17 +641,18 @@ __device__ void ComputeKeysP2SH(uint32_t mode, uint64_t *startx, uint64_t *start
 // Optimized kernel for compressed P2PKH address only
 
 #define CHECK_P2PKH_POINT(_incr) {                                             \
+int32_t fIncr = (int32_t)incrBase + (_incr);                                   \
 _GetHash160CompSym(px, (uint8_t *)h1, (uint8_t *)h2);                          \
-CheckPoint(h1, (_incr), 0, true, sPrefix, lookup32, maxFound, out, P2PKH);     \
-CheckPoint(h2, -(_incr), 0, true, sPrefix, lookup32, maxFound, out, P2PKH);    \
+CheckPoint(h1, (fIncr), 0, true, sPrefix, lookup32, maxFound, out, P2PKH);     \
+CheckPoint(h2, -(fIncr), 0, true, sPrefix, lookup32, maxFound, out, P2PKH);    \
 _ModMult(pe1x, px, _beta);                                                     \
 _GetHash160CompSym(pe1x, (uint8_t *)h1, (uint8_t *)h2);                        \
-CheckPoint(h1, (_incr), 1, true, sPrefix, lookup32, maxFound, out, P2PKH);     \
-CheckPoint(h2, -(_incr), 1, true, sPrefix, lookup32, maxFound, out, P2PKH);    \
+CheckPoint(h1, (fIncr), 1, true, sPrefix, lookup32, maxFound, out, P2PKH);     \
+CheckPoint(h2, -(fIncr), 1, true, sPrefix, lookup32, maxFound, out, P2PKH);    \
 _ModMult(pe2x, px, _beta2);                                                    \
 _GetHash160CompSym(pe2x, (uint8_t *)h1, (uint8_t *)h2);                        \
-CheckPoint(h1, (_incr), 2, true, sPrefix, lookup32, maxFound, out, P2PKH);     \
-CheckPoint(h2, -(_incr), 2, true, sPrefix, lookup32, maxFound, out, P2PKH);    \
+CheckPoint(h1, (fIncr), 2, true, sPrefix, lookup32, maxFound, out, P2PKH);     \
+CheckPoint(h2, -(fIncr), 2, true, sPrefix, lookup32, maxFound, out, P2PKH);    \
 }
 
 // -----------------------------------------------------------------------------------------
@@ -536,32 +661,41 @@ CheckPoint(h2, -(_incr), 2, true, sPrefix, lookup32, maxFound, out, P2PKH);    \
 // Uses secp256k1 endomorphism: lambda*P = (beta*x, y) where lambda^3 = 1 mod n
 // -----------------------------------------------------------------------------------------
 
+// Test an X coordinate against every (value, mask) pair in constant memory,
+// returns the index of the first matching target or -1
+__device__ int MatchStegoTarget(uint64_t *px) {
+
+  for (int t = 0; t < _stego_nbTarget; t++) {
+    bool match = true;
+    for (int i = 0; i < 4; i++) {
+      if ((px[i] & _stego_mask[t][i]) != (_stego_value[t][i] & _stego_mask[t][i])) {
+        match = false;
+        break;
+      }
+    }
+    if (match)
+      return t;
+  }
+  return -1;
+
+}
+
 __device__ __noinline__ void CheckStegoPointEndo(uint64_t *px, int32_t incr, int endo, uint32_t maxFound, uint32_t *out) {
 
   uint32_t tid = (blockIdx.x * blockDim.x) + threadIdx.x;
 
-  // Check if (px & mask) == (target & mask)
-  // Using constant memory: _stego_value[4] and _stego_mask[4]
-  bool match = true;
-  for (int i = 0; i < 4; i++) {
-    if ((px[i] & _stego_mask[i]) != (_stego_value[i] & _stego_mask[i])) {
-      match = false;
-      break;
-    }
-  }
+  // Check if (px & mask) == (target & mask) for any of the targets
+  int target = MatchStegoTarget(px);
 
-  if (match) {
-    uint32_t pos = atomicAdd(out, 1);
+  if (target >= 0) {
+    uint32_t pos = AtomicAddWarp(out);
     if (pos < maxFound) {
-      out[pos * ITEM_SIZE32 + 1] = tid;
-      // incr in high 16 bits, mode=1 (compressed) in bit 15, endo in bits 0-1
-      out[pos * ITEM_SIZE32 + 2] = (uint32_t)((incr << 16) | (1 << 15) | (endo & 0x3));
-      // Store first 160 bits of X coordinate for quick verification
-      out[pos * ITEM_SIZE32 + 3] = (uint32_t)(px[0]);
-      out[pos * ITEM_SIZE32 + 4] = (uint32_t)(px[0] >> 32);
-      out[pos * ITEM_SIZE32 + 5] = (uint32_t)(px[1]);
-      out[pos * ITEM_SIZE32 + 6] = (uint32_t)(px[1] >> 32);
-      out[pos * ITEM_SIZE32 + 7] = (uint32_t)(px[2]);
+      // tid/incr/endo are all the host needs, it recomputes and verifies X
+      // from them so the record stays at 8 bytes
+      out[pos * ITEM_SIZE32_STEGO + 1] = tid;
+      // incr in high 16 bits, mode=1 (compressed) in bit 15, matched target
+      // index in bits 2-9, endo in bits 0-1
+      out[pos * ITEM_SIZE32_STEGO + 2] = (uint32_t)((incr << 16) | (1 << 15) | ((target & 0xFF) << 2) | (endo & 0x3));
     }
   }
 }
@@ -589,9 +723,10 @@ __device__ __noinline__ void CheckStegoPointAll(uint64_t *px, int32_t incr, uint
   CheckStegoPointEndo(pe2x, -incr, 2, maxFound, out);
 }
 
-#define CHECK_STEGO_POINT(_incr) CheckStegoPointAll(px, (_incr), maxFound, out)
+#define CHECK_STEGO_POINT(_incr) CheckStegoPointAll(px, (int32_t)incrBase + (_incr), maxFound, out)
 
-__device__ void ComputeKeysStego(uint64_t *startx, uint64_t *starty, uint32_t maxFound, uint32_t *out) {
+__device__ void ComputeKeysStego(uint64_t *startx, uint64_t *starty, uint32_t maxFound, uint32_t *out,
+                                 uint32_t incrBase) {
 
   uint64_t dx[GRP_SIZE/2+1][4];
   uint64_t px[4];
@@ -614,6 +749,7 @@ __device__ void ComputeKeysStego(uint64_t *startx, uint64_t *starty, uint32_t ma
 
     // Fill group with delta x
     uint32_t i;
+    #pragma unroll DX_UNROLL
     for (i = 0; i < HSIZE; i++)
       ModSub256(dx[i], Gx[i], sx);
     ModSub256(dx[i] , Gx[i], sx);  // For the first point
@@ -706,7 +842,8 @@ __device__ void ComputeKeysStego(uint64_t *startx, uint64_t *starty, uint32_t ma
 
 // -----------------------------------------------------------------------------------------
 
-__device__ void ComputeKeysComp(uint64_t *startx, uint64_t *starty, prefix_t *sPrefix, uint32_t *lookup32, uint32_t maxFound, uint32_t *out) {
+__device__ void ComputeKeysComp(uint64_t *startx, uint64_t *starty, prefix_t *sPrefix, uint32_t *lookup32, uint32_t maxFound, uint32_t *out,
+                                uint32_t incrBase) {
 
   uint64_t dx[GRP_SIZE/2+1][4];
   uint64_t px[4];
@@ -733,6 +870,7 @@ __device__ void ComputeKeysComp(uint64_t *startx, uint64_t *starty, prefix_t *sP
 
     // Fill group with delta x
     uint32_t i;
+    #pragma unroll DX_UNROLL
     for (i = 0; i < HSIZE; i++)
       ModSub256(dx[i], Gx[i], sx);
     ModSub256(dx[i] , Gx[i], sx);  // For the first point
@@ -989,19 +1127,14 @@ __device__ void ScalarMultG(uint64_t Rx[4], uint64_t Ry[4], uint64_t scalar[4])
 
 // Check if Qx matches stego target (uses _stego_value and _stego_mask from constant memory)
 __device__ bool CheckTaprootMatch(uint64_t Qx[4]) {
-  for (int i = 0; i < 4; i++) {
-    if ((Qx[i] & _stego_mask[i]) != (_stego_value[i] & _stego_mask[i])) {
-      return false;
-    }
-  }
-  return true;
+  return MatchStegoTarget(Qx) >= 0;
 }
 
 // Taproot compute kernel: Q = P + hash("TapTweak" || P.x) * G
 // Simplified taproot kernel - processes just 1 point per thread to avoid timeout
 // The scalar multiplication is very slow (256 iterations), so we minimize per-thread work
 __device__ void ComputeKeysTaproot(uint64_t *startx, uint64_t *starty,
-                                   uint32_t maxFound, uint32_t *out) {
+                                   uint32_t maxFound, uint32_t *out, int32_t iter) {
 
   uint64_t px[4], py[4];
 
@@ -1036,15 +1169,20 @@ __device__ void ComputeKeysTaproot(uint64_t *startx, uint64_t *starty,
     uint32_t tid = (blockIdx.x * blockDim.x) + threadIdx.x;
     uint32_t pos = atomicAdd(out, 1);
     if (pos < maxFound) {
-      out[pos*ITEM_SIZE32 + 1] = tid;
-      // Bit 15 = mode (taproot=1), bits 0-14 = iteration counter
-      out[pos*ITEM_SIZE32 + 2] = (uint32_t)((_taproot_iter << 16) | (1 << 15));
-      // Store P.x MSB (the internal key we're tweaking)
-      out[pos*ITEM_SIZE32 + 3] = (uint32_t)(px[3] >> 32);
-      out[pos*ITEM_SIZE32 + 4] = (uint32_t)(px[3]);
-      // Store Q.x MSB (the output key - what we matched)
-      out[pos*ITEM_SIZE32 + 5] = (uint32_t)(Qx[3] >> 32);
-      out[pos*ITEM_SIZE32 + 6] = (uint32_t)(Qx[3]);
+      out[pos*ITEM_SIZE32_TAPROOT + 1] = tid;
+      // Bit 15 = mode (taproot=1), bits 16-31 = iteration counter
+      out[pos*ITEM_SIZE32_TAPROOT + 2] = (uint32_t)((iter << 16) | (1 << 15));
+      // Emit P.x, the reduced tweak and Q.x (little endian 32 bit words) so
+      // the host reporting path does not redo the tagged hash or t*G, only
+      // the private key reconstruction and a P.x consistency check remain
+      for (int i = 0; i < 4; i++) {
+        out[pos*ITEM_SIZE32_TAPROOT + 3 + 2*i] = (uint32_t)(px[i]);
+        out[pos*ITEM_SIZE32_TAPROOT + 4 + 2*i] = (uint32_t)(px[i] >> 32);
+        out[pos*ITEM_SIZE32_TAPROOT + 11 + 2*i] = (uint32_t)(t_scalar[i]);
+        out[pos*ITEM_SIZE32_TAPROOT + 12 + 2*i] = (uint32_t)(t_scalar[i] >> 32);
+        out[pos*ITEM_SIZE32_TAPROOT + 19 + 2*i] = (uint32_t)(Qx[i]);
+        out[pos*ITEM_SIZE32_TAPROOT + 20 + 2*i] = (uint32_t)(Qx[i] >> 32);
+      }
     }
   }
 
@@ -1086,3 +1224,489 @@ __device__ void ComputeKeysTaproot(uint64_t *startx, uint64_t *starty,
   Store256A(starty, py);
 
 }
+
+// -----------------------------------------------------------------------------------------
+// SIGNATURE MODE: R value grinding with on-device signing
+// At short masks the host confirmation path (inversion, challenge hashing)
+// starves the GPU, so the kernel completes s itself and emits fully formed
+// signatures. Scalar arithmetic is mod n = 2^256 - c with
+// c = 2^128 + 0x4551231950B75FC4*2^64 + 0x402DA1732FC9BEBF
+// -----------------------------------------------------------------------------------------
+
+#define ORDER_C0 0x402DA1732FC9BEBFULL
+#define ORDER_C1 0x4551231950B75FC4ULL
+
+// (n-1)/2 for BIP 146 low-s normalization
+__device__ __constant__ uint64_t SECP256K1_HALF_ORDER[4] = {
+  0xDFE92F46681B20A0ULL,
+  0x5D576E7357A4501DULL,
+  0xFFFFFFFFFFFFFFFFULL,
+  0x7FFFFFFFFFFFFFFFULL
+};
+
+// Endomorphism multipliers mod n (lambda^3 = 1 mod n), the nonce of a match
+// found on a beta/beta2 multiplied X coordinate is the walk key times lambda
+__device__ __constant__ uint64_t _lambda_n[4] = {
+  0xDF02967C1B23BD72ULL,
+  0x122E22EA20816678ULL,
+  0xA5261C028812645AULL,
+  0x5363AD4CC05C30E0ULL
+};
+__device__ __constant__ uint64_t _lambda2_n[4] = {
+  0xE0CFC810B51283CEULL,
+  0xA880B9FC8EC739C2ULL,
+  0x5AD9E3FD77ED9BA4ULL,
+  0xAC9C52B33FA3CF1FULL
+};
+
+// Midstate of SHA256(tagHash || tagHash) for the Schnorr challenge tagged
+// hash, tagHash = SHA256("BIP0340/challenge"). The duplicated tag prefix
+// fills exactly one block and never changes, resuming from its midstate
+// saves a compression per candidate (R.x leads the hashed data so the two
+// remaining blocks both depend on the candidate)
+__device__ __constant__ uint32_t _bip340_challenge_midstate[8] = {
+  0x9cecba11, 0x23925381, 0x11679112, 0xd1627e0f,
+  0x97c87550, 0x003cc765, 0x90f61164, 0x33e9b66a
+};
+
+// r = a + b mod n (a and b lower than n)
+__device__ void AddOrder(uint64_t *r, uint64_t *a, uint64_t *b) {
+
+  uint64_t c;
+  UADDO(r[0], a[0], b[0]);
+  UADDC(r[1], a[1], b[1]);
+  UADDC(r[2], a[2], b[2]);
+  UADDC(r[3], a[3], b[3]);
+  UADD(c, 0ULL, 0ULL);
+  if (c) {
+    // Sum wrapped past 2^256, add back 2^256 mod n = c
+    UADDO1(r[0], ORDER_C0);
+    UADDC1(r[1], ORDER_C1);
+    UADDC1(r[2], 1ULL);
+    UADD1(r[3], 0ULL);
+  }
+  ModReduceOrder(r);
+
+}
+
+// r = a - b mod n (a and b lower than n)
+__device__ void SubOrder(uint64_t *r, uint64_t *a, uint64_t *b) {
+
+  uint64_t t;
+  USUBO(r[0], a[0], b[0]);
+  USUBC(r[1], a[1], b[1]);
+  USUBC(r[2], a[2], b[2]);
+  USUBC(r[3], a[3], b[3]);
+  USUB(t, 0ULL, 0ULL);
+  if (t) {
+    // Borrow, the wrap added 2^256 so take back c to end up adding n
+    USUBO1(r[0], ORDER_C0);
+    USUBC1(r[1], ORDER_C1);
+    USUBC1(r[2], 1ULL);
+    USUB1(r[3], 0ULL);
+  }
+
+}
+
+// r = n - a (a lower than n and non zero)
+__device__ void NegOrder(uint64_t *r, uint64_t *a) {
+
+  USUBO(r[0], SECP256K1_ORDER[0], a[0]);
+  USUBC(r[1], SECP256K1_ORDER[1], a[1]);
+  USUBC(r[2], SECP256K1_ORDER[2], a[2]);
+  USUB(r[3], SECP256K1_ORDER[3], a[3]);
+
+}
+
+// r = a * b mod n
+// The 512 bit product is folded three times using 2^256 = c (mod n),
+// same scheme as _ModMult but c spans two limbs plus the 2^128 term
+__device__ void MultOrder(uint64_t *r, uint64_t *a, uint64_t *b) {
+
+  uint64_t r512[8];
+  uint64_t s[7];
+  uint64_t s2[5];
+  uint64_t h[4];
+  uint64_t t[NBBLOCK];
+  uint64_t u[NBBLOCK];
+  uint64_t h3, ah, al, bh, bl, c;
+
+  r512[5] = 0;
+  r512[6] = 0;
+  r512[7] = 0;
+
+  // 256*256 multiplier
+  UMult(r512, a, b[0]);
+  UMult(t, a, b[1]);
+  UADDO1(r512[1], t[0]);
+  UADDC1(r512[2], t[1]);
+  UADDC1(r512[3], t[2]);
+  UADDC1(r512[4], t[3]);
+  UADD1(r512[5], t[4]);
+  UMult(t, a, b[2]);
+  UADDO1(r512[2], t[0]);
+  UADDC1(r512[3], t[1]);
+  UADDC1(r512[4], t[2]);
+  UADDC1(r512[5], t[3]);
+  UADD1(r512[6], t[4]);
+  UMult(t, a, b[3]);
+  UADDO1(r512[3], t[0]);
+  UADDC1(r512[4], t[1]);
+  UADDC1(r512[5], t[2]);
+  UADDC1(r512[6], t[3]);
+  UADD1(r512[7], t[4]);
+
+  // First fold: s = low + high*c0 + (high*c1 << 64) + (high << 128), fits 7 limbs
+  s[5] = 0;
+  s[6] = 0;
+  UMult(s, (r512 + 4), ORDER_C0);
+  UMult(u, (r512 + 4), ORDER_C1);
+  UADDO1(s[1], u[0]);
+  UADDC1(s[2], u[1]);
+  UADDC1(s[3], u[2]);
+  UADDC1(s[4], u[3]);
+  UADDC1(s[5], u[4]);
+  UADD1(s[6], 0ULL);
+  UADDO1(s[2], r512[4]);
+  UADDC1(s[3], r512[5]);
+  UADDC1(s[4], r512[6]);
+  UADDC1(s[5], r512[7]);
+  UADD1(s[6], 0ULL);
+  UADDO1(s[0], r512[0]);
+  UADDC1(s[1], r512[1]);
+  UADDC1(s[2], r512[2]);
+  UADDC1(s[3], r512[3]);
+  UADDC1(s[4], 0ULL);
+  UADDC1(s[5], 0ULL);
+  UADD1(s[6], 0ULL);
+
+  // Second fold: h = s[4..6] (at most 2^130), fits 5 limbs
+  h[0] = s[4];
+  h[1] = s[5];
+  h[2] = s[6];
+  h[3] = 0;
+  UMult(s2, h, ORDER_C0);
+  UMult(u, h, ORDER_C1);
+  UADDO1(s2[1], u[0]);
+  UADDC1(s2[2], u[1]);
+  UADDC1(s2[3], u[2]);
+  UADD1(s2[4], u[3]);
+  UADDO1(s2[2], h[0]);
+  UADDC1(s2[3], h[1]);
+  UADD1(s2[4], h[2]);
+  UADDO1(s2[0], s[0]);
+  UADDC1(s2[1], s[1]);
+  UADDC1(s2[2], s[2]);
+  UADDC1(s2[3], s[3]);
+  UADD1(s2[4], 0ULL);
+
+  // Third fold: h3 = s2[4] (a few bits), at most one extra wrap remains
+  h3 = s2[4];
+  UMULLO(al, h3, ORDER_C0);
+  UMULHI(ah, h3, ORDER_C0);
+  UMULLO(bl, h3, ORDER_C1);
+  UMULHI(bh, h3, ORDER_C1);
+  UADDO(r[0], s2[0], al);
+  UADDC(r[1], s2[1], ah);
+  UADDC(r[2], s2[2], h3);
+  UADDC(r[3], s2[3], 0ULL);
+  UADD(c, 0ULL, 0ULL);
+  UADDO1(r[1], bl);
+  UADDC1(r[2], bh);
+  UADDC1(r[3], 0ULL);
+  UADD1(c, 0ULL);
+  if (c) {
+    UADDO1(r[0], ORDER_C0);
+    UADDC1(r[1], ORDER_C1);
+    UADDC1(r[2], 1ULL);
+    UADD1(r[3], 0ULL);
+  }
+  ModReduceOrder(r);
+
+}
+
+// r = a^-1 mod n via Fermat (a^(n-2)), slow but only runs on the match path
+__device__ void ModInvOrder(uint64_t *r, uint64_t *a) {
+
+  // n - 2
+  uint64_t e[4] = {
+    0xBFD25E8CD036413FULL,
+    0xBAAEDCE6AF48A03BULL,
+    0xFFFFFFFFFFFFFFFEULL,
+    0xFFFFFFFFFFFFFFFFULL
+  };
+  uint64_t base[4];
+
+  Load256(base, a);
+  r[0] = 1; r[1] = 0; r[2] = 0; r[3] = 0;
+  for (int i = 0; i < 256; i++) {
+    if ((e[i / 64] >> (i % 64)) & 1ULL)
+      MultOrder(r, r, base);
+    MultOrder(base, base, base);
+  }
+
+}
+
+// e = TaggedHash("BIP0340/challenge", R.x || P.x || m) mod n
+// Message is 96 bytes so with the duplicated tag hash the input is 160 bytes
+__device__ void SchnorrChallenge(uint64_t *e, uint64_t *rx) {
+
+  uint32_t s[8];
+  uint32_t w[16];
+
+  // Resume from the precomputed tag block midstate, two compressions left
+  for (int i = 0; i < 8; i++)
+    s[i] = _bip340_challenge_midstate[i];
+
+  // Block 2: R.x || P.x (big-endian 32 byte scalars)
+  for (int i = 0; i < 4; i++) {
+    w[2 * i] = (uint32_t)(rx[3 - i] >> 32);
+    w[2 * i + 1] = (uint32_t)(rx[3 - i]);
+    w[8 + 2 * i] = (uint32_t)(_sig_pubx[3 - i] >> 32);
+    w[8 + 2 * i + 1] = (uint32_t)(_sig_pubx[3 - i]);
+  }
+  SHA256Transform(s, w);
+
+  // Block 3: m plus padding, total length 160 bytes = 1280 bits
+  for (int i = 0; i < 4; i++) {
+    w[2 * i] = (uint32_t)(_sig_z[3 - i] >> 32);
+    w[2 * i + 1] = (uint32_t)(_sig_z[3 - i]);
+  }
+  w[8] = 0x80000000;
+  w[9] = 0;
+  w[10] = 0;
+  w[11] = 0;
+  w[12] = 0;
+  w[13] = 0;
+  w[14] = 0;
+  w[15] = 0x500;
+  SHA256Transform(s, w);
+
+  HashToScalar256(e, s);
+  ModReduceOrder(e);
+
+}
+
+// Check one X coordinate variant against the target mask and complete the
+// signature on device on a match. The nonce is rebuilt from the per thread
+// base scalar (increment, then endomorphism, then symmetric) and R = kG is
+// recomputed since the walk only carries X and parity of R.y is needed
+__device__ __noinline__ void CheckSigPoint(uint64_t *px, int32_t incr, int endo, uint64_t *k0, uint32_t maxFound, uint32_t *out) {
+
+  if (MatchStegoTarget(px) < 0)
+    return;
+
+  // k = lambda^endo * (k0 + |incr|), negated for the symmetric (incr < 0)
+  uint64_t k[4];
+  uint64_t off[4];
+  off[0] = (uint64_t)(incr < 0 ? -incr : incr);
+  off[1] = 0;
+  off[2] = 0;
+  off[3] = 0;
+  AddOrder(k, k0, off);
+  if (endo == 1)
+    MultOrder(k, k, (uint64_t *)_lambda_n);
+  else if (endo == 2)
+    MultOrder(k, k, (uint64_t *)_lambda2_n);
+  if (incr < 0)
+    NegOrder(k, k);
+
+  // R = kG (the walk only carries X, the signature needs R.y parity too)
+  uint64_t rx[4];
+  uint64_t ry[4];
+  ScalarMultG(rx, ry, k);
+
+  uint32_t parity = (uint32_t)(ry[0] & 1ULL);
+  uint64_t sig[4];
+
+  if (_sig_schnorr) {
+
+    // BIP340 requires even R.y, negate k otherwise (same R.x)
+    if (parity) {
+      NegOrder(k, k);
+      parity = 0;
+    }
+
+    // s = k + e*d with e = TaggedHash("BIP0340/challenge", R.x || P.x || m)
+    uint64_t e[4];
+    SchnorrChallenge(e, rx);
+    MultOrder(sig, e, (uint64_t *)_sig_d);
+    AddOrder(sig, sig, k);
+
+  } else {
+
+    // ECDSA: s = k^-1 * (z + r*d) mod n
+    uint64_t rn[4];
+    uint64_t ki[4];
+    Load256(rn, rx);
+    ModReduceOrder(rn);
+    MultOrder(sig, rn, (uint64_t *)_sig_d);
+    AddOrder(sig, sig, (uint64_t *)_sig_z);
+    ModInvOrder(ki, k);
+    MultOrder(sig, sig, ki);
+
+    // BIP 146 low-s normalization
+    bool high = false;
+    for (int i = 3; i >= 0; i--) {
+      if (sig[i] > SECP256K1_HALF_ORDER[i]) { high = true; break; }
+      if (sig[i] < SECP256K1_HALF_ORDER[i]) break;
+    }
+    if (high)
+      NegOrder(sig, sig);
+
+  }
+
+  uint32_t tid = (blockIdx.x * blockDim.x) + threadIdx.x;
+  uint32_t pos = atomicAdd(out, 1);
+  if (pos < maxFound) {
+    out[pos * ITEM_SIZE32_SIG + 1] = tid;
+    // incr in high 16 bits, mode=1 in bit 15, R.y parity in bit 14, endo in bits 0-1
+    out[pos * ITEM_SIZE32_SIG + 2] = (uint32_t)((incr << 16) | (1 << 15) | (parity << 14) | (endo & 0x3));
+    // k, R.x and s as little endian 32 bit words
+    for (int i = 0; i < 4; i++) {
+      out[pos * ITEM_SIZE32_SIG + 3 + 2 * i] = (uint32_t)(k[i]);
+      out[pos * ITEM_SIZE32_SIG + 4 + 2 * i] = (uint32_t)(k[i] >> 32);
+      out[pos * ITEM_SIZE32_SIG + 11 + 2 * i] = (uint32_t)(rx[i]);
+      out[pos * ITEM_SIZE32_SIG + 12 + 2 * i] = (uint32_t)(rx[i] >> 32);
+      out[pos * ITEM_SIZE32_SIG + 19 + 2 * i] = (uint32_t)(sig[i]);
+      out[pos * ITEM_SIZE32_SIG + 20 + 2 * i] = (uint32_t)(sig[i] >> 32);
+    }
+  }
+
+}
+
+// Check all 6 variations: base + 2 endomorphisms, each with symmetric (negated incr)
+__device__ __noinline__ void CheckSigPointAll(uint64_t *px, int32_t incr, uint64_t *k0, uint32_t maxFound, uint32_t *out) {
+
+  uint64_t pe1x[4];
+  uint64_t pe2x[4];
+
+  CheckSigPoint(px, incr, 0, k0, maxFound, out);
+
+  _ModMult(pe1x, px, _beta);
+  CheckSigPoint(pe1x, incr, 1, k0, maxFound, out);
+
+  _ModMult(pe2x, px, _beta2);
+  CheckSigPoint(pe2x, incr, 2, k0, maxFound, out);
+
+  CheckSigPoint(px, -incr, 0, k0, maxFound, out);
+  CheckSigPoint(pe1x, -incr, 1, k0, maxFound, out);
+  CheckSigPoint(pe2x, -incr, 2, k0, maxFound, out);
+
+}
+
+#define CHECK_SIG_POINT(_incr) CheckSigPointAll(px, (int32_t)incrBase + (_incr), k0, maxFound, out)
+
+__device__ void ComputeKeysSig(uint64_t *startx, uint64_t *starty, uint64_t *k0, uint32_t maxFound, uint32_t *out,
+                               uint32_t incrBase) {
+
+  uint64_t dx[GRP_SIZE/2+1][4];
+  uint64_t px[4];
+  uint64_t py[4];
+  uint64_t pyn[4];
+  uint64_t sx[4];
+  uint64_t sy[4];
+  uint64_t dy[4];
+  uint64_t _s[4];
+  uint64_t _p2[4];
+
+  // Load starting key
+  __syncthreads();
+  Load256A(sx, startx);
+  Load256A(sy, starty);
+  Load256(px, sx);
+  Load256(py, sy);
+
+  for (uint32_t j = 0; j < STEP_SIZE / GRP_SIZE; j++) {
+
+    // Fill group with delta x
+    uint32_t i;
+    #pragma unroll DX_UNROLL
+    for (i = 0; i < HSIZE; i++)
+      ModSub256(dx[i], Gx[i], sx);
+    ModSub256(dx[i] , Gx[i], sx);  // For the first point
+    ModSub256(dx[i+1],_2Gnx, sx);  // For the next center point
+
+    // Compute modular inverse
+    _ModInvGrouped(dx);
+
+    // We use the fact that P + i*G and P - i*G has the same deltax, so the same inverse
+    // We compute key in the positive and negative way from the center of the group
+
+    // Check starting point (center of group)
+    CHECK_SIG_POINT(j*GRP_SIZE + (GRP_SIZE/2));
+
+    ModNeg256(pyn,py);
+
+    for(i = 0; i < HSIZE; i++) {
+
+      __syncthreads();
+      // P = StartPoint + i*G
+      Load256(px, sx);
+      Load256(py, sy);
+      ModSub256(dy, Gy[i], py);
+
+      _ModMult(_s, dy, dx[i]);      //  s = (p2.y-p1.y)*inverse(p2.x-p1.x)
+      _ModSqr(_p2, _s);             // _p2 = pow2(s)
+
+      ModSub256(px, _p2,px);
+      ModSub256(px, Gx[i]);         // px = pow2(s) - p1.x - p2.x;
+
+      CHECK_SIG_POINT(j*GRP_SIZE + (GRP_SIZE/2 + (i + 1)));
+
+      __syncthreads();
+      // P = StartPoint - i*G, if (x,y) = i*G then (x,-y) = -i*G
+      Load256(px, sx);
+      ModSub256(dy,pyn,Gy[i]);
+
+      _ModMult(_s, dy, dx[i]);      //  s = (p2.y-p1.y)*inverse(p2.x-p1.x)
+      _ModSqr(_p2, _s);             // _p = pow2(s)
+
+      ModSub256(px, _p2, px);
+      ModSub256(px, Gx[i]);         // px = pow2(s) - p1.x - p2.x;
+
+      CHECK_SIG_POINT(j*GRP_SIZE + (GRP_SIZE/2 - (i + 1)));
+
+    }
+
+    __syncthreads();
+    // First point (startP - (GRP_SIZE/2)*G)
+    Load256(px, sx);
+    Load256(py, sy);
+    ModNeg256(dy, Gy[i]);
+    ModSub256(dy, py);
+
+    _ModMult(_s, dy, dx[i]);      //  s = (p2.y-p1.y)*inverse(p2.x-p1.x)
+    _ModSqr(_p2,_s);              // _p = pow2(s)
+
+    ModSub256(px, _p2, px);
+    ModSub256(px, Gx[i]);         // px = pow2(s) - p1.x - p2.x;
+
+    CHECK_SIG_POINT(j*GRP_SIZE + (0));
+
+    i++;
+
+    __syncthreads();
+    // Next start point (startP + GRP_SIZE*G)
+    Load256(px, sx);
+    Load256(py, sy);
+    ModSub256(dy, _2Gny, py);
+
+    _ModMult(_s, dy, dx[i]);      //  s = (p2.y-p1.y)*inverse(p2.x-p1.x)
+    _ModSqr(_p2, _s);             // _p2 = pow2(s)
+
+    ModSub256(px, _p2, px);
+    ModSub256(px, _2Gnx);         // px = pow2(s) - p1.x - p2.x;
+
+    ModSub256(py, _2Gnx, px);
+    _ModMult(py, _s);             // py = - s*(ret.x-p2.x)
+    ModSub256(py, _2Gny);         // py = - p2.y - s*(ret.x-p2.x);
+
+  }
+
+  // Update starting point
+  __syncthreads();
+  Store256A(startx, px);
+  Store256A(starty, py);
+
+}
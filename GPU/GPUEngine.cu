@@ -33,111 +33,234 @@
 #include "GPUMath.h"
 #include "GPUHash.h"
 #include "GPUBase58.h"
+#include "../PatternSet.h"
 #include "GPUWildcard.h"
 
 // DEFINITION of steganography constant memory - MUST be before GPUCompute.h
-__constant__ uint64_t _stego_value[4];
-__constant__ uint64_t _stego_mask[4];
+// Up to STEGO_MAX_TARGETS (value, mask) pairs tested against every X
+// coordinate, the EC walk is shared so extra targets are nearly free.
+// Sig/taproot modes set a single pair (index 0)
+__constant__ uint64_t _stego_value[STEGO_MAX_TARGETS][4];
+__constant__ uint64_t _stego_mask[STEGO_MAX_TARGETS][4];
+__constant__ int _stego_nbTarget;
+
+// BECH32 refine pairs: each bech32 data character encodes 5 bits of hash160
+// so a character prefix maps to exact leading bits. The host converts the
+// prefixes into (value, mask) pairs over the first 64 bits (4 words per
+// prefix: value0, value1, mask0, mask1) and CheckPoint drops the 16 bit
+// table collisions on device instead of shipping them over PCIe
+__constant__ uint32_t _b32_vm[BECH32_MAX_PREFIX][4];
+__constant__ int _b32_nbPrefix;
 
 // DEFINITION of TXID grinding constant memory
 __constant__ uint64_t _txid_target[4];
 __constant__ uint64_t _txid_mask[4];
-__constant__ uint8_t _raw_tx[4096];  // Max 4KB transaction
+__constant__ uint8_t _raw_tx[4096];  // Tail of the transaction (after the midstate boundary), max 4KB
 __constant__ int _tx_len;
 __constant__ int _nonce_offset;
 __constant__ int _nonce_len;
 __constant__ uint64_t _txid_base_nonce;
+// SHA256 midstate over the blocks preceding the nonce, they never change
+// so each attempt only rehashes the tail
+__constant__ uint32_t _txid_midstate[8];
+__constant__ int _tx_prefix_len;  // Bytes already hashed into the midstate (multiple of 64)
 
 // Taproot iteration counter - tracks kernel calls for key reconstruction
 __constant__ int32_t _taproot_iter;
 
+// DEFINITION of signature mode constant memory (the R value mask itself
+// reuses _stego_value/_stego_mask)
+__constant__ uint64_t _sig_d[4];     // Signing private key (mod n)
+__constant__ uint64_t _sig_z[4];     // Message hash
+__constant__ uint64_t _sig_pubx[4];  // Signing pubkey X (Schnorr challenge)
+__constant__ int _sig_schnorr;       // 1 = BIP340 Schnorr, 0 = ECDSA
+
+// Bloom filter over the full hash160 target list (huge -i input files)
+// Checked before an ITEM is emitted to kill 32-bit prefix false positives
+__constant__ uint32_t *_bloom;
+__constant__ uint64_t _bloomMask;
+
+// Exact match list: full hash160 of every target stored in second level
+// table order, the entry of a lookup32 hit at index mi sits at (mi - 64K).
+// When set, only true matches are emitted and the host verification path
+// has nothing left to reject
+__constant__ uint32_t *_fullHash;
+
+// Host mapped stop flag (zero copy), polled by the kernels between steps so
+// a persistent grid can be interrupted on rekey or end of search
+__constant__ uint32_t *_pkStop;
+
+// Early stop support: the vanity/stego kernels also bail out between steps
+// when the output item count passes _foundLimit (buffer nearly full) and
+// record in _stepRecord the first step they skipped, the host then resyncs
+// the keys and replays from there so no item is ever lost
+__constant__ uint32_t *_stepRecord;
+__constant__ uint32_t _foundLimit;
+
 #include "GPUCompute.h"
 
 // ---------------------------------------------------------------------------------------
 
-__global__ void comp_keys(uint32_t mode,prefix_t *prefix, uint32_t *lookup32, uint64_t *keys, uint32_t maxFound, uint32_t *found) {
+// All kernels loop nbStep times device side (nbStep>1 in persistent kernel
+// mode), the starting point is written back after each step so the loop
+// simply resumes where the previous step ended
+
+// Search mode is a template parameter, GPUEngine::callKernel selects among
+// the pre instantiated variants so that the hot loop carries no mode branch
+
+// The fatbin holds one cubin per GENCODE target and the driver loads the one
+// matching the device, so launch bounds are specialized per architecture at
+// compile time. 256 is the largest group size the autotuner sweeps (and Init
+// rejects larger), on sm_80+ the bigger register file leaves room to ask for
+// 2 resident blocks per SM (128 registers/thread cap) which older parts
+// cannot honour without spilling
+#if __CUDA_ARCH__ >= 800
+#define WALK_LAUNCH_BOUNDS __launch_bounds__(256, 2)
+#else
+#define WALK_LAUNCH_BOUNDS __launch_bounds__(256)
+#endif
+
+template<uint32_t mode>
+__global__ void WALK_LAUNCH_BOUNDS comp_keys(prefix_t *prefix, uint32_t *lookup32, uint64_t *keys, uint32_t maxFound, uint32_t *found, uint32_t nbStep) {
 
   int xPtr = (blockIdx.x*blockDim.x) * 8;
   int yPtr = xPtr + 4 * blockDim.x;
-  ComputeKeys(mode, keys + xPtr, keys + yPtr, prefix, lookup32, maxFound, found);
+  uint32_t step;
+  for (step = 0; step < nbStep && !*(volatile uint32_t *)_pkStop && *(volatile uint32_t *)found < _foundLimit; step++)
+    ComputeKeys<mode>(keys + xPtr, keys + yPtr, prefix, lookup32, maxFound, found, step * STEP_SIZE);
+  if (step < nbStep)
+    atomicMin(_stepRecord, step);
 
 }
 
-__global__ void comp_keys_p2sh(uint32_t mode, prefix_t *prefix, uint32_t *lookup32, uint64_t *keys, uint32_t maxFound, uint32_t *found) {
+template<uint32_t mode>
+__global__ void WALK_LAUNCH_BOUNDS comp_keys_p2sh(prefix_t *prefix, uint32_t *lookup32, uint64_t *keys, uint32_t maxFound, uint32_t *found, uint32_t nbStep) {
 
   int xPtr = (blockIdx.x*blockDim.x) * 8;
   int yPtr = xPtr + 4 * blockDim.x;
-  ComputeKeysP2SH(mode, keys + xPtr, keys + yPtr, prefix, lookup32, maxFound, found);
+  uint32_t step;
+  for (step = 0; step < nbStep && !*(volatile uint32_t *)_pkStop && *(volatile uint32_t *)found < _foundLimit; step++)
+    ComputeKeysP2SH<mode>(keys + xPtr, keys + yPtr, prefix, lookup32, maxFound, found, step * STEP_SIZE);
+  if (step < nbStep)
+    atomicMin(_stepRecord, step);
 
 }
 
-__global__ void comp_keys_comp(prefix_t *prefix, uint32_t *lookup32, uint64_t *keys, uint32_t maxFound, uint32_t *found) {
+__global__ void WALK_LAUNCH_BOUNDS comp_keys_comp(prefix_t *prefix, uint32_t *lookup32, uint64_t *keys, uint32_t maxFound, uint32_t *found, uint32_t nbStep) {
 
   int xPtr = (blockIdx.x*blockDim.x) * 8;
   int yPtr = xPtr + 4 * blockDim.x;
-  ComputeKeysComp(keys + xPtr, keys + yPtr, prefix, lookup32, maxFound, found);
+  uint32_t step;
+  for (step = 0; step < nbStep && !*(volatile uint32_t *)_pkStop && *(volatile uint32_t *)found < _foundLimit; step++)
+    ComputeKeysComp(keys + xPtr, keys + yPtr, prefix, lookup32, maxFound, found, step * STEP_SIZE);
+  if (step < nbStep)
+    atomicMin(_stepRecord, step);
 
 }
 
-__global__ void comp_keys_pattern(uint32_t mode, prefix_t *pattern, uint64_t *keys,  uint32_t maxFound, uint32_t *found) {
+template<uint32_t mode>
+__global__ void WALK_LAUNCH_BOUNDS comp_keys_pattern(prefix_t *pattern, uint64_t *keys,  uint32_t maxFound, uint32_t *found, uint32_t nbStep) {
 
   int xPtr = (blockIdx.x*blockDim.x) * 8;
   int yPtr = xPtr + 4 * blockDim.x;
-  ComputeKeys(mode, keys + xPtr, keys + yPtr, NULL, (uint32_t *)pattern, maxFound, found);
+  uint32_t step;
+  for (step = 0; step < nbStep && !*(volatile uint32_t *)_pkStop && *(volatile uint32_t *)found < _foundLimit; step++)
+    ComputeKeys<mode>(keys + xPtr, keys + yPtr, NULL, (uint32_t *)pattern, maxFound, found, step * STEP_SIZE);
+  if (step < nbStep)
+    atomicMin(_stepRecord, step);
 
 }
 
-__global__ void comp_keys_p2sh_pattern(uint32_t mode, prefix_t *pattern, uint64_t *keys, uint32_t maxFound, uint32_t *found) {
+template<uint32_t mode>
+__global__ void WALK_LAUNCH_BOUNDS comp_keys_p2sh_pattern(prefix_t *pattern, uint64_t *keys, uint32_t maxFound, uint32_t *found, uint32_t nbStep) {
 
   int xPtr = (blockIdx.x*blockDim.x) * 8;
   int yPtr = xPtr + 4 * blockDim.x;
-  ComputeKeysP2SH(mode, keys + xPtr, keys + yPtr, NULL, (uint32_t *)pattern, maxFound, found);
+  uint32_t step;
+  for (step = 0; step < nbStep && !*(volatile uint32_t *)_pkStop && *(volatile uint32_t *)found < _foundLimit; step++)
+    ComputeKeysP2SH<mode>(keys + xPtr, keys + yPtr, NULL, (uint32_t *)pattern, maxFound, found, step * STEP_SIZE);
+  if (step < nbStep)
+    atomicMin(_stepRecord, step);
 
 }
 
 // Steganography kernel - matches raw pubkey X coordinate against mask
-__global__ void comp_keys_stego(uint64_t *keys, uint32_t maxFound, uint32_t *found) {
+__global__ void WALK_LAUNCH_BOUNDS comp_keys_stego(uint64_t *keys, uint32_t maxFound, uint32_t *found, uint32_t nbStep) {
+
+  int xPtr = (blockIdx.x*blockDim.x) * 8;
+  int yPtr = xPtr + 4 * blockDim.x;
+  uint32_t step;
+  for (step = 0; step < nbStep && !*(volatile uint32_t *)_pkStop && *(volatile uint32_t *)found < _foundLimit; step++)
+    ComputeKeysStego(keys + xPtr, keys + yPtr, maxFound, found, step * STEP_SIZE);
+  if (step < nbStep)
+    atomicMin(_stepRecord, step);
+
+}
+
+// Signature kernel - same walk as stego but completes the signature on device
+// Each thread carries its base scalar so the nonce never leaves the GPU as a
+// host side reconstruction, the scalar is advanced past the steps actually
+// done (the stop flag can cut the loop short)
+__global__ void WALK_LAUNCH_BOUNDS comp_keys_sig(uint64_t *keys, uint64_t *sigKeys, uint32_t maxFound, uint32_t *found, uint32_t nbStep) {
 
   int xPtr = (blockIdx.x*blockDim.x) * 8;
   int yPtr = xPtr + 4 * blockDim.x;
-  ComputeKeysStego(keys + xPtr, keys + yPtr, maxFound, found);
+  uint32_t tid = (blockIdx.x * blockDim.x) + threadIdx.x;
+  uint64_t *k0 = sigKeys + (uint64_t)tid * 4;
+  uint32_t step;
+  for (step = 0; step < nbStep && !*(volatile uint32_t *)_pkStop; step++)
+    ComputeKeysSig(keys + xPtr, keys + yPtr, k0, maxFound, found, step * STEP_SIZE);
+
+  uint64_t off[4] = { (uint64_t)step * STEP_SIZE, 0, 0, 0 };
+  uint64_t nk[4];
+  AddOrder(nk, k0, off);
+  k0[0] = nk[0];
+  k0[1] = nk[1];
+  k0[2] = nk[2];
+  k0[3] = nk[3];
 
 }
 
 // Taproot kernel - grinds for post-tweak pubkey Q.x prefix
-__global__ void comp_keys_taproot(uint64_t *keys, uint32_t maxFound, uint32_t *found) {
+__global__ void WALK_LAUNCH_BOUNDS comp_keys_taproot(uint64_t *keys, uint32_t maxFound, uint32_t *found, uint32_t nbStep) {
 
   int xPtr = (blockIdx.x*blockDim.x) * 8;
   int yPtr = xPtr + 4 * blockDim.x;
-  ComputeKeysTaproot(keys + xPtr, keys + yPtr, maxFound, found);
+  for (uint32_t step = 0; step < nbStep && !*(volatile uint32_t *)_pkStop; step++)
+    ComputeKeysTaproot(keys + xPtr, keys + yPtr, maxFound, found, _taproot_iter + (int32_t)step);
 
 }
 
 // TXID grinding kernel - grinds nonce to match TXID pattern
-__global__ void grind_txid_kernel(uint32_t maxFound, uint32_t *found) {
+__global__ void WALK_LAUNCH_BOUNDS grind_txid_kernel(uint32_t maxFound, uint32_t *found, uint32_t nbStep) {
 
   uint32_t tid = (blockIdx.x * blockDim.x) + threadIdx.x;
 
-  // Calculate nonce for this thread
-  uint64_t nonce = _txid_base_nonce + tid;
+  for (uint32_t step = 0; step < nbStep && !*(volatile uint32_t *)_pkStop; step++) {
 
-  // Copy raw tx to local memory and insert nonce
+  // Calculate nonce for this thread, each step covers a full grid worth
+  uint64_t nonce = _txid_base_nonce + (uint64_t)step * (gridDim.x * blockDim.x) + tid;
+
+  // Only the tail after the midstate boundary changes, copy it and insert the nonce
+  int tailLen = _tx_len - _tx_prefix_len;
   uint8_t tx[4096];
-  for (int i = 0; i < _tx_len; i++) {
+  for (int i = 0; i < tailLen; i++) {
     tx[i] = _raw_tx[i];
   }
 
-  // Insert nonce at offset (little-endian)
+  // Insert nonce at offset (little-endian), relative to the tail
+  int nOff = _nonce_offset - _tx_prefix_len;
   for (int i = 0; i < _nonce_len; i++) {
-    tx[_nonce_offset + i] = (uint8_t)((nonce >> (i * 8)) & 0xFF);
+    tx[nOff + i] = (uint8_t)((nonce >> (i * 8)) & 0xFF);
   }
 
-  // ---- First SHA256 pass ----
+  // ---- First SHA256 pass, resumed from the precomputed midstate ----
   uint32_t s1[8];
-  SHA256Initialize(s1);
+  for (int i = 0; i < 8; i++)
+    s1[i] = _txid_midstate[i];
 
-  int numFullBlocks = _tx_len / 64;
-  int remaining = _tx_len % 64;
+  int numFullBlocks = tailLen / 64;
+  int remaining = tailLen % 64;
 
   // Process full 64-byte blocks
   for (int b = 0; b < numFullBlocks; b++) {
@@ -232,12 +355,12 @@ __global__ void grind_txid_kernel(uint32_t maxFound, uint32_t *found) {
     uint32_t pos = atomicAdd(found, 1);
     if (pos < maxFound) {
       // Store result: thread ID and nonce
-      found[pos * ITEM_SIZE32 + 1] = tid;
+      found[pos * ITEM_SIZE32_TXID + 1] = tid;
       // Store nonce in the incr/endo fields
-      found[pos * ITEM_SIZE32 + 2] = (uint32_t)(nonce & 0xFFFFFFFF);
+      found[pos * ITEM_SIZE32_TXID + 2] = (uint32_t)(nonce & 0xFFFFFFFF);
       // Store first 20 bytes of displayed TXID
       // s2[] is in native little-endian format, same as target/mask
-      uint32_t *hashPtr = &found[pos * ITEM_SIZE32 + 3];
+      uint32_t *hashPtr = &found[pos * ITEM_SIZE32_TXID + 3];
       hashPtr[0] = s2[7];  // TXID bytes 0-3
       hashPtr[1] = s2[6];  // TXID bytes 4-7
       hashPtr[2] = s2[5];  // TXID bytes 8-11
@@ -245,6 +368,8 @@ __global__ void grind_txid_kernel(uint32_t maxFound, uint32_t *found) {
       hashPtr[4] = s2[3];  // TXID bytes 16-19
     }
   }
+
+  }
 }
 
 //#define FULLCHECK
@@ -344,9 +469,25 @@ int _ConvertSMVer2Cores(int major, int minor) {
 
 GPUEngine::GPUEngine(int nbThreadGroup, int nbThreadPerGroup, int gpuId, uint32_t maxFound,bool rekey) {
 
+  std::vector<int> gpuIds;
+  std::vector<int> gridSize;
+  gpuIds.push_back(gpuId);
+  gridSize.push_back(nbThreadGroup);
+  gridSize.push_back(nbThreadPerGroup);
+  Init(gpuIds, gridSize, maxFound, rekey);
+
+}
+
+GPUEngine::GPUEngine(const std::vector<int> &gpuIds, const std::vector<int> &gridSize, uint32_t maxFound, bool rekey) {
+
+  Init(gpuIds, gridSize, maxFound, rekey);
+
+}
+
+void GPUEngine::Init(const std::vector<int> &gpuIds, const std::vector<int> &gridSize, uint32_t maxFound, bool rekey) {
+
   // Initialise CUDA
   this->rekey = rekey;
-  this->nbThreadPerGroup = nbThreadPerGroup;
   initialised = false;
   cudaError_t err;
 
@@ -364,95 +505,160 @@ GPUEngine::GPUEngine(int nbThreadGroup, int nbThreadPerGroup, int gpuId, uint32_
     return;
   }
 
-  err = cudaSetDevice(gpuId);
-  if (err != cudaSuccess) {
-    printf("GPUEngine: %s\n", cudaGetErrorString(err));
-    return;
-  }
+  this->maxFound = maxFound;
+  this->outputCap = maxFound * OUTPUT_OVERCOMMIT;
+  this->outputSize = (maxFound*ITEM_SIZE + 4);
+  this->itemSize = ITEM_SIZE_VANITY;
+  nbThread = 0;
+  deviceName = "";
+
+  // Each device gets its own stream and device buffers, host side staging
+  // buffers (prefix tables, starting keys) are shared by all devices
+  for (int d = 0; d < (int)gpuIds.size(); d++) {
+
+    GPU_DEVICE dev;
+    dev.gpuId = gpuIds[d];
+    dev.nbThreadPerGroup = gridSize[2*d + 1];
+    // Kernels are compiled with __launch_bounds__(256), a larger explicit
+    // -g group size would fail at launch time with a cryptic error
+    if (dev.nbThreadPerGroup > 256) {
+      printf("GPUEngine: Group size is limited to 256 threads (kernel launch bounds)\n");
+      return;
+    }
+    dev.inputPrefixLookUp = NULL;
+    dev.bloomFilter = NULL;
+    dev.fullHash = NULL;
+    dev.inputSigKey = NULL;
 
-  cudaDeviceProp deviceProp;
-  cudaGetDeviceProperties(&deviceProp, gpuId);
+    err = cudaSetDevice(dev.gpuId);
+    if (err != cudaSuccess) {
+      printf("GPUEngine: %s\n", cudaGetErrorString(err));
+      return;
+    }
 
-  if (nbThreadGroup == -1)
-    nbThreadGroup = deviceProp.multiProcessorCount * 8;
+    cudaDeviceProp deviceProp;
+    cudaGetDeviceProperties(&deviceProp, dev.gpuId);
+
+    int nbThreadGroup = gridSize[2*d];
+    if (nbThreadGroup == -1)
+      nbThreadGroup = deviceProp.multiProcessorCount * 8;
+
+    dev.nbThread = nbThreadGroup * dev.nbThreadPerGroup;
+    dev.threadBase = nbThread;
+    nbThread += dev.nbThread;
+
+    char tmp[512];
+    sprintf(tmp,"GPU #%d %s (%dx%d cores) Grid(%dx%d)",
+    dev.gpuId,deviceProp.name,deviceProp.multiProcessorCount,
+    _ConvertSMVer2Cores(deviceProp.major, deviceProp.minor),
+                        dev.nbThread / dev.nbThreadPerGroup,
+                        dev.nbThreadPerGroup);
+    if (d > 0) deviceName += ", ";
+    deviceName += std::string(tmp);
+    dev.numMP = deviceProp.multiProcessorCount;
+    dev.numCores = _ConvertSMVer2Cores(deviceProp.major, deviceProp.minor) * dev.numMP;
+
+    // Prefer L1 (We do not use __shared__ at all)
+    err = cudaDeviceSetCacheConfig(cudaFuncCachePreferL1);
+    if (err != cudaSuccess) {
+      printf("GPUEngine: %s\n", cudaGetErrorString(err));
+      return;
+    }
 
-  this->nbThread = nbThreadGroup * nbThreadPerGroup;
-  this->maxFound = maxFound;
-  this->outputSize = (maxFound*ITEM_SIZE + 4);
+    size_t stackSize = 49152;
+    err = cudaDeviceSetLimit(cudaLimitStackSize, stackSize);
+    if (err != cudaSuccess) {
+      printf("GPUEngine: %s\n", cudaGetErrorString(err));
+      return;
+    }
 
-  char tmp[512];
-  sprintf(tmp,"GPU #%d %s (%dx%d cores) Grid(%dx%d)",
-  gpuId,deviceProp.name,deviceProp.multiProcessorCount,
-  _ConvertSMVer2Cores(deviceProp.major, deviceProp.minor),
-                      nbThread / nbThreadPerGroup,
-                      nbThreadPerGroup);
-  deviceName = std::string(tmp);
-  numMP = deviceProp.multiProcessorCount;
-  numCores = _ConvertSMVer2Cores(deviceProp.major, deviceProp.minor) * numMP;
-
-  // Prefer L1 (We do not use __shared__ at all)
-  err = cudaDeviceSetCacheConfig(cudaFuncCachePreferL1);
-  if (err != cudaSuccess) {
-    printf("GPUEngine: %s\n", cudaGetErrorString(err));
-    return;
-  }
+    err = cudaStreamCreate(&dev.stream);
+    if (err != cudaSuccess) {
+      printf("GPUEngine: Create stream: %s\n", cudaGetErrorString(err));
+      return;
+    }
+    err = cudaStreamCreate(&dev.copyStream);
+    if (err != cudaSuccess) {
+      printf("GPUEngine: Create copy stream: %s\n", cudaGetErrorString(err));
+      return;
+    }
 
-  size_t stackSize = 49152;
-  err = cudaDeviceSetLimit(cudaLimitStackSize, stackSize);
-  if (err != cudaSuccess) {
-    printf("GPUEngine: %s\n", cudaGetErrorString(err));
-    return;
-  }
+    // Allocate device memory
+    err = cudaMalloc((void **)&dev.inputPrefix, _64K * 2);
+    if (err != cudaSuccess) {
+      printf("GPUEngine: Allocate prefix memory: %s\n", cudaGetErrorString(err));
+      return;
+    }
+    err = cudaMalloc((void **)&dev.inputKey, dev.nbThread * 32 * 2);
+    if (err != cudaSuccess) {
+      printf("GPUEngine: Allocate input memory: %s\n", cudaGetErrorString(err));
+      return;
+    }
+    for (int b = 0; b < 2; b++) {
+      // Device buffer is overcommitted so bursts above maxFound survive until
+      // the drain, the pinned staging buffer keeps the -m size
+      err = cudaMalloc((void **)&dev.outputPrefix[b], (size_t)outputCap*ITEM_SIZE + 4);
+      if (err != cudaSuccess) {
+        printf("GPUEngine: Allocate output memory: %s\n", cudaGetErrorString(err));
+        return;
+      }
+      // Initialize output buffer to zero to prevent garbage results on first Launch* call
+      // This is needed because SetKeys no longer calls callKernel() which would zero this buffer
+      cudaMemset(dev.outputPrefix[b], 0, (size_t)outputCap*ITEM_SIZE + 4);
+      err = cudaHostAlloc(&dev.outputPrefixPinned[b], outputSize, cudaHostAllocMapped);
+      if (err != cudaSuccess) {
+        printf("GPUEngine: Allocate output pinned memory: %s\n", cudaGetErrorString(err));
+        return;
+      }
+    }
+    dev.overflowItems = NULL;
+    dev.stepGraph[0] = NULL;
+    dev.stepGraph[1] = NULL;
 
-  /*
-  size_t heapSize = ;
-  err = cudaDeviceSetLimit(cudaLimitMallocHeapSize, heapSize);
-  if (err != cudaSuccess) {
-    printf("Error: %s\n", cudaGetErrorString(err));
-    exit(0);
-  }
+    // Host mapped stop flag (zero copy), lets the host interrupt a persistent
+    // grid between steps without waiting for the full launch to complete
+    err = cudaHostAlloc(&dev.pkStop, 4, cudaHostAllocMapped);
+    if (err != cudaSuccess) {
+      printf("GPUEngine: Allocate stop flag: %s\n", cudaGetErrorString(err));
+      return;
+    }
+    *dev.pkStop = 0;
+    err = cudaHostGetDevicePointer((void **)&dev.pkStopDev, dev.pkStop, 0);
+    if (err != cudaSuccess) {
+      printf("GPUEngine: Map stop flag: %s\n", cudaGetErrorString(err));
+      return;
+    }
+    cudaMemcpyToSymbol(_pkStop, &dev.pkStopDev, sizeof(uint32_t *));
+
+    // Early stop bookkeeping: the record word holds the first skipped step
+    // (0xFFFFFFFF when a kernel ran to completion), the limit leaves one -m
+    // worth of headroom so in flight matches of the current step still land
+    err = cudaMalloc((void **)&dev.stepRecord, 4);
+    if (err != cudaSuccess) {
+      printf("GPUEngine: Allocate step record: %s\n", cudaGetErrorString(err));
+      return;
+    }
+    cudaMemset(dev.stepRecord, 0xFF, 4);
+    cudaMemcpyToSymbol(_stepRecord, &dev.stepRecord, sizeof(uint32_t *));
+    uint32_t foundLimit = outputCap - maxFound;
+    cudaMemcpyToSymbol(_foundLimit, &foundLimit, sizeof(uint32_t));
+    dev.completedSteps = 0xFFFFFFFF;
 
-  size_t size;
-  cudaDeviceGetLimit(&size, cudaLimitStackSize);
-  printf("Stack Size %lld\n", size);
-  cudaDeviceGetLimit(&size, cudaLimitMallocHeapSize);
-  printf("Heap Size %lld\n", size);
-  */
+    devices.push_back(dev);
 
-  // Allocate memory
-  err = cudaMalloc((void **)&inputPrefix, _64K * 2);
-  if (err != cudaSuccess) {
-    printf("GPUEngine: Allocate prefix memory: %s\n", cudaGetErrorString(err));
-    return;
   }
-  err = cudaHostAlloc(&inputPrefixPinned, _64K * 2, cudaHostAllocWriteCombined | cudaHostAllocMapped);
+
+  // Shared host side staging buffers (portable so every device can copy from them)
+  err = cudaHostAlloc(&inputPrefixPinned, _64K * 2, cudaHostAllocWriteCombined | cudaHostAllocPortable);
   if (err != cudaSuccess) {
     printf("GPUEngine: Allocate prefix pinned memory: %s\n", cudaGetErrorString(err));
     return;
   }
-  err = cudaMalloc((void **)&inputKey, nbThread * 32 * 2);
-  if (err != cudaSuccess) {
-    printf("GPUEngine: Allocate input memory: %s\n", cudaGetErrorString(err));
-    return;
-  }
-  err = cudaHostAlloc(&inputKeyPinned, nbThread * 32 * 2, cudaHostAllocWriteCombined | cudaHostAllocMapped);
+  err = cudaHostAlloc(&inputKeyPinned, nbThread * 32 * 2, cudaHostAllocWriteCombined | cudaHostAllocPortable);
   if (err != cudaSuccess) {
     printf("GPUEngine: Allocate input pinned memory: %s\n", cudaGetErrorString(err));
     return;
   }
-  err = cudaMalloc((void **)&outputPrefix, outputSize);
-  if (err != cudaSuccess) {
-    printf("GPUEngine: Allocate output memory: %s\n", cudaGetErrorString(err));
-    return;
-  }
-  // Initialize output buffer to zero to prevent garbage results on first Launch* call
-  // This is needed because SetKeys no longer calls callKernel() which would zero this buffer
-  cudaMemset(outputPrefix, 0, outputSize);
-  err = cudaHostAlloc(&outputPrefixPinned, outputSize, cudaHostAllocMapped);
-  if (err != cudaSuccess) {
-    printf("GPUEngine: Allocate output pinned memory: %s\n", cudaGetErrorString(err));
-    return;
-  }
 
   searchMode = SEARCH_COMPRESSED;
   searchType = P2PKH;
@@ -460,12 +666,22 @@ GPUEngine::GPUEngine(int nbThreadGroup, int nbThreadPerGroup, int gpuId, uint32_
   pattern = "";
   hasPattern = false;
   stegoMode = false;
+  sigMode = false;
   txidMode = false;
+  inputSigKeyPinned = NULL;
   taprootIter = 0;
   txLen = 0;
   txNonceOffset = 0;
   txNonceLen = 4;
-  inputPrefixLookUp = NULL;
+  txidBaseNonce = 0;
+  curBuf = 0;
+  nbStep = 1;
+  lostWarning = false;
+  discardNext = false;
+  graphEnabled = true;
+  inputPrefixLookUpPinned = NULL;
+  kernelTime = 0.0;
+  pcieTime = 0.0;
 
 }
 
@@ -523,11 +739,32 @@ void GPUEngine::PrintCudaInfo() {
 
 GPUEngine::~GPUEngine() {
 
-  cudaFree(inputKey);
-  cudaFree(inputPrefix);
-  if(inputPrefixLookUp) cudaFree(inputPrefixLookUp);
-  cudaFreeHost(outputPrefixPinned);
-  cudaFree(outputPrefix);
+  // Interrupt a possibly running persistent grid before freeing its buffers
+  RequestStop();
+
+  for (int d = 0; d < (int)devices.size(); d++) {
+    GPU_DEVICE &dev = devices[d];
+    cudaSetDevice(dev.gpuId);
+    cudaDeviceSynchronize();
+    cudaFree(dev.inputKey);
+    cudaFree(dev.inputPrefix);
+    if(dev.inputPrefixLookUp) cudaFree(dev.inputPrefixLookUp);
+    if(dev.bloomFilter) cudaFree(dev.bloomFilter);
+    if(dev.fullHash) cudaFree(dev.fullHash);
+    if(dev.inputSigKey) cudaFree(dev.inputSigKey);
+    for (int b = 0; b < 2; b++) {
+      if (dev.stepGraph[b]) cudaGraphExecDestroy(dev.stepGraph[b]);
+      cudaFreeHost(dev.outputPrefixPinned[b]);
+      cudaFree(dev.outputPrefix[b]);
+    }
+    cudaFreeHost(dev.pkStop);
+    cudaFree(dev.stepRecord);
+    if(dev.overflowItems) free(dev.overflowItems);
+    cudaStreamDestroy(dev.stream);
+    cudaStreamDestroy(dev.copyStream);
+  }
+  if(inputKeyPinned) cudaFreeHost(inputKeyPinned);
+  if(inputSigKeyPinned) cudaFreeHost(inputSigKeyPinned);
 
 }
 
@@ -535,6 +772,208 @@ int GPUEngine::GetNbThread() {
   return nbThread;
 }
 
+void GPUEngine::SetPersistent(bool persistent) {
+  nbStep = persistent ? PK_STEPS : 1;
+  // nbStep is baked into a captured step, drop any stale graph
+  for (int d = 0; d < (int)devices.size(); d++) {
+    for (int b = 0; b < 2; b++) {
+      if (devices[d].stepGraph[b]) {
+        cudaSetDevice(devices[d].gpuId);
+        cudaGraphExecDestroy(devices[d].stepGraph[b]);
+        devices[d].stepGraph[b] = NULL;
+      }
+    }
+  }
+}
+
+int GPUEngine::GetNbStep() {
+  return (int)nbStep;
+}
+
+void GPUEngine::ResetTimings() {
+  kernelTime = 0.0;
+  pcieTime = 0.0;
+}
+
+void GPUEngine::GetTimings(double *kernel, double *pcie) {
+  *kernel = kernelTime;
+  *pcie = pcieTime;
+}
+
+// ----------------------------------------------------------------------------
+// Grid size autotuner
+// The fastest geometry is cached per device name so the sweep runs only once
+// per GPU model (our mixed fleets keep copying the wrong -g between hosts)
+
+#define TUNE_CACHE_FILE "vanitysearch.tune"
+#define TUNE_RUNS 3
+
+static bool tuneCacheLookup(std::string name, int *gridX, int *gridY) {
+
+  char line[256];
+  bool found = false;
+
+  FILE *f = fopen(TUNE_CACHE_FILE, "r");
+  if (f == NULL)
+    return false;
+
+  while (!found && fgets(line, sizeof(line), f)) {
+    int x, y;
+    char *n = strchr(line, ',');
+    if (n) n = strchr(n + 1, ',');
+    if (n == NULL || sscanf(line, "%d,%d,", &x, &y) != 2)
+      continue;
+    n++;
+    char *e = strchr(n, '\n');
+    if (e) *e = 0;
+    if (name == n) {
+      *gridX = x;
+      *gridY = y;
+      found = true;
+    }
+  }
+
+  fclose(f);
+  return found;
+
+}
+
+static void tuneCacheStore(std::string name, int gridX, int gridY) {
+
+  FILE *f = fopen(TUNE_CACHE_FILE, "a");
+  if (f == NULL) {
+    printf("GPUEngine: Autotune: cannot write %s\n", TUNE_CACHE_FILE);
+    return;
+  }
+  fprintf(f, "%d,%d,%s\n", gridX, gridY, name.c_str());
+  fclose(f);
+
+}
+
+// Time a few comp_keys launches for one grid geometry, returns a negative
+// value if the geometry cannot be launched on this device
+double GPUEngine::TuneRun(int gpuId, int nbThreadGroup, int nbThreadPerGroup) {
+
+  GPUEngine g(nbThreadGroup, nbThreadPerGroup, gpuId, 65536, false);
+  if (!g.initialised)
+    return -1.0;
+
+  g.SetSearchMode(SEARCH_COMPRESSED);
+  g.SetSearchType(P2PKH);
+  std::vector<prefix_t> prefs;
+  prefs.push_back((prefix_t)0xCA11);
+  g.SetPrefix(prefs);
+
+  // The EC walk is data independent, random limbs cost the same as real
+  // points so there is no need to compute valid starting keys here
+  int n = g.GetNbThread();
+  Point *p = new Point[n];
+  for (int i = 0; i < n; i++) {
+    p[i].x.Rand(256);
+    p[i].y.Rand(256);
+    p[i].z.SetInt32(1);
+  }
+  if (!g.SetKeys(p)) {
+    delete[] p;
+    return -1.0;
+  }
+  delete[] p;
+
+  std::vector<ITEM> found;
+  bool ok = g.Launch(found, true);
+  double t0 = Timer::get_tick();
+  for (int i = 0; i < TUNE_RUNS && ok; i++) {
+    found.clear();
+    ok = g.Launch(found, true);
+  }
+  if (!ok)
+    return -1.0;
+
+  return Timer::get_tick() - t0;
+
+}
+
+void GPUEngine::Autotune(const std::vector<int> &gpuIds, std::vector<int> &gridSize) {
+
+  for (int d = 0; d < (int)gpuIds.size(); d++) {
+
+    // Explicit -g entries are kept as is
+    if (gridSize[2*d] != -1)
+      continue;
+
+    cudaError_t err = cudaSetDevice(gpuIds[d]);
+    if (err != cudaSuccess) {
+      printf("GPUEngine: Autotune: %s\n", cudaGetErrorString(err));
+      continue;
+    }
+    cudaDeviceProp deviceProp;
+    cudaGetDeviceProperties(&deviceProp, gpuIds[d]);
+
+    int gridX;
+    int gridY;
+    if (tuneCacheLookup(deviceProp.name, &gridX, &gridY)) {
+      printf("GPU #%d %s: grid %dx%d (cached)\n", gpuIds[d], deviceProp.name, gridX, gridY);
+      gridSize[2*d] = gridX;
+      gridSize[2*d + 1] = gridY;
+      continue;
+    }
+
+    printf("GPU #%d %s: autotuning grid size...\n", gpuIds[d], deviceProp.name);
+
+    // Default heuristic as fallback if every candidate fails
+    int bestX = deviceProp.multiProcessorCount * 8;
+    int bestY = 128;
+    double bestT = -1.0;
+
+    int mults[3] = {4, 8, 16};
+    int groups[3] = {64, 128, 256};
+
+    for (int mi = 0; mi < 3; mi++) {
+      for (int gi = 0; gi < 3; gi++) {
+
+        int x = deviceProp.multiProcessorCount * mults[mi];
+        int y = groups[gi];
+        if (y > deviceProp.maxThreadsPerBlock)
+          continue;
+
+        double t = TuneRun(gpuIds[d], x, y);
+        if (t > 0.0 && (bestT < 0.0 || t < bestT)) {
+          bestT = t;
+          bestX = x;
+          bestY = y;
+        }
+
+      }
+    }
+
+    printf("GPU #%d %s: grid %dx%d selected\n", gpuIds[d], deviceProp.name, bestX, bestY);
+    tuneCacheStore(deviceProp.name, bestX, bestY);
+    gridSize[2*d] = bestX;
+    gridSize[2*d + 1] = bestY;
+
+  }
+
+}
+
+void GPUEngine::RequestStop() {
+  // Host mapped write, seen by the kernels at the next step boundary
+  // The items of the interrupted kernel relate to device points the caller
+  // is about to replace (rekey or replay resync) so the next drain drops them
+  for (int d = 0; d < (int)devices.size(); d++)
+    *devices[d].pkStop = 1;
+  discardNext = true;
+}
+
+int GPUEngine::GetCompletedSteps() {
+  // Steps every block of the last drained kernel completed, the record is
+  // 0xFFFFFFFF when no block stopped early
+  uint32_t r = nbStep;
+  for (int d = 0; d < (int)devices.size(); d++)
+    if (devices[d].completedSteps < r)
+      r = devices[d].completedSteps;
+  return (int)r;
+}
+
 void GPUEngine::SetSearchMode(int searchMode) {
   this->searchMode = searchMode;
 }
@@ -545,12 +984,16 @@ void GPUEngine::SetSearchType(int searchType) {
 
 void GPUEngine::SetPrefix(std::vector<prefix_t> prefixes) {
 
+  // Table is built once on the host and uploaded to every device
   memset(inputPrefixPinned, 0, _64K * 2);
   for(int i=0;i<(int)prefixes.size();i++)
     inputPrefixPinned[prefixes[i]]=1;
 
   // Fill device memory
-  cudaMemcpy(inputPrefix, inputPrefixPinned, _64K * 2, cudaMemcpyHostToDevice);
+  for (int d = 0; d < (int)devices.size(); d++) {
+    cudaSetDevice(devices[d].gpuId);
+    cudaMemcpy(devices[d].inputPrefix, inputPrefixPinned, _64K * 2, cudaMemcpyHostToDevice);
+  }
 
   // We do not need the input pinned memory anymore
   cudaFreeHost(inputPrefixPinned);
@@ -564,12 +1007,108 @@ void GPUEngine::SetPrefix(std::vector<prefix_t> prefixes) {
 
 }
 
+void GPUEngine::SetBech32Prefixes(const uint32_t *vm, int nbPrefix) {
+
+  // The refine is a filter over the union of all targets so it is all or
+  // nothing: a truncated upload would drop valid matches of the excluded
+  // prefixes. Above the constant memory budget keep the plain 16 bit match
+  if (nbPrefix > BECH32_MAX_PREFIX) {
+    printf("GPUEngine: SetBech32Prefixes: too many prefixes (%d > %d), device refine disabled\n",
+           nbPrefix, BECH32_MAX_PREFIX);
+    return;
+  }
+  if (nbPrefix < 1)
+    return;
+
+  for (int d = 0; d < (int)devices.size(); d++) {
+
+    cudaSetDevice(devices[d].gpuId);
+
+    cudaError_t err = cudaMemcpyToSymbol(_b32_vm, vm, (size_t)nbPrefix * 4 * sizeof(uint32_t));
+    if (err != cudaSuccess) {
+      printf("GPUEngine: SetBech32Prefixes: %s\n", cudaGetErrorString(err));
+      return;
+    }
+
+    err = cudaMemcpyToSymbol(_b32_nbPrefix, &nbPrefix, sizeof(int));
+    if (err != cudaSuccess) {
+      printf("GPUEngine: SetBech32Prefixes count: %s\n", cudaGetErrorString(err));
+      return;
+    }
+
+  }
+
+}
+
+// Compile a wildcard pattern into per position bitmasks of allowed Base58
+// digits, split around a single '*' into an anchored head and tail. Returns
+// false if the pattern cannot be anchored (several '*' or too long), the
+// kernel then falls back to the generic _Match on the raw pattern string
+static bool CompilePattern(const char *pattern, uint64_t *head, int32_t *headLen,
+                           uint64_t *tail, int32_t *tailLen, int32_t *openEnded) {
+
+  const char *b58 = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+  const uint64_t allDigits = (1ULL << 58) - 1;
+
+  *headLen = 0;
+  *tailLen = 0;
+  *openEnded = 0;
+
+  int nbStar = 0;
+  for (const char *p = pattern; *p; p++)
+    if (*p == '*') nbStar++;
+  if (nbStar > 1)
+    return false;
+
+  uint64_t *cur = head;
+  int32_t *curLen = headLen;
+  for (const char *p = pattern; *p; p++) {
+    if (*p == '*') {
+      *openEnded = 1;
+      cur = tail;
+      curLen = tailLen;
+      continue;
+    }
+    if (*curLen >= PATTERN_MAX_LEN)
+      return false;
+    if (*p == '?') {
+      cur[(*curLen)++] = allDigits;
+    } else {
+      const char *f = strchr(b58, *p);
+      if (f == NULL)
+        return false;
+      cur[(*curLen)++] = 1ULL << (f - b58);
+    }
+  }
+
+  return true;
+
+}
+
 void GPUEngine::SetPattern(const char *pattern) {
 
   strcpy((char *)inputPrefixPinned,pattern);
 
+  uint64_t head[PATTERN_MAX_LEN] = {0};
+  uint64_t tail[PATTERN_MAX_LEN] = {0};
+  int32_t headLen, tailLen, openEnded;
+  int32_t generic = CompilePattern(pattern, head, &headLen, tail, &tailLen, &openEnded) ? 0 : 1;
+
+  for (int d = 0; d < (int)devices.size(); d++) {
+    cudaSetDevice(devices[d].gpuId);
+    cudaMemcpyToSymbol(_patHead, head, sizeof(head));
+    cudaMemcpyToSymbol(_patTail, tail, sizeof(tail));
+    cudaMemcpyToSymbol(_patHeadLen, &headLen, sizeof(int32_t));
+    cudaMemcpyToSymbol(_patTailLen, &tailLen, sizeof(int32_t));
+    cudaMemcpyToSymbol(_patOpenEnded, &openEnded, sizeof(int32_t));
+    cudaMemcpyToSymbol(_patGeneric, &generic, sizeof(int32_t));
+  }
+
   // Fill device memory
-  cudaMemcpy(inputPrefix, inputPrefixPinned, _64K * 2, cudaMemcpyHostToDevice);
+  for (int d = 0; d < (int)devices.size(); d++) {
+    cudaSetDevice(devices[d].gpuId);
+    cudaMemcpy(devices[d].inputPrefix, inputPrefixPinned, _64K * 2, cudaMemcpyHostToDevice);
+  }
 
   // We do not need the input pinned memory anymore
   cudaFreeHost(inputPrefixPinned);
@@ -585,15 +1124,54 @@ void GPUEngine::SetPattern(const char *pattern) {
 
 }
 
-void GPUEngine::SetPrefix(std::vector<LPREFIX> prefixes, uint32_t totalPrefix) {
+void GPUEngine::SetPatternSet(const PatternSet &ps) {
+
+  int32_t maxHead = ps.MaxHead();
+  int32_t maxTail = ps.MaxTail();
+  int32_t active = 1;
+
+  for (int d = 0; d < (int)devices.size(); d++) {
+
+    cudaSetDevice(devices[d].gpuId);
+
+    cudaError_t err = cudaMemcpyToSymbol(_psFwd, ps.FwdTable(),
+      (size_t)PATTERN_SET_MAXLEN * 128 * PATTERN_SET_NBWORD * sizeof(uint64_t));
+    if (err != cudaSuccess) {
+      printf("GPUEngine: SetPatternSet: %s\n", cudaGetErrorString(err));
+      return;
+    }
+
+    err = cudaMemcpyToSymbol(_psBwd, ps.BwdTable(),
+      (size_t)PATTERN_SET_MAXLEN * 128 * PATTERN_SET_NBWORD * sizeof(uint64_t));
+    if (err != cudaSuccess) {
+      printf("GPUEngine: SetPatternSet: %s\n", cudaGetErrorString(err));
+      return;
+    }
+
+    cudaMemcpyToSymbol(_psFwdDone, ps.FwdDone(),
+      (size_t)PATTERN_SET_MAXLEN * PATTERN_SET_NBWORD * sizeof(uint64_t));
+    cudaMemcpyToSymbol(_psBwdDone, ps.BwdDone(),
+      (size_t)PATTERN_SET_MAXLEN * PATTERN_SET_NBWORD * sizeof(uint64_t));
+    cudaMemcpyToSymbol(_psLenOk, ps.LenTable(),
+      (size_t)64 * PATTERN_SET_NBWORD * sizeof(uint64_t));
+    cudaMemcpyToSymbol(_psMaxHead, &maxHead, sizeof(int32_t));
+    cudaMemcpyToSymbol(_psMaxTail, &maxTail, sizeof(int32_t));
+    cudaMemcpyToSymbol(_psActive, &active, sizeof(int32_t));
+
+    err = cudaGetLastError();
+    if (err != cudaSuccess) {
+      printf("GPUEngine: SetPatternSet: %s\n", cudaGetErrorString(err));
+      return;
+    }
 
-  // Allocate memory for the second level of lookup tables
-  cudaError_t err = cudaMalloc((void **)&inputPrefixLookUp, (_64K+totalPrefix) * 4);
-  if (err != cudaSuccess) {
-    printf("GPUEngine: Allocate prefix lookup memory: %s\n", cudaGetErrorString(err));
-    return;
   }
-  err = cudaHostAlloc(&inputPrefixLookUpPinned, (_64K+totalPrefix) * 4, cudaHostAllocWriteCombined | cudaHostAllocMapped);
+
+}
+
+void GPUEngine::SetPrefix(std::vector<LPREFIX> prefixes, uint32_t totalPrefix) {
+
+  // The lookup tables are built once on the host and uploaded to every device
+  cudaError_t err = cudaHostAlloc(&inputPrefixLookUpPinned, (_64K+totalPrefix) * 4, cudaHostAllocWriteCombined | cudaHostAllocPortable);
   if (err != cudaSuccess) {
     printf("GPUEngine: Allocate prefix lookup pinned memory: %s\n", cudaGetErrorString(err));
     return;
@@ -616,9 +1194,18 @@ void GPUEngine::SetPrefix(std::vector<LPREFIX> prefixes, uint32_t totalPrefix) {
     return;
   }
 
-  // Fill device memory
-  cudaMemcpy(inputPrefix, inputPrefixPinned, _64K * 2, cudaMemcpyHostToDevice);
-  cudaMemcpy(inputPrefixLookUp, inputPrefixLookUpPinned, (_64K+totalPrefix) * 4, cudaMemcpyHostToDevice);
+  // Allocate the second level of lookup tables and fill device memory
+  for (int d = 0; d < (int)devices.size(); d++) {
+    GPU_DEVICE &dev = devices[d];
+    cudaSetDevice(dev.gpuId);
+    err = cudaMalloc((void **)&dev.inputPrefixLookUp, (_64K+totalPrefix) * 4);
+    if (err != cudaSuccess) {
+      printf("GPUEngine: Allocate prefix lookup memory: %s\n", cudaGetErrorString(err));
+      return;
+    }
+    cudaMemcpy(dev.inputPrefix, inputPrefixPinned, _64K * 2, cudaMemcpyHostToDevice);
+    cudaMemcpy(dev.inputPrefixLookUp, inputPrefixLookUpPinned, (_64K+totalPrefix) * 4, cudaMemcpyHostToDevice);
+  }
 
   // We do not need the input pinned memory anymore
   cudaFreeHost(inputPrefixPinned);
@@ -634,81 +1221,294 @@ void GPUEngine::SetPrefix(std::vector<LPREFIX> prefixes, uint32_t totalPrefix) {
 
 }
 
-bool GPUEngine::callKernel() {
+void GPUEngine::SetBloomFilter(const uint8_t *hash160, uint32_t nbHash) {
 
-  // Reset nbFound
-  cudaMemset(outputPrefix,0,4);
+  cudaError_t err;
 
-  // Call the kernel (Perform STEP_SIZE keys per thread)
-  if (searchType == P2SH) {
+  // Size the filter from the list: ~16 bits per key rounded up to a power
+  // of two (k=8 gives a false positive rate around 5e-4)
+  uint64_t nbBit = _64K;
+  while (nbBit < 16ULL * nbHash)
+    nbBit <<= 1;
+  uint64_t mask = nbBit - 1;
+  uint64_t nbWord = nbBit / 32;
+
+  uint32_t *bitmap = (uint32_t *)calloc(nbWord, 4);
+  if (bitmap == NULL) {
+    printf("GPUEngine: SetBloomFilter: Unable to allocate %.1f MB bitmap\n", (double)nbWord * 4.0 / 1048576.0);
+    return;
+  }
 
-    if (hasPattern) {
-      comp_keys_p2sh_pattern << < nbThread / nbThreadPerGroup, nbThreadPerGroup >> >
-        (searchMode, inputPrefix, inputKey, maxFound, outputPrefix);
-    } else {
-      comp_keys_p2sh << < nbThread / nbThreadPerGroup, nbThreadPerGroup >> >
-        (searchMode, inputPrefix, inputPrefixLookUp, inputKey, maxFound, outputPrefix);
+  for (uint32_t i = 0; i < nbHash; i++) {
+    uint32_t h[5];
+    memcpy(h, hash160 + (size_t)i * 20, 20);
+    for (int j = 0; j < BLOOM_K; j++) {
+      uint64_t idx = BloomIdx(h, j, mask);
+      bitmap[idx >> 5] |= (1u << (idx & 31));
     }
+  }
 
-  } else {
+  for (int d = 0; d < (int)devices.size(); d++) {
 
-    // P2PKH or BECH32
-    if (hasPattern) {
-      if (searchType == BECH32) {
-        // TODO
-        printf("GPUEngine: (TODO) BECH32 not yet supported with wildard\n");
-        return false;
-      }
-      comp_keys_pattern << < nbThread / nbThreadPerGroup, nbThreadPerGroup >> >
-        (searchMode, inputPrefix, inputKey, maxFound, outputPrefix);
-    } else {
-      if (searchMode == SEARCH_COMPRESSED) {
-        comp_keys_comp << < nbThread / nbThreadPerGroup, nbThreadPerGroup >> >
-          (inputPrefix, inputPrefixLookUp, inputKey, maxFound, outputPrefix);
-      } else {
-        comp_keys << < nbThread / nbThreadPerGroup, nbThreadPerGroup >> >
-          (searchMode, inputPrefix, inputPrefixLookUp, inputKey, maxFound, outputPrefix);
-      }
+    GPU_DEVICE &dev = devices[d];
+    cudaSetDevice(dev.gpuId);
+
+    err = cudaMalloc((void **)&dev.bloomFilter, nbWord * 4);
+    if (err != cudaSuccess) {
+      printf("GPUEngine: Allocate bloom filter memory: %s\n", cudaGetErrorString(err));
+      free(bitmap);
+      return;
     }
+    cudaMemcpy(dev.bloomFilter, bitmap, nbWord * 4, cudaMemcpyHostToDevice);
+    cudaMemcpyToSymbol(_bloom, &dev.bloomFilter, sizeof(uint32_t *));
+    cudaMemcpyToSymbol(_bloomMask, &mask, sizeof(uint64_t));
 
   }
 
-  cudaError_t err = cudaGetLastError();
+  free(bitmap);
+
+  printf("Bloom filter: %u targets, %.1f MB per GPU\n", nbHash, (double)nbWord * 4.0 / 1048576.0);
+
+  err = cudaGetLastError();
   if (err != cudaSuccess) {
-    printf("GPUEngine: Kernel: %s\n", cudaGetErrorString(err));
-    return false;
+    printf("GPUEngine: SetBloomFilter: %s\n", cudaGetErrorString(err));
   }
-  return true;
 
 }
 
-bool GPUEngine::SetKeys(Point *p) {
+void GPUEngine::SetFullHashes(const uint8_t *hash160, uint32_t nbHash) {
 
-  // Sets the starting keys for each thread
-  // p must contains nbThread public keys
-  for (int i = 0; i < nbThread; i+= nbThreadPerGroup) {
-    for (int j = 0; j < nbThreadPerGroup; j++) {
+  cudaError_t err;
 
-      inputKeyPinned[8*i + j + 0* nbThreadPerGroup] = p[i + j].x.bits64[0];
-      inputKeyPinned[8*i + j + 1* nbThreadPerGroup] = p[i + j].x.bits64[1];
-      inputKeyPinned[8*i + j + 2* nbThreadPerGroup] = p[i + j].x.bits64[2];
-      inputKeyPinned[8*i + j + 3* nbThreadPerGroup] = p[i + j].x.bits64[3];
+  // hash160 must follow the second level table order (sorted lPrefixes
+  // concatenated in ascending sPrefix order): a lookup32 hit at index mi
+  // finds its full hash at (mi - 64K) so no extra indirection is needed
+  for (int d = 0; d < (int)devices.size(); d++) {
 
-      inputKeyPinned[8*i + j + 4* nbThreadPerGroup] = p[i + j].y.bits64[0];
-      inputKeyPinned[8*i + j + 5* nbThreadPerGroup] = p[i + j].y.bits64[1];
-      inputKeyPinned[8*i + j + 6* nbThreadPerGroup] = p[i + j].y.bits64[2];
-      inputKeyPinned[8*i + j + 7* nbThreadPerGroup] = p[i + j].y.bits64[3];
+    GPU_DEVICE &dev = devices[d];
+    cudaSetDevice(dev.gpuId);
 
+    err = cudaMalloc((void **)&dev.fullHash, (size_t)nbHash * 20);
+    if (err != cudaSuccess) {
+      printf("GPUEngine: Allocate full hash memory: %s\n", cudaGetErrorString(err));
+      return;
     }
+    cudaMemcpy(dev.fullHash, hash160, (size_t)nbHash * 20, cudaMemcpyHostToDevice);
+    cudaMemcpyToSymbol(_fullHash, &dev.fullHash, sizeof(uint32_t *));
+
   }
 
-  // Fill device memory
-  cudaMemcpy(inputKey, inputKeyPinned, nbThread*32*2, cudaMemcpyHostToDevice);
+  printf("Exact match list: %u targets, %.1f MB per GPU\n", nbHash, (double)nbHash * 20.0 / 1048576.0);
 
-  if (!rekey) {
-    // We do not need the input pinned memory anymore
-    cudaFreeHost(inputKeyPinned);
-    inputKeyPinned = NULL;
+  err = cudaGetLastError();
+  if (err != cudaSuccess) {
+    printf("GPUEngine: SetFullHashes: %s\n", cudaGetErrorString(err));
+  }
+
+}
+
+// Every GPU step replays the same reset/launch/count copy cycle and the per
+// step cudaMemsetAsync/launch/cudaMemcpyAsync calls cost tens of microseconds
+// of host CPU each. The first step issued into each output buffer is captured
+// into a CUDA graph and later steps replay the instantiated graph with a
+// single cudaGraphLaunch. Device pointers, grid geometry and nbStep are fixed
+// once the search runs so a captured step stays valid across rekeys, per step
+// varying values (taproot iteration, txid base nonce) travel through constant
+// symbols updated outside the capture
+
+bool GPUEngine::beginStepCapture(GPU_DEVICE &dev) {
+
+  if (!graphEnabled)
+    return false;
+  return cudaStreamBeginCapture(dev.stream, cudaStreamCaptureModeThreadLocal) == cudaSuccess;
+
+}
+
+bool GPUEngine::endStepCapture(GPU_DEVICE &dev) {
+
+  cudaGraph_t graph;
+  cudaGraphExec_t exec;
+
+  if (cudaStreamEndCapture(dev.stream, &graph) != cudaSuccess) {
+    printf("GPUEngine: Step capture (GPU #%d): %s\n", dev.gpuId,
+      cudaGetErrorString(cudaGetLastError()));
+    graphEnabled = false;
+    return false;
+  }
+
+#if CUDART_VERSION >= 12000
+  cudaError_t err = cudaGraphInstantiate(&exec, graph, 0);
+#else
+  cudaError_t err = cudaGraphInstantiate(&exec, graph, NULL, NULL, 0);
+#endif
+  cudaGraphDestroy(graph);
+  if (err != cudaSuccess) {
+    printf("GPUEngine: Graph instantiation (GPU #%d): %s\n", dev.gpuId, cudaGetErrorString(err));
+    graphEnabled = false;
+    return false;
+  }
+
+  dev.stepGraph[curBuf] = exec;
+
+  // Captured work does not execute, replay the graph to run this step
+  cudaGraphLaunch(exec, dev.stream);
+  return true;
+
+}
+
+bool GPUEngine::callKernel() {
+
+  itemSize = ITEM_SIZE_VANITY;
+
+  if (hasPattern && searchType == BECH32) {
+    // TODO
+    printf("GPUEngine: (TODO) BECH32 not yet supported with wildard\n");
+    return false;
+  }
+
+  for (int d = 0; d < (int)devices.size(); d++) {
+
+    GPU_DEVICE &dev = devices[d];
+    cudaSetDevice(dev.gpuId);
+
+    // Re-arm the stop flag (previous kernel has completed) and replay the
+    // captured step when we already have one
+    *dev.pkStop = 0;
+    if (dev.stepGraph[curBuf] != NULL) {
+      cudaGraphLaunch(dev.stepGraph[curBuf], dev.stream);
+      cudaError_t err = cudaGetLastError();
+      if (err != cudaSuccess) {
+        printf("GPUEngine: Kernel (GPU #%d): %s\n", dev.gpuId, cudaGetErrorString(err));
+        return false;
+      }
+      continue;
+    }
+
+    bool capturing = beginStepCapture(dev);
+
+    // Reset nbFound and the step record
+    cudaMemsetAsync(dev.outputPrefix[curBuf],0,4,dev.stream);
+    cudaMemsetAsync(dev.stepRecord,0xFF,4,dev.stream);
+
+    // Call the kernel (Perform nbStep*STEP_SIZE keys per thread)
+    // Select among the pre instantiated search mode variants, the mode is a
+    // template parameter so the hot loop carries no runtime branch on it
+#define LAUNCH_MODES(kernel, ...)                                                                                               \
+    switch (searchMode) {                                                                                                       \
+    case SEARCH_UNCOMPRESSED:                                                                                                   \
+      kernel<SEARCH_UNCOMPRESSED> << < dev.nbThread / dev.nbThreadPerGroup, dev.nbThreadPerGroup, 0, dev.stream >> > (__VA_ARGS__); \
+      break;                                                                                                                    \
+    case SEARCH_BOTH:                                                                                                           \
+      kernel<SEARCH_BOTH> << < dev.nbThread / dev.nbThreadPerGroup, dev.nbThreadPerGroup, 0, dev.stream >> > (__VA_ARGS__);     \
+      break;                                                                                                                    \
+    default:                                                                                                                    \
+      kernel<SEARCH_COMPRESSED> << < dev.nbThread / dev.nbThreadPerGroup, dev.nbThreadPerGroup, 0, dev.stream >> > (__VA_ARGS__); \
+      break;                                                                                                                    \
+    }
+
+    if (searchType == P2SH) {
+
+      if (hasPattern) {
+        LAUNCH_MODES(comp_keys_p2sh_pattern, dev.inputPrefix, dev.inputKey, outputCap, dev.outputPrefix[curBuf], nbStep)
+      } else {
+        LAUNCH_MODES(comp_keys_p2sh, dev.inputPrefix, dev.inputPrefixLookUp, dev.inputKey, outputCap, dev.outputPrefix[curBuf], nbStep)
+      }
+
+    } else {
+
+      // P2PKH or BECH32
+      if (hasPattern) {
+        LAUNCH_MODES(comp_keys_pattern, dev.inputPrefix, dev.inputKey, outputCap, dev.outputPrefix[curBuf], nbStep)
+      } else {
+        if (searchMode == SEARCH_COMPRESSED) {
+          // Hand specialized compressed kernel (symmetric points share their
+          // hash pipeline), kept over the template instantiation
+          comp_keys_comp << < dev.nbThread / dev.nbThreadPerGroup, dev.nbThreadPerGroup, 0, dev.stream >> >
+            (dev.inputPrefix, dev.inputPrefixLookUp, dev.inputKey, outputCap, dev.outputPrefix[curBuf], nbStep);
+        } else {
+          LAUNCH_MODES(comp_keys, dev.inputPrefix, dev.inputPrefixLookUp, dev.inputKey, outputCap, dev.outputPrefix[curBuf], nbStep)
+        }
+      }
+
+    }
+
+#undef LAUNCH_MODES
+
+    // Fetch the found count as part of the step, waitKernels reads it from
+    // the pinned buffer once the stream has drained
+    cudaMemcpyAsync(dev.outputPrefixPinned[curBuf], dev.outputPrefix[curBuf], 4,
+      cudaMemcpyDeviceToHost, dev.stream);
+
+    if (capturing && !endStepCapture(dev))
+      return false;
+
+    cudaError_t err = cudaGetLastError();
+    if (err != cudaSuccess) {
+      printf("GPUEngine: Kernel (GPU #%d): %s\n", dev.gpuId, cudaGetErrorString(err));
+      return false;
+    }
+
+  }
+
+  return true;
+
+}
+
+bool GPUEngine::SetKeys(Point *p, Int *sigKeys) {
+
+  // Sets the starting keys for each thread
+  // p must contains nbThread public keys, each device gets its own slice
+  // In sig mode sigKeys holds the matching private scalars, uploaded so the
+  // kernel can rebuild the nonce of a match without a host round trip
+  for (int d = 0; d < (int)devices.size(); d++) {
+
+    GPU_DEVICE &dev = devices[d];
+    uint64_t *kp = inputKeyPinned + (uint64_t)dev.threadBase * 8;
+    Point *dp = p + dev.threadBase;
+
+    for (int i = 0; i < dev.nbThread; i+= dev.nbThreadPerGroup) {
+      for (int j = 0; j < dev.nbThreadPerGroup; j++) {
+
+        kp[8*i + j + 0* dev.nbThreadPerGroup] = dp[i + j].x.bits64[0];
+        kp[8*i + j + 1* dev.nbThreadPerGroup] = dp[i + j].x.bits64[1];
+        kp[8*i + j + 2* dev.nbThreadPerGroup] = dp[i + j].x.bits64[2];
+        kp[8*i + j + 3* dev.nbThreadPerGroup] = dp[i + j].x.bits64[3];
+
+        kp[8*i + j + 4* dev.nbThreadPerGroup] = dp[i + j].y.bits64[0];
+        kp[8*i + j + 5* dev.nbThreadPerGroup] = dp[i + j].y.bits64[1];
+        kp[8*i + j + 6* dev.nbThreadPerGroup] = dp[i + j].y.bits64[2];
+        kp[8*i + j + 7* dev.nbThreadPerGroup] = dp[i + j].y.bits64[3];
+
+      }
+    }
+
+    // Fill device memory
+    cudaSetDevice(dev.gpuId);
+    cudaMemcpy(dev.inputKey, kp, dev.nbThread*32*2, cudaMemcpyHostToDevice);
+
+    if (sigKeys != NULL && dev.inputSigKey != NULL) {
+      // Plain per thread layout (tid*4 + limb), only read on the match path
+      uint64_t *sp = inputSigKeyPinned + (uint64_t)dev.threadBase * 4;
+      Int *dk = sigKeys + dev.threadBase;
+      for (int i = 0; i < dev.nbThread; i++) {
+        sp[4*i + 0] = dk[i].bits64[0];
+        sp[4*i + 1] = dk[i].bits64[1];
+        sp[4*i + 2] = dk[i].bits64[2];
+        sp[4*i + 3] = dk[i].bits64[3];
+      }
+      cudaMemcpy(dev.inputSigKey, sp, dev.nbThread*32, cudaMemcpyHostToDevice);
+    }
+
+  }
+
+  if (!rekey) {
+    // We do not need the input pinned memory anymore
+    cudaFreeHost(inputKeyPinned);
+    inputKeyPinned = NULL;
+    if (inputSigKeyPinned) {
+      cudaFreeHost(inputSigKeyPinned);
+      inputSigKeyPinned = NULL;
+    }
   }
 
   cudaError_t err = cudaGetLastError();
@@ -724,65 +1524,195 @@ bool GPUEngine::SetKeys(Point *p) {
 
 }
 
-bool GPUEngine::Launch(std::vector<ITEM> &prefixFound,bool spinWait) {
-
+bool GPUEngine::waitKernels(bool spinWait) {
 
-  prefixFound.clear();
+  // Wait until the running kernels have filled outputPrefix[curBuf]
+  // Only the item count is fetched here, items are drained later on the copy
+  // stream so that the transfer overlaps the next kernel. A captured step
+  // already ends with the count copy, only the wait remains then
 
-  // Get the result
+  double t0 = Timer::get_tick();
 
   if(spinWait) {
 
-    cudaMemcpy(outputPrefixPinned, outputPrefix, outputSize, cudaMemcpyDeviceToHost);
+    for (int d = 0; d < (int)devices.size(); d++) {
+      cudaSetDevice(devices[d].gpuId);
+      if (devices[d].stepGraph[curBuf] != NULL)
+        cudaStreamSynchronize(devices[d].stream);
+      else
+        cudaMemcpy(devices[d].outputPrefixPinned[curBuf], devices[d].outputPrefix[curBuf], 4, cudaMemcpyDeviceToHost);
+    }
 
   } else {
 
     // Use cudaMemcpyAsync to avoid default spin wait of cudaMemcpy wich takes 100% CPU
-    cudaEvent_t evt;
-    cudaEventCreate(&evt);
-    cudaMemcpyAsync(outputPrefixPinned, outputPrefix, 4, cudaMemcpyDeviceToHost, 0);
-    cudaEventRecord(evt, 0);
-    while (cudaEventQuery(evt) == cudaErrorNotReady) {
-      // Sleep 1 ms to free the CPU
-      Timer::SleepMillis(1);
+    std::vector<cudaEvent_t> evts(devices.size());
+    for (int d = 0; d < (int)devices.size(); d++) {
+      cudaSetDevice(devices[d].gpuId);
+      cudaEventCreate(&evts[d]);
+      if (devices[d].stepGraph[curBuf] == NULL)
+        cudaMemcpyAsync(devices[d].outputPrefixPinned[curBuf], devices[d].outputPrefix[curBuf], 4, cudaMemcpyDeviceToHost, devices[d].stream);
+      cudaEventRecord(evts[d], devices[d].stream);
+    }
+    for (int d = 0; d < (int)devices.size(); d++) {
+      cudaSetDevice(devices[d].gpuId);
+      while (cudaEventQuery(evts[d]) == cudaErrorNotReady) {
+        // Sleep 1 ms to free the CPU
+        Timer::SleepMillis(1);
+      }
+      cudaEventDestroy(evts[d]);
     }
-    cudaEventDestroy(evt);
 
   }
 
+  kernelTime += Timer::get_tick() - t0;
+
+  // Fetch the early stop record of the finished kernels, it must be read
+  // before the next callKernel resets it
+  for (int d = 0; d < (int)devices.size(); d++) {
+    cudaSetDevice(devices[d].gpuId);
+    cudaMemcpy(&devices[d].completedSteps, devices[d].stepRecord, 4, cudaMemcpyDeviceToHost);
+  }
+
   cudaError_t err = cudaGetLastError();
   if (err != cudaSuccess) {
-    printf("GPUEngine: Launch: %s\n", cudaGetErrorString(err));
+    printf("GPUEngine: waitKernels: %s\n", cudaGetErrorString(err));
     return false;
   }
 
-  // Look for prefix found
-  uint32_t nbFound = outputPrefixPinned[0];
-  if (nbFound > maxFound) {
-    // prefix has been lost
-    if (!lostWarning) {
-      printf("\nWarning, %d items lost\nHint: Search with less prefixes, less threads (-g) or increase maxFound (-m)\n", (nbFound - maxFound));
-      lostWarning = true;
+  return true;
+
+}
+
+bool GPUEngine::getAllResults(std::vector<ITEM> &found, int drainBuf) {
+
+  // Drain the output buffer of every device into a single found list
+  // The next kernel is already running and fills the other buffer, the item
+  // copies run on the per device copy stream and overlap it
+
+  double t0 = Timer::get_tick();
+
+  std::vector<cudaEvent_t> evts(devices.size());
+
+  for (int d = 0; d < (int)devices.size(); d++) {
+
+    GPU_DEVICE &dev = devices[d];
+    cudaSetDevice(dev.gpuId);
+
+    uint32_t nbFound = dev.outputPrefixPinned[drainBuf][0];
+    if (nbFound > outputCap) {
+      // Overrun of the overcommitted buffer within a single step, the early
+      // stop headroom was not enough (extreme match rate)
+      if (!lostWarning) {
+        printf("\nWarning, %d items lost\nHint: Search with less prefixes, less threads (-g) or increase maxFound (-m)\n", (nbFound - outputCap));
+        lostWarning = true;
+      }
+      nbFound = outputCap;
     }
-    nbFound = maxFound;
+
+    // First chunk, up to the pinned staging size, at the active mode's
+    // record stride so narrow modes copy only the bytes actually produced
+    uint32_t nbCopy = (nbFound > maxFound) ? maxFound : nbFound;
+    cudaEventCreate(&evts[d]);
+    cudaMemcpyAsync(dev.outputPrefixPinned[drainBuf], dev.outputPrefix[drainBuf], nbCopy*itemSize + 4, cudaMemcpyDeviceToHost, dev.copyStream);
+    cudaEventRecord(evts[d], dev.copyStream);
+
   }
 
-  // When can perform a standard copy, the kernel is eneded
-  cudaMemcpy( outputPrefixPinned , outputPrefix , nbFound*ITEM_SIZE + 4 , cudaMemcpyDeviceToHost);
+  for (int d = 0; d < (int)devices.size(); d++) {
+
+    GPU_DEVICE &dev = devices[d];
+    cudaSetDevice(dev.gpuId);
+
+    while (cudaEventQuery(evts[d]) == cudaErrorNotReady) {
+      // Sleep 1 ms to free the CPU
+      Timer::SleepMillis(1);
+    }
+    cudaEventDestroy(evts[d]);
+
+    uint32_t nbFound = dev.outputPrefixPinned[drainBuf][0];
+    if (nbFound > outputCap)
+      nbFound = outputCap;
+
+    if (discardNext) {
+      // Results of a kernel interrupted by RequestStop, the device points
+      // they relate to are being replaced so the host side key
+      // reconstruction would use wrong bases, drop them
+      dev.completedSteps = 0xFFFFFFFF;
+      continue;
+    }
 
-  for (uint32_t i = 0; i < nbFound; i++) {
-    uint32_t *itemPtr = outputPrefixPinned + (i*ITEM_SIZE32 + 1);
-    ITEM it;
-    it.thId = itemPtr[0];
-    int16_t *ptr = (int16_t *)&(itemPtr[1]);
-    it.endo = ptr[0] & 0x7FFF;
-    it.mode = (ptr[0]&0x8000)!=0;
-    it.incr = ptr[1];
-    it.hash = (uint8_t *)(itemPtr + 2);
-    prefixFound.push_back(it);
+    uint32_t *items = dev.outputPrefixPinned[drainBuf] + 1;
+
+    if (nbFound > maxFound) {
+      // Burst above the pinned staging size, pull the remaining items in
+      // maxFound sized chunks through the pinned buffer into a plain host
+      // buffer (the ITEM hash pointers must stay valid across chunks)
+      if (dev.overflowItems == NULL)
+        dev.overflowItems = (uint32_t *)malloc((uint64_t)outputCap * ITEM_SIZE);
+      uint32_t drained = 0;
+      while (drained < nbFound) {
+        uint32_t n = nbFound - drained;
+        if (n > maxFound) n = maxFound;
+        if (drained > 0)
+          cudaMemcpy(dev.outputPrefixPinned[drainBuf] + 1, dev.outputPrefix[drainBuf] + ((uint64_t)drained*(itemSize/4) + 1), (uint64_t)n*itemSize, cudaMemcpyDeviceToHost);
+        memcpy(dev.overflowItems + (uint64_t)drained*(itemSize/4), dev.outputPrefixPinned[drainBuf] + 1, (uint64_t)n*itemSize);
+        drained += n;
+      }
+      items = dev.overflowItems;
+    }
+
+    for (uint32_t i = 0; i < nbFound; i++) {
+      uint32_t *itemPtr = items + i*(itemSize/4);
+      ITEM it;
+      if (txidMode) {
+        // For TXID mode, store full 32-bit nonce across incr/endo
+        it.thId = itemPtr[0] + dev.threadBase;
+        uint32_t nonce = itemPtr[1];
+        it.incr = (int16_t)(nonce & 0xFFFF);
+        it.endo = (int16_t)((nonce >> 16) & 0xFFFF);
+        it.mode = false;
+      } else {
+        // Thread ids are made unique across devices
+        it.thId = itemPtr[0] + dev.threadBase;
+        int16_t *ptr = (int16_t *)&(itemPtr[1]);
+        it.endo = ptr[0] & 0x7FFF;
+        it.mode = (ptr[0]&0x8000)!=0;
+        it.incr = ptr[1];
+      }
+      it.hash = (uint8_t *)(itemPtr + 2);
+      found.push_back(it);
+    }
+
+  }
+
+  discardNext = false;
+  pcieTime += Timer::get_tick() - t0;
+
+  cudaError_t err = cudaGetLastError();
+  if (err != cudaSuccess) {
+    printf("GPUEngine: getAllResults: %s\n", cudaGetErrorString(err));
+    return false;
   }
 
-  return callKernel();
+  return true;
+
+}
+
+bool GPUEngine::Launch(std::vector<ITEM> &prefixFound,bool spinWait) {
+
+  prefixFound.clear();
+
+  // Wait for the running kernels, flip buffers and relaunch immediately,
+  // then drain the completed buffer while the next kernels run
+  int drainBuf = curBuf;
+  if (!waitKernels(spinWait))
+    return false;
+  curBuf ^= 1;
+  if (!callKernel())
+    return false;
+
+  return getAllResults(prefixFound, drainBuf);
 
 }
 
@@ -792,45 +1722,117 @@ bool GPUEngine::Launch(std::vector<ITEM> &prefixFound,bool spinWait) {
 
 void GPUEngine::SetStegoTarget(uint64_t *value, uint64_t *mask) {
 
+  StegoTarget t;
+  memcpy(t.value, value, 4 * sizeof(uint64_t));
+  memcpy(t.mask, mask, 4 * sizeof(uint64_t));
+  t.numBits = countMaskBits(mask);
+  SetStegoTargets(&t, 1);
+
+}
+
+void GPUEngine::SetStegoTargets(const StegoTarget *targets, int nbTarget) {
+
   cudaError_t err;
 
-  // Copy target value to constant memory
-  err = cudaMemcpyToSymbol(_stego_value, value, 4 * sizeof(uint64_t));
-  if (err != cudaSuccess) {
-    printf("GPUEngine: SetStegoTarget value: %s\n", cudaGetErrorString(err));
+  if (nbTarget < 1)
     return;
+  if (nbTarget > STEGO_MAX_TARGETS) {
+    printf("GPUEngine: SetStegoTargets: too many targets (%d), using first %d\n",
+           nbTarget, STEGO_MAX_TARGETS);
+    nbTarget = STEGO_MAX_TARGETS;
   }
 
-  // Copy mask to constant memory
-  err = cudaMemcpyToSymbol(_stego_mask, mask, 4 * sizeof(uint64_t));
-  if (err != cudaSuccess) {
-    printf("GPUEngine: SetStegoTarget mask: %s\n", cudaGetErrorString(err));
-    return;
+  // Pack the pairs contiguously for the symbol copies
+  uint64_t *values = new uint64_t[nbTarget * 4];
+  uint64_t *masks = new uint64_t[nbTarget * 4];
+  for (int t = 0; t < nbTarget; t++) {
+    memcpy(values + t * 4, targets[t].value, 4 * sizeof(uint64_t));
+    memcpy(masks + t * 4, targets[t].mask, 4 * sizeof(uint64_t));
   }
 
+  // Constant memory is per device, copy targets and masks to all of them
+  for (int d = 0; d < (int)devices.size(); d++) {
+
+    cudaSetDevice(devices[d].gpuId);
+
+    err = cudaMemcpyToSymbol(_stego_value, values, nbTarget * 4 * sizeof(uint64_t));
+    if (err != cudaSuccess) {
+      printf("GPUEngine: SetStegoTargets value: %s\n", cudaGetErrorString(err));
+      break;
+    }
+
+    err = cudaMemcpyToSymbol(_stego_mask, masks, nbTarget * 4 * sizeof(uint64_t));
+    if (err != cudaSuccess) {
+      printf("GPUEngine: SetStegoTargets mask: %s\n", cudaGetErrorString(err));
+      break;
+    }
+
+    err = cudaMemcpyToSymbol(_stego_nbTarget, &nbTarget, sizeof(int));
+    if (err != cudaSuccess) {
+      printf("GPUEngine: SetStegoTargets count: %s\n", cudaGetErrorString(err));
+      break;
+    }
+
+  }
+
+  delete[] values;
+  delete[] masks;
+
   stegoMode = true;
 
   err = cudaGetLastError();
   if (err != cudaSuccess) {
-    printf("GPUEngine: SetStegoTarget: %s\n", cudaGetErrorString(err));
+    printf("GPUEngine: SetStegoTargets: %s\n", cudaGetErrorString(err));
   }
 
 }
 
 bool GPUEngine::callKernelStego() {
 
-  // Reset nbFound
-  cudaMemset(outputPrefix, 0, 4);
+  itemSize = ITEM_SIZE_STEGO;
 
-  // Call steganography kernel
-  comp_keys_stego <<< nbThread / nbThreadPerGroup, nbThreadPerGroup >>>
-    (inputKey, maxFound, outputPrefix);
+  for (int d = 0; d < (int)devices.size(); d++) {
+
+    GPU_DEVICE &dev = devices[d];
+    cudaSetDevice(dev.gpuId);
+
+    // Re-arm the stop flag (previous kernel has completed) and replay the
+    // captured step when we already have one
+    *dev.pkStop = 0;
+    if (dev.stepGraph[curBuf] != NULL) {
+      cudaGraphLaunch(dev.stepGraph[curBuf], dev.stream);
+      cudaError_t err = cudaGetLastError();
+      if (err != cudaSuccess) {
+        printf("GPUEngine: Stego Kernel (GPU #%d): %s\n", dev.gpuId, cudaGetErrorString(err));
+        return false;
+      }
+      continue;
+    }
+
+    bool capturing = beginStepCapture(dev);
+
+    // Reset nbFound and the step record
+    cudaMemsetAsync(dev.outputPrefix[curBuf], 0, 4, dev.stream);
+    cudaMemsetAsync(dev.stepRecord, 0xFF, 4, dev.stream);
+
+    // Call steganography kernel
+    comp_keys_stego <<< dev.nbThread / dev.nbThreadPerGroup, dev.nbThreadPerGroup, 0, dev.stream >>>
+      (dev.inputKey, outputCap, dev.outputPrefix[curBuf], nbStep);
+
+    cudaMemcpyAsync(dev.outputPrefixPinned[curBuf], dev.outputPrefix[curBuf], 4,
+      cudaMemcpyDeviceToHost, dev.stream);
+
+    if (capturing && !endStepCapture(dev))
+      return false;
+
+    cudaError_t err = cudaGetLastError();
+    if (err != cudaSuccess) {
+      printf("GPUEngine: Stego Kernel (GPU #%d): %s\n", dev.gpuId, cudaGetErrorString(err));
+      return false;
+    }
 
-  cudaError_t err = cudaGetLastError();
-  if (err != cudaSuccess) {
-    printf("GPUEngine: Stego Kernel: %s\n", cudaGetErrorString(err));
-    return false;
   }
+
   return true;
 
 }
@@ -839,54 +1841,142 @@ bool GPUEngine::LaunchStego(std::vector<ITEM> &found, bool spinWait) {
 
   found.clear();
 
-  // Get the result
-  if (spinWait) {
-    cudaMemcpy(outputPrefixPinned, outputPrefix, outputSize, cudaMemcpyDeviceToHost);
-  } else {
-    cudaEvent_t evt;
-    cudaEventCreate(&evt);
-    cudaMemcpyAsync(outputPrefixPinned, outputPrefix, 4, cudaMemcpyDeviceToHost, 0);
-    cudaEventRecord(evt, 0);
-    while (cudaEventQuery(evt) == cudaErrorNotReady) {
-      Timer::SleepMillis(1);
+  int drainBuf = curBuf;
+  if (!waitKernels(spinWait))
+    return false;
+  curBuf ^= 1;
+  if (!callKernelStego())
+    return false;
+
+  return getAllResults(found, drainBuf);
+
+}
+
+// =============================================================================
+// SIGNATURE MODE
+// =============================================================================
+
+void GPUEngine::SetSigParams(uint64_t *d, uint64_t *z, uint64_t *pubx, bool schnorr) {
+
+  cudaError_t err;
+  int sch = schnorr ? 1 : 0;
+
+  // Per thread base scalars, uploaded by SetKeys alongside the points
+  if (inputSigKeyPinned == NULL) {
+    err = cudaHostAlloc(&inputSigKeyPinned, nbThread * 32, cudaHostAllocWriteCombined | cudaHostAllocPortable);
+    if (err != cudaSuccess) {
+      printf("GPUEngine: SetSigParams: Allocate sig key pinned memory: %s\n", cudaGetErrorString(err));
+      return;
     }
-    cudaEventDestroy(evt);
   }
 
-  cudaError_t err = cudaGetLastError();
+  for (int dv = 0; dv < (int)devices.size(); dv++) {
+
+    GPU_DEVICE &dev = devices[dv];
+    cudaSetDevice(dev.gpuId);
+
+    if (dev.inputSigKey == NULL) {
+      err = cudaMalloc((void **)&dev.inputSigKey, dev.nbThread * 32);
+      if (err != cudaSuccess) {
+        printf("GPUEngine: SetSigParams: Allocate sig key memory: %s\n", cudaGetErrorString(err));
+        return;
+      }
+    }
+
+    // Constant memory is per device, copy the signing parameters to all of them
+    err = cudaMemcpyToSymbol(_sig_d, d, 4 * sizeof(uint64_t));
+    if (err != cudaSuccess) {
+      printf("GPUEngine: SetSigParams d: %s\n", cudaGetErrorString(err));
+      return;
+    }
+    err = cudaMemcpyToSymbol(_sig_z, z, 4 * sizeof(uint64_t));
+    if (err != cudaSuccess) {
+      printf("GPUEngine: SetSigParams z: %s\n", cudaGetErrorString(err));
+      return;
+    }
+    err = cudaMemcpyToSymbol(_sig_pubx, pubx, 4 * sizeof(uint64_t));
+    if (err != cudaSuccess) {
+      printf("GPUEngine: SetSigParams pubx: %s\n", cudaGetErrorString(err));
+      return;
+    }
+    err = cudaMemcpyToSymbol(_sig_schnorr, &sch, sizeof(int));
+    if (err != cudaSuccess) {
+      printf("GPUEngine: SetSigParams schnorr: %s\n", cudaGetErrorString(err));
+      return;
+    }
+
+  }
+
+  sigMode = true;
+
+  err = cudaGetLastError();
   if (err != cudaSuccess) {
-    printf("GPUEngine: LaunchStego: %s\n", cudaGetErrorString(err));
-    return false;
+    printf("GPUEngine: SetSigParams: %s\n", cudaGetErrorString(err));
   }
 
-  // Look for matches found
-  uint32_t nbFound = outputPrefixPinned[0];
+}
+
+bool GPUEngine::callKernelSig() {
+
+  itemSize = ITEM_SIZE_SIG;
 
-  if (nbFound > maxFound) {
-    if (!lostWarning) {
-      printf("\nWarning, %d items lost\n", (nbFound - maxFound));
-      lostWarning = true;
+  for (int d = 0; d < (int)devices.size(); d++) {
+
+    GPU_DEVICE &dev = devices[d];
+    cudaSetDevice(dev.gpuId);
+
+    // Re-arm the stop flag (previous kernel has completed) and replay the
+    // captured step when we already have one
+    *dev.pkStop = 0;
+    if (dev.stepGraph[curBuf] != NULL) {
+      cudaGraphLaunch(dev.stepGraph[curBuf], dev.stream);
+      cudaError_t err = cudaGetLastError();
+      if (err != cudaSuccess) {
+        printf("GPUEngine: Sig Kernel (GPU #%d): %s\n", dev.gpuId, cudaGetErrorString(err));
+        return false;
+      }
+      continue;
     }
-    nbFound = maxFound;
-  }
 
-  // Copy results
-  cudaMemcpy(outputPrefixPinned, outputPrefix, nbFound * ITEM_SIZE + 4, cudaMemcpyDeviceToHost);
+    bool capturing = beginStepCapture(dev);
 
-  for (uint32_t i = 0; i < nbFound; i++) {
-    uint32_t *itemPtr = outputPrefixPinned + (i * ITEM_SIZE32 + 1);
-    ITEM it;
-    it.thId = itemPtr[0];
-    int16_t *ptr = (int16_t *)&(itemPtr[1]);
-    it.endo = ptr[0] & 0x7FFF;
-    it.mode = (ptr[0] & 0x8000) != 0;
-    it.incr = ptr[1];
-    it.hash = (uint8_t *)(itemPtr + 2);
+    // Reset nbFound
+    cudaMemsetAsync(dev.outputPrefix[curBuf], 0, 4, dev.stream);
+
+    // Call signature kernel
+    comp_keys_sig <<< dev.nbThread / dev.nbThreadPerGroup, dev.nbThreadPerGroup, 0, dev.stream >>>
+      (dev.inputKey, dev.inputSigKey, outputCap, dev.outputPrefix[curBuf], nbStep);
+
+    cudaMemcpyAsync(dev.outputPrefixPinned[curBuf], dev.outputPrefix[curBuf], 4,
+      cudaMemcpyDeviceToHost, dev.stream);
+
+    if (capturing && !endStepCapture(dev))
+      return false;
+
+    cudaError_t err = cudaGetLastError();
+    if (err != cudaSuccess) {
+      printf("GPUEngine: Sig Kernel (GPU #%d): %s\n", dev.gpuId, cudaGetErrorString(err));
+      return false;
+    }
 
-    found.push_back(it);
   }
 
-  return callKernelStego();
+  return true;
+
+}
+
+bool GPUEngine::LaunchSig(std::vector<ITEM> &found, bool spinWait) {
+
+  found.clear();
+
+  int drainBuf = curBuf;
+  if (!waitKernels(spinWait))
+    return false;
+  curBuf ^= 1;
+  if (!callKernelSig())
+    return false;
+
+  return getAllResults(found, drainBuf);
 
 }
 
@@ -896,80 +1986,73 @@ bool GPUEngine::LaunchStego(std::vector<ITEM> &found, bool spinWait) {
 
 bool GPUEngine::callKernelTaproot() {
 
-  // Reset nbFound
-  cudaMemset(outputPrefix, 0, 4);
+  itemSize = ITEM_SIZE_TAPROOT;
 
-  // Copy current iteration count to GPU constant memory
-  cudaMemcpyToSymbol(_taproot_iter, &taprootIter, sizeof(int32_t));
+  for (int d = 0; d < (int)devices.size(); d++) {
 
-  // Increment for next call (key = base + tid + taprootIter, so we need value before this kernel)
-  taprootIter++;
+    GPU_DEVICE &dev = devices[d];
+    cudaSetDevice(dev.gpuId);
 
-  // Call taproot kernel
-  comp_keys_taproot <<< nbThread / nbThreadPerGroup, nbThreadPerGroup >>>
-    (inputKey, maxFound, outputPrefix);
+    // Re-arm the stop flag (previous kernel has completed)
+    *dev.pkStop = 0;
 
-  cudaError_t err = cudaGetLastError();
-  if (err != cudaSuccess) {
-    printf("GPUEngine: Taproot Kernel: %s\n", cudaGetErrorString(err));
-    return false;
-  }
-  return true;
+    // Copy current iteration count to GPU constant memory, per step varying
+    // so it stays outside the captured graph
+    cudaMemcpyToSymbol(_taproot_iter, &taprootIter, sizeof(int32_t));
 
-}
+    // Replay the captured step when we already have one
+    if (dev.stepGraph[curBuf] != NULL) {
+      cudaGraphLaunch(dev.stepGraph[curBuf], dev.stream);
+      cudaError_t err = cudaGetLastError();
+      if (err != cudaSuccess) {
+        printf("GPUEngine: Taproot Kernel (GPU #%d): %s\n", dev.gpuId, cudaGetErrorString(err));
+        return false;
+      }
+      continue;
+    }
 
-bool GPUEngine::LaunchTaproot(std::vector<ITEM> &found, bool spinWait) {
+    bool capturing = beginStepCapture(dev);
 
-  found.clear();
+    // Reset nbFound
+    cudaMemsetAsync(dev.outputPrefix[curBuf], 0, 4, dev.stream);
 
-  // Get the result
-  if (spinWait) {
-    cudaMemcpy(outputPrefixPinned, outputPrefix, outputSize, cudaMemcpyDeviceToHost);
-  } else {
-    cudaEvent_t evt;
-    cudaEventCreate(&evt);
-    cudaMemcpyAsync(outputPrefixPinned, outputPrefix, 4, cudaMemcpyDeviceToHost, 0);
-    cudaEventRecord(evt, 0);
-    while (cudaEventQuery(evt) == cudaErrorNotReady) {
-      Timer::SleepMillis(1);
-    }
-    cudaEventDestroy(evt);
-  }
+    // Call taproot kernel
+    comp_keys_taproot <<< dev.nbThread / dev.nbThreadPerGroup, dev.nbThreadPerGroup, 0, dev.stream >>>
+      (dev.inputKey, outputCap, dev.outputPrefix[curBuf], nbStep);
 
-  cudaError_t err = cudaGetLastError();
-  if (err != cudaSuccess) {
-    printf("GPUEngine: LaunchTaproot: %s\n", cudaGetErrorString(err));
-    return false;
-  }
+    cudaMemcpyAsync(dev.outputPrefixPinned[curBuf], dev.outputPrefix[curBuf], 4,
+      cudaMemcpyDeviceToHost, dev.stream);
+
+    if (capturing && !endStepCapture(dev))
+      return false;
 
-  // Look for matches found
-  uint32_t nbFound = outputPrefixPinned[0];
-  if (nbFound > maxFound) {
-    if (!lostWarning) {
-      printf("\nWarning, %d items lost\n", (nbFound - maxFound));
-      lostWarning = true;
+    cudaError_t err = cudaGetLastError();
+    if (err != cudaSuccess) {
+      printf("GPUEngine: Taproot Kernel (GPU #%d): %s\n", dev.gpuId, cudaGetErrorString(err));
+      return false;
     }
-    nbFound = maxFound;
+
   }
 
-  // Copy results
-  cudaMemcpy(outputPrefixPinned, outputPrefix, nbFound * ITEM_SIZE + 4, cudaMemcpyDeviceToHost);
+  // Increment for next call (key = base + tid + taprootIter, so we need value before this kernel)
+  taprootIter += (int32_t)nbStep;
 
-  for (uint32_t i = 0; i < nbFound; i++) {
-    uint32_t *itemPtr = outputPrefixPinned + (i * ITEM_SIZE32 + 1);
-    ITEM it;
-    // Same format as stego: [0]=tid, [1]=packed(incr|mode|endo), [2..]=Qx data
-    it.thId = itemPtr[0];
-    int16_t *ptr = (int16_t *)&(itemPtr[1]);
-    it.endo = ptr[0] & 0x7FFF;
-    it.mode = (ptr[0] & 0x8000) != 0;
-    it.incr = ptr[1];
-    it.hash = (uint8_t *)(itemPtr + 2);
+  return true;
 
-    found.push_back(it);
-  }
+}
 
-  return callKernelTaproot();
+bool GPUEngine::LaunchTaproot(std::vector<ITEM> &found, bool spinWait) {
+
+  found.clear();
+
+  int drainBuf = curBuf;
+  if (!waitKernels(spinWait))
+    return false;
+  curBuf ^= 1;
+  if (!callKernelTaproot())
+    return false;
+
+  return getAllResults(found, drainBuf);
 
 }
 
@@ -983,20 +2066,26 @@ void GPUEngine::SetTxidTarget(uint64_t *value, uint64_t *mask) {
 
   // Target/mask are already stored in display order by main.cpp
   // (byte 0 = first byte of displayed TXID)
-  // Just copy directly to GPU constant memory
+  // Just copy directly to the constant memory of every device
 
-  // Copy target value to constant memory
-  err = cudaMemcpyToSymbol(_txid_target, value, 4 * sizeof(uint64_t));
-  if (err != cudaSuccess) {
-    printf("GPUEngine: SetTxidTarget value: %s\n", cudaGetErrorString(err));
-    return;
-  }
+  for (int d = 0; d < (int)devices.size(); d++) {
+
+    cudaSetDevice(devices[d].gpuId);
+
+    // Copy target value to constant memory
+    err = cudaMemcpyToSymbol(_txid_target, value, 4 * sizeof(uint64_t));
+    if (err != cudaSuccess) {
+      printf("GPUEngine: SetTxidTarget value: %s\n", cudaGetErrorString(err));
+      return;
+    }
+
+    // Copy mask to constant memory
+    err = cudaMemcpyToSymbol(_txid_mask, mask, 4 * sizeof(uint64_t));
+    if (err != cudaSuccess) {
+      printf("GPUEngine: SetTxidTarget mask: %s\n", cudaGetErrorString(err));
+      return;
+    }
 
-  // Copy mask to constant memory
-  err = cudaMemcpyToSymbol(_txid_mask, mask, 4 * sizeof(uint64_t));
-  if (err != cudaSuccess) {
-    printf("GPUEngine: SetTxidTarget mask: %s\n", cudaGetErrorString(err));
-    return;
   }
 
   txidMode = true;
@@ -1023,28 +2112,52 @@ void GPUEngine::SetRawTx(uint8_t *tx, int txLenIn, int nonceOffsetIn, int nonceL
     return;
   }
 
-  err = cudaMemcpyToSymbol(_raw_tx, tx, txLenIn);
-  if (err != cudaSuccess) {
-    printf("GPUEngine: SetRawTx raw_tx: %s\n", cudaGetErrorString(err));
-    return;
-  }
+  // Precompute the SHA256 midstate over the full blocks preceding the nonce,
+  // they never change so the kernel only rehashes the tail
+  int prefixLen = (nonceOffsetIn / 64) * 64;
+  uint32_t midstate[8];
+  sha256_midstate(tx, prefixLen / 64, midstate);
 
-  err = cudaMemcpyToSymbol(_tx_len, &txLenIn, sizeof(int));
-  if (err != cudaSuccess) {
-    printf("GPUEngine: SetRawTx tx_len: %s\n", cudaGetErrorString(err));
-    return;
-  }
+  for (int d = 0; d < (int)devices.size(); d++) {
 
-  err = cudaMemcpyToSymbol(_nonce_offset, &nonceOffsetIn, sizeof(int));
-  if (err != cudaSuccess) {
-    printf("GPUEngine: SetRawTx nonce_offset: %s\n", cudaGetErrorString(err));
-    return;
-  }
+    cudaSetDevice(devices[d].gpuId);
+
+    err = cudaMemcpyToSymbol(_raw_tx, tx + prefixLen, txLenIn - prefixLen);
+    if (err != cudaSuccess) {
+      printf("GPUEngine: SetRawTx raw_tx: %s\n", cudaGetErrorString(err));
+      return;
+    }
+
+    err = cudaMemcpyToSymbol(_txid_midstate, midstate, 8 * sizeof(uint32_t));
+    if (err != cudaSuccess) {
+      printf("GPUEngine: SetRawTx midstate: %s\n", cudaGetErrorString(err));
+      return;
+    }
+
+    err = cudaMemcpyToSymbol(_tx_prefix_len, &prefixLen, sizeof(int));
+    if (err != cudaSuccess) {
+      printf("GPUEngine: SetRawTx tx_prefix_len: %s\n", cudaGetErrorString(err));
+      return;
+    }
+
+    err = cudaMemcpyToSymbol(_tx_len, &txLenIn, sizeof(int));
+    if (err != cudaSuccess) {
+      printf("GPUEngine: SetRawTx tx_len: %s\n", cudaGetErrorString(err));
+      return;
+    }
+
+    err = cudaMemcpyToSymbol(_nonce_offset, &nonceOffsetIn, sizeof(int));
+    if (err != cudaSuccess) {
+      printf("GPUEngine: SetRawTx nonce_offset: %s\n", cudaGetErrorString(err));
+      return;
+    }
+
+    err = cudaMemcpyToSymbol(_nonce_len, &nonceLenIn, sizeof(int));
+    if (err != cudaSuccess) {
+      printf("GPUEngine: SetRawTx nonce_len: %s\n", cudaGetErrorString(err));
+      return;
+    }
 
-  err = cudaMemcpyToSymbol(_nonce_len, &nonceLenIn, sizeof(int));
-  if (err != cudaSuccess) {
-    printf("GPUEngine: SetRawTx nonce_len: %s\n", cudaGetErrorString(err));
-    return;
   }
 
   err = cudaGetLastError();
@@ -1056,78 +2169,75 @@ void GPUEngine::SetRawTx(uint8_t *tx, int txLenIn, int nonceOffsetIn, int nonceL
 
 bool GPUEngine::callKernelTxid() {
 
-  // Reset nbFound
-  cudaMemset(outputPrefix, 0, 4);
+  itemSize = ITEM_SIZE_TXID;
 
-  // Call TXID grinding kernel
-  grind_txid_kernel <<< nbThread / nbThreadPerGroup, nbThreadPerGroup >>>
-    (maxFound, outputPrefix);
+  for (int d = 0; d < (int)devices.size(); d++) {
 
-  cudaError_t err = cudaGetLastError();
-  if (err != cudaSuccess) {
-    printf("GPUEngine: TXID Kernel: %s\n", cudaGetErrorString(err));
-    return false;
-  }
-  return true;
-
-}
+    GPU_DEVICE &dev = devices[d];
+    cudaSetDevice(dev.gpuId);
 
-bool GPUEngine::LaunchTxid(std::vector<ITEM> &found, bool spinWait) {
+    // Re-arm the stop flag (previous kernel has completed)
+    *dev.pkStop = 0;
 
-  found.clear();
+    // Each device grinds a disjoint slice of the nonce space
+    // (nbStep grid sized chunks per device when persistent), per step
+    // varying so the symbol copy stays outside the captured graph
+    uint64_t baseNonce = txidBaseNonce + (uint64_t)dev.threadBase * nbStep;
+    cudaMemcpyToSymbol(_txid_base_nonce, &baseNonce, sizeof(uint64_t));
 
-  // Get the result
-  if (spinWait) {
-    cudaMemcpy(outputPrefixPinned, outputPrefix, outputSize, cudaMemcpyDeviceToHost);
-  } else {
-    cudaEvent_t evt;
-    cudaEventCreate(&evt);
-    cudaMemcpyAsync(outputPrefixPinned, outputPrefix, 4, cudaMemcpyDeviceToHost, 0);
-    cudaEventRecord(evt, 0);
-    while (cudaEventQuery(evt) == cudaErrorNotReady) {
-      Timer::SleepMillis(1);
+    // Replay the captured step when we already have one
+    if (dev.stepGraph[curBuf] != NULL) {
+      cudaGraphLaunch(dev.stepGraph[curBuf], dev.stream);
+      cudaError_t err = cudaGetLastError();
+      if (err != cudaSuccess) {
+        printf("GPUEngine: TXID Kernel (GPU #%d): %s\n", dev.gpuId, cudaGetErrorString(err));
+        return false;
+      }
+      continue;
     }
-    cudaEventDestroy(evt);
-  }
 
-  cudaError_t err = cudaGetLastError();
-  if (err != cudaSuccess) {
-    printf("GPUEngine: LaunchTxid: %s\n", cudaGetErrorString(err));
-    return false;
-  }
+    bool capturing = beginStepCapture(dev);
 
-  // Look for matches found
-  uint32_t nbFound = outputPrefixPinned[0];
-  if (nbFound > maxFound) {
-    if (!lostWarning) {
-      printf("\nWarning, %d items lost\n", (nbFound - maxFound));
-      lostWarning = true;
-    }
-    nbFound = maxFound;
-  }
+    // Reset nbFound
+    cudaMemsetAsync(dev.outputPrefix[curBuf], 0, 4, dev.stream);
 
-  // Copy results
-  cudaMemcpy(outputPrefixPinned, outputPrefix, nbFound * ITEM_SIZE + 4, cudaMemcpyDeviceToHost);
+    // Call TXID grinding kernel
+    grind_txid_kernel <<< dev.nbThread / dev.nbThreadPerGroup, dev.nbThreadPerGroup, 0, dev.stream >>>
+      (outputCap, dev.outputPrefix[curBuf], nbStep);
+
+    cudaMemcpyAsync(dev.outputPrefixPinned[curBuf], dev.outputPrefix[curBuf], 4,
+      cudaMemcpyDeviceToHost, dev.stream);
+
+    if (capturing && !endStepCapture(dev))
+      return false;
+
+    cudaError_t err = cudaGetLastError();
+    if (err != cudaSuccess) {
+      printf("GPUEngine: TXID Kernel (GPU #%d): %s\n", dev.gpuId, cudaGetErrorString(err));
+      return false;
+    }
 
-  for (uint32_t i = 0; i < nbFound; i++) {
-    uint32_t *itemPtr = outputPrefixPinned + (i * ITEM_SIZE32 + 1);
-    ITEM it;
-    it.thId = itemPtr[0];
-    // For TXID mode, store full 32-bit nonce across incr/endo
-    uint32_t nonce = itemPtr[1];
-    it.incr = (int16_t)(nonce & 0xFFFF);
-    it.endo = (int16_t)((nonce >> 16) & 0xFFFF);
-    it.mode = false;
-    it.hash = (uint8_t *)(itemPtr + 2);
-    found.push_back(it);
   }
 
   // Update base nonce for next kernel call
-  static uint64_t baseNonce = 0;
-  baseNonce += nbThread;
-  cudaMemcpyToSymbol(_txid_base_nonce, &baseNonce, sizeof(uint64_t));
+  txidBaseNonce += (uint64_t)nbThread * nbStep;
+
+  return true;
+
+}
+
+bool GPUEngine::LaunchTxid(std::vector<ITEM> &found, bool spinWait) {
+
+  found.clear();
+
+  int drainBuf = curBuf;
+  if (!waitKernels(spinWait))
+    return false;
+  curBuf ^= 1;
+  if (!callKernelTxid())
+    return false;
 
-  return callKernelTxid();
+  return getAllResults(found, drainBuf);
 
 }
 
@@ -20,6 +20,9 @@
 
 #include <vector>
 #include "../SECP256k1.h"
+#include "../StegoTarget.h"
+
+class PatternSet;
 
 #define SEARCH_COMPRESSED 0
 #define SEARCH_UNCOMPRESSED 1
@@ -30,15 +33,80 @@ static const char *searchModes[] = {"Compressed","Uncompressed","Compressed or U
 // Number of key per thread (must be a multiple of GRP_SIZE) per kernel call
 #define STEP_SIZE 1024
 
-// Number of thread per block
-// Note: Increased from 28 to 40 for taproot debug output (10 uint32 slots)
-#define ITEM_SIZE 40
+// Number of device side steps of STEP_SIZE per kernel launch in persistent
+// kernel mode (-pk). Bounded so that the increment of a found item still fits
+// the 16 bit incr field (30*STEP_SIZE + STEP_SIZE < 32768)
+#define PK_STEPS 30
+
+// Found record strides, per mode. Every record starts with tid and an info
+// word; vanity and txid add 20 bytes of hash160/TXID, sig emits k, R.x and s
+// (24 uint32 slots) and taproot reuses the same room for P.x, t and Q.x,
+// stego stores nothing else (the host recomputes X from tid/incr/endo).
+// Device buffers are allocated at the largest stride (ITEM_SIZE), each
+// kernel writes and the host drains at the active mode's stride so the idle
+// record bytes of narrow modes never cross PCIe
+#define ITEM_SIZE 112
 #define ITEM_SIZE32 (ITEM_SIZE/4)
+#define ITEM_SIZE_VANITY 28
+#define ITEM_SIZE32_VANITY (ITEM_SIZE_VANITY/4)
+#define ITEM_SIZE_STEGO 8
+#define ITEM_SIZE32_STEGO (ITEM_SIZE_STEGO/4)
+#define ITEM_SIZE_TXID 28
+#define ITEM_SIZE32_TXID (ITEM_SIZE_TXID/4)
+#define ITEM_SIZE_SIG 112
+#define ITEM_SIZE32_SIG (ITEM_SIZE_SIG/4)
+#define ITEM_SIZE_TAPROOT 112
+#define ITEM_SIZE32_TAPROOT (ITEM_SIZE_TAPROOT/4)
 #define _64K 65536
 
+// The device side output buffer holds OUTPUT_OVERCOMMIT*maxFound items so a
+// burst above maxFound in a single launch survives until the host drains it,
+// the pinned staging buffer keeps the -m size and big drains run in chunks
+#define OUTPUT_OVERCOMMIT 16
+
+// Maximum number of simultaneous stego (value, mask) pairs held in constant
+// memory, the kernels test each X coordinate against all of them
+#define STEGO_MAX_TARGETS 256
+
+// Maximum number of BECH32 (value, mask) refine pairs held in constant
+// memory (4 words per prefix, see SetBech32Prefixes)
+#define BECH32_MAX_PREFIX 256
+
 typedef uint16_t prefix_t;
 typedef uint32_t prefixl_t;
 
+struct CUstream_st;
+struct CUgraphExec_st;
+
+// Per device context (multi GPU mode), each device gets its own stream
+// and its own copy of the lookup tables, host side staging buffers are shared
+typedef struct {
+  int gpuId;
+  int nbThread;
+  int nbThreadPerGroup;
+  int threadBase;          // Offset of this device threads in the global key array
+  int numMP;
+  int numCores;
+  CUstream_st *stream;
+  CUstream_st *copyStream;  // Output drains overlap the next kernel
+  prefix_t *inputPrefix;
+  uint32_t *inputPrefixLookUp;
+  uint32_t *bloomFilter;
+  uint32_t *fullHash;      // Exact hash160 list in second level table order
+  uint64_t *inputKey;
+  uint64_t *inputSigKey;            // Per thread base scalars (sig mode only)
+  uint32_t *outputPrefix[2];        // Double buffered, the kernel fills one buffer
+  uint32_t *outputPrefixPinned[2];  // while the host drains the other one
+  uint32_t *pkStop;                 // Host mapped stop flag, polled by the kernel
+  uint32_t *pkStopDev;              // between steps in persistent kernel mode
+  uint32_t *stepRecord;             // Device word, first step a block skipped when
+                                    // it bailed out on a nearly full output buffer
+  uint32_t completedSteps;          // stepRecord of the last drained kernel
+  uint32_t *overflowItems;          // Host staging for drains above maxFound items
+  CUgraphExec_st *stepGraph[2];     // Captured reset/launch/count copy cycle per
+                                    // output buffer, replayed with one API call
+} GPU_DEVICE;
+
 typedef struct {
   uint32_t thId;
   int16_t  incr;
@@ -58,21 +126,54 @@ class GPUEngine {
 public:
 
   GPUEngine(int nbThreadGroup,int nbThreadPerGroup,int gpuId,uint32_t maxFound,bool rekey);
+  GPUEngine(const std::vector<int> &gpuIds,const std::vector<int> &gridSize,uint32_t maxFound,bool rekey);
   ~GPUEngine();
   void SetPrefix(std::vector<prefix_t> prefixes);
   void SetPrefix(std::vector<LPREFIX> prefixes,uint32_t totalPrefix);
-  bool SetKeys(Point *p);
+  void SetBloomFilter(const uint8_t *hash160, uint32_t nbHash);
+  // Exact device side match of the full hash160 (and therefore the full
+  // Base58 address, checksum included), hash160 must be in second level
+  // table order. Only true matches cross PCIe then
+  void SetFullHashes(const uint8_t *hash160, uint32_t nbHash);
+  bool SetKeys(Point *p, Int *sigKeys = NULL);
   void SetSearchMode(int searchMode);
   void SetSearchType(int searchType);
   void SetPattern(const char *pattern);
+  // BECH32 refine stage: each data character of a bech32 prefix encodes 5
+  // bits of hash160, the (value, mask) pairs cover the whole character
+  // prefix (up to the first 64 bits) so the kernel drops the 16 bit table
+  // collisions before they cross PCIe. vm holds 4 words per prefix:
+  // value0, value1, mask0, mask1 (values pre-masked)
+  void SetBech32Prefixes(const uint32_t *vm, int nbPrefix);
+  // Combined multi pattern matcher (see PatternSet), uploaded next to the
+  // single pattern of SetPattern and evaluated instead of it when active
+  void SetPatternSet(const PatternSet &ps);
   bool Launch(std::vector<ITEM> &prefixFound,bool spinWait=false);
   int GetNbThread();
   int GetGroupSize();
 
-  // Steganography mode
+  // Persistent kernel mode: the grid loops PK_STEPS steps device side per
+  // launch instead of one, Launch becomes a lightweight drain call
+  void SetPersistent(bool persistent);
+  int GetNbStep();
+  void RequestStop();
+
+  // Steps actually executed by the last drained kernel, smaller than
+  // GetNbStep() only when a kernel bailed out early on a nearly full output
+  // buffer, the caller must then resync the keys and replay from there
+  int GetCompletedSteps();
+
+  // Steganography mode, up to STEGO_MAX_TARGETS simultaneous (value, mask)
+  // pairs (different payload alignments share the same EC walk). The matched
+  // target index comes back in bits 2-9 of the item endo field
   void SetStegoTarget(uint64_t *value, uint64_t *mask);
+  void SetStegoTargets(const StegoTarget *targets, int nbTarget);
   bool LaunchStego(std::vector<ITEM> &found, bool spinWait=false);
 
+  // Signature mode (R value grinding with on-device signing)
+  void SetSigParams(uint64_t *d, uint64_t *z, uint64_t *pubx, bool schnorr);
+  bool LaunchSig(std::vector<ITEM> &found, bool spinWait=false);
+
   // Taproot mode
   bool LaunchTaproot(std::vector<ITEM> &found, bool spinWait=false);
 
@@ -81,50 +182,72 @@ public:
   void SetRawTx(uint8_t *tx, int txLen, int nonceOffset, int nonceLen);
   bool LaunchTxid(std::vector<ITEM> &found, bool spinWait=false);
 
+  // Benchmark instrumentation (-bench): wall time spent waiting for kernels
+  // and draining output buffers over PCIe since the last reset
+  void ResetTimings();
+  void GetTimings(double *kernel, double *pcie);
+
   bool Check(Secp256K1 *secp);
   std::string deviceName;
 
+  // Startup grid size autotuner: sweeps a few grid geometries with short
+  // timing runs and locks in the fastest, the winner is cached per device
+  // name so subsequent startups are instant. Entries of gridSize whose x
+  // is not -1 (explicit -g) are left untouched.
+  static void Autotune(const std::vector<int> &gpuIds, std::vector<int> &gridSize);
+
   static void PrintCudaInfo();
   static void GenerateCode(Secp256K1 *secp, int size);
 
 private:
 
+  void Init(const std::vector<int> &gpuIds,const std::vector<int> &gridSize,uint32_t maxFound,bool rekey);
   bool callKernel();
   bool callKernelStego();
+  bool callKernelSig();
   bool callKernelTaproot();
   bool callKernelTxid();
+  bool beginStepCapture(GPU_DEVICE &dev);
+  bool endStepCapture(GPU_DEVICE &dev);
+  bool waitKernels(bool spinWait);
+  bool getAllResults(std::vector<ITEM> &found, int drainBuf);
+  static double TuneRun(int gpuId, int nbThreadGroup, int nbThreadPerGroup);
   static void ComputeIndex(std::vector<int> &s, int depth, int n);
   static void Browse(FILE *f,int depth, int max, int s);
   bool CheckHash(uint8_t *h, std::vector<ITEM>& found, int tid, int incr, int endo, int *ok);
 
   int nbThread;
-  int nbThreadPerGroup;
-  prefix_t *inputPrefix;
+  int curBuf;
+  uint32_t nbStep;
+  std::vector<GPU_DEVICE> devices;
   prefix_t *inputPrefixPinned;
-  uint32_t *inputPrefixLookUp;
   uint32_t *inputPrefixLookUpPinned;
-  uint64_t *inputKey;
   uint64_t *inputKeyPinned;
-  uint32_t *outputPrefix;
-  uint32_t *outputPrefixPinned;
+  uint64_t *inputSigKeyPinned;
   bool initialised;
   uint32_t searchMode;
   uint32_t searchType;
   bool littleEndian;
   bool lostWarning;
+  bool discardNext;     // Drop the next drain (results of an interrupted kernel)
+  bool graphEnabled;    // CUDA graph step replay, cleared when capture fails
   bool rekey;
   uint32_t maxFound;
+  uint32_t outputCap;   // maxFound*OUTPUT_OVERCOMMIT, device side item capacity
   uint32_t outputSize;
+  uint32_t itemSize;    // Record stride of the active mode (bytes)
   std::string pattern;
   bool hasPattern;
   bool stegoMode;
+  bool sigMode;
   bool txidMode;
   int txLen;
   int txNonceOffset;
   int txNonceLen;
-  int numMP;
-  int numCores;
+  uint64_t txidBaseNonce;
   int32_t taprootIter;  // Iteration counter for taproot key reconstruction
+  double kernelTime;    // Accumulated kernel wait time (-bench)
+  double pcieTime;      // Accumulated output drain time (-bench)
 
 };
 
@@ -141,7 +141,13 @@ __device__ __forceinline__ uint32_t s1(uint32_t x) {
 
 #else
 
+// Funnel shift maps to a single SHF instruction on sm_32+, the shift pair
+// is kept for older targets
+#if __CUDA_ARCH__ >= 320
+#define ROR(x,n) __funnelshift_r(x, x, n)
+#else
 #define ROR(x,n) ((x>>n)|(x<<(32-n)))
+#endif
 #define S0(x) (ROR(x,2) ^ ROR(x,13) ^ ROR(x,22))
 #define S1(x) (ROR(x,6) ^ ROR(x,11) ^ ROR(x,25))
 #define s0(x) (ROR(x,7) ^ ROR(x,18) ^ (x >> 3))
@@ -253,28 +259,25 @@ __device__ void SHA256Transform(uint32_t s[8],uint32_t* w) {
 // TAPROOT (BIP-341) TAGGED HASH
 // ---------------------------------------------------------------------------------
 
-// Precomputed SHA256("TapTweak") - used as prefix for tagged hash
-// SHA256("TapTweak") = e80fe1639c9ca050e3af1b39c143c63e429cbceb15d940fbb5c5a1f4af57c5e9
-__device__ __constant__ uint32_t _taptweak_tag_hash[8] = {
-  0xe80fe163U, 0x9c9ca050U, 0xe3af1b39U, 0xc143c63eU,
-  0x429cbcebU, 0x15d940fbU, 0xb5c5a1f4U, 0xaf57c5e9U
+// Midstate of SHA256(tagHash || tagHash) with tagHash = SHA256("TapTweak")
+// (e80fe1639c9ca050e3af1b39c143c63e429cbceb15d940fbb5c5a1f4af57c5e9). The
+// duplicated tag prefix fills exactly one block and never changes, resuming
+// from its midstate saves a compression per candidate
+__device__ __constant__ uint32_t _taptweak_midstate[8] = {
+  0xd129a2f3U, 0x701c655dU, 0x6583b6c3U, 0xb9419727U,
+  0x95f4e232U, 0x94fd54f4U, 0xa2ae8d85U, 0x47ca590bU
 };
 
 // Compute BIP-340/341 tagged hash: SHA256(SHA256(tag) || SHA256(tag) || data)
 // For TapTweak, data is the 32-byte x-coordinate of the internal key
 __device__ void SHA256_TapTweak(uint32_t result[8], uint64_t px[4]) {
   uint32_t s[8];
-
-  // Initialize state
-  SHA256Initialize(s);
-
-  // Block 1: tagHash || tagHash (64 bytes = one full block)
   uint32_t w[16];
+
+  // Resume from the precomputed tag block midstate, a single compression
+  // is left
   #pragma unroll 8
-  for (int i = 0; i < 8; i++) w[i] = _taptweak_tag_hash[i];
-  #pragma unroll 8
-  for (int i = 0; i < 8; i++) w[8 + i] = _taptweak_tag_hash[i];
-  SHA256Transform(s, w);
+  for (int i = 0; i < 8; i++) s[i] = _taptweak_midstate[i];
 
   // Block 2: px (32 bytes) + padding (32 bytes)
   // Convert px from 4x uint64 (little-endian limbs) to 8x uint32 big-endian words
@@ -335,7 +338,11 @@ __device__ void RIPEMD160Initialize(uint32_t s[5]) {
 
 }
 
+#if __CUDA_ARCH__ >= 320
+#define ROL(x,n) __funnelshift_l(x, x, n)
+#else
 #define ROL(x,n) ((x>>(32-n))|(x<<n))
+#endif
 #define f1(x, y, z) (x ^ y ^ z)
 #define f2(x, y, z) ((x & y) | (~x & z))
 #define f3(x, y, z) ((x | ~y) ^ z)
@@ -707,6 +714,95 @@ __device__ __noinline__ void _GetHash160(uint64_t *x, uint64_t *y, uint8_t *hash
 
 }
 
+// Compressed and uncompressed hash160 of the same point in one call.
+// Bytes 1..32 of both serializations are the X coordinate, so it is
+// serialized once and the compressed block is derived from the shared words
+__device__ __noinline__ void _GetHash160Both(uint64_t *x, uint64_t *y, uint8_t isOdd,
+                                             uint8_t *hComp, uint8_t *hUncomp) {
+
+  uint32_t *x32 = (uint32_t *)(x);
+  uint32_t *y32 = (uint32_t *)(y);
+  uint32_t publicKeyBytes[32];
+  uint32_t compKeyBytes[16];
+  uint32_t s[16];
+
+  // Uncompressed public key
+  publicKeyBytes[0] = __byte_perm(x32[7], 0x04, 0x4321);
+  publicKeyBytes[1] = __byte_perm(x32[7], x32[6], 0x0765);
+  publicKeyBytes[2] = __byte_perm(x32[6], x32[5], 0x0765);
+  publicKeyBytes[3] = __byte_perm(x32[5], x32[4], 0x0765);
+  publicKeyBytes[4] = __byte_perm(x32[4], x32[3], 0x0765);
+  publicKeyBytes[5] = __byte_perm(x32[3], x32[2], 0x0765);
+  publicKeyBytes[6] = __byte_perm(x32[2], x32[1], 0x0765);
+  publicKeyBytes[7] = __byte_perm(x32[1], x32[0], 0x0765);
+  publicKeyBytes[8] = __byte_perm(x32[0], y32[7], 0x0765);
+  publicKeyBytes[9] = __byte_perm(y32[7], y32[6], 0x0765);
+  publicKeyBytes[10] = __byte_perm(y32[6], y32[5], 0x0765);
+  publicKeyBytes[11] = __byte_perm(y32[5], y32[4], 0x0765);
+  publicKeyBytes[12] = __byte_perm(y32[4], y32[3], 0x0765);
+  publicKeyBytes[13] = __byte_perm(y32[3], y32[2], 0x0765);
+  publicKeyBytes[14] = __byte_perm(y32[2], y32[1], 0x0765);
+  publicKeyBytes[15] = __byte_perm(y32[1], y32[0], 0x0765);
+  publicKeyBytes[16] = __byte_perm(y32[0], 0x80, 0x0456);
+  publicKeyBytes[17] = 0;
+  publicKeyBytes[18] = 0;
+  publicKeyBytes[19] = 0;
+  publicKeyBytes[20] = 0;
+  publicKeyBytes[21] = 0;
+  publicKeyBytes[22] = 0;
+  publicKeyBytes[23] = 0;
+  publicKeyBytes[24] = 0;
+  publicKeyBytes[25] = 0;
+  publicKeyBytes[26] = 0;
+  publicKeyBytes[27] = 0;
+  publicKeyBytes[28] = 0;
+  publicKeyBytes[29] = 0;
+  publicKeyBytes[30] = 0;
+  publicKeyBytes[31] = 0x208;
+
+  // Compressed public key, the X words are shared with the block above
+  compKeyBytes[0] = __byte_perm(x32[7], 0x2 + isOdd, 0x4321);
+  compKeyBytes[1] = publicKeyBytes[1];
+  *(uint64_t *)(&compKeyBytes[2]) = *(uint64_t *)(&publicKeyBytes[2]);
+  *(uint64_t *)(&compKeyBytes[4]) = *(uint64_t *)(&publicKeyBytes[4]);
+  *(uint64_t *)(&compKeyBytes[6]) = *(uint64_t *)(&publicKeyBytes[6]);
+  compKeyBytes[8] = __byte_perm(x32[0], 0x80, 0x0456);
+  compKeyBytes[9] = 0;
+  compKeyBytes[10] = 0;
+  compKeyBytes[11] = 0;
+  compKeyBytes[12] = 0;
+  compKeyBytes[13] = 0;
+  compKeyBytes[14] = 0;
+  compKeyBytes[15] = 0x108;
+
+  SHA256Initialize(s);
+  SHA256Transform(s, publicKeyBytes);
+  SHA256Transform(s, publicKeyBytes + 16);
+
+#pragma unroll 8
+  for (int i = 0; i < 8; i++)
+    s[i] = bswap32(s[i]);
+
+  *(uint64_t *)(s + 8) = 0x80ULL;
+  *(uint64_t *)(s + 10) = 0ULL;
+  *(uint64_t *)(s + 12) = 0ULL;
+  *(uint64_t *)(s + 14) = ripemd160_sizedesc_32;
+
+  RIPEMD160Initialize((uint32_t *)hUncomp);
+  RIPEMD160Transform((uint32_t *)hUncomp, s);
+
+  SHA256Initialize(s);
+  SHA256Transform(s, compKeyBytes);
+
+#pragma unroll 8
+  for (int i = 0; i < 8; i++)
+    s[i] = bswap32(s[i]);
+
+  RIPEMD160Initialize((uint32_t *)hComp);
+  RIPEMD160Transform((uint32_t *)hComp, s);
+
+}
+
 __device__ __noinline__ void _GetHash160P2SHComp(uint64_t *x, uint8_t isOdd, uint8_t *hash) {
 
   uint32_t h[5];
@@ -57,3 +57,114 @@ starCheck:
   goto loopStart;
 
 }
+
+// ---------------------------------------------------------------------------------
+// Compiled pattern matcher
+// The host compiles the pattern once into per position bitmasks of allowed
+// Base58 digits ('?' allows all 58), split around a single '*' into an
+// anchored head and an anchored tail. Matching is then a linear scan with a
+// table lookup per character, no recursion and no per character divergence.
+// Patterns with several '*' cannot be anchored and fall back to _Match
+// ---------------------------------------------------------------------------------
+
+#define PATTERN_MAX_LEN 40
+
+__device__ __constant__ uint64_t _patHead[PATTERN_MAX_LEN];
+__device__ __constant__ uint64_t _patTail[PATTERN_MAX_LEN];
+__device__ __constant__ int32_t _patHeadLen;
+__device__ __constant__ int32_t _patTailLen;
+__device__ __constant__ int32_t _patOpenEnded;  // Pattern contains a '*'
+__device__ __constant__ int32_t _patGeneric;    // Not compilable, use _Match
+
+__device__ bool _MatchCompiled(const char *add, const char *pattern) {
+
+  if (_patGeneric)
+    return _Match(add, pattern);
+
+  int len = 0;
+  while (add[len]) len++;
+
+  if (_patOpenEnded) {
+    if (len < _patHeadLen + _patTailLen) return false;
+  } else {
+    if (len != _patHeadLen) return false;
+  }
+
+  for (int i = 0; i < _patHeadLen; i++) {
+    int8_t d = b58digits_map[(uint8_t)add[i] & 0x7F];
+    if (d < 0 || ((_patHead[i] >> d) & 1ULL) == 0)
+      return false;
+  }
+
+  for (int i = 0; i < _patTailLen; i++) {
+    int8_t d = b58digits_map[(uint8_t)add[len - _patTailLen + i] & 0x7F];
+    if (d < 0 || ((_patTail[i] >> d) & 1ULL) == 0)
+      return false;
+  }
+
+  return true;
+
+}
+
+// ---------------------------------------------------------------------------------
+// Combined pattern set matcher
+// Device mirror of PatternSet::Match. The host compiles up to PATTERN_SET_MAX
+// anchored patterns into shared per position character tables with one bit
+// per pattern, the scan below ANDs the table rows into an alive mask so all
+// patterns are evaluated in a single pass over the address. The character
+// tables do not fit in constant memory and live in global memory, the small
+// done/length tables stay constant
+// ---------------------------------------------------------------------------------
+
+__device__ uint64_t _psFwd[PATTERN_SET_MAXLEN][128][PATTERN_SET_NBWORD];
+__device__ uint64_t _psBwd[PATTERN_SET_MAXLEN][128][PATTERN_SET_NBWORD];
+__device__ __constant__ uint64_t _psFwdDone[PATTERN_SET_MAXLEN][PATTERN_SET_NBWORD];
+__device__ __constant__ uint64_t _psBwdDone[PATTERN_SET_MAXLEN][PATTERN_SET_NBWORD];
+__device__ __constant__ uint64_t _psLenOk[64][PATTERN_SET_NBWORD];
+__device__ __constant__ int32_t _psMaxHead;
+__device__ __constant__ int32_t _psMaxTail;
+__device__ __constant__ int32_t _psActive;
+
+__device__ bool _MatchPatternSet(const char *add) {
+
+  int len = 0;
+  while (add[len]) len++;
+  if (len >= 64)
+    return false;
+
+  uint64_t m[PATTERN_SET_NBWORD];
+  uint64_t any = 0ULL;
+  for (int w = 0; w < PATTERN_SET_NBWORD; w++) {
+    m[w] = _psLenOk[len][w];
+    any |= m[w];
+  }
+  if (!any)
+    return false;
+
+  int n = (_psMaxHead < len) ? _psMaxHead : len;
+  for (int i = 0; i < n; i++) {
+    int c = (uint8_t)add[i] & 0x7F;
+    any = 0ULL;
+    for (int w = 0; w < PATTERN_SET_NBWORD; w++) {
+      m[w] &= _psFwd[i][c][w] | _psFwdDone[i][w];
+      any |= m[w];
+    }
+    if (!any)
+      return false;
+  }
+
+  n = (_psMaxTail < len) ? _psMaxTail : len;
+  for (int j = 0; j < n; j++) {
+    int c = (uint8_t)add[len - 1 - j] & 0x7F;
+    any = 0ULL;
+    for (int w = 0; w < PATTERN_SET_NBWORD; w++) {
+      m[w] &= _psBwd[j][c][w] | _psBwdDone[j][w];
+      any |= m[w];
+    }
+    if (!any)
+      return false;
+  }
+
+  return true;
+
+}
@@ -16,6 +16,7 @@
 */
 
 #include "IntGroup.h"
+#include <string.h>
 
 using namespace std;
 
@@ -38,6 +39,13 @@ void IntGroup::ModInv() {
   Int newValue;
   Int inverse;
 
+  // The batch multiplier needs at least one full vector per lane
+  static bool useIFMA = IntGroupIFMA_Supported();
+  if (useIFMA && size >= 16) {
+    ModInvIFMA();
+    return;
+  }
+
   subp[0].Set(&ints[0]);
   for (int i = 1; i < size; i++) {
     subp[i].ModMulK1(&subp[i - 1], &ints[i]);
@@ -55,4 +63,67 @@ void IntGroup::ModInv() {
 
   ints[0].Set(&inverse);
 
+}
+
+// 8 lane batch inversion: the vectorized prefix/unwind phases run in
+// IntGroupIFMA.cpp, the 8 lane totals, the remainder elements and the
+// single inversion are combined here with the scalar code. The subp
+// buffer is reused as limb vector scratch (one step = 8*sizeof(Int))
+void IntGroup::ModInvIFMA() {
+
+  int chunk = size / 8;
+  int m = chunk * 8;
+  int tail = size - m;
+  int stride = sizeof(Int) / 8;
+  uint64_t T64[32];
+  uint64_t inv64[32];
+  Int T[8];
+  Int pT[8];
+  Int tp[8];
+  Int invT[8];
+  Int newValue;
+  Int inverse;
+  int j, k;
+
+  IntGroupIFMA_Prefix((uint64_t *)ints, stride, chunk, (uint64_t *)subp, T64);
+
+  for (k = 0; k < 8; k++) {
+    T[k].SetInt32(0);
+    memcpy(T[k].bits64, T64 + 4 * k, 32);
+  }
+  pT[0].Set(&T[0]);
+  for (k = 1; k < 8; k++)
+    pT[k].ModMulK1(&pT[k - 1], &T[k]);
+
+  // Remainder elements (size not divisible by 8) continue the chain
+  if (tail > 0) {
+    tp[0].ModMulK1(&pT[7], &ints[m]);
+    for (j = 1; j < tail; j++)
+      tp[j].ModMulK1(&tp[j - 1], &ints[m + j]);
+    inverse.Set(&tp[tail - 1]);
+  } else {
+    inverse.Set(&pT[7]);
+  }
+
+  // Do the inversion
+  inverse.ModInv();
+
+  for (j = size - 1; j >= m; j--) {
+    newValue.ModMulK1((j == m) ? &pT[7] : &tp[j - m - 1], &inverse);
+    inverse.ModMulK1(&ints[j]);
+    ints[j].Set(&newValue);
+  }
+
+  // Unwind across the lane totals, invT[k] = inverse of lane k's product
+  for (k = 7; k > 0; k--) {
+    invT[k].ModMulK1(&pT[k - 1], &inverse);
+    inverse.ModMulK1(&T[k]);
+  }
+  invT[0].Set(&inverse);
+
+  for (k = 0; k < 8; k++)
+    memcpy(inv64 + 4 * k, invT[k].bits64, 32);
+
+  IntGroupIFMA_Unwind((uint64_t *)ints, stride, chunk, (uint64_t *)subp, inv64);
+
 }
\ No newline at end of file
@@ -32,10 +32,20 @@ public:
 
 private:
 
+	void ModInvIFMA();
+
 	Int *ints;
   Int *subp;
   int size;
 
 };
 
+// 8 way AVX512-IFMA batch path (IntGroupIFMA.cpp), compiled with its own
+// ISA flags and only entered after the runtime CPU feature check. The ISA
+// specific unit cannot include Int.h, elements are passed as raw 64 bit
+// limb arrays with their stride in words
+bool IntGroupIFMA_Supported();
+void IntGroupIFMA_Prefix(const uint64_t *ints, int stride, int chunk, uint64_t *vs, uint64_t *totals);
+void IntGroupIFMA_Unwind(uint64_t *ints, int stride, int chunk, const uint64_t *vs, const uint64_t *laneInv);
+
 #endif // INTGROUPCPUH
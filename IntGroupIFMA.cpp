@@ -0,0 +1,248 @@
+/*
+ * This file is part of the VanitySearch distribution (https://github.com/JeanLucPons/VanitySearch).
+ * Copyright (c) 2019 Jean Luc PONS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// 8 way AVX512-IFMA batch field multiplier for IntGroup::ModInv
+//
+// The group is split into 8 equal lanes, the prefix-product and unwind
+// phases of the Montgomery trick then run 8 field multiplications at a
+// time with vpmadd52: elements are sliced into 5 radix 2^52 limbs, one
+// zmm register per limb holding that limb of all 8 lanes. The lane
+// totals, the remainder elements and the single inversion stay on the
+// scalar Int code in IntGroup.cpp.
+//
+// This translation unit is compiled with -mavx512ifma and must only be
+// entered after IntGroupIFMA_Supported() returned true (same pattern as
+// the AVX512 hash pipelines). It cannot include Int.h (whose carry/mul
+// shims clash with the intrinsic headers), elements are passed as raw
+// 64 bit limb arrays with their stride in words.
+
+#include <immintrin.h>
+#include <stdint.h>
+
+#ifdef WIN64
+#include <intrin.h>
+#endif
+
+#define M52 0x000FFFFFFFFFFFFFULL
+
+// 2^260 mod P = (2^256 mod P)<<4
+#define FOLD52 0x1000003D10ULL
+
+bool IntGroupIFMA_Supported() {
+
+#ifdef WIN64
+  int info[4];
+  __cpuidex(info, 7, 0);
+  return ((info[1] >> 16) & 1) && ((info[1] >> 21) & 1);
+#else
+  return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512ifma");
+#endif
+
+}
+
+// r = a*b mod P on all 8 lanes, limbs in [0,2^52) (value < 2^260, lazily
+// reduced), r may alias a or b
+static inline void MulMod52(__m512i r[5], const __m512i a[5], const __m512i b[5]) {
+
+  const __m512i ZERO = _mm512_setzero_si512();
+  const __m512i MASK = _mm512_set1_epi64(M52);
+  const __m512i FOLD = _mm512_set1_epi64(FOLD52);
+  __m512i t[10];
+  __m512i c, t5;
+  int i, j;
+
+  // Column sums of the 5x5 schoolbook product, at most 10 products per
+  // column so the 64 bit accumulators cannot overflow
+  for (i = 0; i < 10; i++)
+    t[i] = ZERO;
+  for (i = 0; i < 5; i++) {
+    for (j = 0; j < 5; j++) {
+      t[i + j] = _mm512_madd52lo_epu64(t[i + j], a[i], b[j]);
+      t[i + j + 1] = _mm512_madd52hi_epu64(t[i + j + 1], a[i], b[j]);
+    }
+  }
+
+  // Carry normalize so every limb is an exact 52 bit digit (the product is
+  // below 2^520 so the top limb ends below 2^52)
+  c = ZERO;
+  for (i = 0; i < 10; i++) {
+    t[i] = _mm512_add_epi64(t[i], c);
+    c = _mm512_srli_epi64(t[i], 52);
+    t[i] = _mm512_and_si512(t[i], MASK);
+  }
+
+  // Fold the 5 high limbs back (2^260 = FOLD52 mod P), the madd52hi of the
+  // top limb lands on limb 5 again and is folded separately
+  for (i = 0; i < 5; i++)
+    t[i] = _mm512_madd52lo_epu64(t[i], t[5 + i], FOLD);
+  for (i = 0; i < 4; i++)
+    t[i + 1] = _mm512_madd52hi_epu64(t[i + 1], t[5 + i], FOLD);
+  t5 = _mm512_madd52hi_epu64(ZERO, t[9], FOLD);
+  t[0] = _mm512_madd52lo_epu64(t[0], t5, FOLD);
+  t[1] = _mm512_madd52hi_epu64(t[1], t5, FOLD);
+
+  // Settle all limbs strictly below 2^52, a carry out of limb 4 is worth
+  // FOLD52 on limb 0, carries die out after a couple of rounds
+  do {
+    c = ZERO;
+    for (i = 0; i < 5; i++) {
+      t[i] = _mm512_add_epi64(t[i], c);
+      c = _mm512_srli_epi64(t[i], 52);
+      t[i] = _mm512_and_si512(t[i], MASK);
+    }
+    t[0] = _mm512_madd52lo_epu64(t[0], c, FOLD);
+  } while (_mm512_test_epi64_mask(c, c));
+
+  for (i = 0; i < 5; i++)
+    r[i] = t[i];
+
+}
+
+// Slice 8 canonical 4x64 elements (lane k at a[k*lstride]) into 52 bit
+// limb vectors
+static inline void Load52(__m512i r[5], const uint64_t *a, int lstride) {
+
+  uint64_t s[5][8];
+  int k;
+
+  for (k = 0; k < 8; k++) {
+    const uint64_t *b = a + k * lstride;
+    s[0][k] = b[0] & M52;
+    s[1][k] = ((b[0] >> 52) | (b[1] << 12)) & M52;
+    s[2][k] = ((b[1] >> 40) | (b[2] << 24)) & M52;
+    s[3][k] = ((b[2] >> 28) | (b[3] << 36)) & M52;
+    s[4][k] = b[3] >> 16;
+  }
+  for (k = 0; k < 5; k++)
+    r[k] = _mm512_loadu_si512((const void *)s[k]);
+
+}
+
+// Reassemble one lane as a canonically reduced 4x64 element
+static inline void Canon(uint64_t *r, const uint64_t *l) {
+
+  unsigned __int128 s;
+  uint64_t v[4];
+  uint64_t t[4];
+  uint64_t o, br;
+  int i;
+
+  v[0] = l[0] | (l[1] << 52);
+  v[1] = (l[1] >> 12) | (l[2] << 40);
+  v[2] = (l[2] >> 24) | (l[3] << 28);
+  v[3] = (l[3] >> 36) | (l[4] << 16);
+  o = l[4] >> 48;
+
+  // Bits 256..259 fold back through the prime tail
+  while (o) {
+    s = (unsigned __int128)v[0] + o * 0x1000003D1ULL;
+    v[0] = (uint64_t)s;
+    for (i = 1; i < 4; i++) {
+      s = (unsigned __int128)v[i] + (uint64_t)(s >> 64);
+      v[i] = (uint64_t)s;
+    }
+    o = (uint64_t)(s >> 64);
+  }
+
+  // At most one subtract of P since the value is below 2^256
+  s = (unsigned __int128)v[0] - 0xFFFFFFFEFFFFFC2FULL;
+  t[0] = (uint64_t)s; br = (uint64_t)(s >> 64) & 1;
+  s = (unsigned __int128)v[1] - 0xFFFFFFFFFFFFFFFFULL - br;
+  t[1] = (uint64_t)s; br = (uint64_t)(s >> 64) & 1;
+  s = (unsigned __int128)v[2] - 0xFFFFFFFFFFFFFFFFULL - br;
+  t[2] = (uint64_t)s; br = (uint64_t)(s >> 64) & 1;
+  s = (unsigned __int128)v[3] - 0xFFFFFFFFFFFFFFFFULL - br;
+  t[3] = (uint64_t)s; br = (uint64_t)(s >> 64) & 1;
+
+  for (i = 0; i < 4; i++)
+    r[i] = br ? v[i] : t[i];
+
+}
+
+// Write 8 lanes back as canonical 4x64 elements (lane k at a[k*lstride])
+static inline void Store52(uint64_t *a, int lstride, const __m512i r[5]) {
+
+  uint64_t s[5][8];
+  uint64_t l[5];
+  int i, k;
+
+  for (k = 0; k < 5; k++)
+    _mm512_storeu_si512((void *)s[k], r[k]);
+
+  for (k = 0; k < 8; k++) {
+    for (i = 0; i < 5; i++)
+      l[i] = s[i][k];
+    Canon(a + k * lstride, l);
+  }
+
+}
+
+// Raw limb vector save/restore for the per step prefix products, one step
+// is 40 uint64_t (5 limb vectors of 8 lanes)
+static inline void SaveV(uint64_t *p, const __m512i v[5]) {
+  for (int i = 0; i < 5; i++)
+    _mm512_storeu_si512((void *)(p + i * 8), v[i]);
+}
+
+static inline void LoadV(__m512i v[5], const uint64_t *p) {
+  for (int i = 0; i < 5; i++)
+    v[i] = _mm512_loadu_si512((const void *)(p + i * 8));
+}
+
+// Prefix products of 8 lanes of chunk elements each, lane k owns elements
+// [k*chunk,(k+1)*chunk), vs receives the intermediate products in limb
+// vector form (chunk*40 words) for the unwind, totals the 8 canonical lane
+// products (stride 4)
+void IntGroupIFMA_Prefix(const uint64_t *ints, int stride, int chunk, uint64_t *vs, uint64_t *totals) {
+
+  __m512i acc[5];
+  __m512i b[5];
+  int lstride = chunk * stride;
+  int i;
+
+  Load52(acc, ints, lstride);
+  SaveV(vs, acc);
+  for (i = 1; i < chunk; i++) {
+    Load52(b, ints + (size_t)i * stride, lstride);
+    MulMod52(acc, acc, b);
+    SaveV(vs + (size_t)i * 40, acc);
+  }
+  Store52(totals, 4, acc);
+
+}
+
+// Unwind of 8 lanes given the canonical inverse of each lane's total
+// (laneInv, stride 4), replaces every element by its inverse
+void IntGroupIFMA_Unwind(uint64_t *ints, int stride, int chunk, const uint64_t *vs, const uint64_t *laneInv) {
+
+  __m512i acc[5];
+  __m512i b[5];
+  __m512i nv[5];
+  int lstride = chunk * stride;
+  int i;
+
+  Load52(acc, laneInv, 4);
+  for (i = chunk - 1; i > 0; i--) {
+    LoadV(nv, vs + (size_t)(i - 1) * 40);
+    MulMod52(nv, nv, acc);
+    Load52(b, ints + (size_t)i * stride, lstride);
+    MulMod52(acc, acc, b);
+    Store52(ints + (size_t)i * stride, lstride, nv);
+  }
+  Store52(ints, lstride, acc);
+
+}
@@ -0,0 +1,140 @@
+/*
+ * This file is part of the VanitySearch distribution (https://github.com/JeanLucPons/VanitySearch).
+ * Copyright (c) 2019 Jean Luc PONS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "PatternSet.h"
+#include <string.h>
+#include <ctype.h>
+
+PatternSet::PatternSet() {
+
+  nbPattern = 0;
+  maxHead = 0;
+  maxTail = 0;
+  memset(fwd, 0, sizeof(fwd));
+  memset(bwd, 0, sizeof(bwd));
+  memset(fwdDone, 0, sizeof(fwdDone));
+  memset(bwdDone, 0, sizeof(bwdDone));
+  memset(lenOk, 0, sizeof(lenOk));
+
+}
+
+void PatternSet::allow(uint64_t tab[PATTERN_SET_MAXLEN][128][PATTERN_SET_NBWORD],
+                       int pos, char c, bool caseSensitive, int word, uint64_t bit) {
+
+  if (c == '?') {
+    for (int ch = 0; ch < 128; ch++)
+      tab[pos][ch][word] |= bit;
+  } else {
+    tab[pos][(uint8_t)c & 0x7F][word] |= bit;
+    if (!caseSensitive) {
+      tab[pos][tolower((uint8_t)c) & 0x7F][word] |= bit;
+      tab[pos][toupper((uint8_t)c) & 0x7F][word] |= bit;
+    }
+  }
+
+}
+
+bool PatternSet::Add(const char *pattern, bool caseSensitive) {
+
+  if (nbPattern >= PATTERN_SET_MAX)
+    return false;
+
+  // Split around a single '*' into an anchored head and an anchored tail
+  int nbStar = 0;
+  for (const char *p = pattern; *p; p++)
+    if (*p == '*') nbStar++;
+  if (nbStar > 1)
+    return false;
+
+  const char *star = strchr(pattern, '*');
+  int headLen = star ? (int)(star - pattern) : (int)strlen(pattern);
+  int tailLen = star ? (int)strlen(star + 1) : 0;
+  if (headLen > PATTERN_SET_MAXLEN || tailLen > PATTERN_SET_MAXLEN)
+    return false;
+
+  int word = nbPattern / 64;
+  uint64_t bit = 1ULL << (nbPattern % 64);
+
+  for (int i = 0; i < headLen; i++)
+    allow(fwd, i, pattern[i], caseSensitive, word, bit);
+  for (int j = 0; j < tailLen; j++)
+    allow(bwd, j, star[tailLen - j], caseSensitive, word, bit);
+
+  for (int i = headLen; i < PATTERN_SET_MAXLEN; i++)
+    fwdDone[i][word] |= bit;
+  for (int j = tailLen; j < PATTERN_SET_MAXLEN; j++)
+    bwdDone[j][word] |= bit;
+
+  for (int L = 0; L < 64; L++) {
+    bool ok = star ? (headLen + tailLen <= L) : (L == headLen);
+    if (ok)
+      lenOk[L][word] |= bit;
+  }
+
+  if (headLen > maxHead) maxHead = headLen;
+  if (tailLen > maxTail) maxTail = tailLen;
+  nbPattern++;
+
+  return true;
+
+}
+
+bool PatternSet::Match(const char *str, uint64_t *matched) const {
+
+  int len = (int)strlen(str);
+  if (len >= 64)
+    return false;
+
+  uint64_t any = 0ULL;
+  for (int w = 0; w < PATTERN_SET_NBWORD; w++) {
+    matched[w] = lenOk[len][w];
+    any |= matched[w];
+  }
+  if (!any)
+    return false;
+
+  int n = (maxHead < len) ? maxHead : len;
+  for (int i = 0; i < n; i++) {
+    int c = (uint8_t)str[i] & 0x7F;
+    any = 0ULL;
+    for (int w = 0; w < PATTERN_SET_NBWORD; w++) {
+      matched[w] &= fwd[i][c][w] | fwdDone[i][w];
+      any |= matched[w];
+    }
+    if (!any)
+      return false;
+  }
+
+  n = (maxTail < len) ? maxTail : len;
+  for (int j = 0; j < n; j++) {
+    int c = (uint8_t)str[len - 1 - j] & 0x7F;
+    any = 0ULL;
+    for (int w = 0; w < PATTERN_SET_NBWORD; w++) {
+      matched[w] &= bwd[j][c][w] | bwdDone[j][w];
+      any |= matched[w];
+    }
+    if (!any)
+      return false;
+  }
+
+  return true;
+
+}
+
+int PatternSet::Size() const {
+  return nbPattern;
+}
@@ -0,0 +1,82 @@
+/*
+ * This file is part of the VanitySearch distribution (https://github.com/JeanLucPons/VanitySearch).
+ * Copyright (c) 2019 Jean Luc PONS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PATTERNSETH
+#define PATTERNSETH
+
+#include <cstdint>
+
+// Combined multi pattern wildcard matcher.
+// Up to PATTERN_SET_MAX anchored patterns (at most one '*', '?' allows any
+// character) are compiled into shared per position character tables holding
+// one bit per pattern. Matching then walks the string once, ANDing the table
+// rows into an alive mask - a bit parallel evaluation of all the pattern
+// automata at once - so N patterns cost the same single scan as one instead
+// of N Wildcard::match calls. Patterns with several '*' cannot be anchored
+// and are rejected by Add, the caller keeps those on the generic matcher
+#define PATTERN_SET_MAX    256
+#define PATTERN_SET_NBWORD (PATTERN_SET_MAX / 64)
+#define PATTERN_SET_MAXLEN 40
+
+class PatternSet {
+
+public:
+
+  PatternSet();
+  // Compile a pattern into the set. Returns false if the pattern does not
+  // fit (several '*', an anchored part longer than PATTERN_SET_MAXLEN or the
+  // set is full), the set is left unchanged then. With caseSensitive false
+  // literal characters are folded at compile time
+  bool Add(const char *pattern, bool caseSensitive);
+  // Match str against all patterns at once. Returns true if any pattern
+  // matches and fills matched[PATTERN_SET_NBWORD] with one bit per matching
+  // pattern, in Add order
+  bool Match(const char *str, uint64_t *matched) const;
+  int Size() const;
+
+  // Raw table access for the GPU upload (see GPUEngine::SetPatternSet)
+  const uint64_t *FwdTable() const { return &fwd[0][0][0]; }
+  const uint64_t *BwdTable() const { return &bwd[0][0][0]; }
+  const uint64_t *FwdDone() const { return &fwdDone[0][0]; }
+  const uint64_t *BwdDone() const { return &bwdDone[0][0]; }
+  const uint64_t *LenTable() const { return &lenOk[0][0]; }
+  int MaxHead() const { return maxHead; }
+  int MaxTail() const { return maxTail; }
+
+private:
+
+  void allow(uint64_t tab[PATTERN_SET_MAXLEN][128][PATTERN_SET_NBWORD],
+             int pos, char c, bool caseSensitive, int word, uint64_t bit);
+
+  int nbPattern;
+  int maxHead;
+  int maxTail;
+  // fwd[i][c] holds the patterns whose head position i allows character c,
+  // bwd[j][c] the same for tail position j counted from the last character.
+  // fwdDone[i]/bwdDone[j] hold the patterns whose head/tail is shorter than
+  // the position (already fully matched, they stay alive on any character)
+  uint64_t fwd[PATTERN_SET_MAXLEN][128][PATTERN_SET_NBWORD];
+  uint64_t bwd[PATTERN_SET_MAXLEN][128][PATTERN_SET_NBWORD];
+  uint64_t fwdDone[PATTERN_SET_MAXLEN][PATTERN_SET_NBWORD];
+  uint64_t bwdDone[PATTERN_SET_MAXLEN][PATTERN_SET_NBWORD];
+  // lenOk[L] holds the patterns a string of length L can satisfy at all:
+  // headLen + tailLen <= L with a '*', length exactly headLen without
+  uint64_t lenOk[64][PATTERN_SET_NBWORD];
+
+};
+
+#endif // PATTERNSETH
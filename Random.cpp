@@ -115,3 +115,91 @@ unsigned long rndl() {
 double rnd() {
   return rk_double(&localState);
 }
+
+/* ChaCha20 counter mode bulk generator. The Mersenne Twister above hands out
+   one 32 bit value per call which makes bulk rekeying serialize on the RNG,
+   this one fills a whole buffer in a single pass. The key is set once at
+   startup and the 64 bit block counter only ever moves forward (reserved
+   atomically) so concurrent callers never reuse a block */
+
+#include <string.h>
+#include <stdint.h>
+#ifdef WIN64
+#include <intrin.h>
+#endif
+
+static uint32_t chachaKey[8];
+static uint64_t chachaCounter = 0;
+static int chachaSeeded = 0;
+
+#define CHACHA_ROTL(x,n) (((x) << (n)) | ((x) >> (32 - (n))))
+#define CHACHA_QR(a,b,c,d)             \
+  a += b; d ^= a; d = CHACHA_ROTL(d,16); \
+  c += d; b ^= c; b = CHACHA_ROTL(b,12); \
+  a += b; d ^= a; d = CHACHA_ROTL(d, 8); \
+  c += d; b ^= c; b = CHACHA_ROTL(b, 7);
+
+static void chachaBlock(uint32_t *out, uint64_t counter) {
+
+  uint32_t s[16];
+  s[0] = 0x61707865; s[1] = 0x3320646e; s[2] = 0x79622d32; s[3] = 0x6b206574;
+  memcpy(s + 4, chachaKey, 32);
+  s[12] = (uint32_t)counter;
+  s[13] = (uint32_t)(counter >> 32);
+  s[14] = 0;
+  s[15] = 0;
+
+  uint32_t x[16];
+  memcpy(x, s, 64);
+  for (int i = 0; i < 10; i++) {
+    CHACHA_QR(x[0], x[4], x[8], x[12]);
+    CHACHA_QR(x[1], x[5], x[9], x[13]);
+    CHACHA_QR(x[2], x[6], x[10], x[14]);
+    CHACHA_QR(x[3], x[7], x[11], x[15]);
+    CHACHA_QR(x[0], x[5], x[10], x[15]);
+    CHACHA_QR(x[1], x[6], x[11], x[12]);
+    CHACHA_QR(x[2], x[7], x[8], x[13]);
+    CHACHA_QR(x[3], x[4], x[9], x[14]);
+  }
+  for (int i = 0; i < 16; i++)
+    out[i] = x[i] + s[i];
+
+}
+
+// Set the 256 bit key, done once at startup
+void rseedBulk(const unsigned char *key32) {
+  memcpy(chachaKey, key32, 32);
+  chachaCounter = 0;
+  chachaSeeded = 1;
+}
+
+void rndBulk(unsigned char *buff, unsigned long long length) {
+
+  if (!chachaSeeded) {
+    // Keep tools that never call rseedBulk working
+    for (unsigned long long i = 0; i < length; i++)
+      buff[i] = (unsigned char)rndl();
+    return;
+  }
+
+  // Reserve the block range up front, concurrent rekeys then draw from
+  // disjoint parts of the key stream
+  uint64_t nbBlock = (length + 63) / 64;
+#ifdef WIN64
+  uint64_t ctr = (uint64_t)_InterlockedExchangeAdd64((volatile long long *)&chachaCounter, (long long)nbBlock);
+#else
+  uint64_t ctr = __sync_fetch_and_add(&chachaCounter, nbBlock);
+#endif
+
+  uint32_t block[16];
+  while (length >= 64) {
+    chachaBlock((uint32_t *)buff, ctr++);
+    buff += 64;
+    length -= 64;
+  }
+  if (length > 0) {
+    chachaBlock(block, ctr);
+    memcpy(buff, block, (size_t)length);
+  }
+
+}
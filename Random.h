@@ -22,4 +22,9 @@ double rnd();
 unsigned long rndl();
 void rseed(unsigned long seed);
 
+// ChaCha20 counter mode bulk generator, used by the rekey paths which need
+// a whole grid's worth of starting key entropy in one pass
+void rseedBulk(const unsigned char *key32);
+void rndBulk(unsigned char *buff, unsigned long long length);
+
 #endif
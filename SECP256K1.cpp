@@ -16,15 +16,204 @@
 */
 
 #include "SECP256k1.h"
+#include "FieldElement.h"
 #include "hash/sha256.h"
 #include "hash/ripemd160.h"
 #include "Base58.h"
 #include "Bech32.h"
 #include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#ifdef WIN64
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 Secp256K1::Secp256K1() {
 }
 
+// ----------------------------------------------------------------------------
+// Binary snapshot cache of the generator tables
+// Building GTable costs 8192 sequential point additions (one ModInv each)
+// which dominates process cold start, so the tables are serialized once and
+// memory mapped back on subsequent startups. The snapshot also carries the
+// caller side Gn/_2Gn group tables (built in the VanitySearch constructor)
+// ----------------------------------------------------------------------------
+
+#define TABLE_CACHE_FILE "vanitysearch.gtable"
+#define TABLE_MAGIC 0x4C425447
+#define TABLE_VERSION 1
+#define GTABLE_SIZE (256*32)
+
+typedef struct {
+
+  uint32_t magic;
+  uint32_t version;
+  uint32_t nbGn;      // Group table half size of the writer (CPU_GRP_SIZE/2)
+  uint32_t checksum;  // Over everything after this field
+
+} TABLE_CACHE_HEADER;
+
+static uint32_t tableChecksum(const uint8_t *p, size_t len) {
+
+  uint32_t sum = 0;
+  for (size_t i = 0; i < len; i++)
+    sum = sum * 31 + p[i];
+  return sum;
+
+}
+
+// Points are stored as 4 little endian 64 bit limbs per coordinate (the
+// tables only hold reduced affine points) so the format does not depend on
+// NB64BLOCK
+static void writePoint(uint8_t *p, Point &pt) {
+
+  memcpy(p, pt.x.bits64, 32);
+  memcpy(p + 32, pt.y.bits64, 32);
+
+}
+
+static void readPoint(const uint8_t *p, Point &pt) {
+
+  pt.x.SetInt32(0);
+  pt.y.SetInt32(0);
+  memcpy(pt.x.bits64, p, 32);
+  memcpy(pt.y.bits64, p + 32, 32);
+  pt.z.SetInt32(1);
+
+}
+
+static size_t tableCacheSize(int nbGn) {
+
+  return sizeof(TABLE_CACHE_HEADER) + ((size_t)GTABLE_SIZE + nbGn + 1) * 64;
+
+}
+
+// Map the snapshot read only and validate it, returns NULL when the file is
+// missing or stale. On success *size receives the mapping size
+static const uint8_t *tableCacheMap(size_t *size) {
+
+  size_t sz;
+
+#ifdef WIN64
+  HANDLE hFile = CreateFileA(TABLE_CACHE_FILE, GENERIC_READ, FILE_SHARE_READ,
+                             NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (hFile == INVALID_HANDLE_VALUE)
+    return NULL;
+  sz = (size_t)GetFileSize(hFile, NULL);
+  HANDLE hMap = CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+  CloseHandle(hFile);
+  if (hMap == NULL)
+    return NULL;
+  const uint8_t *map = (const uint8_t *)MapViewOfFile(hMap, FILE_MAP_READ, 0, 0, 0);
+  CloseHandle(hMap);
+  if (map == NULL)
+    return NULL;
+#else
+  int fd = open(TABLE_CACHE_FILE, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    close(fd);
+    return NULL;
+  }
+  sz = (size_t)st.st_size;
+  const uint8_t *map = (const uint8_t *)mmap(NULL, sz, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return NULL;
+#endif
+
+  const TABLE_CACHE_HEADER *h = (const TABLE_CACHE_HEADER *)map;
+  if (sz < sizeof(TABLE_CACHE_HEADER) ||
+      h->magic != TABLE_MAGIC ||
+      h->version != TABLE_VERSION ||
+      sz != tableCacheSize((int)h->nbGn) ||
+      h->checksum != tableChecksum(map + sizeof(TABLE_CACHE_HEADER), sz - sizeof(TABLE_CACHE_HEADER))) {
+#ifdef WIN64
+    UnmapViewOfFile(map);
+#else
+    munmap((void *)map, sz);
+#endif
+    return NULL;
+  }
+
+  *size = sz;
+  return map;
+
+}
+
+static void tableCacheUnmap(const uint8_t *map, size_t size) {
+
+#ifdef WIN64
+  UnmapViewOfFile(map);
+#else
+  munmap((void *)map, size);
+#endif
+
+}
+
+bool Secp256K1::LoadTableCache(Point *gn, int nbGn, Point *g2n) {
+
+  size_t sz;
+  const uint8_t *map = tableCacheMap(&sz);
+  if (map == NULL)
+    return false;
+
+  const TABLE_CACHE_HEADER *h = (const TABLE_CACHE_HEADER *)map;
+  if ((int)h->nbGn != nbGn) {
+    tableCacheUnmap(map, sz);
+    return false;
+  }
+
+  const uint8_t *p = map + sizeof(TABLE_CACHE_HEADER) + (size_t)GTABLE_SIZE * 64;
+  for (int i = 0; i < nbGn; i++)
+    readPoint(p + (size_t)i * 64, gn[i]);
+  readPoint(p + (size_t)nbGn * 64, *g2n);
+
+  tableCacheUnmap(map, sz);
+  return true;
+
+}
+
+void Secp256K1::SaveTableCache(Point *gn, int nbGn, Point *g2n) {
+
+  size_t sz = tableCacheSize(nbGn);
+  uint8_t *buf = (uint8_t *)malloc(sz);
+
+  TABLE_CACHE_HEADER *h = (TABLE_CACHE_HEADER *)buf;
+  h->magic = TABLE_MAGIC;
+  h->version = TABLE_VERSION;
+  h->nbGn = (uint32_t)nbGn;
+
+  uint8_t *p = buf + sizeof(TABLE_CACHE_HEADER);
+  for (int i = 0; i < GTABLE_SIZE; i++)
+    writePoint(p + (size_t)i * 64, GTable[i]);
+  p += (size_t)GTABLE_SIZE * 64;
+  for (int i = 0; i < nbGn; i++)
+    writePoint(p + (size_t)i * 64, gn[i]);
+  writePoint(p + (size_t)nbGn * 64, *g2n);
+
+  h->checksum = tableChecksum(buf + sizeof(TABLE_CACHE_HEADER), sz - sizeof(TABLE_CACHE_HEADER));
+
+  FILE *f = fopen(TABLE_CACHE_FILE, "wb");
+  if (f == NULL) {
+    printf("Warning, cannot write %s\n", TABLE_CACHE_FILE);
+    free(buf);
+    return;
+  }
+  if (fwrite(buf, 1, sz, f) != sz)
+    printf("Warning, short write on %s\n", TABLE_CACHE_FILE);
+  fclose(f);
+  free(buf);
+
+}
+
 void Secp256K1::Init() {
 
   // Prime for the finite field
@@ -42,16 +231,30 @@ void Secp256K1::Init() {
 
   Int::InitK1(&order);
 
-  // Compute Generator table
-  Point N(G);
-  for(int i = 0; i < 32; i++) {
-    GTable[i * 256] = N;
-    N = DoubleDirect(N);
-    for (int j = 1; j < 255; j++) {
-      GTable[i * 256 + j] = N;
-      N = AddDirect(N, GTable[i * 256]);
+  // Compute Generator table, restored from the binary snapshot of a
+  // previous run when one is present
+  size_t cacheSize;
+  const uint8_t *cache = tableCacheMap(&cacheSize);
+  if (cache) {
+
+    const uint8_t *p = cache + sizeof(TABLE_CACHE_HEADER);
+    for (int i = 0; i < GTABLE_SIZE; i++)
+      readPoint(p + (size_t)i * 64, GTable[i]);
+    tableCacheUnmap(cache, cacheSize);
+
+  } else {
+
+    Point N(G);
+    for(int i = 0; i < 32; i++) {
+      GTable[i * 256] = N;
+      N = DoubleDirect(N);
+      for (int j = 1; j < 255; j++) {
+        GTable[i * 256 + j] = N;
+        N = AddDirect(N, GTable[i * 256]);
+      }
+      GTable[i * 256 + 255] = N; // Dummy point for check function
     }
-    GTable[i * 256 + 255] = N; // Dummy point for check function
+
   }
 
 }
@@ -196,6 +399,35 @@ Point Secp256K1::ComputePublicKey(Int *privKey) {
 
 }
 
+Point Secp256K1::ComputePublicKeyProjective(Int *privKey) {
+
+  // Same as ComputePublicKey but leaves the point in projective coordinates,
+  // the caller batches the final inversion of z over many keys (IntGroup)
+
+  int i = 0;
+  uint8_t b;
+  Point Q;
+  Q.Clear();
+
+  // Search first significant byte
+  for (i = 0; i < 32; i++) {
+    b = privKey->GetByte(i);
+    if(b)
+      break;
+  }
+  Q = GTable[256 * i + (b-1)];
+  i++;
+
+  for(; i < 32; i++) {
+    b = privKey->GetByte(i);
+    if(b)
+      Q = Add2(Q, GTable[256 * i + (b-1)]);
+  }
+
+  return Q;
+
+}
+
 Point Secp256K1::NextKey(Point &key) {
   // Input key must be reduced and different from G
   // in order to use AddDirect
@@ -431,6 +663,260 @@ void Secp256K1::GetHash160(int type,bool compressed,
 
 }
 
+// Compressed and uncompressed hash160 of the same 4 points in one call.
+// Both serializations share the X coordinate, so the points are serialized
+// once (uncompressed) and the fused SHA-256 rebuilds the compressed block
+// from the shared words instead of hashing twice from scratch
+void Secp256K1::GetHash160Both(int type,
+  Point &k0, Point &k1, Point &k2, Point &k3,
+  uint8_t *hc0, uint8_t *hc1, uint8_t *hc2, uint8_t *hc3,
+  uint8_t *hu0, uint8_t *hu1, uint8_t *hu2, uint8_t *hu3) {
+
+#ifdef WIN64
+  __declspec(align(16)) unsigned char shc0[64];
+  __declspec(align(16)) unsigned char shc1[64];
+  __declspec(align(16)) unsigned char shc2[64];
+  __declspec(align(16)) unsigned char shc3[64];
+  __declspec(align(16)) unsigned char shu0[64];
+  __declspec(align(16)) unsigned char shu1[64];
+  __declspec(align(16)) unsigned char shu2[64];
+  __declspec(align(16)) unsigned char shu3[64];
+#else
+  unsigned char shc0[64] __attribute__((aligned(16)));
+  unsigned char shc1[64] __attribute__((aligned(16)));
+  unsigned char shc2[64] __attribute__((aligned(16)));
+  unsigned char shc3[64] __attribute__((aligned(16)));
+  unsigned char shu0[64] __attribute__((aligned(16)));
+  unsigned char shu1[64] __attribute__((aligned(16)));
+  unsigned char shu2[64] __attribute__((aligned(16)));
+  unsigned char shu3[64] __attribute__((aligned(16)));
+#endif
+
+  switch (type) {
+
+  case P2PKH:
+  case BECH32:
+  {
+
+    uint32_t b0[32];
+    uint32_t b1[32];
+    uint32_t b2[32];
+    uint32_t b3[32];
+
+    KEYBUFFUNCOMP(b0, k0);
+    KEYBUFFUNCOMP(b1, k1);
+    KEYBUFFUNCOMP(b2, k2);
+    KEYBUFFUNCOMP(b3, k3);
+
+    sha256sse_33_65(b0, b1, b2, b3,
+      (uint8_t)(0x2 + k0.y.IsOdd()), (uint8_t)(0x2 + k1.y.IsOdd()),
+      (uint8_t)(0x2 + k2.y.IsOdd()), (uint8_t)(0x2 + k3.y.IsOdd()),
+      shc0, shc1, shc2, shc3, shu0, shu1, shu2, shu3);
+
+    ripemd160sse_32(shc0, shc1, shc2, shc3, hc0, hc1, hc2, hc3);
+    ripemd160sse_32(shu0, shu1, shu2, shu3, hu0, hu1, hu2, hu3);
+
+  }
+  break;
+
+  case P2SH:
+  {
+
+    unsigned char khc0[20];
+    unsigned char khc1[20];
+    unsigned char khc2[20];
+    unsigned char khc3[20];
+    unsigned char khu0[20];
+    unsigned char khu1[20];
+    unsigned char khu2[20];
+    unsigned char khu3[20];
+
+    GetHash160Both(P2PKH, k0, k1, k2, k3,
+      khc0, khc1, khc2, khc3, khu0, khu1, khu2, khu3);
+
+    // Redeem Script (1 to 1 P2SH)
+    uint32_t b0[16];
+    uint32_t b1[16];
+    uint32_t b2[16];
+    uint32_t b3[16];
+
+    KEYBUFFSCRIPT(b0, khc0);
+    KEYBUFFSCRIPT(b1, khc1);
+    KEYBUFFSCRIPT(b2, khc2);
+    KEYBUFFSCRIPT(b3, khc3);
+
+    sha256sse_1B(b0, b1, b2, b3, shc0, shc1, shc2, shc3);
+    ripemd160sse_32(shc0, shc1, shc2, shc3, hc0, hc1, hc2, hc3);
+
+    KEYBUFFSCRIPT(b0, khu0);
+    KEYBUFFSCRIPT(b1, khu1);
+    KEYBUFFSCRIPT(b2, khu2);
+    KEYBUFFSCRIPT(b3, khu3);
+
+    sha256sse_1B(b0, b1, b2, b3, shu0, shu1, shu2, shu3);
+    ripemd160sse_32(shu0, shu1, shu2, shu3, hu0, hu1, hu2, hu3);
+
+  }
+  break;
+
+  }
+
+}
+
+void Secp256K1::GetHash160x8(int type, bool compressed, Point *k, uint8_t(*h)[20]) {
+
+#ifdef WIN64
+  __declspec(align(32)) unsigned char sh[8][64];
+#else
+  unsigned char sh[8][64] __attribute__((aligned(32)));
+#endif
+
+  uint32_t *bp[8];
+  uint8_t *shp[8];
+  uint8_t *hp[8];
+
+  for (int i = 0; i < 8; i++) {
+    shp[i] = sh[i];
+    hp[i] = h[i];
+  }
+
+  switch (type) {
+
+  case P2PKH:
+  case BECH32:
+  {
+
+    if (!compressed) {
+
+      uint32_t b[8][32];
+
+      for (int i = 0; i < 8; i++) {
+        KEYBUFFUNCOMP(b[i], k[i]);
+        bp[i] = b[i];
+      }
+
+      sha256avx2_2B(bp, shp);
+      ripemd160avx2_32(shp, hp);
+
+    } else {
+
+      uint32_t b[8][16];
+
+      for (int i = 0; i < 8; i++) {
+        KEYBUFFCOMP(b[i], k[i]);
+        bp[i] = b[i];
+      }
+
+      sha256avx2_1B(bp, shp);
+      ripemd160avx2_32(shp, hp);
+
+    }
+
+  }
+  break;
+
+  case P2SH:
+  {
+
+    uint8_t kh[8][20];
+
+    GetHash160x8(P2PKH, compressed, k, kh);
+
+    // Redeem Script (1 to 1 P2SH)
+    uint32_t b[8][16];
+
+    for (int i = 0; i < 8; i++) {
+      KEYBUFFSCRIPT(b[i], kh[i]);
+      bp[i] = b[i];
+    }
+
+    sha256avx2_1B(bp, shp);
+    ripemd160avx2_32(shp, hp);
+
+  }
+  break;
+
+  }
+
+}
+
+void Secp256K1::GetHash160x16(int type, bool compressed, Point *k, uint8_t(*h)[20]) {
+
+#ifdef WIN64
+  __declspec(align(64)) unsigned char sh[16][64];
+#else
+  unsigned char sh[16][64] __attribute__((aligned(64)));
+#endif
+
+  uint32_t *bp[16];
+  uint8_t *shp[16];
+  uint8_t *hp[16];
+
+  for (int i = 0; i < 16; i++) {
+    shp[i] = sh[i];
+    hp[i] = h[i];
+  }
+
+  switch (type) {
+
+  case P2PKH:
+  case BECH32:
+  {
+
+    if (!compressed) {
+
+      uint32_t b[16][32];
+
+      for (int i = 0; i < 16; i++) {
+        KEYBUFFUNCOMP(b[i], k[i]);
+        bp[i] = b[i];
+      }
+
+      sha256avx512_2B(bp, shp);
+      ripemd160avx512_32(shp, hp);
+
+    } else {
+
+      uint32_t b[16][16];
+
+      for (int i = 0; i < 16; i++) {
+        KEYBUFFCOMP(b[i], k[i]);
+        bp[i] = b[i];
+      }
+
+      sha256avx512_1B(bp, shp);
+      ripemd160avx512_32(shp, hp);
+
+    }
+
+  }
+  break;
+
+  case P2SH:
+  {
+
+    uint8_t kh[16][20];
+
+    GetHash160x16(P2PKH, compressed, k, kh);
+
+    // Redeem Script (1 to 1 P2SH)
+    uint32_t b[16][16];
+
+    for (int i = 0; i < 16; i++) {
+      KEYBUFFSCRIPT(b[i], kh[i]);
+      bp[i] = b[i];
+    }
+
+    sha256avx512_1B(bp, shp);
+    ripemd160avx512_32(shp, hp);
+
+  }
+  break;
+
+  }
+
+}
+
 uint8_t Secp256K1::GetByte(std::string &str, int idx) {
 
   char tmp[3];
@@ -794,29 +1280,54 @@ bool Secp256K1::CheckPudAddress(std::string address) {
 
 }
 
-Point Secp256K1::AddDirect(Point &p1,Point &p2) {
+// In-place variant: writes the affine result coordinates without touching
+// r.z (the CPU pipeline works on z=1 points and never reads it), r may
+// alias p1 or p2 since the result is only stored at the end
+void Secp256K1::AddDirectInto(Point &r, Point &p1, Point &p2) {
 
-  Int _s;
-  Int _p;
   Int dy;
   Int dx;
-  Point r;
-  r.z.SetInt32(1);
+  FieldElement _s;
+  FieldElement _p;
+  FieldElement x1;
+  FieldElement x2;
+  FieldElement y2;
+  FieldElement rx;
+  FieldElement ry;
 
   dy.ModSub(&p2.y,&p1.y);
   dx.ModSub(&p2.x,&p1.x);
   dx.ModInv();
-  _s.ModMulK1(&dy,&dx);     // s = (p2.y-p1.y)*inverse(p2.x-p1.x);
 
-  _p.ModSquareK1(&_s);       // _p = pow2(s)
+  // Everything after the inversion runs on lazily reduced field elements,
+  // only the returned coordinates are normalized
+  _s.Set(&dy);
+  _p.Set(&dx);
+  _s.MulK1(&_p);           // s = (p2.y-p1.y)*inverse(p2.x-p1.x);
+
+  _p.SquareK1(&_s);        // _p = pow2(s)
 
-  r.x.ModSub(&_p,&p1.x);
-  r.x.ModSub(&p2.x);       // rx = pow2(s) - p1.x - p2.x;
+  x1.Set(&p1.x);
+  x2.Set(&p2.x);
+  y2.Set(&p2.y);
 
-  r.y.ModSub(&p2.x,&r.x);
-  r.y.ModMulK1(&_s);
-  r.y.ModSub(&p2.y);       // ry = - p2.y - s*(ret.x-p2.x);
+  rx.Sub(&_p,&x1);
+  rx.Sub(&x2);             // rx = pow2(s) - p1.x - p2.x;
 
+  ry.Sub(&x2,&rx);
+  ry.MulK1(&_s);
+  ry.Sub(&y2);             // ry = - p2.y - s*(ret.x-p2.x);
+
+  rx.Get(&r.x);
+  ry.Get(&r.y);
+
+}
+
+Point Secp256K1::AddDirect(Point &p1,Point &p2) {
+
+  Point r;
+  r.z.SetInt32(1);
+  AddDirectInto(r, p1, p2);
   return r;
 
 }
@@ -934,34 +1445,55 @@ Point Secp256K1::Add(Point &p1,Point &p2) {
   return r;
 }
 
-Point Secp256K1::DoubleDirect(Point &p) {
+// In-place variant, same conventions as AddDirectInto
+void Secp256K1::DoubleDirectInto(Point &r, Point &p) {
 
-  Int _s;
-  Int _p;
-  Int a;
-  Point r;
-  r.z.SetInt32(1);
+  Int i;
+  FieldElement _s;
+  FieldElement _p;
+  FieldElement a;
+  FieldElement x;
+  FieldElement y;
+  FieldElement rx;
+  FieldElement ry;
+
+  i.ModAdd(&p.y,&p.y);
+  i.ModInv();
+
+  // Everything after the inversion runs on lazily reduced field elements,
+  // only the returned coordinates are normalized
+  x.Set(&p.x);
+  y.Set(&p.y);
 
-  _s.ModMulK1(&p.x,&p.x);
-  _p.ModAdd(&_s,&_s);
-  _p.ModAdd(&_s);
+  _s.SquareK1(&x);
+  _p.Add(&_s,&_s);
+  _p.Add(&_s);
 
-  a.ModAdd(&p.y,&p.y);
-  a.ModInv();
-  _s.ModMulK1(&_p,&a);     // s = (3*pow2(p.x))*inverse(2*p.y);
+  a.Set(&i);
+  _s.MulK1(&_p,&a);        // s = (3*pow2(p.x))*inverse(2*p.y);
 
-  _p.ModMulK1(&_s,&_s);
-  a.ModAdd(&p.x,&p.x);
-  a.ModNeg();
-  r.x.ModAdd(&a,&_p);    // rx = pow2(s) + neg(2*p.x);
+  _p.SquareK1(&_s);
+  rx.Sub(&_p,&x);
+  rx.Sub(&x);              // rx = pow2(s) - 2*p.x;
 
-  a.ModSub(&r.x,&p.x);
+  a.Sub(&rx,&x);
 
-  _p.ModMulK1(&a,&_s);
-  r.y.ModAdd(&_p,&p.y);
-  r.y.ModNeg();           // ry = neg(p.y + s*(ret.x+neg(p.x)));
+  _p.MulK1(&a,&_s);
+  ry.Add(&_p,&y);
+  ry.Neg();                // ry = neg(p.y + s*(ret.x+neg(p.x)));
 
+  rx.Get(&r.x);
+  ry.Get(&r.y);
+
+}
+
+Point Secp256K1::DoubleDirect(Point &p) {
+
+  Point r;
+  r.z.SetInt32(1);
+  DoubleDirectInto(r, p);
   return r;
+
 }
 
 Point Secp256K1::Double(Point &p) {
@@ -35,6 +35,7 @@ public:
   ~Secp256K1();
   void Init();
   Point ComputePublicKey(Int *privKey);
+  Point ComputePublicKeyProjective(Int *privKey);
   Point NextKey(Point &key);
   void Check();
   bool  EC(Point &p);
@@ -43,6 +44,16 @@ public:
     Point &k0, Point &k1, Point &k2, Point &k3,
     uint8_t *h0, uint8_t *h1, uint8_t *h2, uint8_t *h3);
 
+  // Fused both mode variant, compressed and uncompressed hash160 in one call
+  void GetHash160Both(int type,
+    Point &k0, Point &k1, Point &k2, Point &k3,
+    uint8_t *hc0, uint8_t *hc1, uint8_t *hc2, uint8_t *hc3,
+    uint8_t *hu0, uint8_t *hu1, uint8_t *hu2, uint8_t *hu3);
+
+  // Wide variants (8 way AVX2, 16 way AVX512)
+  void GetHash160x8(int type, bool compressed, Point *k, uint8_t (*h)[20]);
+  void GetHash160x16(int type, bool compressed, Point *k, uint8_t (*h)[20]);
+
   void GetHash160(int type,bool compressed, Point &pubKey, unsigned char *hash);
 
   std::string GetAddress(int type, bool compressed, Point &pubKey);
@@ -54,6 +65,12 @@ public:
 
   bool CheckPudAddress(std::string address);
 
+  // Binary snapshot cache of the generator tables (GTable plus the caller
+  // side Gn/_2Gn group tables), building them costs thousands of sequential
+  // ModInv so they are serialized once and memory mapped back at startup
+  bool LoadTableCache(Point *gn, int nbGn, Point *g2n);
+  void SaveTableCache(Point *gn, int nbGn, Point *g2n);
+
   static Int DecodePrivateKey(char *key,bool *compressed);
 
   Point Add(Point &p1, Point &p2);
@@ -62,6 +79,11 @@ public:
   Point Double(Point &p);
   Point DoubleDirect(Point &p);
 
+  // In-place variants: write the affine result into r without touching r.z,
+  // r may alias an operand
+  void AddDirectInto(Point &r, Point &p1, Point &p2);
+  void DoubleDirectInto(Point &r, Point &p);
+
   Point G;                 // Generator
   Int   order;             // Curve order
 
@@ -0,0 +1,108 @@
+/*
+ * This file is part of the VanitySearch distribution (https://github.com/JeanLucPons/VanitySearch).
+ * Copyright (c) 2019 Jean Luc PONS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Stats.h"
+#include "Timer.h"
+#include <stdio.h>
+#include <string.h>
+
+bool Stats::enabled = false;
+std::string Stats::fileName;
+double Stats::startTime = 0.0;
+volatile uint64_t Stats::stageNs[STATS_NB_STAGE];
+volatile uint64_t Stats::stageCall[STATS_NB_STAGE];
+uint64_t Stats::lastNs[STATS_NB_STAGE];
+uint64_t Stats::lastCall[STATS_NB_STAGE];
+
+// Column base names, kept in the STATS_* define order
+static const char *stageNames[STATS_NB_STAGE] = {
+  "kernel", "pcie", "gpu_item", "cpu_hash", "check_priv", "verify"
+};
+
+void Stats::Enable(std::string fileName) {
+
+  Stats::fileName = fileName;
+  memset((void *)stageNs, 0, sizeof(stageNs));
+  memset((void *)stageCall, 0, sizeof(stageCall));
+  memset(lastNs, 0, sizeof(lastNs));
+  memset(lastCall, 0, sizeof(lastCall));
+  startTime = Timer::get_tick();
+
+  // Truncate and write the header so each run starts a fresh trace
+  FILE *f = fopen(fileName.c_str(), "w");
+  if (f == NULL) {
+    printf("Stats: Cannot open %s for writing\n", fileName.c_str());
+    return;
+  }
+  fprintf(f, "elapsed_s,key_rate,gpu_key_rate,total_keys,found");
+  for (int s = 0; s < STATS_NB_STAGE; s++)
+    fprintf(f, ",%s_ms,%s_calls", stageNames[s], stageNames[s]);
+  fprintf(f, "\n");
+  fclose(f);
+
+  enabled = true;
+
+}
+
+void Stats::Add(int stage, double seconds) {
+
+  uint64_t ns = (uint64_t)(seconds * 1e9);
+#ifdef WIN64
+  _InterlockedExchangeAdd64((volatile long long *)&stageNs[stage], (long long)ns);
+  _InterlockedExchangeAdd64((volatile long long *)&stageCall[stage], 1LL);
+#else
+  __sync_fetch_and_add(&stageNs[stage], ns);
+  __sync_fetch_and_add(&stageCall[stage], 1ULL);
+#endif
+
+}
+
+void Stats::Flush(double keyRate, double gpuKeyRate, uint64_t totalCount, int nbFound) {
+
+  if (!enabled)
+    return;
+
+  FILE *f = fopen(fileName.c_str(), "a");
+  if (f == NULL)
+    return;
+
+  fprintf(f, "%.1f,%.0f,%.0f,%llu,%d", Timer::get_tick() - startTime,
+          keyRate, gpuKeyRate, (unsigned long long)totalCount, nbFound);
+  for (int s = 0; s < STATS_NB_STAGE; s++) {
+    // Aligned volatile 64 bit reads are atomic on x64, time and call count
+    // are sampled independently but a skew only blurs a single row
+    uint64_t ns = stageNs[s];
+    uint64_t call = stageCall[s];
+    fprintf(f, ",%.3f,%llu", (double)(ns - lastNs[s]) / 1e6,
+            (unsigned long long)(call - lastCall[s]));
+    lastNs[s] = ns;
+    lastCall[s] = call;
+  }
+  fprintf(f, "\n");
+  fclose(f);
+
+}
+
+StatsScope::StatsScope(int stage) {
+  this->stage = stage;
+  this->t0 = Stats::enabled ? Timer::get_tick() : 0.0;
+}
+
+StatsScope::~StatsScope() {
+  if (Stats::enabled)
+    Stats::Add(stage, Timer::get_tick() - t0);
+}
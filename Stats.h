@@ -0,0 +1,76 @@
+/*
+ * This file is part of the VanitySearch distribution (https://github.com/JeanLucPons/VanitySearch).
+ * Copyright (c) 2019 Jean Luc PONS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STATSH
+#define STATSH
+
+#include <string>
+#include <cstdint>
+
+// Hot path stage identifiers (see the Stats::Add callers in Vanity.cpp)
+#define STATS_KERNEL    0   // GPU kernel wait
+#define STATS_PCIE      1   // GPU output drain copies
+#define STATS_GPU_ITEM  2   // Host processing of GPU reported items
+#define STATS_CPU_HASH  3   // CPU hash and table probe loop
+#define STATS_CHECK     4   // checkPrivKey reconstruction and verification
+#define STATS_VERIFY    5   // Batched verifier drains
+#define STATS_NB_STAGE  6
+
+// Opt-in hot path instrumentation (-stats <file>). Workers accumulate per
+// stage wall time and call counts with atomic adds, the stats loop appends
+// one CSV row per refresh with the deltas since the previous row so the file
+// can be tailed into a dashboard while the search runs. When disabled (the
+// default) each probe costs a single predictable branch
+class Stats {
+
+public:
+
+  static void Enable(std::string fileName);
+  static void Add(int stage, double seconds);
+  // Append a CSV row with the per stage deltas since the previous call,
+  // called from the stats loop only
+  static void Flush(double keyRate, double gpuKeyRate, uint64_t totalCount, int nbFound);
+
+  static bool enabled;
+
+private:
+
+  static std::string fileName;
+  static double startTime;
+  static volatile uint64_t stageNs[STATS_NB_STAGE];
+  static volatile uint64_t stageCall[STATS_NB_STAGE];
+  static uint64_t lastNs[STATS_NB_STAGE];
+  static uint64_t lastCall[STATS_NB_STAGE];
+
+};
+
+// Scope timer for stages with several exit paths
+class StatsScope {
+
+public:
+
+  StatsScope(int stage);
+  ~StatsScope();
+
+private:
+
+  int stage;
+  double t0;
+
+};
+
+#endif // STATSH
@@ -21,89 +21,43 @@
 #include "hash/sha256.h"
 #include "hash/sha512.h"
 #include "IntGroup.h"
+#include "Cluster.h"
+#include "Random.h"
 #include "Wildcard.h"
 #include "Timer.h"
+#include "Stats.h"
 #include "hash/ripemd160.h"
 #include <string.h>
 #include <math.h>
 #include <algorithm>
 #ifndef WIN64
 #include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#else
+#include <intrin.h>
 #endif
+#include <emmintrin.h>
+#include <stddef.h>
 
 using namespace std;
 
-Point Gn[CPU_GRP_SIZE / 2];
-Point _2Gn;
+Point Gn[CPU_GRP_SIZE_MAX / 2];
+// GRP*G for each supported group size (1024, 2048, 4096)
+Point _2Gn[3];
 
-// ----------------------------------------------------------------------------
-// Helper: Compute modular inverse using extended Euclidean algorithm
-// result = a^(-1) mod n
-// ----------------------------------------------------------------------------
-static void ModInvOrder(Int *result, Int *a, Int *n) {
-  // Extended Euclidean Algorithm
-  // Returns a^(-1) mod n
-  // Fixed: Use ModMulK1order instead of Mult to avoid overflow
-  Int u, v, x1, x2, q, r, temp;
-
-  u.Set(n);
-  v.Set(a);
-  x1.SetInt32(0);
-  x2.SetInt32(1);
-
-  while (!v.IsZero() && !v.IsOne()) {
-    // q = u / v
-    q.Set(&u);
-    q.Div(&v, &r);  // q = u/v, r = u%v
-
-    // x1, x2 = x2, x1 - q*x2
-    // Use modular multiplication to avoid 512-bit overflow
-    temp.Set(&q);
-    temp.ModMulK1order(&x2);  // temp = q * x2 mod n
-
-    // x1 - temp (mod n)
-    Int newX2;
-    newX2.Set(&x1);
-    newX2.ModSubK1order(&temp);  // newX2 = x1 - q*x2 mod n
-
-    x1.Set(&x2);
-    x2.Set(&newX2);
-
-    // u, v = v, r
-    u.Set(&v);
-    v.Set(&r);
-  }
-
-  if (v.IsOne()) {
-    result->Set(&x2);
-    // Ensure result is positive and in range [0, n-1]
-    if (result->IsNegative()) {
-      result->Add(n);
-    }
-  } else {
-    result->SetInt32(0);  // No inverse exists
-  }
+// Index of a group size in _2Gn
+static inline int GrpIdx(int grpSize) {
+  return (grpSize == CPU_GRP_SIZE_MAX) ? 2 : ((grpSize == 2048) ? 1 : 0);
 }
 
 // ----------------------------------------------------------------------------
-// Helper: BIP-340/341 Tagged Hash
-// result = SHA256(SHA256(tag) || SHA256(tag) || data)
-// ----------------------------------------------------------------------------
-static void TaggedHash(const char* tag, const uint8_t* data, size_t dataLen, uint8_t* result) {
-  // Compute tag hash
-  uint8_t tagHash[32];
-  sha256((uint8_t*)tag, (int)strlen(tag), tagHash);
-
-  // Build buffer: tagHash || tagHash || data
-  size_t bufLen = 64 + dataLen;
-  uint8_t* buf = new uint8_t[bufLen];
-  memcpy(buf, tagHash, 32);
-  memcpy(buf + 32, tagHash, 32);
-  memcpy(buf + 64, data, dataLen);
 
-  // Final hash
-  sha256(buf, (int)bufLen, result);
-  delete[] buf;
+static bool lPrefixLess(const PREFIX_ITEM &a, const PREFIX_ITEM &b) {
+  return a.lPrefix < b.lPrefix;
 }
 
 // ----------------------------------------------------------------------------
@@ -111,11 +65,12 @@ static void TaggedHash(const char* tag, const uint8_t* data, size_t dataLen, uin
 VanitySearch::VanitySearch(Secp256K1 *secp, vector<std::string> &inputPrefixes,string seed,int searchMode,
                            bool useGpu, bool stop, string outputFile, bool useSSE, uint32_t maxFound,
                            uint64_t rekey, bool caseSensitive, Point &startPubKey, bool paranoiacSeed,
-                           StegoTarget *stegoTargetPtr,
+                           StegoTarget *stegoTargetPtr, int nbStegoTarget,
                            bool sigModeIn, bool schnorrModeIn, Int *sigMsgHashPtr, Int *sigPrivKeyPtr,
                            Int *sigPubKeyXPtr,
                            bool txidModeIn, std::vector<uint8_t> rawTxIn, int nonceOffsetIn, int nonceLenIn,
-                           bool taprootModeIn)
+                           bool taprootModeIn, bool persistentKernelIn,
+                           std::string resumeFileIn, int classMaskIn)
   :inputPrefixes(inputPrefixes) {
 
   // Initialize mutex handle to NULL (will be created in Search())
@@ -129,9 +84,57 @@ VanitySearch::VanitySearch(Secp256K1 *secp, vector<std::string> &inputPrefixes,s
   this->stopWhenFound = stop;
   this->outputFile = outputFile;
   this->useSSE = useSSE;
+
+  // Widest hash pipeline supported by the CPU (AVX512 > AVX2 > SSE)
+#ifdef WIN64
+  {
+    int info[4];
+    __cpuidex(info, 7, 0);
+    this->useAVX2 = useSSE && ((info[1] >> 5) & 1);
+    this->useAVX512 = useSSE && ((info[1] >> 16) & 1);
+  }
+#else
+  this->useAVX2 = useSSE && __builtin_cpu_supports("avx2");
+  this->useAVX512 = useSSE && __builtin_cpu_supports("avx512f");
+#endif
+
   this->nbGPUThread = 0;
+  this->clusterWorker = NULL;
+  this->cpuGrpSize = CPU_GRP_SIZE;
   this->maxFound = maxFound;
+  this->outputHead = NULL;
+  this->writerRunning = false;
+  this->writerStop = false;
+  this->verifierRunning = false;
+  this->verifierStop = false;
+  this->resumeFile = resumeFileIn;
+  this->resumeState = NULL;
+  this->resumeSlot = 0;
+  this->savedTotalCount = 0;
+  memset((void *)this->threadOffsets, 0, sizeof(this->threadOffsets));
+  if (resumeFile.length() > 0 && rekey > 0) {
+    // Rekeying draws random starting keys, there is nothing to resume from
+    printf("Warning: -resume disables rekeying (-r)\n");
+    rekey = 0;
+  }
   this->rekey = rekey;
+  this->classMask = classMaskIn & CLASS_ALL;
+  if (this->classMask == 0)
+    this->classMask = CLASS_ALL;
+  if (searchMode == SEARCH_STEGO) {
+    // A symmetric point shares the X coordinate of its base class so it can
+    // never match a mask the base class does not, and checkStegoMask already
+    // recovers the negated key on match. Fold the symmetric bits away, each
+    // remaining class then covers its symmetric key for free
+    this->classMask = (this->classMask | (this->classMask >> 3)) & 0x7;
+  }
+  this->nbClass = 0;
+  for (int b = 0; b < 6; b++)
+    if ((this->classMask >> b) & 1) this->nbClass++;
+  if (searchMode == SEARCH_STEGO)
+    this->nbClass *= 2;
+  if (this->nbClass != 6)
+    printf("Symmetry classes: %d of 6 checked (CPU)\n", this->nbClass);
   this->searchType = -1;
   this->startPubKey = startPubKey;
   this->hasPattern = false;
@@ -142,6 +145,8 @@ VanitySearch::VanitySearch(Secp256K1 *secp, vector<std::string> &inputPrefixes,s
   this->stegoMode = (stegoTargetPtr != NULL) && !sigModeIn && !txidModeIn && !taprootModeIn;
   if (stegoTargetPtr) {
     memcpy(&this->stegoTarget, stegoTargetPtr, sizeof(StegoTarget));
+    for (int i = 0; i < nbStegoTarget; i++)
+      stegoTargets.push_back(stegoTargetPtr[i]);
   } else {
     memset(&this->stegoTarget, 0, sizeof(StegoTarget));
   }
@@ -168,6 +173,9 @@ VanitySearch::VanitySearch(Secp256K1 *secp, vector<std::string> &inputPrefixes,s
   // Taproot post-tweak grinding mode
   this->taprootMode = taprootModeIn;
 
+  // Persistent GPU kernel mode
+  this->persistentKernel = persistentKernelIn;
+
   // TXID grinding mode
   this->txidMode = txidModeIn;
   this->rawTx = rawTxIn;
@@ -195,8 +203,16 @@ VanitySearch::VanitySearch(Secp256K1 *secp, vector<std::string> &inputPrefixes,s
     nbPrefix = 0;
     onlyFull = false;
     searchType = P2PKH;  // Doesn't matter for mask mode, but needs to be set
-    _difficulty = pow(2.0, stegoTarget.numBits);
-    printf("Mask mode: Matching %d bits of pubkey X coordinate\n", stegoTarget.numBits);
+    // A key matching any of the targets counts, the match probabilities add
+    double pMatch = 0.0;
+    for (int i = 0; i < (int)stegoTargets.size(); i++)
+      pMatch += pow(2.0, -stegoTargets[i].numBits);
+    _difficulty = 1.0 / pMatch;
+    if (stegoTargets.size() > 1)
+      printf("Mask mode: Matching %d targets (difficulty 2^%.1f)\n",
+             (int)stegoTargets.size(), log(_difficulty) / log(2.0));
+    else
+      printf("Mask mode: Matching %d bits of pubkey X coordinate\n", stegoTarget.numBits);
   } else if (sigMode) {
     nbPrefix = 0;
     onlyFull = false;
@@ -225,6 +241,15 @@ VanitySearch::VanitySearch(Secp256K1 *secp, vector<std::string> &inputPrefixes,s
 
     nbPrefix = 0;
     onlyFull = true;
+
+    // Case sensitive lists draw their found flags from one flat allocation,
+    // a per item new bool costs ~32 bytes of heap each on multi million
+    // address files
+    bool *foundFlags = NULL;
+    size_t nbFoundFlag = 0;
+    if (caseSensitive && inputPrefixes.size() > 0)
+      foundFlags = (bool *)calloc(inputPrefixes.size(), sizeof(bool));
+
     for (int i = 0; i < (int)inputPrefixes.size(); i++) {
 
       PREFIX_ITEM it;
@@ -232,55 +257,86 @@ VanitySearch::VanitySearch(Secp256K1 *secp, vector<std::string> &inputPrefixes,s
 
       if (!caseSensitive) {
 
-        // For caseunsensitive search, loop through all possible combination
-        // and fill up lookup table
+        // For case insensitive search each case combination still decodes to
+        // its own hash160 range, so its 16 bit lookup slot is still needed,
+        // but every slot shares a single case folded item and the final
+        // compare is folded too (see prefixMatch). This replaces the old
+        // scheme that kept one PREFIX_ITEM and prefix string per casing.
         vector<string> subList;
         enumCaseUnsentivePrefix(inputPrefixes[i], subList);
 
         bool *found = new bool;
         *found = false;
 
+        vector<prefix_t> slots;
+        double dMin = 0.0;
+        int nbMin = 0;
+
         for (int j = 0; j < (int)subList.size(); j++) {
           if (initPrefix(subList[j], &it)) {
-            it.found = found;
-            it.prefix = strdup(it.prefix); // We need to allocate here, subList will be destroyed
-            itPrefixes.push_back(it);
-          }
-        }
 
-        if (itPrefixes.size() > 0) {
+            if (it.isFull) {
+              // Full addresses have a distinct hash160 per casing, keep one
+              // item per casing
+              it.found = found;
+              it.prefix = strdup(it.prefix); // We need to allocate here, subList will be destroyed
+              itPrefixes.push_back(it);
+              continue;
+            }
 
-          // Compute difficulty for case unsensitive search
-          // Not obvious to perform the right calculation here using standard double
-          // Improvement are welcome
+            slots.push_back(it.sPrefix);
 
-          // Get the min difficulty and divide by the number of item having the same difficulty
-          // Should give good result when difficulty is large enough
-          double dMin = itPrefixes[0].difficulty;
-          int nbMin = 1;
-          for (int j = 1; j < (int)itPrefixes.size(); j++) {
-            if (itPrefixes[j].difficulty == dMin) {
-              nbMin++;
-            } else if (itPrefixes[j].difficulty < dMin) {
-              dMin = itPrefixes[j].difficulty;
+            // Compute difficulty for case unsensitive search
+            // Get the min difficulty and divide by the number of item having
+            // the same difficulty, should give good result when difficulty
+            // is large enough
+            if (nbMin == 0 || it.difficulty < dMin) {
+              dMin = it.difficulty;
               nbMin = 1;
+            } else if (it.difficulty == dMin) {
+              nbMin++;
             }
+
           }
+        }
+
+        if (slots.size() > 0) {
 
           dMin /= (double)nbMin;
 
-          // Updates
-          for (int j = 0; j < (int)itPrefixes.size(); j++)
-            itPrefixes[j].difficulty = dMin;
+          string folded = inputPrefixes[i];
+          std::transform(folded.begin(), folded.end(), folded.begin(), ::tolower);
+
+          PREFIX_ITEM shared;
+          shared.found = found;
+          shared.prefix = strdup(folded.c_str());
+          shared.prefixLength = (int)inputPrefixes[i].length();
+          shared.difficulty = dMin;
+          shared.isFull = false;
+          shared.lPrefix = 0;
+
+          // One shared item per unique lookup slot
+          sort(slots.begin(), slots.end());
+          slots.erase(unique(slots.begin(), slots.end()), slots.end());
+
+          for (int j = 0; j < (int)slots.size(); j++) {
+            shared.sPrefix = slots[j];
+            itPrefixes.push_back(shared);
+          }
 
         }
 
       } else {
 
         if (initPrefix(inputPrefixes[i], &it)) {
-          bool *found = new bool;
-          *found = false;
-          it.found = found;
+          it.found = foundFlags + nbFoundFlag++;
+          if (it.isFull && loadingProgress) {
+            // Full addresses match on their hash160 alone and the prefix
+            // field is never read for full items, release the string
+            // storage as we go on huge lists
+            it.prefix = NULL;
+            std::string().swap(inputPrefixes[i]);
+          }
           itPrefixes.push_back(it);
         }
 
@@ -332,9 +388,21 @@ VanitySearch::VanitySearch(Secp256K1 *secp, vector<std::string> &inputPrefixes,s
     uint32_t maxI = 0;
     for (int i = 0; i < (int)prefixes.size(); i++) {
       if (prefixes[i].items) {
+        // Return the geometric growth overshoot of the insert loop, it adds
+        // up to hundreds of MB across the slots of a huge list
+        prefixes[i].items->shrink_to_fit();
+        if (onlyFull) {
+          // Sort the items on their lPrefix and keep a flat sorted copy,
+          // checkAddr probes it with SSE instead of scanning the items
+          sort(prefixes[i].items->begin(), prefixes[i].items->end(), lPrefixLess);
+          prefixes[i].lPrefixes.reserve(prefixes[i].items->size());
+          for (int j = 0; j < (int)prefixes[i].items->size(); j++)
+            prefixes[i].lPrefixes.push_back((*prefixes[i].items)[j].lPrefix);
+        }
         LPREFIX lit;
         lit.sPrefix = i;
         if (prefixes[i].items) {
+          lit.lPrefixes.reserve(prefixes[i].items->size());
           for (int j = 0; j < (int)prefixes[i].items->size(); j++) {
             lit.lPrefixes.push_back((*prefixes[i].items)[j].lPrefix);
           }
@@ -403,20 +471,42 @@ VanitySearch::VanitySearch(Secp256K1 *secp, vector<std::string> &inputPrefixes,s
     patternFound = (bool *)malloc(inputPrefixes.size()*sizeof(bool));
     memset(patternFound,0, inputPrefixes.size() * sizeof(bool));
 
+    // Compile the patterns into the combined matcher, each candidate address
+    // is then matched against all of them in a single scan instead of one
+    // Wildcard::match per pattern (see PatternSet)
+    for (int i = 0; i < (int)inputPrefixes.size(); i++) {
+      if (patternSet.Add(inputPrefixes[i].c_str(), caseSensitive))
+        patternSetIdx.push_back(i);
+      else
+        patternGeneric.push_back(i);
+    }
+
   }
 
   // Compute Generator table G[n] = (n+1)*G
+  // The table is part of the binary snapshot cache (see SECP256K1.cpp),
+  // build and write it only when no valid snapshot exists
+
+  if (!secp->LoadTableCache(Gn, CPU_GRP_SIZE_MAX/2, &_2Gn[2])) {
+
+    Point g = secp->G;
+    Gn[0] = g;
+    g = secp->DoubleDirect(g);
+    Gn[1] = g;
+    for (int i = 2; i < CPU_GRP_SIZE_MAX/2; i++) {
+      g = secp->AddDirect(g,secp->G);
+      Gn[i] = g;
+    }
+    // _2Gn = CPU_GRP_SIZE_MAX*G
+    _2Gn[2] = secp->DoubleDirect(Gn[CPU_GRP_SIZE_MAX/2-1]);
+
+    secp->SaveTableCache(Gn, CPU_GRP_SIZE_MAX/2, &_2Gn[2]);
 
-  Point g = secp->G;
-  Gn[0] = g;
-  g = secp->DoubleDirect(g);
-  Gn[1] = g;
-  for (int i = 2; i < CPU_GRP_SIZE/2; i++) {
-    g = secp->AddDirect(g,secp->G);
-    Gn[i] = g;
   }
-  // _2Gn = CPU_GRP_SIZE*G
-  _2Gn = secp->DoubleDirect(Gn[CPU_GRP_SIZE/2-1]);
+
+  // GRP*G for the smaller group sizes
+  _2Gn[0] = secp->DoubleDirect(Gn[1024/2-1]);
+  _2Gn[1] = secp->DoubleDirect(Gn[2048/2-1]);
 
   // Constant for endomorphism
   // if a is a nth primitive root of unity, a^-1 is also a nth primitive root.
@@ -429,6 +519,25 @@ VanitySearch::VanitySearch(Secp256K1 *secp, vector<std::string> &inputPrefixes,s
   lambda2.SetBase16("ac9c52b33fa3cf1f5ad9e3fd77ed9ba4a880b9fc8ec739c2e0cfc810b51283ce");
 
   // Seed
+  startKey = ComputeBaseKey(seed, paranoiacSeed);
+
+  char *ctimeBuff;
+  time_t now = time(NULL);
+  ctimeBuff = ctime(&now);
+  printf("Start %s", ctimeBuff);
+
+  if (rekey > 0) {
+    printf("Base Key: Randomly changed every %.0f Mkeys\n",(double)rekey);
+  } else {
+    printf("Base Key: %s\n", startKey.GetBase16().c_str());
+  }
+
+}
+
+// ----------------------------------------------------------------------------
+
+Int VanitySearch::ComputeBaseKey(std::string seed, bool paranoiacSeed) {
+
   if (seed.length() == 0) {
     // Default seed
     seed = Timer::getSeed(32);
@@ -444,20 +553,17 @@ VanitySearch::VanitySearch(Secp256K1 *secp, vector<std::string> &inputPrefixes,s
   pbkdf2_hmac_sha512(hseed, 64, (const uint8_t *)seed.c_str(), seed.length(),
     (const uint8_t *)salt.c_str(), salt.length(),
     2048);
-  startKey.SetInt32(0);
-  sha256(hseed, 64, (unsigned char *)startKey.bits64);
+  Int baseKey;
+  baseKey.SetInt32(0);
+  sha256(hseed, 64, (unsigned char *)baseKey.bits64);
+  return baseKey;
 
-  char *ctimeBuff;
-  time_t now = time(NULL);
-  ctimeBuff = ctime(&now);
-  printf("Start %s", ctimeBuff);
+}
 
-  if (rekey > 0) {
-    printf("Base Key: Randomly changed every %.0f Mkeys\n",(double)rekey);
-  } else {
-    printf("Base Key: %s\n", startKey.GetBase16().c_str());
-  }
+// ----------------------------------------------------------------------------
 
+void VanitySearch::SetClusterWorker(ClusterWorker *worker) {
+  this->clusterWorker = worker;
 }
 
 // ----------------------------------------------------------------------------
@@ -807,58 +913,129 @@ string VanitySearch::GetExpectedTime(double keyRate,double keyCount) {
 
 // ----------------------------------------------------------------------------
 
-void VanitySearch::output(string addr,string pAddr,string pAddrHex) {
+// Relaxed accessors for the padded per thread counters, one writer per slot
+// so only atomicity of the 64 bit access is needed, not ordering
+static inline uint64_t counterLoad(THREAD_COUNTER &c) {
+#ifdef WIN64
+  // Aligned volatile 64 bit accesses are atomic on x64
+  return c.count;
+#else
+  return __atomic_load_n(&c.count, __ATOMIC_RELAXED);
+#endif
+}
 
+static inline void counterStore(THREAD_COUNTER &c, uint64_t v) {
 #ifdef WIN64
-  if (ghMutex != NULL) {
-    WaitForSingleObject(ghMutex,INFINITE);
-  }
+  c.count = v;
 #else
-  pthread_mutex_lock(&ghMutex);
+  __atomic_store_n(&c.count, v, __ATOMIC_RELAXED);
 #endif
+}
 
-  FILE *f = stdout;
-  bool needToClose = false;
+static inline void counterAdd(THREAD_COUNTER &c, uint64_t v) {
+  counterStore(c, counterLoad(c) + v);
+}
 
-  if (outputFile.length() > 0) {
-    f = fopen(outputFile.c_str(), "a");
-    if (f == NULL) {
-      printf("Cannot open %s for writing\n", outputFile.c_str());
-      f = stdout;
-    } else {
-      needToClose = true;
-    }
-  }
+// Lock free MPSC stack primitives for the result writer
+static inline OUTPUT_RECORD *outputExchange(OUTPUT_RECORD **head, OUTPUT_RECORD *r) {
+#ifdef WIN64
+  return (OUTPUT_RECORD *)InterlockedExchangePointer((PVOID *)head, (PVOID)r);
+#else
+  return (OUTPUT_RECORD *)__sync_lock_test_and_set(head, r);
+#endif
+}
 
-  if(!needToClose)
+static inline bool outputCompareExchange(OUTPUT_RECORD **head, OUTPUT_RECORD *expected, OUTPUT_RECORD *r) {
+#ifdef WIN64
+  return InterlockedCompareExchangePointer((PVOID *)head, (PVOID)r, (PVOID)expected) == (PVOID)expected;
+#else
+  return __sync_bool_compare_and_swap(head, expected, r);
+#endif
+}
+
+void VanitySearch::writeRecord(FILE *f, OUTPUT_RECORD *r) {
+
+  if (f == stdout)
     printf("\n");
 
-  fprintf(f, "PubAddress: %s\n", addr.c_str());
+  fprintf(f, "PubAddress: %s\n", r->addr.c_str());
 
   if (startPubKeySpecified) {
 
-    fprintf(f, "PartialPriv: %s\n", pAddr.c_str());
+    fprintf(f, "PartialPriv: %s\n", r->pAddr.c_str());
 
   } else {
 
     switch (searchType) {
     case P2PKH:
-      fprintf(f, "Priv (WIF): p2pkh:%s\n", pAddr.c_str());
+      fprintf(f, "Priv (WIF): p2pkh:%s\n", r->pAddr.c_str());
       break;
     case P2SH:
-      fprintf(f, "Priv (WIF): p2wpkh-p2sh:%s\n", pAddr.c_str());
+      fprintf(f, "Priv (WIF): p2wpkh-p2sh:%s\n", r->pAddr.c_str());
       break;
     case BECH32:
-      fprintf(f, "Priv (WIF): p2wpkh:%s\n", pAddr.c_str());
+      fprintf(f, "Priv (WIF): p2wpkh:%s\n", r->pAddr.c_str());
       break;
     }
-    fprintf(f, "Priv (HEX): 0x%s\n", pAddrHex.c_str());
+    fprintf(f, "Priv (HEX): 0x%s\n", r->pAddrHex.c_str());
+
+  }
+
+}
+
+void VanitySearch::output(string addr,string pAddr,string pAddrHex) {
+
+  // Forward hits to the coordinator in addition to the local output path
+  if (clusterWorker != NULL)
+    clusterWorker->Found(addr, pAddr, pAddrHex);
+
+  OUTPUT_RECORD *r = new OUTPUT_RECORD;
+  r->addr = addr;
+  r->pAddr = pAddr;
+  r->pAddrHex = pAddrHex;
+
+  if (writerRunning) {
+
+    // Push on the MPSC stack, the writer thread batches records to disk so
+    // low difficulty runs (thousands of hits per second) do not serialize
+    // the workers on the file system
+    do {
+      r->next = outputHead;
+    } while (!outputCompareExchange(&outputHead, r->next, r));
+    return;
+
+  }
+
+  // No writer thread running (startup/shutdown path), write synchronously
+
+#ifdef WIN64
+  if (ghMutex != NULL) {
+    WaitForSingleObject(ghMutex,INFINITE);
+  }
+#else
+  pthread_mutex_lock(&ghMutex);
+#endif
 
+  FILE *f = stdout;
+  bool needToClose = false;
+
+  if (outputFile.length() > 0) {
+    f = fopen(outputFile.c_str(), "a");
+    if (f == NULL) {
+      printf("Cannot open %s for writing\n", outputFile.c_str());
+      f = stdout;
+    } else {
+      needToClose = true;
+    }
   }
 
+  writeRecord(f, r);
+
   if(needToClose)
     fclose(f);
 
+  delete r;
+
 #ifdef WIN64
   if (ghMutex != NULL) {
     ReleaseMutex(ghMutex);
@@ -869,6 +1046,59 @@ void VanitySearch::output(string addr,string pAddr,string pAddrHex) {
 
 }
 
+void VanitySearch::OutputWriterThread() {
+
+  FILE *f = stdout;
+
+  if (outputFile.length() > 0) {
+    f = fopen(outputFile.c_str(), "a");
+    if (f == NULL) {
+      printf("Cannot open %s for writing\n", outputFile.c_str());
+      f = stdout;
+    }
+  }
+
+  writerRunning = true;
+
+  while (true) {
+
+    // Grab the whole pending stack in one exchange
+    OUTPUT_RECORD *list = outputExchange(&outputHead, NULL);
+
+    if (list == NULL) {
+      if (writerStop)
+        break;
+      Timer::SleepMillis(50);
+      continue;
+    }
+
+    // The stack pops newest first, restore arrival order
+    OUTPUT_RECORD *rev = NULL;
+    while (list) {
+      OUTPUT_RECORD *n = list->next;
+      list->next = rev;
+      rev = list;
+      list = n;
+    }
+
+    while (rev) {
+      writeRecord(f, rev);
+      OUTPUT_RECORD *n = rev->next;
+      delete rev;
+      rev = n;
+    }
+
+    fflush(f);
+
+  }
+
+  if (f != stdout)
+    fclose(f);
+
+  writerRunning = false;
+
+}
+
 // ----------------------------------------------------------------------------
 
 void VanitySearch::updateFound() {
@@ -914,16 +1144,16 @@ void VanitySearch::updateFound() {
 
 // ----------------------------------------------------------------------------
 
-bool VanitySearch::checkPrivKey(string addr, Int &key, int32_t incr, int endomorphism, bool mode) {
+// Scalar actually matched for a reported (incr, endomorphism) pair, shared
+// by checkPrivKey and the batched verifier
+Int VanitySearch::adjustedKey(Int &key, int32_t incr, int endomorphism) {
 
   Int k(&key);
-  Point sp = startPubKey;
 
   if (incr < 0) {
     k.Add((uint64_t)(-incr));
     k.Neg();
     k.Add(&secp->order);
-    if (startPubKeySpecified) sp.y.ModNeg();
   } else {
     k.Add((uint64_t)incr);
   }
@@ -932,16 +1162,36 @@ bool VanitySearch::checkPrivKey(string addr, Int &key, int32_t incr, int endomor
   switch (endomorphism) {
   case 1:
     k.ModMulK1order(&lambda);
-    if(startPubKeySpecified) sp.x.ModMulK1(&beta);
     break;
   case 2:
     k.ModMulK1order(&lambda2);
-    if (startPubKeySpecified) sp.x.ModMulK1(&beta2);
     break;
   }
 
-  // Check addresses
-  Point p = secp->ComputePublicKey(&k);
+  return k;
+
+}
+
+bool VanitySearch::checkPrivKey(string addr, Int &key, int32_t incr, int endomorphism, bool mode, Point *knownP) {
+
+  StatsScope statsScope(STATS_CHECK);
+
+  Int k = adjustedKey(key, incr, endomorphism);
+
+  Point sp = startPubKey;
+  if (startPubKeySpecified) {
+    if (incr < 0) sp.y.ModNeg();
+    switch (endomorphism) {
+    case 1: sp.x.ModMulK1(&beta); break;
+    case 2: sp.x.ModMulK1(&beta2); break;
+    }
+  }
+
+  // Check addresses, the batched verifier hands in the precomputed k.G so
+  // only the mismatch retry below ever pays a scalar multiplication here
+  Point p;
+  if (knownP) p = *knownP;
+  else p = secp->ComputePublicKey(&k);
   if (startPubKeySpecified) p = secp->AddDirect(p, sp);
 
   string chkAddr = secp->GetAddress(searchType, mode, p);
@@ -972,31 +1222,43 @@ bool VanitySearch::checkPrivKey(string addr, Int &key, int32_t incr, int endomor
 
 }
 
-void VanitySearch::checkAddrSSE(uint8_t *h1, uint8_t *h2, uint8_t *h3, uint8_t *h4,
-                                int32_t incr1, int32_t incr2, int32_t incr3, int32_t incr4,
-                                Int &key, int endomorphism, bool mode) {
-
-  vector<string> addr = secp->GetAddress(searchType, mode, h1,h2,h3,h4);
+// Match one address against every wildcard pattern. The anchored patterns
+// are evaluated all at once by the combined matcher, only the few it could
+// not compile (several '*') fall back to a per pattern Wildcard::match
+void VanitySearch::matchPatterns(string &addr, Int &key, int32_t incr, int endomorphism, bool mode, Point *knownP) {
 
-  for (int i = 0; i < (int)inputPrefixes.size(); i++) {
+  uint64_t matched[PATTERN_SET_NBWORD];
+  if (patternSet.Match(addr.c_str(), matched)) {
+    for (int w = 0; w < PATTERN_SET_NBWORD; w++) {
+      uint64_t m = matched[w];
+      while (m) {
+#ifdef WIN64
+        unsigned long b;
+        _BitScanForward64(&b, m);
+#else
+        int b = __builtin_ctzll(m);
+#endif
+        m &= m - 1;
+        int i = patternSetIdx[w * 64 + (int)b];
 
-    if (Wildcard::match(addr[0].c_str(), inputPrefixes[i].c_str(), caseSensitive)) {
+        // Found it !
+        if (checkPrivKey(addr, key, incr, endomorphism, mode, knownP)) {
+          nbFoundKey++;
+          patternFound[i] = true;
+          updateFound();
+        }
 
-      // Found it !
-      //*((*pi)[i].found) = true;
-      if (checkPrivKey(addr[0], key, incr1, endomorphism, mode)) {
-        nbFoundKey++;
-        patternFound[i] = true;
-        updateFound();
       }
-
     }
+  }
 
-    if (Wildcard::match(addr[1].c_str(), inputPrefixes[i].c_str(), caseSensitive)) {
+  for (int g = 0; g < (int)patternGeneric.size(); g++) {
+
+    int i = patternGeneric[g];
+    if (Wildcard::match(addr.c_str(), inputPrefixes[i].c_str(), caseSensitive)) {
 
       // Found it !
-      //*((*pi)[i].found) = true;
-      if (checkPrivKey(addr[1], key, incr2, endomorphism, mode)) {
+      if (checkPrivKey(addr, key, incr, endomorphism, mode, knownP)) {
         nbFoundKey++;
         patternFound[i] = true;
         updateFound();
@@ -1004,58 +1266,70 @@ void VanitySearch::checkAddrSSE(uint8_t *h1, uint8_t *h2, uint8_t *h3, uint8_t *
 
     }
 
-    if (Wildcard::match(addr[2].c_str(), inputPrefixes[i].c_str(), caseSensitive)) {
+  }
 
-      // Found it !
-      //*((*pi)[i].found) = true;
-      if (checkPrivKey(addr[2], key, incr3, endomorphism, mode)) {
-        nbFoundKey++;
-        patternFound[i] = true;
-        updateFound();
-      }
+}
 
-    }
+void VanitySearch::checkAddrSSE(uint8_t *h1, uint8_t *h2, uint8_t *h3, uint8_t *h4,
+                                int32_t incr1, int32_t incr2, int32_t incr3, int32_t incr4,
+                                Int &key, int endomorphism, bool mode) {
 
-    if (Wildcard::match(addr[3].c_str(), inputPrefixes[i].c_str(), caseSensitive)) {
+  vector<string> addr = secp->GetAddress(searchType, mode, h1,h2,h3,h4);
 
-      // Found it !
-      //*((*pi)[i].found) = true;
-      if (checkPrivKey(addr[3], key, incr4, endomorphism, mode)) {
-        nbFoundKey++;
-        patternFound[i] = true;
-        updateFound();
-      }
+  matchPatterns(addr[0], key, incr1, endomorphism, mode);
+  matchPatterns(addr[1], key, incr2, endomorphism, mode);
+  matchPatterns(addr[2], key, incr3, endomorphism, mode);
+  matchPatterns(addr[3], key, incr4, endomorphism, mode);
 
-    }
+}
 
-  }
+// Case folded prefix compare, case insensitive prefixes are stored lower
+// case once instead of being expanded into every case combination
+bool VanitySearch::prefixMatch(char *prefix, char *addr) {
+
+  if (caseSensitive)
+    return strcmp(prefix, addr) == 0;
 
+  int i = 0;
+  while (prefix[i] && addr[i]) {
+    if (prefix[i] != tolower(addr[i]))
+      return false;
+    i++;
+  }
+  return prefix[i] == 0 && addr[i] == 0;
 
 }
 
-void VanitySearch::checkAddr(int prefIdx, uint8_t *hash160, Int &key, int32_t incr, int endomorphism, bool mode) {
+// Full 20 byte compare of one indexed item, called for the (rare) lPrefix
+// hits of the checkAddr probe
+void VanitySearch::checkFullItem(int prefIdx, int idx, uint8_t *hash160, Int &key, int32_t incr, int endomorphism, bool mode, Point *knownP) {
 
-  if (hasPattern) {
+  vector<PREFIX_ITEM> *pi = prefixes[prefIdx].items;
 
-    // Wildcard search
-    string addr = secp->GetAddress(searchType, mode, hash160);
+  if (stopWhenFound && *((*pi)[idx].found))
+    return;
 
-    for (int i = 0; i < (int)inputPrefixes.size(); i++) {
+  if (ripemd160_comp_hash((*pi)[idx].hash160, hash160)) {
 
-      if (Wildcard::match(addr.c_str(), inputPrefixes[i].c_str(), caseSensitive)) {
+    // Found it !
+    *((*pi)[idx].found) = true;
+    // You believe it ?
+    if (checkPrivKey(secp->GetAddress(searchType, mode, hash160), key, incr, endomorphism, mode, knownP)) {
+      nbFoundKey++;
+      updateFound();
+    }
 
-        // Found it !
-        //*((*pi)[i].found) = true;
-        if (checkPrivKey(addr, key, incr, endomorphism, mode)) {
-          nbFoundKey++;
-          patternFound[i] = true;
-          updateFound();
-        }
+  }
 
-      }
+}
 
-    }
+void VanitySearch::checkAddr(int prefIdx, uint8_t *hash160, Int &key, int32_t incr, int endomorphism, bool mode, Point *knownP) {
+
+  if (hasPattern) {
 
+    // Wildcard search
+    string addr = secp->GetAddress(searchType, mode, hash160);
+    matchPatterns(addr, key, incr, endomorphism, mode, knownP);
     return;
 
   }
@@ -1064,25 +1338,30 @@ void VanitySearch::checkAddr(int prefIdx, uint8_t *hash160, Int &key, int32_t in
 
   if (onlyFull) {
 
-    // Full addresses
-    for (int i = 0; i < (int)pi->size(); i++) {
-
-      if (stopWhenFound && *((*pi)[i].found))
-        continue;
-
-      if (ripemd160_comp_hash((*pi)[i].hash160, hash160)) {
-
-        // Found it !
-        *((*pi)[i].found) = true;
-        // You believe it ?
-        if (checkPrivKey(secp->GetAddress(searchType, mode, hash160), key, incr, endomorphism, mode)) {
-          nbFoundKey++;
-          updateFound();
-        }
-
+    // Full addresses: probe the sorted flat lPrefix index 4 way with SSE,
+    // only candidates sharing the first 4 hash bytes get the 20 byte compare
+    vector<prefixl_t> &lp = prefixes[prefIdx].lPrefixes;
+    prefixl_t l32 = *(prefixl_t *)hash160;
+    int n = (int)lp.size();
+    int i = 0;
+
+    __m128i target = _mm_set1_epi32((int)l32);
+    while (i + 4 <= n) {
+      __m128i eq = _mm_cmpeq_epi32(_mm_loadu_si128((__m128i *)&lp[i]), target);
+      int msk = _mm_movemask_epi8(eq);
+      if (msk) {
+        for (int j = 0; j < 4; j++)
+          if ((msk >> (4 * j)) & 1)
+            checkFullItem(prefIdx, i + j, hash160, key, incr, endomorphism, mode, knownP);
       }
-
+      // The index is sorted, nothing behind a larger block can match
+      if (lp[i + 3] > l32)
+        return;
+      i += 4;
     }
+    for (; i < n; i++)
+      if (lp[i] == l32)
+        checkFullItem(prefIdx, i, hash160, key, incr, endomorphism, mode, knownP);
 
   } else {
 
@@ -1099,11 +1378,11 @@ void VanitySearch::checkAddr(int prefIdx, uint8_t *hash160, Int &key, int32_t in
       strncpy(a, addr.c_str(), (*pi)[i].prefixLength);
       a[(*pi)[i].prefixLength] = 0;
 
-      if (strcmp((*pi)[i].prefix, a) == 0) {
+      if (prefixMatch((*pi)[i].prefix, a)) {
 
         // Found it !
         *((*pi)[i].found) = true;
-        if (checkPrivKey(addr, key, incr, endomorphism, mode)) {
+        if (checkPrivKey(addr, key, incr, endomorphism, mode, knownP)) {
           nbFoundKey++;
           updateFound();
         }
@@ -1138,6 +1417,67 @@ void *_FindKeyGPU(void *lpParam) {
   return 0;
 }
 
+// Worker slice for the GPU starting point computation (see getGPUStartingKeys)
+typedef struct {
+
+  VanitySearch *obj;
+  Int *keys;
+  Point *p;
+  int groupSize;
+  int from;
+  int to;
+
+} KEYGEN_PARAM;
+
+#ifdef WIN64
+DWORD WINAPI _ComputeStartingPoints(LPVOID lpParam) {
+#else
+void *_ComputeStartingPoints(void *lpParam) {
+#endif
+  KEYGEN_PARAM *g = (KEYGEN_PARAM *)lpParam;
+  g->obj->computeGPUStartingPoints(g->keys, g->p, g->groupSize, g->from, g->to);
+  return 0;
+}
+
+#ifdef WIN64
+DWORD WINAPI _OutputWriter(LPVOID lpParam) {
+#else
+void *_OutputWriter(void *lpParam) {
+#endif
+  ((VanitySearch *)lpParam)->OutputWriterThread();
+  return 0;
+}
+
+#ifdef WIN64
+DWORD WINAPI _VerifyWorker(LPVOID lpParam) {
+#else
+void *_VerifyWorker(void *lpParam) {
+#endif
+  ((VanitySearch *)lpParam)->VerifyWorkerThread();
+  return 0;
+}
+
+// Worker slice of a verifier batch (see VerifyWorkerThread)
+typedef struct {
+
+  VanitySearch *obj;
+  VERIFY_CANDIDATE *cand;
+  Point *p;
+  int from;
+  int to;
+
+} VERIFY_PARAM;
+
+#ifdef WIN64
+DWORD WINAPI _VerifyPoints(LPVOID lpParam) {
+#else
+void *_VerifyPoints(void *lpParam) {
+#endif
+  VERIFY_PARAM *v = (VERIFY_PARAM *)lpParam;
+  v->obj->computeVerifyPoints(v->cand, v->p, v->from, v->to);
+  return 0;
+}
+
 // ----------------------------------------------------------------------------
 // CPU Steganography mask checking - matches pubkey X-coordinate against mask pattern
 // ----------------------------------------------------------------------------
@@ -1160,16 +1500,20 @@ void VanitySearch::checkStegoMask(Int &key, int32_t incr, int endomorphism, Poin
     }
   }
 
-  // Check if (px & mask) == (target & mask)
-  bool match = true;
-  for (int j = 0; j < 4; j++) {
-    if ((px[j] & stegoTarget.mask[j]) != (stegoTarget.value[j] & stegoTarget.mask[j])) {
-      match = false;
-      break;
+  // Check if (px & mask) == (target & mask) for any of the targets
+  int target = -1;
+  for (int t = 0; t < (int)stegoTargets.size() && target < 0; t++) {
+    bool match = true;
+    for (int j = 0; j < 4; j++) {
+      if ((px[j] & stegoTargets[t].mask[j]) != (stegoTargets[t].value[j] & stegoTargets[t].mask[j])) {
+        match = false;
+        break;
+      }
     }
+    if (match) target = t;
   }
 
-  if (!match) return;
+  if (target < 0) return;
 
   // Found a match! Reconstruct the private key
   Int finalKey;
@@ -1215,7 +1559,7 @@ void VanitySearch::checkStegoMask(Int &key, int32_t incr, int endomorphism, Poin
 
   bool verified = true;
   for (int j = 0; j < 4; j++) {
-    if ((verifyX[j] & stegoTarget.mask[j]) != (stegoTarget.value[j] & stegoTarget.mask[j])) {
+    if ((verifyX[j] & stegoTargets[target].mask[j]) != (stegoTargets[target].value[j] & stegoTargets[target].mask[j])) {
       verified = false;
       break;
     }
@@ -1240,7 +1584,7 @@ void VanitySearch::checkStegoMask(Int &key, int32_t incr, int endomorphism, Poin
     }
     verified = true;
     for (int j = 0; j < 4; j++) {
-      if ((verifyX[j] & stegoTarget.mask[j]) != (stegoTarget.value[j] & stegoTarget.mask[j])) {
+      if ((verifyX[j] & stegoTargets[target].mask[j]) != (stegoTargets[target].value[j] & stegoTargets[target].mask[j])) {
         verified = false;
         break;
       }
@@ -1265,47 +1609,33 @@ void VanitySearch::checkStegoMask(Int &key, int32_t incr, int endomorphism, Poin
   }
 }
 
-// Check stego mask for a single point with all endomorphisms and symmetry
+// Check stego mask for a single point, selected endomorphism classes only.
+// The symmetric classes share the X coordinate of their base class so the
+// constructor folds them away, checkStegoMask recovers a negated key itself
 void VanitySearch::checkStegoMaskAll(Int &key, int i, Point &p) {
 
   // Base point (endo=0)
-  checkStegoMask(key, i, 0, p);
-  if (endOfSearch) return;
+  if (classMask & CLASS_BIT(0, 0)) {
+    checkStegoMask(key, i, 0, p);
+    if (endOfSearch) return;
+  }
 
   // Endomorphism #1: (beta*x, y)
-  Point pe1;
-  pe1.x.ModMulK1(&p.x, &beta);
-  pe1.y.Set(&p.y);
-  checkStegoMask(key, i, 1, pe1);
-  if (endOfSearch) return;
+  if (classMask & CLASS_BIT(1, 0)) {
+    Point pe1;
+    pe1.x.ModMulK1(&p.x, &beta);
+    pe1.y.Set(&p.y);
+    checkStegoMask(key, i, 1, pe1);
+    if (endOfSearch) return;
+  }
 
   // Endomorphism #2: (beta2*x, y)
-  Point pe2;
-  pe2.x.ModMulK1(&p.x, &beta2);
-  pe2.y.Set(&p.y);
-  checkStegoMask(key, i, 2, pe2);
-  if (endOfSearch) return;
-
-  // Symmetric points (negated Y means negated incr)
-  Point pn;
-  pn.x.Set(&p.x);
-  pn.y.Set(&p.y);
-  pn.y.ModNeg();
-  checkStegoMask(key, -i, 0, pn);
-  if (endOfSearch) return;
-
-  Point pne1;
-  pne1.x.Set(&pe1.x);
-  pne1.y.Set(&pe1.y);
-  pne1.y.ModNeg();
-  checkStegoMask(key, -i, 1, pne1);
-  if (endOfSearch) return;
-
-  Point pne2;
-  pne2.x.Set(&pe2.x);
-  pne2.y.Set(&pe2.y);
-  pne2.y.ModNeg();
-  checkStegoMask(key, -i, 2, pne2);
+  if (classMask & CLASS_BIT(2, 0)) {
+    Point pe2;
+    pe2.x.ModMulK1(&p.x, &beta2);
+    pe2.y.Set(&p.y);
+    checkStegoMask(key, i, 2, pe2);
+  }
 }
 
 // SSE version for 4 points
@@ -1326,58 +1656,73 @@ void VanitySearch::checkAddresses(bool compressed, Int key, int i, Point p1) {
   unsigned char h0[20];
   Point pte1[1];
   Point pte2[1];
+  prefix_t pr0;
 
   // Point
-  secp->GetHash160(searchType,compressed, p1, h0);
-  prefix_t pr0 = *(prefix_t *)h0;
-  if (hasPattern || prefixes[pr0].items)
-    checkAddr(pr0, h0, key, i, 0, compressed);
+  if (classMask & CLASS_BIT(0, 0)) {
+    secp->GetHash160(searchType, compressed, p1, h0);
+    pr0 = *(prefix_t *)h0;
+    if (hasPattern || prefixes[pr0].items)
+      checkAddr(pr0, h0, key, i, 0, compressed);
+  }
 
   // Endomorphism #1
-  pte1[0].x.ModMulK1(&p1.x, &beta);
-  pte1[0].y.Set(&p1.y);
-
-  secp->GetHash160(searchType, compressed, pte1[0], h0);
+  if (classMask & (CLASS_BIT(1, 0) | CLASS_BIT(1, 1))) {
+    pte1[0].x.ModMulK1(&p1.x, &beta);
+    pte1[0].y.Set(&p1.y);
+  }
 
-  pr0 = *(prefix_t *)h0;
-  if (hasPattern || prefixes[pr0].items)
-    checkAddr(pr0, h0, key, i, 1, compressed);
+  if (classMask & CLASS_BIT(1, 0)) {
+    secp->GetHash160(searchType, compressed, pte1[0], h0);
+    pr0 = *(prefix_t *)h0;
+    if (hasPattern || prefixes[pr0].items)
+      checkAddr(pr0, h0, key, i, 1, compressed);
+  }
 
   // Endomorphism #2
-  pte2[0].x.ModMulK1(&p1.x, &beta2);
-  pte2[0].y.Set(&p1.y);
-
-  secp->GetHash160(searchType, compressed, pte2[0], h0);
+  if (classMask & (CLASS_BIT(2, 0) | CLASS_BIT(2, 1))) {
+    pte2[0].x.ModMulK1(&p1.x, &beta2);
+    pte2[0].y.Set(&p1.y);
+  }
 
-  pr0 = *(prefix_t *)h0;
-  if (hasPattern || prefixes[pr0].items)
-    checkAddr(pr0, h0, key, i, 2, compressed);
+  if (classMask & CLASS_BIT(2, 0)) {
+    secp->GetHash160(searchType, compressed, pte2[0], h0);
+    pr0 = *(prefix_t *)h0;
+    if (hasPattern || prefixes[pr0].items)
+      checkAddr(pr0, h0, key, i, 2, compressed);
+  }
 
   // Curve symetrie
   // if (x,y) = k*G, then (x, -y) is -k*G
-  p1.y.ModNeg();
-  secp->GetHash160(searchType, compressed, p1, h0);
-  pr0 = *(prefix_t *)h0;
-  if (hasPattern || prefixes[pr0].items)
-    checkAddr(pr0, h0, key, -i, 0, compressed);
+  if (classMask & CLASS_BIT(0, 1)) {
+    p1.y.ModNeg();
+    secp->GetHash160(searchType, compressed, p1, h0);
+    pr0 = *(prefix_t *)h0;
+    if (hasPattern || prefixes[pr0].items)
+      checkAddr(pr0, h0, key, -i, 0, compressed);
+  }
 
   // Endomorphism #1
-  pte1[0].y.ModNeg();
+  if (classMask & CLASS_BIT(1, 1)) {
+    pte1[0].y.ModNeg();
 
-  secp->GetHash160(searchType, compressed, pte1[0], h0);
+    secp->GetHash160(searchType, compressed, pte1[0], h0);
 
-  pr0 = *(prefix_t *)h0;
-  if (hasPattern || prefixes[pr0].items)
-    checkAddr(pr0, h0, key, -i, 1, compressed);
+    pr0 = *(prefix_t *)h0;
+    if (hasPattern || prefixes[pr0].items)
+      checkAddr(pr0, h0, key, -i, 1, compressed);
+  }
 
   // Endomorphism #2
-  pte2[0].y.ModNeg();
+  if (classMask & CLASS_BIT(2, 1)) {
+    pte2[0].y.ModNeg();
 
-  secp->GetHash160(searchType, compressed, pte2[0], h0);
+    secp->GetHash160(searchType, compressed, pte2[0], h0);
 
-  pr0 = *(prefix_t *)h0;
-  if (hasPattern || prefixes[pr0].items)
-    checkAddr(pr0, h0, key, -i, 2, compressed);
+    pr0 = *(prefix_t *)h0;
+    if (hasPattern || prefixes[pr0].items)
+      checkAddr(pr0, h0, key, -i, 2, compressed);
+  }
 
 }
 
@@ -1385,205 +1730,321 @@ void VanitySearch::checkAddresses(bool compressed, Int key, int i, Point p1) {
 
 void VanitySearch::checkAddressesSSE(bool compressed,Int key, int i, Point p1, Point p2, Point p3, Point p4) {
 
-  unsigned char h0[20];
-  unsigned char h1[20];
-  unsigned char h2[20];
-  unsigned char h3[20];
+  uint8_t h[4][20];
   Point pte1[4];
   Point pte2[4];
-  prefix_t pr0;
-  prefix_t pr1;
-  prefix_t pr2;
-  prefix_t pr3;
 
   // Point -------------------------------------------------------------------------
-  secp->GetHash160(searchType, compressed, p1, p2, p3, p4, h0, h1, h2, h3);
+  if (classMask & CLASS_BIT(0, 0)) {
+    secp->GetHash160(searchType, compressed, p1, p2, p3, p4, h[0], h[1], h[2], h[3]);
+    checkAddrWide(h, 4, key, i, false, 0, compressed);
+  }
 
-  if (!hasPattern) {
+  // Endomorphism #1
+  // if (x, y) = k * G, then (beta*x, y) = lambda*k*G
+  if (classMask & (CLASS_BIT(1, 0) | CLASS_BIT(1, 1))) {
+    pte1[0].x.ModMulK1(&p1.x, &beta);
+    pte1[0].y.Set(&p1.y);
+    pte1[1].x.ModMulK1(&p2.x, &beta);
+    pte1[1].y.Set(&p2.y);
+    pte1[2].x.ModMulK1(&p3.x, &beta);
+    pte1[2].y.Set(&p3.y);
+    pte1[3].x.ModMulK1(&p4.x, &beta);
+    pte1[3].y.Set(&p4.y);
+  }
 
-    pr0 = *(prefix_t *)h0;
-    pr1 = *(prefix_t *)h1;
-    pr2 = *(prefix_t *)h2;
-    pr3 = *(prefix_t *)h3;
+  if (classMask & CLASS_BIT(1, 0)) {
+    secp->GetHash160(searchType, compressed, pte1[0], pte1[1], pte1[2], pte1[3], h[0], h[1], h[2], h[3]);
+    checkAddrWide(h, 4, key, i, false, 1, compressed);
+  }
 
-    if (prefixes[pr0].items)
-      checkAddr(pr0, h0, key, i, 0, compressed);
-    if (prefixes[pr1].items)
-      checkAddr(pr1, h1, key, i + 1, 0, compressed);
-    if (prefixes[pr2].items)
-      checkAddr(pr2, h2, key, i + 2, 0, compressed);
-    if (prefixes[pr3].items)
-      checkAddr(pr3, h3, key, i + 3, 0, compressed);
+  // Endomorphism #2
+  // if (x, y) = k * G, then (beta2*x, y) = lambda2*k*G
+  if (classMask & (CLASS_BIT(2, 0) | CLASS_BIT(2, 1))) {
+    pte2[0].x.ModMulK1(&p1.x, &beta2);
+    pte2[0].y.Set(&p1.y);
+    pte2[1].x.ModMulK1(&p2.x, &beta2);
+    pte2[1].y.Set(&p2.y);
+    pte2[2].x.ModMulK1(&p3.x, &beta2);
+    pte2[2].y.Set(&p3.y);
+    pte2[3].x.ModMulK1(&p4.x, &beta2);
+    pte2[3].y.Set(&p4.y);
+  }
 
-  } else {
+  if (classMask & CLASS_BIT(2, 0)) {
+    secp->GetHash160(searchType, compressed, pte2[0], pte2[1], pte2[2], pte2[3], h[0], h[1], h[2], h[3]);
+    checkAddrWide(h, 4, key, i, false, 2, compressed);
+  }
 
-    checkAddrSSE(h0,h1,h2,h3,i,i+1,i+2,i+3,key,0,compressed);
+  // Curve symetrie -------------------------------------------------------------------------
+  // if (x,y) = k*G, then (x, -y) is -k*G
 
+  if (classMask & CLASS_BIT(0, 1)) {
+    p1.y.ModNeg();
+    p2.y.ModNeg();
+    p3.y.ModNeg();
+    p4.y.ModNeg();
+
+    secp->GetHash160(searchType, compressed, p1, p2, p3, p4, h[0], h[1], h[2], h[3]);
+    checkAddrWide(h, 4, key, i, true, 0, compressed);
   }
 
   // Endomorphism #1
   // if (x, y) = k * G, then (beta*x, y) = lambda*k*G
-  pte1[0].x.ModMulK1(&p1.x, &beta);
-  pte1[0].y.Set(&p1.y);
-  pte1[1].x.ModMulK1(&p2.x, &beta);
-  pte1[1].y.Set(&p2.y);
-  pte1[2].x.ModMulK1(&p3.x, &beta);
-  pte1[2].y.Set(&p3.y);
-  pte1[3].x.ModMulK1(&p4.x, &beta);
-  pte1[3].y.Set(&p4.y);
+  if (classMask & CLASS_BIT(1, 1)) {
+    pte1[0].y.ModNeg();
+    pte1[1].y.ModNeg();
+    pte1[2].y.ModNeg();
+    pte1[3].y.ModNeg();
+
+    secp->GetHash160(searchType, compressed, pte1[0], pte1[1], pte1[2], pte1[3], h[0], h[1], h[2], h[3]);
+    checkAddrWide(h, 4, key, i, true, 1, compressed);
+  }
 
-  secp->GetHash160(searchType, compressed, pte1[0], pte1[1], pte1[2], pte1[3], h0, h1, h2, h3);
+  // Endomorphism #2
+  // if (x, y) = k * G, then (beta2*x, y) = lambda2*k*G
+  if (classMask & CLASS_BIT(2, 1)) {
+    pte2[0].y.ModNeg();
+    pte2[1].y.ModNeg();
+    pte2[2].y.ModNeg();
+    pte2[3].y.ModNeg();
+
+    secp->GetHash160(searchType, compressed, pte2[0], pte2[1], pte2[2], pte2[3], h[0], h[1], h[2], h[3]);
+    checkAddrWide(h, 4, key, i, true, 2, compressed);
+  }
 
-  if (!hasPattern) {
+}
 
-    pr0 = *(prefix_t *)h0;
-    pr1 = *(prefix_t *)h1;
-    pr2 = *(prefix_t *)h2;
-    pr3 = *(prefix_t *)h3;
+// ----------------------------------------------------------------------------
 
-    if (prefixes[pr0].items)
-      checkAddr(pr0, h0, key, i, 1, compressed);
-    if (prefixes[pr1].items)
-      checkAddr(pr1, h1, key, (i + 1), 1, compressed);
-    if (prefixes[pr2].items)
-      checkAddr(pr2, h2, key, (i + 2), 1, compressed);
-    if (prefixes[pr3].items)
-      checkAddr(pr3, h3, key, (i + 3), 1, compressed);
+// SEARCH_BOTH variant of checkAddressesSSE. Each stage hashes the 4 points
+// once through the fused GetHash160Both instead of running the compressed
+// and uncompressed pipelines back to back
+void VanitySearch::checkAddressesBothSSE(Int key, int i, Point p1, Point p2, Point p3, Point p4) {
 
-  } else {
+  uint8_t hc[4][20];
+  uint8_t hu[4][20];
+  Point pte1[4];
+  Point pte2[4];
 
-    checkAddrSSE(h0, h1, h2, h3, i, i + 1, i + 2, i + 3, key, 1, compressed);
+  // Point -------------------------------------------------------------------------
+  if (classMask & CLASS_BIT(0, 0)) {
+    secp->GetHash160Both(searchType, p1, p2, p3, p4,
+      hc[0], hc[1], hc[2], hc[3], hu[0], hu[1], hu[2], hu[3]);
+    checkAddrWide(hc, 4, key, i, false, 0, true);
+    checkAddrWide(hu, 4, key, i, false, 0, false);
+  }
 
+  // Endomorphism #1
+  // if (x, y) = k * G, then (beta*x, y) = lambda*k*G
+  if (classMask & (CLASS_BIT(1, 0) | CLASS_BIT(1, 1))) {
+    pte1[0].x.ModMulK1(&p1.x, &beta);
+    pte1[0].y.Set(&p1.y);
+    pte1[1].x.ModMulK1(&p2.x, &beta);
+    pte1[1].y.Set(&p2.y);
+    pte1[2].x.ModMulK1(&p3.x, &beta);
+    pte1[2].y.Set(&p3.y);
+    pte1[3].x.ModMulK1(&p4.x, &beta);
+    pte1[3].y.Set(&p4.y);
+  }
+
+  if (classMask & CLASS_BIT(1, 0)) {
+    secp->GetHash160Both(searchType, pte1[0], pte1[1], pte1[2], pte1[3],
+      hc[0], hc[1], hc[2], hc[3], hu[0], hu[1], hu[2], hu[3]);
+    checkAddrWide(hc, 4, key, i, false, 1, true);
+    checkAddrWide(hu, 4, key, i, false, 1, false);
   }
 
   // Endomorphism #2
   // if (x, y) = k * G, then (beta2*x, y) = lambda2*k*G
-  pte2[0].x.ModMulK1(&p1.x, &beta2);
-  pte2[0].y.Set(&p1.y);
-  pte2[1].x.ModMulK1(&p2.x, &beta2);
-  pte2[1].y.Set(&p2.y);
-  pte2[2].x.ModMulK1(&p3.x, &beta2);
-  pte2[2].y.Set(&p3.y);
-  pte2[3].x.ModMulK1(&p4.x, &beta2);
-  pte2[3].y.Set(&p4.y);
-
-  secp->GetHash160(searchType, compressed, pte2[0], pte2[1], pte2[2], pte2[3], h0, h1, h2, h3);
+  if (classMask & (CLASS_BIT(2, 0) | CLASS_BIT(2, 1))) {
+    pte2[0].x.ModMulK1(&p1.x, &beta2);
+    pte2[0].y.Set(&p1.y);
+    pte2[1].x.ModMulK1(&p2.x, &beta2);
+    pte2[1].y.Set(&p2.y);
+    pte2[2].x.ModMulK1(&p3.x, &beta2);
+    pte2[2].y.Set(&p3.y);
+    pte2[3].x.ModMulK1(&p4.x, &beta2);
+    pte2[3].y.Set(&p4.y);
+  }
 
-  if (!hasPattern) {
+  if (classMask & CLASS_BIT(2, 0)) {
+    secp->GetHash160Both(searchType, pte2[0], pte2[1], pte2[2], pte2[3],
+      hc[0], hc[1], hc[2], hc[3], hu[0], hu[1], hu[2], hu[3]);
+    checkAddrWide(hc, 4, key, i, false, 2, true);
+    checkAddrWide(hu, 4, key, i, false, 2, false);
+  }
 
-    pr0 = *(prefix_t *)h0;
-    pr1 = *(prefix_t *)h1;
-    pr2 = *(prefix_t *)h2;
-    pr3 = *(prefix_t *)h3;
+  // Curve symetrie -------------------------------------------------------------------------
+  // if (x,y) = k*G, then (x, -y) is -k*G
 
-    if (prefixes[pr0].items)
-      checkAddr(pr0, h0, key, i, 2, compressed);
-    if (prefixes[pr1].items)
-      checkAddr(pr1, h1, key, (i + 1), 2, compressed);
-    if (prefixes[pr2].items)
-      checkAddr(pr2, h2, key, (i + 2), 2, compressed);
-    if (prefixes[pr3].items)
-      checkAddr(pr3, h3, key, (i + 3), 2, compressed);
+  if (classMask & CLASS_BIT(0, 1)) {
+    p1.y.ModNeg();
+    p2.y.ModNeg();
+    p3.y.ModNeg();
+    p4.y.ModNeg();
 
-  } else {
+    secp->GetHash160Both(searchType, p1, p2, p3, p4,
+      hc[0], hc[1], hc[2], hc[3], hu[0], hu[1], hu[2], hu[3]);
+    checkAddrWide(hc, 4, key, i, true, 0, true);
+    checkAddrWide(hu, 4, key, i, true, 0, false);
+  }
 
-    checkAddrSSE(h0, h1, h2, h3, i, i + 1, i + 2, i + 3, key, 2, compressed);
+  // Endomorphism #1
+  // if (x, y) = k * G, then (beta*x, y) = lambda*k*G
+  if (classMask & CLASS_BIT(1, 1)) {
+    pte1[0].y.ModNeg();
+    pte1[1].y.ModNeg();
+    pte1[2].y.ModNeg();
+    pte1[3].y.ModNeg();
+
+    secp->GetHash160Both(searchType, pte1[0], pte1[1], pte1[2], pte1[3],
+      hc[0], hc[1], hc[2], hc[3], hu[0], hu[1], hu[2], hu[3]);
+    checkAddrWide(hc, 4, key, i, true, 1, true);
+    checkAddrWide(hu, 4, key, i, true, 1, false);
+  }
 
+  // Endomorphism #2
+  // if (x, y) = k * G, then (beta2*x, y) = lambda2*k*G
+  if (classMask & CLASS_BIT(2, 1)) {
+    pte2[0].y.ModNeg();
+    pte2[1].y.ModNeg();
+    pte2[2].y.ModNeg();
+    pte2[3].y.ModNeg();
+
+    secp->GetHash160Both(searchType, pte2[0], pte2[1], pte2[2], pte2[3],
+      hc[0], hc[1], hc[2], hc[3], hu[0], hu[1], hu[2], hu[3]);
+    checkAddrWide(hc, 4, key, i, true, 2, true);
+    checkAddrWide(hu, 4, key, i, true, 2, false);
   }
 
-  // Curve symetrie -------------------------------------------------------------------------
-  // if (x,y) = k*G, then (x, -y) is -k*G
+}
 
-  p1.y.ModNeg();
-  p2.y.ModNeg();
-  p3.y.ModNeg();
-  p4.y.ModNeg();
+// ----------------------------------------------------------------------------
 
-  secp->GetHash160(searchType, compressed, p1, p2, p3, p4, h0, h1, h2, h3);
+void VanitySearch::checkAddrWide(uint8_t (*h)[20], int n, Int &key, int i, bool negative, int endomorphism, bool compressed) {
 
   if (!hasPattern) {
 
-    pr0 = *(prefix_t *)h0;
-    pr1 = *(prefix_t *)h1;
-    pr2 = *(prefix_t *)h2;
-    pr3 = *(prefix_t *)h3;
-
-    if (prefixes[pr0].items)
-      checkAddr(pr0, h0, key, -i, 0, compressed);
-    if (prefixes[pr1].items)
-      checkAddr(pr1, h1, key, -(i + 1), 0, compressed);
-    if (prefixes[pr2].items)
-      checkAddr(pr2, h2, key, -(i + 2), 0, compressed);
-    if (prefixes[pr3].items)
-      checkAddr(pr3, h3, key, -(i + 3), 0, compressed);
+    for (int g = 0; g < n; g++) {
+      prefix_t pr = *(prefix_t *)h[g];
+      if (prefixes[pr].items)
+        checkAddr(pr, h[g], key, negative ? -(i + g) : (i + g), endomorphism, compressed);
+    }
 
   } else {
 
-    checkAddrSSE(h0, h1, h2, h3, -i, -(i + 1), -(i + 2), -(i + 3), key, 0, compressed);
+    for (int g = 0; g < n; g += 4) {
+      if (negative)
+        checkAddrSSE(h[g], h[g + 1], h[g + 2], h[g + 3],
+                     -(i + g), -(i + g + 1), -(i + g + 2), -(i + g + 3), key, endomorphism, compressed);
+      else
+        checkAddrSSE(h[g], h[g + 1], h[g + 2], h[g + 3],
+                     i + g, i + g + 1, i + g + 2, i + g + 3, key, endomorphism, compressed);
+    }
 
   }
 
-  // Endomorphism #1
-  // if (x, y) = k * G, then (beta*x, y) = lambda*k*G
-  pte1[0].y.ModNeg();
-  pte1[1].y.ModNeg();
-  pte1[2].y.ModNeg();
-  pte1[3].y.ModNeg();
+}
 
+// ----------------------------------------------------------------------------
 
-  secp->GetHash160(searchType, compressed, pte1[0], pte1[1], pte1[2], pte1[3], h0, h1, h2, h3);
+// AVX2 (n=8) and AVX512 (n=16) variant of checkAddressesSSE
+void VanitySearch::checkAddressesWide(bool compressed, Int key, int i, Point *p, int n) {
 
-  if (!hasPattern) {
+  uint8_t h[16][20];
+  Point pt[16];
+  Point pte1[16];
+  Point pte2[16];
 
-    pr0 = *(prefix_t *)h0;
-    pr1 = *(prefix_t *)h1;
-    pr2 = *(prefix_t *)h2;
-    pr3 = *(prefix_t *)h3;
+  for (int g = 0; g < n; g++)
+    pt[g] = p[g];
 
-    if (prefixes[pr0].items)
-      checkAddr(pr0, h0, key, -i, 1, compressed);
-    if (prefixes[pr1].items)
-      checkAddr(pr1, h1, key, -(i + 1), 1, compressed);
-    if (prefixes[pr2].items)
-      checkAddr(pr2, h2, key, -(i + 2), 1, compressed);
-    if (prefixes[pr3].items)
-      checkAddr(pr3, h3, key, -(i + 3), 1, compressed);
+  // Point -------------------------------------------------------------------------
+  if (classMask & CLASS_BIT(0, 0)) {
+    if (n == 16)
+      secp->GetHash160x16(searchType, compressed, pt, h);
+    else
+      secp->GetHash160x8(searchType, compressed, pt, h);
 
-  } else {
+    checkAddrWide(h, n, key, i, false, 0, compressed);
+  }
+
+  // Endomorphism #1
+  // if (x, y) = k * G, then (beta*x, y) = lambda*k*G
+  if (classMask & (CLASS_BIT(1, 0) | CLASS_BIT(1, 1))) {
+    for (int g = 0; g < n; g++) {
+      pte1[g].x.ModMulK1(&pt[g].x, &beta);
+      pte1[g].y.Set(&pt[g].y);
+    }
+  }
 
-    checkAddrSSE(h0, h1, h2, h3, -i, -(i + 1), -(i + 2), -(i + 3), key, 1, compressed);
+  if (classMask & CLASS_BIT(1, 0)) {
+    if (n == 16)
+      secp->GetHash160x16(searchType, compressed, pte1, h);
+    else
+      secp->GetHash160x8(searchType, compressed, pte1, h);
 
+    checkAddrWide(h, n, key, i, false, 1, compressed);
   }
 
   // Endomorphism #2
   // if (x, y) = k * G, then (beta2*x, y) = lambda2*k*G
-  pte2[0].y.ModNeg();
-  pte2[1].y.ModNeg();
-  pte2[2].y.ModNeg();
-  pte2[3].y.ModNeg();
+  if (classMask & (CLASS_BIT(2, 0) | CLASS_BIT(2, 1))) {
+    for (int g = 0; g < n; g++) {
+      pte2[g].x.ModMulK1(&pt[g].x, &beta2);
+      pte2[g].y.Set(&pt[g].y);
+    }
+  }
 
-  secp->GetHash160(searchType, compressed, pte2[0], pte2[1], pte2[2], pte2[3], h0, h1, h2, h3);
+  if (classMask & CLASS_BIT(2, 0)) {
+    if (n == 16)
+      secp->GetHash160x16(searchType, compressed, pte2, h);
+    else
+      secp->GetHash160x8(searchType, compressed, pte2, h);
 
-  if (!hasPattern) {
+    checkAddrWide(h, n, key, i, false, 2, compressed);
+  }
 
-    pr0 = *(prefix_t *)h0;
-    pr1 = *(prefix_t *)h1;
-    pr2 = *(prefix_t *)h2;
-    pr3 = *(prefix_t *)h3;
+  // Curve symetrie -------------------------------------------------------------------------
+  // if (x,y) = k*G, then (x, -y) is -k*G
 
-    if (prefixes[pr0].items)
-      checkAddr(pr0, h0, key, -i, 2, compressed);
-    if (prefixes[pr1].items)
-      checkAddr(pr1, h1, key, -(i + 1), 2, compressed);
-    if (prefixes[pr2].items)
-      checkAddr(pr2, h2, key, -(i + 2), 2, compressed);
-    if (prefixes[pr3].items)
-      checkAddr(pr3, h3, key, -(i + 3), 2, compressed);
+  if (classMask & CLASS_BIT(0, 1)) {
+    for (int g = 0; g < n; g++)
+      pt[g].y.ModNeg();
 
-  } else {
+    if (n == 16)
+      secp->GetHash160x16(searchType, compressed, pt, h);
+    else
+      secp->GetHash160x8(searchType, compressed, pt, h);
 
-    checkAddrSSE(h0, h1, h2, h3, -i, -(i + 1), -(i + 2), -(i + 3), key, 2, compressed);
+    checkAddrWide(h, n, key, i, true, 0, compressed);
+  }
+
+  // Endomorphism #1
+  if (classMask & CLASS_BIT(1, 1)) {
+    for (int g = 0; g < n; g++)
+      pte1[g].y.ModNeg();
+
+    if (n == 16)
+      secp->GetHash160x16(searchType, compressed, pte1, h);
+    else
+      secp->GetHash160x8(searchType, compressed, pte1, h);
+
+    checkAddrWide(h, n, key, i, true, 1, compressed);
+  }
+
+  // Endomorphism #2
+  if (classMask & CLASS_BIT(2, 1)) {
+    for (int g = 0; g < n; g++)
+      pte2[g].y.ModNeg();
 
+    if (n == 16)
+      secp->GetHash160x16(searchType, compressed, pte2, h);
+    else
+      secp->GetHash160x8(searchType, compressed, pte2, h);
+
+    checkAddrWide(h, n, key, i, true, 2, compressed);
   }
 
 }
@@ -1592,182 +2053,278 @@ void VanitySearch::checkAddressesSSE(bool compressed,Int key, int i, Point p1, P
 void VanitySearch::getCPUStartingKey(int thId,Int& key,Point& startP) {
 
   if (rekey > 0) {
-    key.Rand(256);
+    unsigned char rnd32[32];
+    rndBulk(rnd32, 32);
+    key.Set32Bytes(rnd32);
   } else {
     key.Set(&startKey);
     Int off((int64_t)thId);
     off.ShiftL(64);
     key.Add(&off);
+    // Skip the range already covered before a resumed snapshot
+    key.Add(threadOffsets[thId]);
   }
   Int km(&key);
-  km.Add((uint64_t)CPU_GRP_SIZE / 2);
+  km.Add((uint64_t)cpuGrpSize / 2);
   startP = secp->ComputePublicKey(&km);
   if(startPubKeySpecified)
    startP = secp->AddDirect(startP,startPubKey);
 
 }
 
-void VanitySearch::FindKeyCPU(TH_PARAM *ph) {
-
-  // Global init
-  int thId = ph->threadId;
-  counters[thId] = 0;
-
-  // CPU Thread
-  IntGroup *grp = new IntGroup(CPU_GRP_SIZE/2+1);
-
-  // Group Init
-  Int  key;
-  Point startP;
-  getCPUStartingKey(thId,key,startP);
-
-  Int dx[CPU_GRP_SIZE/2+1];
-  Point pts[CPU_GRP_SIZE];
+// One batch of the group walk: fill the dx deltas against the generator
+// table, run the grouped inversion and build the GRP_SIZE points around
+// startP, then advance startP by GRP_SIZE*G
+template<int GRP_SIZE> void VanitySearch::groupStep(IntGroup *grp, Int *dx, Point *pts, Point &startP) {
 
+  Point &g2 = _2Gn[GrpIdx(GRP_SIZE)];
   Int dy;
   Int dyn;
   Int _s;
   Int _p;
-  Point pp;
-  Point pn;
-  grp->Set(dx);
 
-  ph->hasStarted = true;
-  ph->rekeyRequest = false;
-
-  while (!endOfSearch) {
-
-    if (ph->rekeyRequest) {
-      getCPUStartingKey(thId, key, startP);
-      ph->rekeyRequest = false;
-    }
+  // Fill group
+  int i;
+  int hLength = (GRP_SIZE / 2 - 1);
 
-    // Fill group
-    int i;
-    int hLength = (CPU_GRP_SIZE / 2 - 1);
-
-    for (i = 0; i < hLength; i++) {
-      dx[i].ModSub(&Gn[i].x, &startP.x);
-    }
-    dx[i].ModSub(&Gn[i].x, &startP.x);  // For the first point
-    dx[i+1].ModSub(&_2Gn.x, &startP.x); // For the next center point
-
-    // Grouped ModInv
-    grp->ModInv();
+  for (i = 0; i < hLength; i++) {
+    dx[i].ModSub(&Gn[i].x, &startP.x);
+  }
+  dx[i].ModSub(&Gn[i].x, &startP.x);  // For the first point
+  dx[i+1].ModSub(&g2.x, &startP.x);   // For the next center point
 
-    // We use the fact that P + i*G and P - i*G has the same deltax, so the same inverse
-    // We compute key in the positive and negative way from the center of the group
+  // Grouped ModInv
+  grp->ModInv();
 
-    // center point
-    pts[CPU_GRP_SIZE/2] = startP;
+  // We use the fact that P + i*G and P - i*G has the same deltax, so the same inverse
+  // We compute key in the positive and negative way from the center of the group
+  // The results go straight into their pts slot (affine only, z is never
+  // read by the hash pipelines) instead of through a Point temporary
 
-    for (i = 0; i<hLength && !endOfSearch; i++) {
+  // center point
+  pts[GRP_SIZE/2].x.Set(&startP.x);
+  pts[GRP_SIZE/2].y.Set(&startP.y);
 
-      pp = startP;
-      pn = startP;
+  for (i = 0; i<hLength && !endOfSearch; i++) {
 
-      // P = startP + i*G
-      dy.ModSub(&Gn[i].y,&pp.y);
+    Point *pp = pts + (GRP_SIZE/2 + (i+1));
+    Point *pn = pts + (GRP_SIZE/2 - (i+1));
 
-      _s.ModMulK1(&dy, &dx[i]);       // s = (p2.y-p1.y)*inverse(p2.x-p1.x);
-      _p.ModSquareK1(&_s);            // _p = pow2(s)
+    // P = startP + i*G
+    pp->x.Set(&startP.x);
+    pp->y.Set(&startP.y);
+    dy.ModSub(&Gn[i].y,&pp->y);
 
-      pp.x.ModNeg();
-      pp.x.ModAdd(&_p);
-      pp.x.ModSub(&Gn[i].x);           // rx = pow2(s) - p1.x - p2.x;
+    _s.ModMulK1(&dy, &dx[i]);       // s = (p2.y-p1.y)*inverse(p2.x-p1.x);
+    _p.ModSquareK1(&_s);            // _p = pow2(s)
 
-      pp.y.ModSub(&Gn[i].x, &pp.x);
-      pp.y.ModMulK1(&_s);
-      pp.y.ModSub(&Gn[i].y);           // ry = - p2.y - s*(ret.x-p2.x);
+    pp->x.ModNeg();
+    pp->x.ModAdd(&_p);
+    pp->x.ModSub(&Gn[i].x);          // rx = pow2(s) - p1.x - p2.x;
 
-      // P = startP - i*G  , if (x,y) = i*G then (x,-y) = -i*G
-      dyn.Set(&Gn[i].y);
-      dyn.ModNeg();
-      dyn.ModSub(&pn.y);
+    pp->y.ModSub(&Gn[i].x, &pp->x);
+    pp->y.ModMulK1(&_s);
+    pp->y.ModSub(&Gn[i].y);          // ry = - p2.y - s*(ret.x-p2.x);
 
-      _s.ModMulK1(&dyn, &dx[i]);      // s = (p2.y-p1.y)*inverse(p2.x-p1.x);
-      _p.ModSquareK1(&_s);            // _p = pow2(s)
+    // P = startP - i*G  , if (x,y) = i*G then (x,-y) = -i*G
+    pn->x.Set(&startP.x);
+    pn->y.Set(&startP.y);
+    dyn.Set(&Gn[i].y);
+    dyn.ModNeg();
+    dyn.ModSub(&pn->y);
 
-      pn.x.ModNeg();
-      pn.x.ModAdd(&_p);
-      pn.x.ModSub(&Gn[i].x);          // rx = pow2(s) - p1.x - p2.x;
+    _s.ModMulK1(&dyn, &dx[i]);      // s = (p2.y-p1.y)*inverse(p2.x-p1.x);
+    _p.ModSquareK1(&_s);            // _p = pow2(s)
 
-      pn.y.ModSub(&Gn[i].x, &pn.x);
-      pn.y.ModMulK1(&_s);
-      pn.y.ModAdd(&Gn[i].y);          // ry = - p2.y - s*(ret.x-p2.x);
+    pn->x.ModNeg();
+    pn->x.ModAdd(&_p);
+    pn->x.ModSub(&Gn[i].x);         // rx = pow2(s) - p1.x - p2.x;
 
-      pts[CPU_GRP_SIZE/2 + (i+1)] = pp;
-      pts[CPU_GRP_SIZE/2 - (i+1)] = pn;
+    pn->y.ModSub(&Gn[i].x, &pn->x);
+    pn->y.ModMulK1(&_s);
+    pn->y.ModAdd(&Gn[i].y);         // ry = - p2.y - s*(ret.x-p2.x);
 
-    }
+  }
 
-    // First point (startP - (GRP_SZIE/2)*G)
-    pn = startP;
+  // First point (startP - (GRP_SZIE/2)*G)
+  {
+    Point *pn = pts;
+    pn->x.Set(&startP.x);
+    pn->y.Set(&startP.y);
     dyn.Set(&Gn[i].y);
     dyn.ModNeg();
-    dyn.ModSub(&pn.y);
+    dyn.ModSub(&pn->y);
 
     _s.ModMulK1(&dyn, &dx[i]);
     _p.ModSquareK1(&_s);
 
-    pn.x.ModNeg();
-    pn.x.ModAdd(&_p);
-    pn.x.ModSub(&Gn[i].x);
+    pn->x.ModNeg();
+    pn->x.ModAdd(&_p);
+    pn->x.ModSub(&Gn[i].x);
 
-    pn.y.ModSub(&Gn[i].x, &pn.x);
-    pn.y.ModMulK1(&_s);
-    pn.y.ModAdd(&Gn[i].y);
+    pn->y.ModSub(&Gn[i].x, &pn->x);
+    pn->y.ModMulK1(&_s);
+    pn->y.ModAdd(&Gn[i].y);
+  }
 
-    pts[0] = pn;
+  // Next start point (startP + GRP_SIZE*G), startP is transformed in place
+  // (dy is taken before the coordinates are overwritten)
+  dy.ModSub(&g2.y, &startP.y);
 
-    // Next start point (startP + GRP_SIZE*G)
-    pp = startP;
-    dy.ModSub(&_2Gn.y, &pp.y);
+  _s.ModMulK1(&dy, &dx[i+1]);
+  _p.ModSquareK1(&_s);
 
-    _s.ModMulK1(&dy, &dx[i+1]);
-    _p.ModSquareK1(&_s);
+  startP.x.ModNeg();
+  startP.x.ModAdd(&_p);
+  startP.x.ModSub(&g2.x);
+
+  startP.y.ModSub(&g2.x, &startP.x);
+  startP.y.ModMulK1(&_s);
+  startP.y.ModSub(&g2.y);
+
+}
+
+// The optimal group size depends on the cache hierarchy: a larger group
+// amortizes the batch inversion better but grows the dx/pts working set.
+// Walk a fixed key budget with each supported size and keep the fastest
+template<int GRP_SIZE> double VanitySearch::benchCpuGrpSize() {
 
-    pp.x.ModNeg();
-    pp.x.ModAdd(&_p);
-    pp.x.ModSub(&_2Gn.x);
+  IntGroup *grp = new IntGroup(GRP_SIZE/2+1);
+  Int *dx = new Int[GRP_SIZE/2+1];
+  Point *pts = new Point[GRP_SIZE];
+  Int km;
+  km.SetInt32(0x10DF);
+  km.Add((uint64_t)GRP_SIZE / 2);
+  Point startP = secp->ComputePublicKey(&km);
+  int rounds = (256 * 1024) / GRP_SIZE;
+
+  grp->Set(dx);
 
-    pp.y.ModSub(&_2Gn.x, &pp.x);
-    pp.y.ModMulK1(&_s);
-    pp.y.ModSub(&_2Gn.y);
-    startP = pp;
+  // Warm the generator table slice
+  groupStep<GRP_SIZE>(grp, dx, pts, startP);
+
+  double t0 = Timer::get_tick();
+  for (int r = 0; r < rounds; r++)
+    groupStep<GRP_SIZE>(grp, dx, pts, startP);
+  double t = Timer::get_tick() - t0;
+
+  delete grp;
+  delete[] dx;
+  delete[] pts;
+
+  return ((double)rounds * GRP_SIZE) / t;
+
+}
+
+int VanitySearch::calibrateCpuGrpSize() {
+
+  int best = 1024;
+  double r = benchCpuGrpSize<1024>();
+  double r2 = benchCpuGrpSize<2048>();
+  if (r2 > r) { best = 2048; r = r2; }
+  double r4 = benchCpuGrpSize<4096>();
+  if (r4 > r) { best = 4096; r = r4; }
+  return best;
+
+}
+
+void VanitySearch::FindKeyCPU(TH_PARAM *ph) {
+
+  switch (cpuGrpSize) {
+    case 4096: FindKeyCPUGrp<4096>(ph); break;
+    case 2048: FindKeyCPUGrp<2048>(ph); break;
+    default:   FindKeyCPUGrp<1024>(ph); break;
+  }
+
+}
+
+template<int GRP_SIZE> void VanitySearch::FindKeyCPUGrp(TH_PARAM *ph) {
+
+  // Global init
+  int thId = ph->threadId;
+  counterStore(counters[thId], 0);
+
+  // CPU Thread
+  IntGroup *grp = new IntGroup(GRP_SIZE/2+1);
+
+  // Group Init
+  Int  key;
+  Point startP;
+  getCPUStartingKey(thId,key,startP);
+
+  Int *dx = new Int[GRP_SIZE/2+1];
+  Point *pts = new Point[GRP_SIZE];
+
+  grp->Set(dx);
+
+  ph->hasStarted = true;
+  ph->rekeyRequest = false;
+
+  while (!endOfSearch) {
+
+    if (ph->rekeyRequest) {
+      getCPUStartingKey(thId, key, startP);
+      ph->rekeyRequest = false;
+    }
+
+    groupStep<GRP_SIZE>(grp, dx, pts, startP);
 
 #if 0
     // Check
     {
       bool wrong = false;
-      Point p0 = secp.ComputePublicKey(&key);
-      for (int i = 0; i < CPU_GRP_SIZE; i++) {
-        if (!p0.equals(pts[i])) {
+      Point p0 = secp->ComputePublicKey(&key);
+      for (int i = 0; i < GRP_SIZE; i++) {
+        // pts are affine only, z is never written
+        if (!p0.x.IsEqual(&pts[i].x) || !p0.y.IsEqual(&pts[i].y)) {
           wrong = true;
           printf("[%d] wrong point\n",i);
         }
-        p0 = secp.NextKey(p0);
+        p0 = secp->NextKey(p0);
       }
       if(wrong) exit(0);
     }
 #endif
 
     // Check addresses
-    if (useSSE) {
+    double statT0 = Stats::enabled ? Timer::get_tick() : 0.0;
+
+    if (useSSE && (useAVX2 || useAVX512) && searchMode != SEARCH_STEGO) {
+
+      // 8 or 16 points at a time (AVX2/AVX512 pipelines)
+      int w = useAVX512 ? 16 : 8;
 
-      for (int i = 0; i < CPU_GRP_SIZE && !endOfSearch; i += 4) {
+      for (int i = 0; i < GRP_SIZE && !endOfSearch; i += w) {
 
         switch (searchMode) {
           case SEARCH_COMPRESSED:
-            checkAddressesSSE(true, key, i, pts[i], pts[i + 1], pts[i + 2], pts[i + 3]);
+            checkAddressesWide(true, key, i, pts + i, w);
             break;
           case SEARCH_UNCOMPRESSED:
-            checkAddressesSSE(false, key, i, pts[i], pts[i + 1], pts[i + 2], pts[i + 3]);
+            checkAddressesWide(false, key, i, pts + i, w);
             break;
           case SEARCH_BOTH:
+            checkAddressesWide(true, key, i, pts + i, w);
+            checkAddressesWide(false, key, i, pts + i, w);
+            break;
+        }
+
+      }
+
+    } else if (useSSE) {
+
+      for (int i = 0; i < GRP_SIZE && !endOfSearch; i += 4) {
+
+        switch (searchMode) {
+          case SEARCH_COMPRESSED:
             checkAddressesSSE(true, key, i, pts[i], pts[i + 1], pts[i + 2], pts[i + 3]);
+            break;
+          case SEARCH_UNCOMPRESSED:
             checkAddressesSSE(false, key, i, pts[i], pts[i + 1], pts[i + 2], pts[i + 3]);
             break;
+          case SEARCH_BOTH:
+            checkAddressesBothSSE(key, i, pts[i], pts[i + 1], pts[i + 2], pts[i + 3]);
+            break;
           case SEARCH_STEGO:
             checkStegoMaskSSE(key, i, pts[i], pts[i + 1], pts[i + 2], pts[i + 3]);
             break;
@@ -1777,7 +2334,7 @@ void VanitySearch::FindKeyCPU(TH_PARAM *ph) {
 
     } else {
 
-      for (int i = 0; i < CPU_GRP_SIZE && !endOfSearch; i ++) {
+      for (int i = 0; i < GRP_SIZE && !endOfSearch; i ++) {
 
         switch (searchMode) {
         case SEARCH_COMPRESSED:
@@ -1799,22 +2356,78 @@ void VanitySearch::FindKeyCPU(TH_PARAM *ph) {
 
     }
 
-    key.Add((uint64_t)CPU_GRP_SIZE);
-    counters[thId]+= 6*CPU_GRP_SIZE; // Point + endo #1 + endo #2 + Symetric point + endo #1 + endo #2
+    if (Stats::enabled)
+      Stats::Add(STATS_CPU_HASH, Timer::get_tick() - statT0);
+
+    key.Add((uint64_t)GRP_SIZE);
+    threadOffsets[thId] += GRP_SIZE;
+    counterAdd(counters[thId], (uint64_t)nbClass*GRP_SIZE); // Checked classes per point (6 when -classes is not narrowed)
 
   }
 
+  delete grp;
+  delete[] dx;
+  delete[] pts;
+
   ph->isRunning = false;
 
 }
 
 // ----------------------------------------------------------------------------
 
+void VanitySearch::computeGPUStartingPoints(Int *keys, Point *p, int groupSize, int from, int to) {
+
+  // Compute the starting points of a key slice, the public keys are kept in
+  // projective coordinates and reduced with a grouped inversion, one ModInv
+  // per CPU_GRP_SIZE keys instead of one per key
+  Int z[CPU_GRP_SIZE];
+
+  int i = from;
+  while (i < to) {
+
+    int n = to - i;
+    if (n > CPU_GRP_SIZE) n = CPU_GRP_SIZE;
+
+    for (int j = 0; j < n; j++) {
+      Int k(keys + i + j);
+      // Starting key is at the middle of the group
+      k.Add((uint64_t)(groupSize / 2));
+      p[i + j] = secp->ComputePublicKeyProjective(&k);
+      z[j].Set(&p[i + j].z);
+    }
+
+    IntGroup grp(n);
+    grp.Set(z);
+    grp.ModInv();
+
+    for (int j = 0; j < n; j++) {
+      p[i + j].x.ModMulK1(&p[i + j].x, &z[j]);
+      p[i + j].y.ModMulK1(&p[i + j].y, &z[j]);
+      p[i + j].z.SetInt32(1);
+      if (startPubKeySpecified)
+        p[i + j] = secp->AddDirect(p[i + j], startPubKey);
+    }
+
+    i += n;
+
+  }
+
+}
+
 void VanitySearch::getGPUStartingKeys(int thId, int groupSize, int nbThread, Int *keys, Point *p) {
 
+  // Rekeying draws the whole grid's entropy in one counter mode pass, the
+  // per scalar Mersenne Twister draws used to stall the GPU at every rekey.
+  // The point computations are batched and split across all cores below
+  unsigned char *rnd32 = NULL;
+  if (rekey > 0) {
+    rnd32 = (unsigned char *)malloc((size_t)nbThread * 32);
+    rndBulk(rnd32, (unsigned long long)nbThread * 32);
+  }
+
   for (int i = 0; i < nbThread; i++) {
     if (rekey > 0) {
-      keys[i].Rand(256);
+      keys[i].Set32Bytes(rnd32 + (size_t)i * 32);
     } else {
       keys[i].Set(&startKey);
       Int offT((uint64_t)i);
@@ -1823,17 +2436,199 @@ void VanitySearch::getGPUStartingKeys(int thId, int groupSize, int nbThread, Int
       offG.ShiftL(112);
       keys[i].Add(&offT);
       keys[i].Add(&offG);
+      // Skip the range already covered before a resumed snapshot
+      keys[i].Add(threadOffsets[thId]);
     }
-    Int k(keys + i);
-    // Starting key is at the middle of the group
-    k.Add((uint64_t)(groupSize / 2));
-    p[i] = secp->ComputePublicKey(&k);
-    if (startPubKeySpecified)
-      p[i] = secp->AddDirect(p[i], startPubKey);
+  }
+
+  if (rnd32)
+    free(rnd32);
+
+  int nbWorker = Timer::getCoreNumber();
+  if (nbWorker < 1) nbWorker = 1;
+  if (nbWorker > nbThread) nbWorker = nbThread;
+  int per = (nbThread + nbWorker - 1) / nbWorker;
+
+  KEYGEN_PARAM *params = (KEYGEN_PARAM *)malloc(nbWorker * sizeof(KEYGEN_PARAM));
+#ifdef WIN64
+  HANDLE *thHandles = (HANDLE *)malloc(nbWorker * sizeof(HANDLE));
+#else
+  pthread_t *thIds = (pthread_t *)malloc(nbWorker * sizeof(pthread_t));
+#endif
+
+  int nbLaunched = 0;
+  for (int w = 0; w < nbWorker; w++) {
+    int from = w * per;
+    int to = from + per;
+    if (to > nbThread) to = nbThread;
+    if (from >= to) break;
+    params[w].obj = this;
+    params[w].keys = keys;
+    params[w].p = p;
+    params[w].groupSize = groupSize;
+    params[w].from = from;
+    params[w].to = to;
+#ifdef WIN64
+    DWORD thread_id;
+    thHandles[w] = CreateThread(NULL, 0, _ComputeStartingPoints, (void *)(params + w), 0, &thread_id);
+#else
+    pthread_create(&thIds[w], NULL, &_ComputeStartingPoints, (void *)(params + w));
+#endif
+    nbLaunched++;
+  }
+
+#ifdef WIN64
+  WaitForMultipleObjects(nbLaunched, thHandles, TRUE, INFINITE);
+  for (int w = 0; w < nbLaunched; w++)
+    CloseHandle(thHandles[w]);
+  free(thHandles);
+#else
+  for (int w = 0; w < nbLaunched; w++)
+    pthread_join(thIds[w], NULL);
+  free(thIds);
+#endif
+  free(params);
+
+}
+
+void VanitySearch::computeVerifyPoints(VERIFY_CANDIDATE *cand, Point *p, int from, int to) {
+
+  // Derive k.G of a candidate slice, the points are kept in projective
+  // coordinates and reduced with a grouped inversion as above: one ModInv
+  // per CPU_GRP_SIZE candidates instead of one per scalar multiplication
+  Int z[CPU_GRP_SIZE];
+
+  int i = from;
+  while (i < to) {
+
+    int n = to - i;
+    if (n > CPU_GRP_SIZE) n = CPU_GRP_SIZE;
+
+    for (int j = 0; j < n; j++) {
+      Int k = adjustedKey(cand[i + j].key, cand[i + j].incr, cand[i + j].endo);
+      p[i + j] = secp->ComputePublicKeyProjective(&k);
+      z[j].Set(&p[i + j].z);
+    }
+
+    IntGroup grp(n);
+    grp.Set(z);
+    grp.ModInv();
+
+    for (int j = 0; j < n; j++) {
+      p[i + j].x.ModMulK1(&p[i + j].x, &z[j]);
+      p[i + j].y.ModMulK1(&p[i + j].y, &z[j]);
+      p[i + j].z.SetInt32(1);
+      // The per candidate start point adjustments (-sp) are applied by
+      // checkPrivKey, p holds the raw k.G
+    }
+
+    i += n;
+
   }
 
 }
 
+void VanitySearch::VerifyWorkerThread() {
+
+  vector<VERIFY_CANDIDATE> batch;
+
+  verifierRunning = true;
+
+  while (true) {
+
+    // Grab the whole pending queue in one swap
+    batch.clear();
+#ifdef WIN64
+    WaitForSingleObject(verifyMutex, INFINITE);
+    batch.swap(verifyPending);
+    ReleaseMutex(verifyMutex);
+#else
+    pthread_mutex_lock(&verifyMutex);
+    batch.swap(verifyPending);
+    pthread_mutex_unlock(&verifyMutex);
+#endif
+
+    int n = (int)batch.size();
+    if (n == 0) {
+      if (verifierStop)
+        break;
+      Timer::SleepMillis(10);
+      continue;
+    }
+
+    double statT0 = Stats::enabled ? Timer::get_tick() : 0.0;
+
+    Point *pts = new Point[n];
+
+    // Derive the public keys of the batch, large ones (rekey burst,
+    // permissive prefixes) are split across all cores
+    int nbWorker = Timer::getCoreNumber();
+    if (nbWorker > (n + 255) / 256) nbWorker = (n + 255) / 256;
+    if (nbWorker <= 1) {
+
+      computeVerifyPoints(batch.data(), pts, 0, n);
+
+    } else {
+
+      int per = (n + nbWorker - 1) / nbWorker;
+      VERIFY_PARAM *params = (VERIFY_PARAM *)malloc(nbWorker * sizeof(VERIFY_PARAM));
+#ifdef WIN64
+      HANDLE *thHandles = (HANDLE *)malloc(nbWorker * sizeof(HANDLE));
+#else
+      pthread_t *thIds = (pthread_t *)malloc(nbWorker * sizeof(pthread_t));
+#endif
+
+      int nbLaunched = 0;
+      for (int w = 0; w < nbWorker; w++) {
+        int from = w * per;
+        int to = from + per;
+        if (to > n) to = n;
+        if (from >= to) break;
+        params[w].obj = this;
+        params[w].cand = batch.data();
+        params[w].p = pts;
+        params[w].from = from;
+        params[w].to = to;
+#ifdef WIN64
+        DWORD thread_id;
+        thHandles[w] = CreateThread(NULL, 0, _VerifyPoints, (void *)(params + w), 0, &thread_id);
+#else
+        pthread_create(&thIds[w], NULL, &_VerifyPoints, (void *)(params + w));
+#endif
+        nbLaunched++;
+      }
+
+#ifdef WIN64
+      WaitForMultipleObjects(nbLaunched, thHandles, TRUE, INFINITE);
+      for (int w = 0; w < nbLaunched; w++)
+        CloseHandle(thHandles[w]);
+      free(thHandles);
+#else
+      for (int w = 0; w < nbLaunched; w++)
+        pthread_join(thIds[w], NULL);
+      free(thIds);
+#endif
+      free(params);
+
+    }
+
+    // Table probe, address compare and output. checkPrivKey skips its
+    // scalar multiplication when handed the precomputed point
+    for (int i = 0; i < n && !endOfSearch; i++)
+      checkAddr(*(prefix_t *)(batch[i].hash160), batch[i].hash160, batch[i].key,
+                batch[i].incr, batch[i].endo, batch[i].mode, &pts[i]);
+
+    delete[] pts;
+
+    if (Stats::enabled)
+      Stats::Add(STATS_VERIFY, Timer::get_tick() - statT0);
+
+  }
+
+  verifierRunning = false;
+
+}
+
 void VanitySearch::FindKeyGPU(TH_PARAM *ph) {
 
   bool ok = true;
@@ -1841,16 +2636,31 @@ void VanitySearch::FindKeyGPU(TH_PARAM *ph) {
 #ifdef WITHGPU
 
   // Global init
+  // One engine drives all requested devices (one CUDA stream per device),
+  // prefix tables are built once and found items are aggregated by the engine
   int thId = ph->threadId;
-  GPUEngine g(ph->gridSizeX,ph->gridSizeY, ph->gpuId, maxFound, (rekey!=0));
+
+  // Autotune the grid geometry when -g was not given, the winner is cached
+  // per device name so only the first start on a new GPU model pays for it
+  GPUEngine::Autotune(*(ph->gpuIds), *(ph->gridSizes));
+
+  GPUEngine g(*(ph->gpuIds), *(ph->gridSizes), maxFound, (rekey!=0));
   int nbThread = g.GetNbThread();
   Point *p = new Point[nbThread];
   Int *keys = new Int[nbThread];
   vector<ITEM> found;
+  uint64_t taprootAdds = 0;
+
+  // Persistent kernel mode: the grid loops device side, each launch covers
+  // PK_STEPS steps instead of one
+  if (persistentKernel) {
+    g.SetPersistent(true);
+    printf("Persistent kernel mode: %d steps per launch\n", g.GetNbStep());
+  }
 
   printf("GPU: %s\n",g.deviceName.c_str());
 
-  counters[thId] = 0;
+  counterStore(counters[thId], 0);
 
   getGPUStartingKeys(thId, g.GetGroupSize(), nbThread, keys, p);
 
@@ -1860,42 +2670,111 @@ void VanitySearch::FindKeyGPU(TH_PARAM *ph) {
     g.SetSearchMode(SEARCH_TXID);
     g.SetTxidTarget(stegoTarget.value, stegoTarget.mask);
     g.SetRawTx(rawTx.data(), (int)rawTx.size(), nonceOffset, nonceLen);
-    printf("TXID grinding mode enabled on GPU %d\n", ph->gpuId);
+    printf("TXID grinding mode enabled on %d GPU(s)\n", (int)ph->gpuIds->size());
   } else if (stegoMode) {
-    // Steganography mode - set target and mask
+    // Steganography mode - set targets and masks
     g.SetSearchMode(SEARCH_COMPRESSED);  // Use compressed for stego
-    g.SetStegoTarget(stegoTarget.value, stegoTarget.mask);
-    printf("Mask mode enabled on GPU %d\n", ph->gpuId);
+    g.SetStegoTargets(stegoTargets.data(), (int)stegoTargets.size());
+    printf("Mask mode enabled on %d GPU(s), %d target(s)\n", (int)ph->gpuIds->size(),
+           (int)stegoTargets.size());
   } else if (sigMode) {
-    // Signature R-value grinding mode - same kernel as stegoMode
+    // Signature R-value grinding mode - dedicated kernel, the signature is
+    // completed on device so the host only formats the results
     g.SetSearchMode(SEARCH_COMPRESSED);  // Use compressed for sig mode
     g.SetStegoTarget(stegoTarget.value, stegoTarget.mask);
-    printf("Signature mode enabled on GPU %d\n", ph->gpuId);
+    g.SetSigParams(sigPrivKey.bits64, sigMsgHash.bits64, sigPubKeyX.bits64, schnorrMode);
+    printf("Signature mode enabled on %d GPU(s) (on-device signing)\n", (int)ph->gpuIds->size());
   } else if (taprootMode) {
-    // Taproot post-tweak grinding mode
-    // NOTE: Current GPU kernel matches P.x, not Q.x
-    // The CPU output handler computes Q = P + hash(P)*G and reports Q.x
-    // For true post-tweak matching, GPU kernel would need modification
+    // Taproot post-tweak grinding mode: the kernel computes the TapTweak
+    // tagged hash and Q = P + t*G on device and matches Q.x, so only final
+    // matches reach the host (with t and Q.x already in the item)
     g.SetSearchMode(SEARCH_COMPRESSED);
     g.SetStegoTarget(stegoTarget.value, stegoTarget.mask);
-    printf("Taproot mode enabled on GPU %d (matches P.x, computes Q.x)\n", ph->gpuId);
-    printf("NOTE: For full post-tweak grinding, GPU kernel modification needed\n");
+    printf("Taproot mode enabled on %d GPU(s) (on-device tweak, matches Q.x)\n", (int)ph->gpuIds->size());
   } else {
     // Normal vanity search mode
     g.SetSearchMode(searchMode);
     g.SetSearchType(searchType);
     if (onlyFull) {
       g.SetPrefix(usedPrefixL,nbPrefix);
+      // The 32 bit second level still lets collisions through to the CPU
+      // confirmation path, gather the full hash160 of every target in second
+      // level table order (items are sorted on lPrefix, usedPrefixL ascends)
+      std::vector<uint8_t> hash160s;
+      hash160s.reserve((size_t)nbPrefix * 20);
+      for (int i = 0; i < (int)usedPrefixL.size(); i++) {
+        std::vector<PREFIX_ITEM> *items = prefixes[usedPrefixL[i].sPrefix].items;
+        for (int j = 0; j < (int)items->size(); j++)
+          hash160s.insert(hash160s.end(), (*items)[j].hash160, (*items)[j].hash160 + 20);
+      }
+      if (nbPrefix <= 1000000) {
+        // Exact device side match, only true hits cross PCIe
+        g.SetFullHashes(hash160s.data(), (uint32_t)(hash160s.size() / 20));
+      } else {
+        // Above that the exact list costs 20 bytes per target, a Bloom stage
+        // (~2 bytes per target, FP rate ~5e-4) keeps the memory in check
+        g.SetBloomFilter(hash160s.data(), (uint32_t)(hash160s.size() / 20));
+      }
     } else {
-      if(hasPattern)
+      if(hasPattern) {
         g.SetPattern(inputPrefixes[0].c_str());
-      else
+        if ((int)inputPrefixes.size() > 1) {
+          // Several patterns, upload the combined matcher. The kernel then
+          // checks all of them in a single scan per candidate address
+          g.SetPatternSet(patternSet);
+          if (patternGeneric.size() > 0)
+            printf("Warning, %d pattern(s) with several '*' are matched on CPU only\n", (int)patternGeneric.size());
+        }
+      } else {
         g.SetPrefix(usedPrefix);
+        if (searchType == BECH32) {
+          // Each bech32 data character encodes exactly 5 bits of hash160,
+          // so the character prefixes convert to (value, mask) pairs the
+          // kernel matches in full. Without this only the 16 bit slot is
+          // checked on device and the 5 bit alignment makes bech32 ship
+          // far more PCIe candidates per true hit than Base58
+          std::vector<uint32_t> vm;
+          int nbVm = 0;
+          for (int i = 0; i < (int)usedPrefix.size(); i++) {
+            std::vector<PREFIX_ITEM> *items = prefixes[usedPrefix[i]].items;
+            for (int j = 0; j < (int)items->size(); j++) {
+              PREFIX_ITEM &pit = (*items)[j];
+              uint8_t data[64];
+              memset(data, 0, 64);
+              int nbBit;
+              if (pit.isFull) {
+                memcpy(data, pit.hash160, 8);
+                nbBit = 64;
+              } else {
+                size_t dataLength;
+                bech32_decode_nocheck(data, &dataLength, pit.prefix + 4);
+                nbBit = 5 * (pit.prefixLength - 4);
+                if (nbBit > 64) nbBit = 64;
+              }
+              uint8_t mask[8];
+              for (int b = 0; b < 8; b++) {
+                int r = nbBit - 8 * b;
+                mask[b] = (r >= 8) ? 0xFF : (r <= 0) ? 0x00 : (uint8_t)(0xFF << (8 - r));
+              }
+              uint32_t w[4];
+              memcpy(&w[0], data, 4);
+              memcpy(&w[1], data + 4, 4);
+              memcpy(&w[2], mask, 4);
+              memcpy(&w[3], mask + 4, 4);
+              w[0] &= w[2];
+              w[1] &= w[3];
+              vm.insert(vm.end(), w, w + 4);
+              nbVm++;
+            }
+          }
+          g.SetBech32Prefixes(vm.data(), nbVm);
+        }
+      }
     }
   }
 
   getGPUStartingKeys(thId, g.GetGroupSize(), nbThread, keys, p);
-  ok = g.SetKeys(p);
+  ok = g.SetKeys(p, sigMode ? keys : NULL);
   ph->rekeyRequest = false;
 
   ph->hasStarted = true;
@@ -1904,9 +2783,13 @@ void VanitySearch::FindKeyGPU(TH_PARAM *ph) {
   while (ok && !endOfSearch) {
 
     if (ph->rekeyRequest) {
+      // Interrupt the running grid at the next step boundary, the stale
+      // results of the interrupted kernel are discarded by the rekey anyway
+      g.RequestStop();
       getGPUStartingKeys(thId, g.GetGroupSize(), nbThread, keys, p);
-      ok = g.SetKeys(p);
+      ok = g.SetKeys(p, sigMode ? keys : NULL);
       ph->rekeyRequest = false;
+      taprootAdds = 0;
     }
 
     // Call kernel based on mode
@@ -1914,12 +2797,25 @@ void VanitySearch::FindKeyGPU(TH_PARAM *ph) {
       ok = g.LaunchTxid(found);
     } else if (taprootMode) {
       ok = g.LaunchTaproot(found);
-    } else if (stegoMode || sigMode) {
+    } else if (sigMode) {
+      ok = g.LaunchSig(found);
+    } else if (stegoMode) {
       ok = g.LaunchStego(found);
     } else {
       ok = g.Launch(found);
     }
 
+    if (Stats::enabled) {
+      // The engine already accumulates its kernel wait and drain times for
+      // -bench, sample and reset them so the flush deltas line up
+      double kernelT, pcieT;
+      g.GetTimings(&kernelT, &pcieT);
+      g.ResetTimings();
+      Stats::Add(STATS_KERNEL, kernelT);
+      Stats::Add(STATS_PCIE, pcieT);
+    }
+    double statT0 = Stats::enabled ? Timer::get_tick() : 0.0;
+
     for(int i=0;i<(int)found.size() && !endOfSearch;i++) {
 
       ITEM it = found[i];
@@ -1977,26 +2873,77 @@ void VanitySearch::FindKeyGPU(TH_PARAM *ph) {
           endOfSearch = true;
         }
 
-      } else if (stegoMode || sigMode || taprootMode) {
-        // Steganography/Signature/Taproot match - reconstruct and output the key
+      } else if (sigMode) {
+        // Fully formed signature computed on device: decode k, R.x and s
+        // (little endian 32 bit words, see CheckSigPoint)
+        uint32_t *sw = (uint32_t *)it.hash;
+        Int nonce_k, rx, s_val;
+        nonce_k.SetInt32(0);
+        rx.SetInt32(0);
+        s_val.SetInt32(0);
+        for (int w = 0; w < 4; w++) {
+          nonce_k.bits64[w] = ((uint64_t)sw[2*w + 1] << 32) | (uint64_t)sw[2*w];
+          rx.bits64[w] = ((uint64_t)sw[2*w + 9] << 32) | (uint64_t)sw[2*w + 8];
+          s_val.bits64[w] = ((uint64_t)sw[2*w + 17] << 32) | (uint64_t)sw[2*w + 16];
+        }
+
+        // ECDSA r = R.x mod n (Schnorr uses R.x as is)
+        Int r_val(&rx);
+        r_val.Mod(&secp->order);
+
+        // R.y parity is in bit 14 of the flags (always even for Schnorr)
+        bool rOdd = (it.endo & 0x4000) != 0;
+
+        // Zero-pad hex values to 64 chars (256 bits) for consistent output
+        string rxHex = rx.GetBase16();
+        while (rxHex.length() < 64) rxHex = "0" + rxHex;
+        string rHex = r_val.GetBase16();
+        while (rHex.length() < 64) rHex = "0" + rHex;
+        string sHex = s_val.GetBase16();
+        while (sHex.length() < 64) sHex = "0" + sHex;
+        string kHex = nonce_k.GetBase16();
+        while (kHex.length() < 64) kHex = "0" + kHex;
+
+        printf("\n=== SIGNATURE FOUND ===\n");
+        printf("Nonce (k):  %s\n", kHex.c_str());
+        printf("R.x:        %s\n", rxHex.c_str());
+        printf("R.y parity: %s\n", rOdd ? "odd" : "even");
+        printf("sig.r:      %s\n", rHex.c_str());
+        printf("sig.s:      %s\n", sHex.c_str());
+        printf("Mode:       %s\n", schnorrMode ? "BIP340 Schnorr" : "ECDSA");
+        printf("========================\n");
+
+        // Also output to file if specified (use padded hex strings)
+        string sigInfo = "SIG:r=" + rHex + ",s=" + sHex;
+        output(sigInfo, kHex, rHex);
+
+        nbFoundKey++;
+        if (stopWhenFound) {
+          endOfSearch = true;
+        }
+
+      } else if (stegoMode || taprootMode) {
+        // Steganography/Taproot match - reconstruct and output the key
         // Order matters! increment -> endomorphism -> symmetric
         Int finalKey;
         finalKey.Set(&keys[it.thId]);
 
         if (taprootMode) {
-          // Taproot mode: GPU increments P by 1 each kernel call (P = P + G)
-          // Results are retrieved one kernel call later (async pattern)
-          // At processing time, keys[thId] = original + taprootIter + 1
-          // The match was found at point original + taprootIter
-          // So we need to subtract 1 to get the correct key
-          finalKey.Sub(1);
+          // Taproot mode: GPU increments P by 1 each step (P = P + G) and
+          // stores the iteration count of the match (16 bit) in incr
+          // At processing time keys[thId] is already advanced past the
+          // drained kernel, recover the absolute iteration of the match from
+          // the 16 bit counter and rewind the difference
+          uint64_t m = (taprootAdds & ~0xFFFFULL) | (uint64_t)(uint16_t)it.incr;
+          if (m >= taprootAdds) m -= 0x10000;
+          finalKey.Sub(taprootAdds - m);
           // Add center offset (GPU starts at keys[i] + groupSize/2)
           finalKey.Add((uint64_t)(g.GetGroupSize() / 2));
         } else {
           // Step 1: Compute key from incr
           // GPU incr maps to: matched_key = original_keys + incr
-          // But results are processed after keys updated by STEP_SIZE (=groupSize)
-          // So: finalKey = keys + incr - STEP_SIZE = keys + incr - groupSize
+          // But results are processed after keys updated by nbStep*STEP_SIZE
+          // So: finalKey = keys + incr - nbStep*STEP_SIZE
           int32_t groupSize = g.GetGroupSize();
           if (it.incr >= 0) {
             finalKey.Add((uint64_t)it.incr);
@@ -2004,156 +2951,58 @@ void VanitySearch::FindKeyGPU(TH_PARAM *ph) {
             finalKey.Sub((uint64_t)(-it.incr));
           }
           // Account for timing: results from previous kernel, keys already advanced
-          finalKey.Sub((uint64_t)groupSize);
+          finalKey.Sub((uint64_t)groupSize * g.GetNbStep());
         }
 
         // Step 2: Apply endomorphism multiplication
         // If endo=1, we matched beta*x, so key = (base+incr)*lambda
         // If endo=2, we matched beta2*x, so key = (base+incr)*lambda2
-        if (it.endo == 1) {
+        // (the matched target index rides in bits 2-9 of the endo field)
+        int endo = it.endo & 0x3;
+        if (endo == 1) {
           finalKey.ModMulK1order(&lambda);
-        } else if (it.endo == 2) {
+        } else if (endo == 2) {
           finalKey.ModMulK1order(&lambda2);
         }
 
         // Step 3: Handle symmetric (negated Y) - incr<0 means we matched -P
-        if (it.incr < 0) {
+        // (taproot stores an iteration counter in incr, never a symmetric)
+        if (!taprootMode && it.incr < 0) {
           finalKey.Neg();
           finalKey.Add(&secp->order);
         }
 
-        // Get public key (R = k*G for signature, or pubkey for stego)
+        // Get public key (pubkey for stego, internal key for taproot)
         Point pubKey = secp->ComputePublicKey(&finalKey);
 
-        if (sigMode) {
-          // Signature R-value grinding mode - compute the full signature
-          Int nonce_k;
-          nonce_k.Set(&finalKey);
-
-          // For BIP340 Schnorr: if R.y is odd, negate k to get even R.y
-          if (schnorrMode && pubKey.y.IsOdd()) {
-            nonce_k.Neg();
-            nonce_k.Add(&secp->order);
-            pubKey = secp->ComputePublicKey(&nonce_k);  // Recompute with negated k
+        if (taprootMode) {
+          // Taproot post-tweak grinding mode
+          // We found P where Q = P + hash("TapTweak", P.x)*G has the target
+          // prefix. The kernel already computed the tagged hash, t*G and Q
+          // on device, decode them from the item (little endian 32 bit
+          // words, see ComputeKeysTaproot)
+          uint32_t *sw = (uint32_t *)it.hash;
+          Int devPx, tweak, qX;
+          devPx.SetInt32(0);
+          tweak.SetInt32(0);
+          qX.SetInt32(0);
+          for (int w = 0; w < 4; w++) {
+            devPx.bits64[w] = ((uint64_t)sw[2*w + 1] << 32) | (uint64_t)sw[2*w];
+            tweak.bits64[w] = ((uint64_t)sw[2*w + 9] << 32) | (uint64_t)sw[2*w + 8];
+            qX.bits64[w] = ((uint64_t)sw[2*w + 17] << 32) | (uint64_t)sw[2*w + 16];
           }
 
-          Int r_val, s_val;
-
-          // r = R.x (for both ECDSA and Schnorr)
-          r_val.Set(&pubKey.x);
-
-          if (schnorrMode) {
-            // BIP-340 Schnorr signature: s = k + e*d mod n
-            // where e = SHA256("BIP0340/challenge" || R.x || P.x || m)
-
-            // Build challenge data: R.x || P.x || m (96 bytes)
-            uint8_t challengeData[96];
-            uint8_t rBytes[32], pBytes[32], mBytes[32];
-
-            // R.x (32 bytes, big-endian)
-            pubKey.x.Get32Bytes(rBytes);
-            memcpy(challengeData, rBytes, 32);
-
-            // P.x (signing pubkey X, 32 bytes)
-            sigPubKeyX.Get32Bytes(pBytes);
-            memcpy(challengeData + 32, pBytes, 32);
-
-            // m (message hash, 32 bytes)
-            sigMsgHash.Get32Bytes(mBytes);
-            memcpy(challengeData + 64, mBytes, 32);
-
-            // e = TaggedHash("BIP0340/challenge", R.x || P.x || m)
-            uint8_t eBytes[32];
-            TaggedHash("BIP0340/challenge", challengeData, 96, eBytes);
-
-            Int e;
-            e.Set32Bytes(eBytes);
-            e.Mod(&secp->order);
-
-            // s = k + e*d mod n (no modular inverse needed!)
-            s_val.Set(&e);
-            s_val.ModMulK1order(&sigPrivKey);
-            s_val.ModAddK1order(&nonce_k);
-
-            // No low-s normalization for BIP-340 Schnorr
-
-          } else {
-            // ECDSA signature: s = k^-1 * (z + r*d) mod n
-
-            // r mod n (ECDSA requires this)
-            r_val.Mod(&secp->order);
-
-            Int k_inv, temp;
-
-            // k^-1 mod n
-            ModInvOrder(&k_inv, &nonce_k, &secp->order);
-
-            // temp = r * d mod n
-            temp.Set(&r_val);
-            temp.ModMulK1order(&sigPrivKey);
-
-            // temp = z + r*d mod n
-            temp.ModAddK1order(&sigMsgHash);
-
-            // s = k^-1 * (z + r*d) mod n
-            s_val.Set(&k_inv);
-            s_val.ModMulK1order(&temp);
-
-            // BIP 146: Low-s normalization for ECDSA
-            Int halfOrder;
-            halfOrder.Set(&secp->order);
-            halfOrder.ShiftR(1);
-            if (s_val.IsGreater(&halfOrder)) {
-              s_val.Neg();
-              s_val.Add(&secp->order);
-            }
+          // Cross check the reconstructed key against the internal key the
+          // kernel actually tweaked, a mismatch means the rewind above went
+          // wrong (rekey race) and the result must be dropped
+          if (!pubKey.x.IsEqual(&devPx)) {
+            printf("\nWarning, wrong taproot private key generated !\n");
+            continue;
           }
 
-          // Output the signature
-          // Zero-pad hex values to 64 chars (256 bits) for consistent output
-          string rxHex = pubKey.x.GetBase16();
-          while (rxHex.length() < 64) rxHex = "0" + rxHex;
-          string rHex = r_val.GetBase16();
-          while (rHex.length() < 64) rHex = "0" + rHex;
-          string sHex = s_val.GetBase16();
-          while (sHex.length() < 64) sHex = "0" + sHex;
-          string kHex = nonce_k.GetBase16();
-          while (kHex.length() < 64) kHex = "0" + kHex;
-
-          printf("\n=== SIGNATURE FOUND ===\n");
-          printf("Nonce (k):  %s\n", kHex.c_str());
-          printf("R.x:        %s\n", rxHex.c_str());
-          printf("R.y parity: %s\n", pubKey.y.IsOdd() ? "odd" : "even");
-          printf("sig.r:      %s\n", rHex.c_str());
-          printf("sig.s:      %s\n", sHex.c_str());
-          printf("Mode:       %s\n", schnorrMode ? "BIP340 Schnorr" : "ECDSA");
-          printf("========================\n");
-
-          // Also output to file if specified (use padded hex strings)
-          string sigInfo = "SIG:r=" + rHex + ",s=" + sHex;
-          output(sigInfo, kHex, rHex);
-
-        } else if (taprootMode) {
-          // Taproot post-tweak grinding mode
-          // We found P where Q = P + hash("TapTweak", P.x)*G has the target prefix
-
-          // Compute tweak: t = TaggedHash("TapTweak", P.x)
-          uint8_t pxBytes[32];
-          pubKey.x.Get32Bytes(pxBytes);
-          uint8_t tweakBytes[32];
-          TaggedHash("TapTweak", pxBytes, 32, tweakBytes);
-
-          Int tweak;
-          tweak.Set32Bytes(tweakBytes);
-          tweak.Mod(&secp->order);
-
-          // Compute Q = P + t*G (output key)
-          Point tG = secp->ComputePublicKey(&tweak);
-          Point Q = secp->AddDirect(pubKey, tG);
-
           string privHex = finalKey.GetBase16();
           string pXHex = pubKey.x.GetBase16();
-          string qXHex = Q.x.GetBase16();
+          string qXHex = qX.GetBase16();
 
           printf("\n=== TAPROOT KEY FOUND ===\n");
           printf("Private key (d):     %s\n", privHex.c_str());
@@ -2182,30 +3031,74 @@ void VanitySearch::FindKeyGPU(TH_PARAM *ph) {
           endOfSearch = true;
         }
 
+      } else if (verifierRunning) {
+        // Normal vanity search: hand the candidate to the batched verifier,
+        // the scalar multiplication of the key check no longer serializes
+        // the drain loop (see VerifyWorkerThread)
+        VERIFY_CANDIDATE c;
+        memcpy(c.hash160, it.hash, 20);
+        c.key.Set(&keys[it.thId]);
+        c.incr = it.incr;
+        c.endo = it.endo;
+        c.mode = it.mode;
+#ifdef WIN64
+        WaitForSingleObject(verifyMutex, INFINITE);
+        verifyPending.push_back(c);
+        ReleaseMutex(verifyMutex);
+#else
+        pthread_mutex_lock(&verifyMutex);
+        verifyPending.push_back(c);
+        pthread_mutex_unlock(&verifyMutex);
+#endif
       } else {
-        // Normal vanity search
+        // No verifier thread running (startup/shutdown path)
         checkAddr(*(prefix_t *)(it.hash), it.hash, keys[it.thId], it.incr, it.endo, it.mode);
       }
 
     }
 
+    if (Stats::enabled)
+      Stats::Add(STATS_GPU_ITEM, Timer::get_tick() - statT0);
+
     if (ok) {
+      uint64_t steps = (uint64_t)g.GetNbStep();
       if (txidMode) {
-        // TXID mode: count nonces tried (1 per thread per kernel call)
-        counters[thId] += (uint64_t)nbThread;
+        // TXID mode: count nonces tried (1 per thread per step)
+        counterAdd(counters[thId], (uint64_t)nbThread * steps);
       } else if (taprootMode) {
-        // Taproot mode: GPU increments P by 1 each kernel call (P = P + G)
-        // So we increment keys by 1 to track the GPU's state
+        // Taproot mode: GPU increments P by 1 each step (P = P + G)
+        // So we increment keys accordingly to track the GPU's state
         for (int i = 0; i < nbThread; i++) {
-          keys[i].Add(1);
+          keys[i].Add(steps);
         }
-        counters[thId] += (uint64_t)nbThread; // 1 point checked per thread per kernel
+        taprootAdds += steps;
+        threadOffsets[thId] += steps;
+        counterAdd(counters[thId], (uint64_t)nbThread * steps); // 1 point checked per thread per step
       } else {
         // EC modes: update keys and count operations
-        for (int i = 0; i < nbThread; i++) {
-          keys[i].Add((uint64_t)STEP_SIZE);
+        uint64_t done = (uint64_t)g.GetCompletedSteps();
+        if (done < steps) {
+          // The drained kernel bailed out early on a nearly full output
+          // buffer (its items were all drained above). The in flight kernel
+          // started from those divergent per block points so stop it,
+          // discard its results and resync the device from the host keys
+          // rewound to the last step every block completed, the remaining
+          // steps are simply replayed
+          g.RequestStop();
+          for (int i = 0; i < nbThread; i++) {
+            keys[i].Sub((uint64_t)STEP_SIZE * (steps - done));
+          }
+          threadOffsets[thId] -= (uint64_t)STEP_SIZE * (steps - done);
+          counterAdd(counters[thId], -(6ULL * STEP_SIZE * (steps - done) * nbThread));
+          computeGPUStartingPoints(keys, p, g.GetGroupSize(), 0, nbThread);
+          ok = g.SetKeys(p, sigMode ? keys : NULL);
+        } else {
+          for (int i = 0; i < nbThread; i++) {
+            keys[i].Add((uint64_t)STEP_SIZE * steps);
+          }
+          threadOffsets[thId] += (uint64_t)STEP_SIZE * steps;
+          counterAdd(counters[thId], 6ULL * STEP_SIZE * steps * nbThread); // Point + endo1 + endo2 + symetrics
         }
-        counters[thId] += 6ULL * STEP_SIZE * nbThread; // Point + endo1 + endo2 + symetrics
       }
     }
 
@@ -2266,7 +3159,7 @@ uint64_t VanitySearch::getGPUCount() {
 
   uint64_t count = 0;
   for(int i=0;i<nbGPUThread;i++)
-    count += counters[0x80L+i];
+    count += counterLoad(counters[0x80L+i]);
   return count;
 
 }
@@ -2275,20 +3168,172 @@ uint64_t VanitySearch::getCPUCount() {
 
   uint64_t count = 0;
   for(int i=0;i<nbCPUThread;i++)
-    count += counters[i];
+    count += counterLoad(counters[i]);
   return count;
 
 }
 
+// Aggregate both totals in a single relaxed pass over the padded slots,
+// used by the stats display so it does not rescan while the writers are hot
+void VanitySearch::snapshotCounters(uint64_t *cpuCount, uint64_t *gpuCount) {
+
+  uint64_t c = 0;
+  uint64_t g = 0;
+  for (int i = 0; i < nbCPUThread; i++)
+    c += counterLoad(counters[i]);
+  for (int i = 0; i < nbGPUThread; i++)
+    g += counterLoad(counters[0x80L + i]);
+  *cpuCount = c;
+  *gpuCount = g;
+
+}
+
 // ----------------------------------------------------------------------------
 
+// ----------------------------------------------------------------------------
+// Checkpoint/resume (-resume): the search state is periodically snapshotted
+// into a small memory mapped file from the stats loop and restored at
+// startup, so multi week runs survive a crash or a reboot. The file holds
+// two checksummed slots written alternately, a crash in the middle of a
+// snapshot can only lose the slot being written
+// ----------------------------------------------------------------------------
+
+#define RESUME_MAGIC 0x564D5253
+#define RESUME_VERSION 1
+
+typedef struct RESUME_STATE {
+
+  uint32_t magic;
+  uint32_t version;
+  uint32_t nbCPUThread;   // Snapshot refused if the thread layout changed
+  uint32_t checksum;      // Over everything after this field
+  uint8_t  startKey[32];
+  uint64_t totalCount;
+  uint64_t offsets[256];  // Per thread key advance since startKey
+
+} RESUME_STATE;
+
+static uint32_t resumeChecksum(RESUME_STATE *s) {
+
+  uint32_t sum = 0;
+  uint8_t *p = (uint8_t *)s->startKey;
+  for (size_t i = 0; i < sizeof(RESUME_STATE) - offsetof(RESUME_STATE, startKey); i++)
+    sum = sum * 31 + p[i];
+  return sum;
+
+}
+
+static bool resumeSlotValid(RESUME_STATE *s, int nbCPUThread) {
+
+  return s->magic == RESUME_MAGIC &&
+         s->version == RESUME_VERSION &&
+         s->nbCPUThread == (uint32_t)nbCPUThread &&
+         s->checksum == resumeChecksum(s);
+
+}
+
+void VanitySearch::loadResumeState() {
+
+  size_t mapSize = 2 * sizeof(RESUME_STATE);
+
+#ifdef WIN64
+  HANDLE hFile = CreateFileA(resumeFile.c_str(), GENERIC_READ | GENERIC_WRITE,
+                             FILE_SHARE_READ, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (hFile == INVALID_HANDLE_VALUE) {
+    printf("Resume: cannot open %s\n", resumeFile.c_str());
+    return;
+  }
+  HANDLE hMap = CreateFileMappingA(hFile, NULL, PAGE_READWRITE, 0, (DWORD)mapSize, NULL);
+  if (hMap == NULL) {
+    printf("Resume: cannot map %s\n", resumeFile.c_str());
+    CloseHandle(hFile);
+    return;
+  }
+  resumeState = (RESUME_STATE *)MapViewOfFile(hMap, FILE_MAP_ALL_ACCESS, 0, 0, mapSize);
+  if (resumeState == NULL) {
+    printf("Resume: cannot map %s\n", resumeFile.c_str());
+    CloseHandle(hMap);
+    CloseHandle(hFile);
+    return;
+  }
+#else
+  int fd = open(resumeFile.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd < 0) {
+    printf("Resume: cannot open %s: %s\n", resumeFile.c_str(), strerror(errno));
+    return;
+  }
+  if (ftruncate(fd, (off_t)mapSize) < 0) {
+    printf("Resume: cannot resize %s: %s\n", resumeFile.c_str(), strerror(errno));
+    close(fd);
+    return;
+  }
+  resumeState = (RESUME_STATE *)mmap(NULL, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);  // The mapping keeps the file open
+  if (resumeState == MAP_FAILED) {
+    printf("Resume: cannot map %s: %s\n", resumeFile.c_str(), strerror(errno));
+    resumeState = NULL;
+    return;
+  }
+#endif
+
+  // Restore the valid slot with the highest key count (a fresh file is all
+  // zero and has no valid slot)
+  int best = -1;
+  for (int s = 0; s < 2; s++) {
+    if (resumeSlotValid(&resumeState[s], nbCPUThread) &&
+        (best < 0 || resumeState[s].totalCount > resumeState[best].totalCount))
+      best = s;
+  }
+
+  if (best >= 0) {
+    startKey.SetInt32(0);
+    startKey.Set32Bytes(resumeState[best].startKey);
+    memcpy((void *)threadOffsets, resumeState[best].offsets, sizeof(threadOffsets));
+    savedTotalCount = resumeState[best].totalCount;
+    resumeSlot = best ^ 1;
+    printf("Resume: %s, 2^%.2f keys done, base key %s\n", resumeFile.c_str(),
+           log2((double)savedTotalCount), startKey.GetBase16().c_str());
+  } else {
+    printf("Resume: no usable snapshot in %s, starting from scratch\n", resumeFile.c_str());
+  }
+
+}
+
+void VanitySearch::saveResumeState(uint64_t totalCount) {
+
+  if (resumeState == NULL)
+    return;
+
+  RESUME_STATE *s = &resumeState[resumeSlot];
+  s->magic = RESUME_MAGIC;
+  s->version = RESUME_VERSION;
+  s->nbCPUThread = (uint32_t)nbCPUThread;
+  startKey.Get32Bytes(s->startKey);
+  s->totalCount = totalCount;
+  // Workers advance their offset concurrently, a slightly stale value only
+  // causes a small rescan after restore
+  memcpy(s->offsets, (void *)threadOffsets, sizeof(s->offsets));
+  s->checksum = resumeChecksum(s);
+
+#ifdef WIN64
+  FlushViewOfFile(s, sizeof(RESUME_STATE));
+#else
+  // msync wants a page aligned address, flush the whole (tiny) mapping
+  msync(resumeState, 2 * sizeof(RESUME_STATE), MS_ASYNC);
+#endif
+
+  resumeSlot ^= 1;
+
+}
+
 void VanitySearch::Search(int nbThread,std::vector<int> gpuId,std::vector<int> gridSize) {
 
   double t0;
   double t1;
   endOfSearch = false;
   nbCPUThread = nbThread;
-  nbGPUThread = (useGpu?(int)gpuId.size():0);
+  // A single engine thread drives all requested devices
+  nbGPUThread = (useGpu && gpuId.size()>0)?1:0;
   nbFoundKey = 0;
 
   // TXID and Taproot modes are GPU-only - disable CPU threads
@@ -2299,8 +3344,30 @@ void VanitySearch::Search(int nbThread,std::vector<int> gpuId,std::vector<int> g
 
   memset(counters,0,sizeof(counters));
 
+  // Restore a previous snapshot before the workers read startKey
+  if (resumeFile.length() > 0)
+    loadResumeState();
+
+  // Cluster worker: the coordinator assigns the key ranges, random
+  // rekeying would leave the leased slab
+  uint64_t leaseBudget = 0;
+  uint64_t leaseBase = savedTotalCount;
+  if (clusterWorker != NULL) {
+    rekey = 0;
+    memset((void *)threadOffsets, 0, sizeof(threadOffsets));
+    clusterWorker->NextLease(startKey, &leaseBudget);
+    printf("Lease Key: %s (%.0f Mkeys)\n", startKey.GetBase16().c_str(),
+      (double)leaseBudget / 1000000.0);
+  }
+
   printf("Number of CPU thread: %d\n", nbCPUThread);
 
+  // Pick the fastest group size for this machine
+  if (nbCPUThread > 0) {
+    cpuGrpSize = calibrateCpuGrpSize();
+    printf("CPU group size: %d\n", cpuGrpSize);
+  }
+
   TH_PARAM *params = (TH_PARAM *)malloc((nbCPUThread + nbGPUThread) * sizeof(TH_PARAM));
   memset(params,0,(nbCPUThread + nbGPUThread) * sizeof(TH_PARAM));
 
@@ -2311,6 +3378,42 @@ void VanitySearch::Search(int nbThread,std::vector<int> gpuId,std::vector<int> g
   ghMutex = PTHREAD_MUTEX_INITIALIZER;
 #endif
 
+  // Start the asynchronous result writer before any worker can find a key
+  outputHead = NULL;
+  writerStop = false;
+  writerRunning = false;
+#ifdef WIN64
+  {
+    DWORD thread_id;
+    CreateThread(NULL, 0, _OutputWriter, (void *)this, 0, &thread_id);
+  }
+#else
+  {
+    pthread_t thread_id;
+    pthread_create(&thread_id, NULL, &_OutputWriter, (void *)this);
+  }
+#endif
+  while (!writerRunning)
+    Timer::SleepMillis(1);
+
+  // Start the batched candidate verifier, GPU reported candidates are
+  // verified off the drain loop (see VerifyWorkerThread)
+  verifierStop = false;
+  verifierRunning = false;
+  if (nbGPUThread > 0) {
+#ifdef WIN64
+    verifyMutex = CreateMutex(NULL, FALSE, NULL);
+    DWORD verify_thread_id;
+    CreateThread(NULL, 0, _VerifyWorker, (void *)this, 0, &verify_thread_id);
+#else
+    verifyMutex = PTHREAD_MUTEX_INITIALIZER;
+    pthread_t verify_thread_id;
+    pthread_create(&verify_thread_id, NULL, &_VerifyWorker, (void *)this);
+#endif
+    while (!verifierRunning)
+      Timer::SleepMillis(1);
+  }
+
   // Launch CPU threads
   for (int i = 0; i < nbCPUThread; i++) {
     params[i].obj = this;
@@ -2326,20 +3429,19 @@ void VanitySearch::Search(int nbThread,std::vector<int> gpuId,std::vector<int> g
 #endif
   }
 
-  // Launch GPU threads
-  for (int i = 0; i < nbGPUThread; i++) {
-    params[nbCPUThread+i].obj = this;
-    params[nbCPUThread+i].threadId = 0x80L+i;
-    params[nbCPUThread+i].isRunning = true;
-    params[nbCPUThread+i].gpuId = gpuId[i];
-    params[nbCPUThread+i].gridSizeX = gridSize[2*i];
-    params[nbCPUThread+i].gridSizeY = gridSize[2*i+1];
+  // Launch GPU thread (one engine for all devices)
+  if (nbGPUThread > 0) {
+    params[nbCPUThread].obj = this;
+    params[nbCPUThread].threadId = 0x80L;
+    params[nbCPUThread].isRunning = true;
+    params[nbCPUThread].gpuIds = &gpuId;
+    params[nbCPUThread].gridSizes = &gridSize;
 #ifdef WIN64
     DWORD thread_id;
-    CreateThread(NULL, 0, _FindKeyGPU, (void*)(params+(nbCPUThread+i)), 0, &thread_id);
+    CreateThread(NULL, 0, _FindKeyGPU, (void*)(params+nbCPUThread), 0, &thread_id);
 #else
     pthread_t thread_id;
-    pthread_create(&thread_id, NULL, &_FindKeyGPU, (void*)(params+(nbCPUThread+i)));
+    pthread_create(&thread_id, NULL, &_FindKeyGPU, (void*)(params+nbCPUThread));
 #endif
   }
 
@@ -2347,7 +3449,7 @@ void VanitySearch::Search(int nbThread,std::vector<int> gpuId,std::vector<int> g
   setvbuf(stdout, NULL, _IONBF, 0);
 #endif
 
-  uint64_t lastCount = 0;
+  uint64_t lastCount = savedTotalCount;
   uint64_t gpuCount = 0;
   uint64_t lastGPUCount = 0;
 
@@ -2379,8 +3481,9 @@ void VanitySearch::Search(int nbThread,std::vector<int> gpuId,std::vector<int> g
       delay -= 500;
     }
 
-    gpuCount = getGPUCount();
-    uint64_t count = getCPUCount() + gpuCount;
+    uint64_t cpuCount;
+    snapshotCounters(&cpuCount, &gpuCount);
+    uint64_t count = cpuCount + gpuCount + savedTotalCount;
 
     t1 = Timer::get_tick();
     keyRate = (double)(count - lastCount) / (t1 - t0);
@@ -2406,6 +3509,8 @@ void VanitySearch::Search(int nbThread,std::vector<int> gpuId,std::vector<int> g
           log2((double)count), GetExpectedTime(avgKeyRate, (double)count).c_str(),nbFoundKey);
     }
 
+    Stats::Flush(keyRate, gpuKeyRate, count, nbFoundKey);
+
     if (rekey > 0) {
       if ((count - lastRekey) > (1000000 * rekey)) {
         // Rekey request
@@ -2414,12 +3519,44 @@ void VanitySearch::Search(int nbThread,std::vector<int> gpuId,std::vector<int> g
       }
     }
 
+    if (clusterWorker != NULL) {
+      clusterWorker->Progress(count - leaseBase);
+      if (count - leaseBase >= leaseBudget) {
+        // Budget burnt, move to the next leased slab. Workers may still add
+        // a group to their offset slot before honoring the rekey request,
+        // the budget is approximate anyway
+        clusterWorker->NextLease(startKey, &leaseBudget);
+        memset((void *)threadOffsets, 0, sizeof(threadOffsets));
+        rekeyRequest(params);
+        leaseBase = count;
+        printf("\nLease Key: %s\n", startKey.GetBase16().c_str());
+      }
+    }
+
+    saveResumeState(count);
+
     lastCount = count;
     lastGPUCount = gpuCount;
     t0 = t1;
 
   }
 
+  // Final snapshot so a clean stop resumes without any rescan
+  saveResumeState(getCPUCount() + getGPUCount() + savedTotalCount);
+
+  // All workers have ended, drain the pending candidates first so late
+  // hits still reach the result writer below
+  if (nbGPUThread > 0) {
+    verifierStop = true;
+    while (verifierRunning)
+      Timer::SleepMillis(10);
+  }
+
+  // Drain and stop the result writer
+  writerStop = true;
+  while (writerRunning)
+    Timer::SleepMillis(10);
+
   free(params);
 
 }
@@ -18,18 +18,33 @@
 #ifndef VANITYH
 #define VANITYH
 
+#include <stdio.h>
 #include <string>
 #include <vector>
 #include "SECP256k1.h"
 #include "StegoTarget.h"
+#include "PatternSet.h"
 #include "GPU/GPUEngine.h"
 #ifdef WIN64
 #include <Windows.h>
 #endif
 
+// Default CPU group size, the search loop is templated on the group size
+// and a startup calibration picks the fastest supported one (1024, 2048 or
+// 4096). The generator table covers the largest
 #define CPU_GRP_SIZE 1024
+#define CPU_GRP_SIZE_MAX 4096
 
+// Endomorphism/symmetry class selection (-classes). Every walked point is
+// checked as k, lambda.k, lambda2.k and their negations, 6 classes in total.
+// Bit e selects endomorphism e, bit e+3 its symmetric counterpart
+#define CLASS_BIT(endo,sym) (1 << ((endo) + ((sym) ? 3 : 0)))
+#define CLASS_ALL 0x3F
+
+class IntGroup;
+class ClusterWorker;
 class VanitySearch;
+struct RESUME_STATE;
 
 typedef struct {
 
@@ -38,13 +53,48 @@ typedef struct {
   bool isRunning;
   bool hasStarted;
   bool rekeyRequest;
-  int  gridSizeX;
-  int  gridSizeY;
-  int  gpuId;
+  std::vector<int> *gpuIds;     // All devices are driven by a single engine thread
+  std::vector<int> *gridSizes;  // 2 entries (x,y) per device
 
 } TH_PARAM;
 
 
+// Per thread key counter, padded to a full cache line: adjacent plain
+// uint64_t slots false-share and the resulting coherence traffic is
+// measurable from around a hundred worker threads. Each slot has a single
+// writer, relaxed atomic accesses are enough
+typedef struct alignas(64) {
+
+  volatile uint64_t count;
+
+} THREAD_COUNTER;
+
+
+// Found key record, pushed on a lock free MPSC stack and written to disk by
+// a dedicated writer thread (per hit fopen/fclose used to serialize workers)
+typedef struct OUTPUT_RECORD {
+
+  std::string addr;
+  std::string pAddr;
+  std::string pAddrHex;
+  struct OUTPUT_RECORD *next;
+
+} OUTPUT_RECORD;
+
+// Candidate reported by a GPU vanity kernel, queued for the batched verifier
+// thread. Checking a candidate costs a full scalar multiplication, doing it
+// inline in the GPU drain loop backs up the output queue after a rekey burst
+// or with permissive prefixes (see VerifyWorkerThread)
+typedef struct {
+
+  uint8_t hash160[20];
+  Int key;        // Base key snapshot, the pinned item buffer gets reused
+  int32_t incr;
+  int endo;
+  bool mode;
+
+} VERIFY_CANDIDATE;
+
 typedef struct {
 
   char *prefix;
@@ -63,6 +113,10 @@ typedef struct {
 typedef struct {
 
   std::vector<PREFIX_ITEM> *items;
+  // Flat copy of the items lPrefix, items are sorted on it (full address
+  // search only). checkAddr probes it 4 way with SSE so dense 16 bit slots
+  // cost no 20 byte compares on the miss path
+  std::vector<prefixl_t> lPrefixes;
   bool found;
 
 } PREFIX_TABLE_ITEM;
@@ -74,59 +128,90 @@ public:
   VanitySearch(Secp256K1 *secp, std::vector<std::string> &prefix, std::string seed, int searchMode,
                bool useGpu,bool stop,std::string outputFile, bool useSSE,uint32_t maxFound,uint64_t rekey,
                bool caseSensitive,Point &startPubKey,bool paranoiacSeed, StegoTarget *stegoTarget = NULL,
+               int nbStegoTarget = 1,
                bool sigMode = false, bool schnorrMode = false, Int *sigMsgHash = NULL, Int *sigPrivKey = NULL,
                Int *sigPubKeyX = NULL,
                bool txidMode = false, std::vector<uint8_t> rawTx = std::vector<uint8_t>(),
                int nonceOffset = 0, int nonceLen = 4,
-               bool taprootMode = false);
+               bool taprootMode = false,
+               bool persistentKernel = false,
+               std::string resumeFile = "",
+               int classMask = CLASS_ALL);
 
   void Search(int nbThread,std::vector<int> gpuId,std::vector<int> gridSize);
+  // Cluster worker mode (-worker), the coordinator assigns the key ranges
+  void SetClusterWorker(ClusterWorker *worker);
+  // Seed to base key derivation, shared with the cluster coordinator which
+  // hands out ranges relative to the same base
+  static Int ComputeBaseKey(std::string seed, bool paranoiacSeed);
   void FindKeyCPU(TH_PARAM *p);
   void FindKeyGPU(TH_PARAM *p);
+  void computeGPUStartingPoints(Int *keys, Point *p, int groupSize, int from, int to);
+  void OutputWriterThread();
+  void VerifyWorkerThread();
+  void computeVerifyPoints(VERIFY_CANDIDATE *cand, Point *p, int from, int to);
 
 private:
 
   std::string GetHex(std::vector<unsigned char> &buffer);
   std::string GetExpectedTime(double keyRate, double keyCount);
-  bool checkPrivKey(std::string addr, Int &key, int32_t incr, int endomorphism, bool mode);
-  void checkAddr(int prefIdx, uint8_t *hash160, Int &key, int32_t incr, int endomorphism, bool mode);
+  Int adjustedKey(Int &key, int32_t incr, int endomorphism);
+  bool checkPrivKey(std::string addr, Int &key, int32_t incr, int endomorphism, bool mode, Point *knownP = NULL);
+  void checkAddr(int prefIdx, uint8_t *hash160, Int &key, int32_t incr, int endomorphism, bool mode, Point *knownP = NULL);
+  void checkFullItem(int prefIdx, int idx, uint8_t *hash160, Int &key, int32_t incr, int endomorphism, bool mode, Point *knownP = NULL);
   void checkAddrSSE(uint8_t *h1, uint8_t *h2, uint8_t *h3, uint8_t *h4,
                     int32_t incr1, int32_t incr2, int32_t incr3, int32_t incr4,
                     Int &key, int endomorphism, bool mode);
+  void matchPatterns(std::string &addr, Int &key, int32_t incr, int endomorphism, bool mode, Point *knownP = NULL);
   void checkAddresses(bool compressed, Int key, int i, Point p1);
   void checkAddressesSSE(bool compressed, Int key, int i, Point p1, Point p2, Point p3, Point p4);
+  void checkAddressesBothSSE(Int key, int i, Point p1, Point p2, Point p3, Point p4);
+  void checkAddressesWide(bool compressed, Int key, int i, Point *p, int n);
+  void checkAddrWide(uint8_t (*h)[20], int n, Int &key, int i, bool negative, int endomorphism, bool compressed);
   void checkStegoMask(Int &key, int32_t incr, int endomorphism, Point &p);
   void checkStegoMaskAll(Int &key, int i, Point &p);
   void checkStegoMaskSSE(Int &key, int i, Point &p1, Point &p2, Point &p3, Point &p4);
   void output(std::string addr, std::string pAddr, std::string pAddrHex);
+  void writeRecord(FILE *f, OUTPUT_RECORD *r);
+  void loadResumeState();
+  void saveResumeState(uint64_t totalCount);
   bool isAlive(TH_PARAM *p);
   bool isSingularPrefix(std::string pref);
   bool hasStarted(TH_PARAM *p);
   void rekeyRequest(TH_PARAM *p);
   uint64_t getGPUCount();
   uint64_t getCPUCount();
+  void snapshotCounters(uint64_t *cpuCount, uint64_t *gpuCount);
   bool initPrefix(std::string &prefix, PREFIX_ITEM *it);
   void dumpPrefixes();
   double getDiffuclty();
   void updateFound();
   void getCPUStartingKey(int thId, Int& key, Point& startP);
+  template<int GRP_SIZE> void groupStep(IntGroup *grp, Int *dx, Point *pts, Point &startP);
+  template<int GRP_SIZE> void FindKeyCPUGrp(TH_PARAM *p);
+  template<int GRP_SIZE> double benchCpuGrpSize();
+  int calibrateCpuGrpSize();
   void getGPUStartingKeys(int thId, int groupSize, int nbThread, Int *keys, Point *p);
   void enumCaseUnsentivePrefix(std::string s, std::vector<std::string> &list);
   bool prefixMatch(char *prefix, char *addr);
 
   Secp256K1 *secp;
+  ClusterWorker *clusterWorker;
   Int startKey;
   Point startPubKey;
   bool startPubKeySpecified;
-  uint64_t counters[256];
+  THREAD_COUNTER counters[256];
   double startTime;
   int searchType;
   int searchMode;
+  int classMask;   // CLASS_BIT mask of the classes the CPU search checks
+  int nbClass;     // Key classes covered per walked point (counter increment)
   bool hasPattern;
   bool caseSensitive;
   bool useGpu;
   bool stopWhenFound;
   bool endOfSearch;
+  int cpuGrpSize;
   int nbCPUThread;
   int nbGPUThread;
   int nbFoundKey;
@@ -135,18 +220,46 @@ private:
   uint32_t nbPrefix;
   std::string outputFile;
   bool useSSE;
+  bool useAVX2;
+  bool useAVX512;
   bool onlyFull;
   uint32_t maxFound;
   double _difficulty;
   bool *patternFound;
+  // Combined wildcard matcher, all anchored patterns are evaluated in one
+  // scan per address (see PatternSet). patternSetIdx maps its bit positions
+  // back to inputPrefixes, patternGeneric lists the patterns it rejected
+  // (several '*'), those stay on Wildcard::match
+  PatternSet patternSet;
+  std::vector<int> patternSetIdx;
+  std::vector<int> patternGeneric;
+  // Asynchronous result writer
+  OUTPUT_RECORD *outputHead;
+  volatile bool writerRunning;
+  volatile bool writerStop;
+  // Batched GPU candidate verifier (see VerifyWorkerThread)
+  std::vector<VERIFY_CANDIDATE> verifyPending;
+  volatile bool verifierRunning;
+  volatile bool verifierStop;
+  // Checkpoint/resume (-resume), the state file is memory mapped and
+  // snapshotted from the stats loop, threadOffsets tracks the key advance
+  // of each worker since startKey
+  std::string resumeFile;
+  RESUME_STATE *resumeState;
+  int resumeSlot;
+  uint64_t savedTotalCount;
+  uint64_t threadOffsets[256];
+
   std::vector<PREFIX_TABLE_ITEM> prefixes;
   std::vector<prefix_t> usedPrefix;
   std::vector<LPREFIX> usedPrefixL;
   std::vector<std::string> &inputPrefixes;
   
-  // Steganography mode
+  // Steganography mode, stegoTargets holds all (value, mask) pairs for mask
+  // mode, stegoTarget is the first pair (sig/txid/taproot use a single one)
   bool stegoMode;
   StegoTarget stegoTarget;
+  std::vector<StegoTarget> stegoTargets;
 
   // Signature R-value grinding mode
   bool sigMode;
@@ -158,6 +271,9 @@ private:
   // Taproot post-tweak grinding mode
   bool taprootMode;
 
+  // Persistent GPU kernel mode (-pk)
+  bool persistentKernel;
+
   // TXID grinding mode
   bool txidMode;
   std::vector<uint8_t> rawTx;
@@ -171,8 +287,10 @@ private:
 
 #ifdef WIN64
   HANDLE ghMutex;
+  HANDLE verifyMutex;
 #else
   pthread_mutex_t  ghMutex;
+  pthread_mutex_t  verifyMutex;
 #endif
 
 };
@@ -431,6 +431,16 @@ void sha256(unsigned char *input, int length, unsigned char *digest) {
 
 }
 
+void sha256_midstate(unsigned char *input, int nbBlock, uint32_t *state) {
+
+  // Raw state (no padding, no finalization) after hashing nbBlock 64-byte
+  // blocks, used to resume hashing from a constant prefix
+  _sha256::Initialize(state);
+  for (int i = 0; i < nbBlock; i++)
+    _sha256::Transform(state, input + 64*i);
+
+}
+
 const uint8_t sizedesc_32[8] = { 0,0,0,0,0,0,1,0 };
 const uint8_t sizedesc_33[8] = { 0,0,0,0,0,0,1,8 };
 const uint8_t sizedesc_65[8] = { 0,0,0,0,0,0,2,8 };
@@ -21,6 +21,7 @@
 #include <cstdint>
 
 void sha256(uint8_t *input,int length, uint8_t *digest);
+void sha256_midstate(uint8_t *input, int nbBlock, uint32_t *state);
 void sha256_33(uint8_t *input, uint8_t *digest);
 void sha256_65(uint8_t *input, uint8_t *digest);
 void sha256_checksum(uint8_t *input, int length, uint8_t *checksum);
@@ -28,8 +29,16 @@ void sha256sse_1B(uint32_t *i0, uint32_t *i1, uint32_t *i2, uint32_t *i3,
   uint8_t *d0, uint8_t *d1, uint8_t *d2, uint8_t *d3);
 void sha256sse_2B(uint32_t *i0, uint32_t *i1, uint32_t *i2, uint32_t *i3,
   uint8_t *d0, uint8_t *d1, uint8_t *d2, uint8_t *d3);
+void sha256sse_33_65(uint32_t *u0, uint32_t *u1, uint32_t *u2, uint32_t *u3,
+  uint8_t p0, uint8_t p1, uint8_t p2, uint8_t p3,
+  uint8_t *dc0, uint8_t *dc1, uint8_t *dc2, uint8_t *dc3,
+  uint8_t *du0, uint8_t *du1, uint8_t *du2, uint8_t *du3);
 void sha256sse_checksum(uint32_t *i0, uint32_t *i1, uint32_t *i2, uint32_t *i3,
   uint8_t *d0, uint8_t *d1, uint8_t *d2, uint8_t *d3);
+void sha256avx2_1B(uint32_t *i[8], uint8_t *d[8]);
+void sha256avx2_2B(uint32_t *i[8], uint8_t *d[8]);
+void sha256avx512_1B(uint32_t *i[16], uint8_t *d[16]);
+void sha256avx512_2B(uint32_t *i[16], uint8_t *d[16]);
 std::string sha256_hex(unsigned char *digest);
 void sha256sse_test();
 
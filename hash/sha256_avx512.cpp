@@ -0,0 +1,263 @@
+/*
+ * This file is part of the VanitySearch distribution (https://github.com/JeanLucPons/VanitySearch).
+ * Copyright (c) 2019 Jean Luc PONS.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// 16 way SHA256 using AVX-512, same layout as the SSE2 implementation (sha256_sse.cpp)
+// but with 16 independent messages per transform.
+
+#include "sha256.h"
+#include <immintrin.h>
+#include <string.h>
+#include <stdint.h>
+
+namespace _sha256avx512
+{
+
+// AVX-512F provides a native 32 bit rotate and a 3-input logic instruction,
+// Maj/Ch/xor3 collapse to a single vpternlogd each
+#define Maj(b,c,d) _mm512_ternarylogic_epi32(b, c, d, 0xE8)
+#define Ch(b,c,d)  _mm512_ternarylogic_epi32(b, c, d, 0xCA)
+#define Xor3(a,b,c) _mm512_ternarylogic_epi32(a, b, c, 0x96)
+#define ROR(x,n)   _mm512_ror_epi32(x, n)
+#define SHR(x,n)   _mm512_srli_epi32(x, n)
+
+  /* SHA256 Functions */
+#define	S0(x) Xor3(ROR((x), 2) , ROR((x), 13), ROR((x), 22))
+#define	S1(x) Xor3(ROR((x), 6) , ROR((x), 11), ROR((x), 25))
+#define	s0(x) Xor3(ROR((x), 7) , ROR((x), 18), SHR((x), 3))
+#define	s1(x) Xor3(ROR((x), 17), ROR((x), 19), SHR((x), 10))
+
+#define add4(x0, x1, x2, x3) _mm512_add_epi32(_mm512_add_epi32(x0, x1), _mm512_add_epi32(x2, x3))
+#define add3(x0, x1, x2 ) _mm512_add_epi32(_mm512_add_epi32(x0, x1), x2)
+#define add5(x0, x1, x2, x3, x4) _mm512_add_epi32(add3(x0, x1, x2), _mm512_add_epi32(x3, x4))
+
+
+#define	Round(a, b, c, d, e, f, g, h, i, w)                    \
+    T1 = add5(h, S1(e), Ch(e, f, g), _mm512_set1_epi32(i), w); \
+    d = _mm512_add_epi32(d, T1);                               \
+    T2 = _mm512_add_epi32(S0(a), Maj(a, b, c));                \
+    h = _mm512_add_epi32(T1, T2);
+
+#define WMIX() \
+  w0 = add4(s1(w14), w9, s0(w1), w0); \
+  w1 = add4(s1(w15), w10, s0(w2), w1); \
+  w2 = add4(s1(w0), w11, s0(w3), w2); \
+  w3 = add4(s1(w1), w12, s0(w4), w3); \
+  w4 = add4(s1(w2), w13, s0(w5), w4); \
+  w5 = add4(s1(w3), w14, s0(w6), w5); \
+  w6 = add4(s1(w4), w15, s0(w7), w6); \
+  w7 = add4(s1(w5), w0, s0(w8), w7); \
+  w8 = add4(s1(w6), w1, s0(w9), w8); \
+  w9 = add4(s1(w7), w2, s0(w10), w9); \
+  w10 = add4(s1(w8), w3, s0(w11), w10); \
+  w11 = add4(s1(w9), w4, s0(w12), w11); \
+  w12 = add4(s1(w10), w5, s0(w13), w12); \
+  w13 = add4(s1(w11), w6, s0(w14), w13); \
+  w14 = add4(s1(w12), w7, s0(w15), w14); \
+  w15 = add4(s1(w13), w8, s0(w0), w15);
+
+// Lane 0 goes to the highest element, as in the SSE version
+#define LOADW(j) _mm512_set_epi32(blk[0][j], blk[1][j], blk[2][j], blk[3][j], \
+                                  blk[4][j], blk[5][j], blk[6][j], blk[7][j], \
+                                  blk[8][j], blk[9][j], blk[10][j], blk[11][j], \
+                                  blk[12][j], blk[13][j], blk[14][j], blk[15][j])
+
+  // Initialise state
+  void Initialize(__m512i *s) {
+    s[0] = _mm512_set1_epi32(0x6a09e667);
+    s[1] = _mm512_set1_epi32(0xbb67ae85);
+    s[2] = _mm512_set1_epi32(0x3c6ef372);
+    s[3] = _mm512_set1_epi32(0xa54ff53a);
+    s[4] = _mm512_set1_epi32(0x510e527f);
+    s[5] = _mm512_set1_epi32(0x9b05688c);
+    s[6] = _mm512_set1_epi32(0x1f83d9ab);
+    s[7] = _mm512_set1_epi32(0x5be0cd19);
+  }
+
+  // Perform 16 SHA in parallel using AVX-512
+  void Transform(__m512i *s, uint32_t *blk[16])
+  {
+    __m512i a,b,c,d,e,f,g,h;
+    __m512i w0, w1, w2, w3, w4, w5, w6, w7;
+    __m512i w8, w9, w10, w11, w12, w13, w14, w15;
+    __m512i T1, T2;
+
+    a = _mm512_load_si512(s + 0);
+    b = _mm512_load_si512(s + 1);
+    c = _mm512_load_si512(s + 2);
+    d = _mm512_load_si512(s + 3);
+    e = _mm512_load_si512(s + 4);
+    f = _mm512_load_si512(s + 5);
+    g = _mm512_load_si512(s + 6);
+    h = _mm512_load_si512(s + 7);
+
+    w0 = LOADW(0);
+    w1 = LOADW(1);
+    w2 = LOADW(2);
+    w3 = LOADW(3);
+    w4 = LOADW(4);
+    w5 = LOADW(5);
+    w6 = LOADW(6);
+    w7 = LOADW(7);
+    w8 = LOADW(8);
+    w9 = LOADW(9);
+    w10 = LOADW(10);
+    w11 = LOADW(11);
+    w12 = LOADW(12);
+    w13 = LOADW(13);
+    w14 = LOADW(14);
+    w15 = LOADW(15);
+
+    Round(a, b, c, d, e, f, g, h, 0x428A2F98, w0);
+    Round(h, a, b, c, d, e, f, g, 0x71374491, w1);
+    Round(g, h, a, b, c, d, e, f, 0xB5C0FBCF, w2);
+    Round(f, g, h, a, b, c, d, e, 0xE9B5DBA5, w3);
+    Round(e, f, g, h, a, b, c, d, 0x3956C25B, w4);
+    Round(d, e, f, g, h, a, b, c, 0x59F111F1, w5);
+    Round(c, d, e, f, g, h, a, b, 0x923F82A4, w6);
+    Round(b, c, d, e, f, g, h, a, 0xAB1C5ED5, w7);
+    Round(a, b, c, d, e, f, g, h, 0xD807AA98, w8);
+    Round(h, a, b, c, d, e, f, g, 0x12835B01, w9);
+    Round(g, h, a, b, c, d, e, f, 0x243185BE, w10);
+    Round(f, g, h, a, b, c, d, e, 0x550C7DC3, w11);
+    Round(e, f, g, h, a, b, c, d, 0x72BE5D74, w12);
+    Round(d, e, f, g, h, a, b, c, 0x80DEB1FE, w13);
+    Round(c, d, e, f, g, h, a, b, 0x9BDC06A7, w14);
+    Round(b, c, d, e, f, g, h, a, 0xC19BF174, w15);
+
+    WMIX()
+
+    Round(a, b, c, d, e, f, g, h, 0xE49B69C1, w0);
+    Round(h, a, b, c, d, e, f, g, 0xEFBE4786, w1);
+    Round(g, h, a, b, c, d, e, f, 0x0FC19DC6, w2);
+    Round(f, g, h, a, b, c, d, e, 0x240CA1CC, w3);
+    Round(e, f, g, h, a, b, c, d, 0x2DE92C6F, w4);
+    Round(d, e, f, g, h, a, b, c, 0x4A7484AA, w5);
+    Round(c, d, e, f, g, h, a, b, 0x5CB0A9DC, w6);
+    Round(b, c, d, e, f, g, h, a, 0x76F988DA, w7);
+    Round(a, b, c, d, e, f, g, h, 0x983E5152, w8);
+    Round(h, a, b, c, d, e, f, g, 0xA831C66D, w9);
+    Round(g, h, a, b, c, d, e, f, 0xB00327C8, w10);
+    Round(f, g, h, a, b, c, d, e, 0xBF597FC7, w11);
+    Round(e, f, g, h, a, b, c, d, 0xC6E00BF3, w12);
+    Round(d, e, f, g, h, a, b, c, 0xD5A79147, w13);
+    Round(c, d, e, f, g, h, a, b, 0x06CA6351, w14);
+    Round(b, c, d, e, f, g, h, a, 0x14292967, w15);
+
+    WMIX()
+
+    Round(a, b, c, d, e, f, g, h, 0x27B70A85, w0);
+    Round(h, a, b, c, d, e, f, g, 0x2E1B2138, w1);
+    Round(g, h, a, b, c, d, e, f, 0x4D2C6DFC, w2);
+    Round(f, g, h, a, b, c, d, e, 0x53380D13, w3);
+    Round(e, f, g, h, a, b, c, d, 0x650A7354, w4);
+    Round(d, e, f, g, h, a, b, c, 0x766A0ABB, w5);
+    Round(c, d, e, f, g, h, a, b, 0x81C2C92E, w6);
+    Round(b, c, d, e, f, g, h, a, 0x92722C85, w7);
+    Round(a, b, c, d, e, f, g, h, 0xA2BFE8A1, w8);
+    Round(h, a, b, c, d, e, f, g, 0xA81A664B, w9);
+    Round(g, h, a, b, c, d, e, f, 0xC24B8B70, w10);
+    Round(f, g, h, a, b, c, d, e, 0xC76C51A3, w11);
+    Round(e, f, g, h, a, b, c, d, 0xD192E819, w12);
+    Round(d, e, f, g, h, a, b, c, 0xD6990624, w13);
+    Round(c, d, e, f, g, h, a, b, 0xF40E3585, w14);
+    Round(b, c, d, e, f, g, h, a, 0x106AA070, w15);
+
+    WMIX()
+
+    Round(a, b, c, d, e, f, g, h, 0x19A4C116, w0);
+    Round(h, a, b, c, d, e, f, g, 0x1E376C08, w1);
+    Round(g, h, a, b, c, d, e, f, 0x2748774C, w2);
+    Round(f, g, h, a, b, c, d, e, 0x34B0BCB5, w3);
+    Round(e, f, g, h, a, b, c, d, 0x391C0CB3, w4);
+    Round(d, e, f, g, h, a, b, c, 0x4ED8AA4A, w5);
+    Round(c, d, e, f, g, h, a, b, 0x5B9CCA4F, w6);
+    Round(b, c, d, e, f, g, h, a, 0x682E6FF3, w7);
+    Round(a, b, c, d, e, f, g, h, 0x748F82EE, w8);
+    Round(h, a, b, c, d, e, f, g, 0x78A5636F, w9);
+    Round(g, h, a, b, c, d, e, f, 0x84C87814, w10);
+    Round(f, g, h, a, b, c, d, e, 0x8CC70208, w11);
+    Round(e, f, g, h, a, b, c, d, 0x90BEFFFA, w12);
+    Round(d, e, f, g, h, a, b, c, 0xA4506CEB, w13);
+    Round(c, d, e, f, g, h, a, b, 0xBEF9A3F7, w14);
+    Round(b, c, d, e, f, g, h, a, 0xC67178F2, w15);
+
+    s[0] = _mm512_add_epi32(a, s[0]);
+    s[1] = _mm512_add_epi32(b, s[1]);
+    s[2] = _mm512_add_epi32(c, s[2]);
+    s[3] = _mm512_add_epi32(d, s[3]);
+    s[4] = _mm512_add_epi32(e, s[4]);
+    s[5] = _mm512_add_epi32(f, s[5]);
+    s[6] = _mm512_add_epi32(g, s[6]);
+    s[7] = _mm512_add_epi32(h, s[7]);
+
+  }
+
+#undef LOADW
+
+} // end namespace
+
+// Depack state, lane l of message i lives in element 15-i (see LOADW)
+static void depack16(__m512i *s, uint8_t *d[16]) {
+
+#ifdef WIN64
+  __declspec(align(64)) uint32_t s32[8][16];
+#else
+  uint32_t s32[8][16] __attribute__((aligned(64)));
+#endif
+
+  for (int j = 0; j < 8; j++)
+    _mm512_store_si512((__m512i *)s32[j], s[j]);
+
+  for (int i = 0; i < 16; i++) {
+    uint32_t *o = (uint32_t *)d[i];
+    for (int j = 0; j < 8; j++) {
+#ifdef WIN64
+      o[j] = _byteswap_ulong(s32[j][15 - i]);
+#else
+      o[j] = __builtin_bswap32(s32[j][15 - i]);
+#endif
+    }
+  }
+
+}
+
+void sha256avx512_1B(uint32_t *i[16], uint8_t *d[16]) {
+
+  __m512i s[8];
+
+  _sha256avx512::Initialize(s);
+  _sha256avx512::Transform(s, i);
+
+  depack16(s, d);
+
+}
+
+void sha256avx512_2B(uint32_t *i[16], uint8_t *d[16]) {
+
+  __m512i s[8];
+  uint32_t *i2[16];
+
+  for (int k = 0; k < 16; k++)
+    i2[k] = i[k] + 16;
+
+  _sha256avx512::Initialize(s);
+  _sha256avx512::Transform(s, i);
+  _sha256avx512::Transform(s, i2);
+
+  depack16(s, d);
+
+}
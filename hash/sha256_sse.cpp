@@ -421,6 +421,195 @@ namespace _sha256sse
 
   }
 
+#define Round2(a, b, c, d, e, f, g, h, i, w)                          \
+    Round(a##A, b##A, c##A, d##A, e##A, f##A, g##A, h##A, i, w##A)    \
+    Round(a##B, b##B, c##B, d##B, e##B, f##B, g##B, h##B, i, w##B)
+
+#define WMIXSFX(S) \
+  w0##S = add4(s1(w14##S), w9##S, s0(w1##S), w0##S); \
+  w1##S = add4(s1(w15##S), w10##S, s0(w2##S), w1##S); \
+  w2##S = add4(s1(w0##S), w11##S, s0(w3##S), w2##S); \
+  w3##S = add4(s1(w1##S), w12##S, s0(w4##S), w3##S); \
+  w4##S = add4(s1(w2##S), w13##S, s0(w5##S), w4##S); \
+  w5##S = add4(s1(w3##S), w14##S, s0(w6##S), w5##S); \
+  w6##S = add4(s1(w4##S), w15##S, s0(w7##S), w6##S); \
+  w7##S = add4(s1(w5##S), w0##S, s0(w8##S), w7##S); \
+  w8##S = add4(s1(w6##S), w1##S, s0(w9##S), w8##S); \
+  w9##S = add4(s1(w7##S), w2##S, s0(w10##S), w9##S); \
+  w10##S = add4(s1(w8##S), w3##S, s0(w11##S), w10##S); \
+  w11##S = add4(s1(w9##S), w4##S, s0(w12##S), w11##S); \
+  w12##S = add4(s1(w10##S), w5##S, s0(w13##S), w12##S); \
+  w13##S = add4(s1(w11##S), w6##S, s0(w14##S), w13##S); \
+  w14##S = add4(s1(w12##S), w7##S, s0(w15##S), w14##S); \
+  w15##S = add4(s1(w13##S), w8##S, s0(w0##S), w15##S);
+
+#define WMIX2() WMIXSFX(A) WMIXSFX(B)
+
+  // Process the compressed single block (state A) and the first uncompressed
+  // block (state B) together. Both blocks carry the X coordinate in bytes
+  // 1..32, so the shared words are loaded once and the compressed block is
+  // derived in registers from the uncompressed one; the two independent
+  // round chains also interleave and hide each other's latency
+  void TransformBoth(__m128i *sA, __m128i *sB,
+                     uint32_t *u0, uint32_t *u1, uint32_t *u2, uint32_t *u3,
+                     uint8_t p0, uint8_t p1, uint8_t p2, uint8_t p3)
+  {
+    __m128i aA, bA, cA, dA, eA, fA, gA, hA;
+    __m128i aB, bB, cB, dB, eB, fB, gB, hB;
+    __m128i w0A, w1A, w2A, w3A, w4A, w5A, w6A, w7A;
+    __m128i w8A, w9A, w10A, w11A, w12A, w13A, w14A, w15A;
+    __m128i w0B, w1B, w2B, w3B, w4B, w5B, w6B, w7B;
+    __m128i w8B, w9B, w10B, w11B, w12B, w13B, w14B, w15B;
+    __m128i T1, T2;
+
+    aA = _mm_load_si128(sA + 0);
+    bA = _mm_load_si128(sA + 1);
+    cA = _mm_load_si128(sA + 2);
+    dA = _mm_load_si128(sA + 3);
+    eA = _mm_load_si128(sA + 4);
+    fA = _mm_load_si128(sA + 5);
+    gA = _mm_load_si128(sA + 6);
+    hA = _mm_load_si128(sA + 7);
+
+    aB = _mm_load_si128(sB + 0);
+    bB = _mm_load_si128(sB + 1);
+    cB = _mm_load_si128(sB + 2);
+    dB = _mm_load_si128(sB + 3);
+    eB = _mm_load_si128(sB + 4);
+    fB = _mm_load_si128(sB + 5);
+    gB = _mm_load_si128(sB + 6);
+    hB = _mm_load_si128(sB + 7);
+
+    // Word 0: 0x04 | X[0..2] becomes 0x02/0x03 | X[0..2]
+    w0B = _mm_set_epi32(u0[0], u1[0], u2[0], u3[0]);
+    w0A = _mm_or_si128(_mm_and_si128(w0B, _mm_set1_epi32(0x00FFFFFF)),
+                       _mm_set_epi32((uint32_t)p0 << 24, (uint32_t)p1 << 24,
+                                     (uint32_t)p2 << 24, (uint32_t)p3 << 24));
+
+    // Words 1..7 (X[3..30]) are identical in both serializations
+    w1B = _mm_set_epi32(u0[1], u1[1], u2[1], u3[1]); w1A = w1B;
+    w2B = _mm_set_epi32(u0[2], u1[2], u2[2], u3[2]); w2A = w2B;
+    w3B = _mm_set_epi32(u0[3], u1[3], u2[3], u3[3]); w3A = w3B;
+    w4B = _mm_set_epi32(u0[4], u1[4], u2[4], u3[4]); w4A = w4B;
+    w5B = _mm_set_epi32(u0[5], u1[5], u2[5], u3[5]); w5A = w5B;
+    w6B = _mm_set_epi32(u0[6], u1[6], u2[6], u3[6]); w6A = w6B;
+    w7B = _mm_set_epi32(u0[7], u1[7], u2[7], u3[7]); w7A = w7B;
+
+    // Word 8: X[31] | Y[0..2] becomes X[31] | 0x80 padding
+    w8B = _mm_set_epi32(u0[8], u1[8], u2[8], u3[8]);
+    w8A = _mm_or_si128(_mm_and_si128(w8B, _mm_set1_epi32(0xFF000000)),
+                       _mm_set1_epi32(0x00800000));
+
+    w9B = _mm_set_epi32(u0[9], u1[9], u2[9], u3[9]);
+    w10B = _mm_set_epi32(u0[10], u1[10], u2[10], u3[10]);
+    w11B = _mm_set_epi32(u0[11], u1[11], u2[11], u3[11]);
+    w12B = _mm_set_epi32(u0[12], u1[12], u2[12], u3[12]);
+    w13B = _mm_set_epi32(u0[13], u1[13], u2[13], u3[13]);
+    w14B = _mm_set_epi32(u0[14], u1[14], u2[14], u3[14]);
+    w15B = _mm_set_epi32(u0[15], u1[15], u2[15], u3[15]);
+
+    w9A = _mm_setzero_si128();
+    w10A = _mm_setzero_si128();
+    w11A = _mm_setzero_si128();
+    w12A = _mm_setzero_si128();
+    w13A = _mm_setzero_si128();
+    w14A = _mm_setzero_si128();
+    w15A = _mm_set1_epi32(0x108);
+
+    Round2(a, b, c, d, e, f, g, h, 0x428A2F98, w0);
+    Round2(h, a, b, c, d, e, f, g, 0x71374491, w1);
+    Round2(g, h, a, b, c, d, e, f, 0xB5C0FBCF, w2);
+    Round2(f, g, h, a, b, c, d, e, 0xE9B5DBA5, w3);
+    Round2(e, f, g, h, a, b, c, d, 0x3956C25B, w4);
+    Round2(d, e, f, g, h, a, b, c, 0x59F111F1, w5);
+    Round2(c, d, e, f, g, h, a, b, 0x923F82A4, w6);
+    Round2(b, c, d, e, f, g, h, a, 0xAB1C5ED5, w7);
+    Round2(a, b, c, d, e, f, g, h, 0xD807AA98, w8);
+    Round2(h, a, b, c, d, e, f, g, 0x12835B01, w9);
+    Round2(g, h, a, b, c, d, e, f, 0x243185BE, w10);
+    Round2(f, g, h, a, b, c, d, e, 0x550C7DC3, w11);
+    Round2(e, f, g, h, a, b, c, d, 0x72BE5D74, w12);
+    Round2(d, e, f, g, h, a, b, c, 0x80DEB1FE, w13);
+    Round2(c, d, e, f, g, h, a, b, 0x9BDC06A7, w14);
+    Round2(b, c, d, e, f, g, h, a, 0xC19BF174, w15);
+
+    WMIX2()
+
+    Round2(a, b, c, d, e, f, g, h, 0xE49B69C1, w0);
+    Round2(h, a, b, c, d, e, f, g, 0xEFBE4786, w1);
+    Round2(g, h, a, b, c, d, e, f, 0x0FC19DC6, w2);
+    Round2(f, g, h, a, b, c, d, e, 0x240CA1CC, w3);
+    Round2(e, f, g, h, a, b, c, d, 0x2DE92C6F, w4);
+    Round2(d, e, f, g, h, a, b, c, 0x4A7484AA, w5);
+    Round2(c, d, e, f, g, h, a, b, 0x5CB0A9DC, w6);
+    Round2(b, c, d, e, f, g, h, a, 0x76F988DA, w7);
+    Round2(a, b, c, d, e, f, g, h, 0x983E5152, w8);
+    Round2(h, a, b, c, d, e, f, g, 0xA831C66D, w9);
+    Round2(g, h, a, b, c, d, e, f, 0xB00327C8, w10);
+    Round2(f, g, h, a, b, c, d, e, 0xBF597FC7, w11);
+    Round2(e, f, g, h, a, b, c, d, 0xC6E00BF3, w12);
+    Round2(d, e, f, g, h, a, b, c, 0xD5A79147, w13);
+    Round2(c, d, e, f, g, h, a, b, 0x06CA6351, w14);
+    Round2(b, c, d, e, f, g, h, a, 0x14292967, w15);
+
+    WMIX2()
+
+    Round2(a, b, c, d, e, f, g, h, 0x27B70A85, w0);
+    Round2(h, a, b, c, d, e, f, g, 0x2E1B2138, w1);
+    Round2(g, h, a, b, c, d, e, f, 0x4D2C6DFC, w2);
+    Round2(f, g, h, a, b, c, d, e, 0x53380D13, w3);
+    Round2(e, f, g, h, a, b, c, d, 0x650A7354, w4);
+    Round2(d, e, f, g, h, a, b, c, 0x766A0ABB, w5);
+    Round2(c, d, e, f, g, h, a, b, 0x81C2C92E, w6);
+    Round2(b, c, d, e, f, g, h, a, 0x92722C85, w7);
+    Round2(a, b, c, d, e, f, g, h, 0xA2BFE8A1, w8);
+    Round2(h, a, b, c, d, e, f, g, 0xA81A664B, w9);
+    Round2(g, h, a, b, c, d, e, f, 0xC24B8B70, w10);
+    Round2(f, g, h, a, b, c, d, e, 0xC76C51A3, w11);
+    Round2(e, f, g, h, a, b, c, d, 0xD192E819, w12);
+    Round2(d, e, f, g, h, a, b, c, 0xD6990624, w13);
+    Round2(c, d, e, f, g, h, a, b, 0xF40E3585, w14);
+    Round2(b, c, d, e, f, g, h, a, 0x106AA070, w15);
+
+    WMIX2()
+
+    Round2(a, b, c, d, e, f, g, h, 0x19A4C116, w0);
+    Round2(h, a, b, c, d, e, f, g, 0x1E376C08, w1);
+    Round2(g, h, a, b, c, d, e, f, 0x2748774C, w2);
+    Round2(f, g, h, a, b, c, d, e, 0x34B0BCB5, w3);
+    Round2(e, f, g, h, a, b, c, d, 0x391C0CB3, w4);
+    Round2(d, e, f, g, h, a, b, c, 0x4ED8AA4A, w5);
+    Round2(c, d, e, f, g, h, a, b, 0x5B9CCA4F, w6);
+    Round2(b, c, d, e, f, g, h, a, 0x682E6FF3, w7);
+    Round2(a, b, c, d, e, f, g, h, 0x748F82EE, w8);
+    Round2(h, a, b, c, d, e, f, g, 0x78A5636F, w9);
+    Round2(g, h, a, b, c, d, e, f, 0x84C87814, w10);
+    Round2(f, g, h, a, b, c, d, e, 0x8CC70208, w11);
+    Round2(e, f, g, h, a, b, c, d, 0x90BEFFFA, w12);
+    Round2(d, e, f, g, h, a, b, c, 0xA4506CEB, w13);
+    Round2(c, d, e, f, g, h, a, b, 0xBEF9A3F7, w14);
+    Round2(b, c, d, e, f, g, h, a, 0xC67178F2, w15);
+
+    sA[0] = _mm_add_epi32(aA, sA[0]);
+    sA[1] = _mm_add_epi32(bA, sA[1]);
+    sA[2] = _mm_add_epi32(cA, sA[2]);
+    sA[3] = _mm_add_epi32(dA, sA[3]);
+    sA[4] = _mm_add_epi32(eA, sA[4]);
+    sA[5] = _mm_add_epi32(fA, sA[5]);
+    sA[6] = _mm_add_epi32(gA, sA[6]);
+    sA[7] = _mm_add_epi32(hA, sA[7]);
+
+    sB[0] = _mm_add_epi32(aB, sB[0]);
+    sB[1] = _mm_add_epi32(bB, sB[1]);
+    sB[2] = _mm_add_epi32(cB, sB[2]);
+    sB[3] = _mm_add_epi32(dB, sB[3]);
+    sB[4] = _mm_add_epi32(eB, sB[4]);
+    sB[5] = _mm_add_epi32(fB, sB[5]);
+    sB[6] = _mm_add_epi32(gB, sB[6]);
+    sB[7] = _mm_add_epi32(hB, sB[7]);
+
+  }
+
 } // end namespace
 
 void sha256sse_1B(
@@ -553,6 +742,91 @@ void sha256sse_2B(
 
 }
 
+// Transpose the 4 lane state back to 4 contiguous 32 byte digests
+static void sha256sse_unpack(__m128i *s,
+  unsigned char *d0, unsigned char *d1, unsigned char *d2, unsigned char *d3) {
+
+  __m128i mask = _mm_set_epi8(12, 13, 14, 15, /**/ 4, 5, 6, 7,  /**/ 8, 9, 10, 11,  /**/ 0, 1, 2, 3);
+
+  __m128i u0 = _mm_unpacklo_epi32(s[0], s[1]);   // S2_1 S2_0 S3_1 S3_0
+  __m128i u1 = _mm_unpackhi_epi32(s[0], s[1]);   // S0_1 S0_0 S1_1 S1_0
+
+  __m128i u2 = _mm_unpacklo_epi32(s[2], s[3]);   // S2_3 S2_2 S3_3 S3_2
+  __m128i u3 = _mm_unpackhi_epi32(s[2], s[3]);   // S0_3 S0_2 S1_3 S1_2
+
+  __m128i _d3 = _mm_unpacklo_epi32(u0, u2);      // S3_3 S3_1 S3_2 S3_0
+  __m128i _d2 = _mm_unpackhi_epi32(u0, u2);      // S2_3 S2_1 S2_2 S2_0
+  __m128i _d1 = _mm_unpacklo_epi32(u1, u3);      // S1_3 S1_1 S1_2 S1_0
+  __m128i _d0 = _mm_unpackhi_epi32(u1, u3);      // S0_3 S0_1 S0_2 S0_0
+
+  _d0 = _mm_shuffle_epi8(_d0, mask);
+  _d1 = _mm_shuffle_epi8(_d1, mask);
+  _d2 = _mm_shuffle_epi8(_d2, mask);
+  _d3 = _mm_shuffle_epi8(_d3, mask);
+
+  _mm_store_si128((__m128i *)d0, _d0);
+  _mm_store_si128((__m128i *)d1, _d1);
+  _mm_store_si128((__m128i *)d2, _d2);
+  _mm_store_si128((__m128i *)d3, _d3);
+
+  u0 = _mm_unpacklo_epi32(s[4], s[5]);
+  u1 = _mm_unpackhi_epi32(s[4], s[5]);
+
+  u2 = _mm_unpacklo_epi32(s[6], s[7]);
+  u3 = _mm_unpackhi_epi32(s[6], s[7]);
+
+  _d3 = _mm_unpacklo_epi32(u0, u2);
+  _d2 = _mm_unpackhi_epi32(u0, u2);
+  _d1 = _mm_unpacklo_epi32(u1, u3);
+  _d0 = _mm_unpackhi_epi32(u1, u3);
+
+  _d0 = _mm_shuffle_epi8(_d0, mask);
+  _d1 = _mm_shuffle_epi8(_d1, mask);
+  _d2 = _mm_shuffle_epi8(_d2, mask);
+  _d3 = _mm_shuffle_epi8(_d3, mask);
+
+  _mm_store_si128((__m128i *)(d0 + 16), _d0);
+  _mm_store_si128((__m128i *)(d1 + 16), _d1);
+  _mm_store_si128((__m128i *)(d2 + 16), _d2);
+  _mm_store_si128((__m128i *)(d3 + 16), _d3);
+
+}
+
+// Fused both mode hashing: the compressed (33 byte) digests and the
+// uncompressed (65 byte) digests of 4 public keys in one call. Only the
+// uncompressed serializations are read, the compressed block shares its X
+// words and is rebuilt in registers, p0..p3 are the 0x02/0x03 parity bytes
+void sha256sse_33_65(
+  uint32_t *u0,
+  uint32_t *u1,
+  uint32_t *u2,
+  uint32_t *u3,
+  uint8_t p0,
+  uint8_t p1,
+  uint8_t p2,
+  uint8_t p3,
+  unsigned char *dc0,
+  unsigned char *dc1,
+  unsigned char *dc2,
+  unsigned char *dc3,
+  unsigned char *du0,
+  unsigned char *du1,
+  unsigned char *du2,
+  unsigned char *du3) {
+
+  __m128i sA[8];
+  __m128i sB[8];
+
+  _sha256sse::Initialize(sA);
+  _sha256sse::Initialize(sB);
+  _sha256sse::TransformBoth(sA, sB, u0, u1, u2, u3, p0, p1, p2, p3);
+  _sha256sse::Transform(sB, u0 + 16, u1 + 16, u2 + 16, u3 + 16);
+
+  sha256sse_unpack(sA, dc0, dc1, dc2, dc3);
+  sha256sse_unpack(sB, du0, du1, du2, du3);
+
+}
+
 void sha256sse_checksum(uint32_t *i0, uint32_t *i1, uint32_t *i2, uint32_t *i3,
   uint8_t *d0, uint8_t *d1, uint8_t *d2, uint8_t *d3) {
 
@@ -19,6 +19,9 @@
 #include "Vanity.h"
 #include "SECP256k1.h"
 #include "StegoTarget.h"
+#include "Bench.h"
+#include "Cluster.h"
+#include "Stats.h"
 #include <fstream>
 #include <string>
 #include <string.h>
@@ -26,6 +29,12 @@
 #include <cmath>
 #include "hash/sha512.h"
 #include "hash/sha256.h"
+#ifndef WIN64
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 #define RELEASE "1.19"
 
@@ -38,8 +47,9 @@ void printUsage() {
   printf("VanitySeacrh [-check] [-v] [-u] [-b] [-c] [-gpu] [-stop] [-i inputfile]\n");
   printf("             [-gpuId gpuId1[,gpuId2,...]] [-g g1x,g1y,[,g2x,g2y,...]]\n");
   printf("             [-o outputfile] [-m maxFound] [-ps seed] [-s seed] [-t nbThread]\n");
-  printf("             [-nosse] [-r rekey] [-check] [-kp] [-sp startPubKey]\n");
+  printf("             [-nosse] [-r rekey] [-classes mask] [-check] [-kp] [-sp startPubKey]\n");
   printf("             [-rp privkey partialkeyfile] [prefix]\n");
+  printf("             [-coordinator port] [-worker host:port] [-lease n]\n");
   printf("             [-mask -tx <target_hex> [-mx <mask_hex>] [--prefix <n>]]\n");
   printf("             [-sig -tx <target_hex> -z <msghash> -d <privkey> [--schnorr] [-p <pubkey_x>]]\n");
   printf("             [-taproot -tx <target_hex> [--prefix <n>]]\n\n");
@@ -52,8 +62,11 @@ void printUsage() {
   printf(" -stop: Stop when all prefixes are found\n");
   printf(" -i inputfile: Get list of prefixes to search from specified file\n");
   printf(" -o outputfile: Output results to the specified file\n");
+  printf(" -stats statsfile: Append per stage timing rows (CSV) to statsfile while searching\n");
   printf(" -gpu gpuId1,gpuId2,...: List of GPU(s) to use, default is 0\n");
-  printf(" -g g1x,g1y,g2x,g2y, ...: Specify GPU(s) kernel gridsize, default is 8*(MP number),128\n");
+  printf(" -g g1x,g1y,g2x,g2y, ...: Specify GPU(s) kernel gridsize, default is autotuned (cached in vanitysearch.tune)\n");
+  printf(" -pk: Persistent GPU kernel, the grid loops device side to reduce launch overhead\n");
+  printf(" -resume <file>: Periodically checkpoint the search state to <file> and resume from it\n");
   printf(" -m: Specify maximun number of prefixes found by each kernel call\n");
   printf(" -s seed: Specify a seed for the base key, default is random\n");
   printf(" -ps seed: Specify a seed concatened with a crypto secure random seed\n");
@@ -61,16 +74,22 @@ void printUsage() {
   printf(" -nosse: Disable SSE hash function\n");
   printf(" -l: List cuda enabled devices\n");
   printf(" -check: Check CPU and GPU kernel vs CPU\n");
+  printf(" -bench: Benchmark each engine and print a CSV report (JSON to the -o file)\n");
   printf(" -cp privKey: Compute public key (privKey in hex hormat)\n");
   printf(" -ca pubKey: Compute address (pubKey in hex hormat)\n");
   printf(" -kp: Generate key pair\n");
   printf(" -rp privkey partialkeyfile: Reconstruct final private key(s) from partial key(s) info.\n");
   printf(" -sp startPubKey: Start the search with a pubKey (for private key splitting)\n");
   printf(" -r rekey: Rekey interval in MegaKey, default is disabled\n");
+  printf(" -classes mask: Bitmask of endomorphism/symmetry classes checked by the CPU search,\n");
+  printf("                bit e = endomorphism e, bit e+3 its symmetric point, default 0x3F (all 6)\n");
+  printf(" -coordinator port: Run as cluster coordinator, lease key ranges to workers (use with -s)\n");
+  printf(" -worker host:port: Run as cluster worker, get key ranges from a coordinator\n");
+  printf(" -lease n: Lease budget in MegaKey handed to each worker, default is 100000\n");
   printf("\nPubkey mask mode:\n");
   printf(" -mask: Enable pubkey coordinate masking (match raw X coordinate)\n");
-  printf(" -tx <hex>: Target value for X coordinate (hex, up to 64 chars)\n");
-  printf(" -mx <hex>: Mask for X coordinate (1=check, 0=ignore)\n");
+  printf(" -tx <hex[,hex,...]>: Target value(s) for X coordinate (hex, up to 64 chars each)\n");
+  printf(" -mx <hex[,hex,...]>: Mask(s) for X coordinate (1=check, 0=ignore)\n");
   printf(" --prefix <n>: Match first N bytes of X (auto-generates mask)\n");
   printf("\nSignature R-value grinding mode:\n");
   printf(" -sig: Enable signature mode (grind for nonce k where R.x matches target)\n");
@@ -147,48 +166,118 @@ void getInts(string name,vector<int> &tokens, const string &text, char sep) {
 
 // ------------------------------------------------------------------------------------------
 
+void getStrings(vector<string> &tokens, const string &text, char sep) {
+
+  size_t start = 0, end = 0;
+  tokens.clear();
+
+  while ((end = text.find(sep, start)) != string::npos) {
+    tokens.push_back(text.substr(start, end - start));
+    start = end + 1;
+  }
+
+  tokens.push_back(text.substr(start));
+
+}
+
+// ------------------------------------------------------------------------------------------
+
 void parseFile(string fileName, vector<string> &lines) {
 
-  // Get file size
-  FILE *fp = fopen(fileName.c_str(), "rb");
-  if (fp == NULL) {
+  // Map the file and scan it in place, the old getline loop paid stream
+  // overhead and vector regrowth on every line which took minutes on multi
+  // million address files
+#ifdef WIN64
+  HANDLE hFile = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                             NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (hFile == INVALID_HANDLE_VALUE) {
+    printf("Error: Cannot open %s\n", fileName.c_str());
+    exit(-1);
+  }
+  size_t sz = (size_t)GetFileSize(hFile, NULL);
+  if (sz == 0) {
+    CloseHandle(hFile);
+    return;
+  }
+  HANDLE hMap = CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+  CloseHandle(hFile);
+  const char *map = NULL;
+  if (hMap != NULL) {
+    map = (const char *)MapViewOfFile(hMap, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(hMap);
+  }
+  if (map == NULL) {
+    printf("Error: Cannot map %s\n", fileName.c_str());
+    exit(-1);
+  }
+#else
+  int fd = open(fileName.c_str(), O_RDONLY);
+  if (fd < 0) {
     printf("Error: Cannot open %s %s\n", fileName.c_str(), strerror(errno));
     exit(-1);
   }
-  fseek(fp, 0L, SEEK_END);
-  size_t sz = ftell(fp);
-  size_t nbAddr = sz / 33; /* Upper approximation */
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    printf("Error: Cannot stat %s %s\n", fileName.c_str(), strerror(errno));
+    close(fd);
+    exit(-1);
+  }
+  size_t sz = (size_t)st.st_size;
+  if (sz == 0) {
+    close(fd);
+    return;
+  }
+  const char *map = (const char *)mmap(NULL, sz, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    printf("Error: Cannot map %s %s\n", fileName.c_str(), strerror(errno));
+    exit(-1);
+  }
+#endif
+
   bool loaddingProgress = sz > 100000;
-  fclose(fp);
 
-  // Parse file
-  int nbLine = 0;
-  string line;
-  ifstream inFile(fileName);
-  lines.reserve(nbAddr);
-  while (getline(inFile, line)) {
+  // Count the lines first so the vector is allocated once at its final size
+  size_t nbLine = 0;
+  for (size_t i = 0; i < sz; i++)
+    if (map[i] == '\n')
+      nbLine++;
+  if (map[sz - 1] != '\n')
+    nbLine++;
+  lines.reserve(lines.size() + nbLine);
+
+  size_t start = 0;
+  size_t done = 0;
+  while (start < sz) {
+
+    size_t end = start;
+    while (end < sz && map[end] != '\n')
+      end++;
 
     // Remove ending \r\n
-    int l = (int)line.length() - 1;
-    while (l >= 0 && isspace(line.at(l))) {
-      line.pop_back();
-      l--;
-    }
+    size_t stop = end;
+    while (stop > start && isspace((unsigned char)map[stop - 1]))
+      stop--;
 
-    if (line.length() > 0) {
-      lines.push_back(line);
-      nbLine++;
-      if (loaddingProgress) {
-        if ((nbLine % 50000) == 0)
-          printf("[Loading input file %5.1f%%]\r", ((double)nbLine*100.0) / ((double)(nbAddr)*33.0 / 34.0));
-      }
-    }
+    if (stop > start)
+      lines.push_back(string(map + start, stop - start));
+
+    start = end + 1;
+    done++;
+    if (loaddingProgress && (done % 1000000) == 0)
+      printf("[Loading input file %5.1f%%]\r", ((double)done * 100.0) / (double)nbLine);
 
   }
 
   if (loaddingProgress)
     printf("[Loading input file 100.0%%]\n");
 
+#ifdef WIN64
+  UnmapViewOfFile((void *)map);
+#else
+  munmap((void *)map, sz);
+#endif
+
 }
 
 // ------------------------------------------------------------------------------------------
@@ -400,6 +489,14 @@ int main(int argc, char* argv[]) {
   // Global Init
   Timer::Init();
   rseed(Timer::getSeed32());
+  {
+    // Seed the ChaCha20 bulk generator used by the rekey paths
+    string bulkSeed = Timer::getSeed(32);
+    unsigned char bulkKey[32];
+    for (int i = 0; i < 32; i++)
+      bulkKey[i] = (unsigned char)strtoul(bulkSeed.substr(2 * i, 2).c_str(), NULL, 16);
+    rseedBulk(bulkKey);
+  }
 
   // Init SecpK1
   Secp256K1 *secp = new Secp256K1();
@@ -430,6 +527,12 @@ int main(int argc, char* argv[]) {
   bool startPubKeyCompressed;
   bool caseSensitive = true;
   bool paranoiacSeed = false;
+
+  // Cluster mode variables
+  int coordinatorPort = 0;
+  string workerHost = "";
+  int workerPort = 0;
+  uint64_t leaseMKeys = 100000;
   
   // Steganography mode variables
   bool stegoMode = false;
@@ -438,6 +541,7 @@ int main(int argc, char* argv[]) {
   int stegoPrefixBytes = 0;
   StegoTarget stegoTarget;
   memset(&stegoTarget, 0, sizeof(stegoTarget));
+  vector<StegoTarget> stegoTargets;
 
   // Signature R-value grinding mode variables
   bool sigMode = false;
@@ -454,6 +558,9 @@ int main(int argc, char* argv[]) {
   string rawTxHex = "";
   int nonceOffset = -1;  // -1 = auto (last 4 bytes = nLockTime)
   int nonceLen = 4;      // default 4 bytes
+  bool persistentKernel = false;
+  string resumeFile = "";
+  int classMask = CLASS_ALL;
 
   while (a < argc) {
 
@@ -467,6 +574,42 @@ int main(int argc, char* argv[]) {
     } else if (strcmp(argv[a], "-stop") == 0) {
       stop = true;
       a++;
+    } else if (strcmp(argv[a], "-pk") == 0) {
+      persistentKernel = true;
+      a++;
+    } else if (strcmp(argv[a], "-resume") == 0) {
+      a++;
+      resumeFile = string(argv[a]);
+      a++;
+    } else if (strcmp(argv[a], "-coordinator") == 0) {
+      a++;
+      coordinatorPort = getInt("coordinator", argv[a]);
+      a++;
+    } else if (strcmp(argv[a], "-worker") == 0) {
+      a++;
+      {
+        string w = string(argv[a]);
+        size_t sep = w.rfind(':');
+        if (sep == string::npos) {
+          printf("Invalid -worker argument, expected host:port\n");
+          exit(-1);
+        }
+        workerHost = w.substr(0, sep);
+        workerPort = getInt("worker", (char *)w.c_str() + sep + 1);
+      }
+      a++;
+    } else if (strcmp(argv[a], "-lease") == 0) {
+      a++;
+      leaseMKeys = (uint64_t)getInt("lease", argv[a]);
+      a++;
+    } else if (strcmp(argv[a], "-classes") == 0) {
+      a++;
+      classMask = (int)strtol(argv[a], NULL, 0);
+      if (classMask <= 0 || classMask > CLASS_ALL) {
+        printf("Invalid -classes argument, expected a mask between 1 and 0x3F\n");
+        exit(-1);
+      }
+      a++;
     } else if (strcmp(argv[a], "-c") == 0) {
       caseSensitive = false;
       a++;
@@ -490,6 +633,12 @@ int main(int argc, char* argv[]) {
   printf("GPU code not compiled, use -DWITHGPU when compiling.\n");
 #endif
       exit(0);
+    } else if (strcmp(argv[a], "-bench") == 0) {
+
+      // Options affecting the run (-gpu, -gpuId, -g, -o) must precede -bench
+      RunBench(secp, gpuEnable, gpuId, gridSize, outputFile);
+      exit(0);
+
     } else if (strcmp(argv[a], "-l") == 0) {
 
 #ifdef WITHGPU
@@ -567,6 +716,10 @@ int main(int argc, char* argv[]) {
       a++;
       outputFile = string(argv[a]);
       a++;
+    } else if (strcmp(argv[a], "-stats") == 0) {
+      a++;
+      Stats::Enable(string(argv[a]));
+      a++;
     } else if (strcmp(argv[a], "-i") == 0) {
       a++;
       parseFile(string(argv[a]),prefix);
@@ -652,6 +805,16 @@ int main(int argc, char* argv[]) {
 
   printf("VanitySearch v" RELEASE "\n");
 
+  // The coordinator does not search, it only leases key ranges to workers.
+  // All machines of a cluster must share the same -s seed
+  if (coordinatorPort > 0) {
+    Int base = VanitySearch::ComputeBaseKey(seed, paranoiacSeed);
+    printf("Base Key: %s\n", base.GetBase16().c_str());
+    ClusterCoordinator coord(coordinatorPort, base, leaseMKeys * 1000000ULL, outputFile, 120.0);
+    coord.Run();
+    return 0;
+  }
+
   if(gridSize.size()==0) {
     for (int i = 0; i < gpuId.size(); i++) {
       gridSize.push_back(-1);
@@ -681,35 +844,66 @@ int main(int argc, char* argv[]) {
       exit(-1);
     }
 
-    // Parse target value (MSB-aligned to match prefix mask)
-    int bytes = parseHexToLimbsMSB(stegoTargetHex.c_str(), stegoTarget.value);
-    if (bytes < 0) {
-      printf("Error: Invalid hex in -tx\n");
+    // -tx (and -mx) accept comma separated lists so a single run can grind
+    // one key matching any of several payload alignments, the EC work is
+    // shared so extra targets are nearly free
+    vector<string> targetHexList;
+    vector<string> maskHexList;
+    getStrings(targetHexList, stegoTargetHex, ',');
+    if (!stegoMaskHex.empty())
+      getStrings(maskHexList, stegoMaskHex, ',');
+    if ((int)targetHexList.size() > STEGO_MAX_TARGETS) {
+      printf("Error: Too many mask targets (%d, max %d)\n",
+             (int)targetHexList.size(), STEGO_MAX_TARGETS);
       exit(-1);
     }
-
-    // Generate or parse mask
-    if (stegoPrefixBytes > 0) {
-      generatePrefixMask(stegoTarget.mask, stegoPrefixBytes);
-    } else if (!stegoMaskHex.empty()) {
-      parseHexToLimbsMSB(stegoMaskHex.c_str(), stegoTarget.mask);
-    } else {
-      // Default: generate mask for the bytes we have
-      generatePrefixMask(stegoTarget.mask, bytes);
+    if (maskHexList.size() > 1 && maskHexList.size() != targetHexList.size()) {
+      printf("Error: -mx needs a single mask or one mask per -tx target\n");
+      exit(-1);
     }
-    
-    stegoTarget.numBits = countMaskBits(stegoTarget.mask);
-    
+
     char hexBuf[65];
     printf("\n=== PUBKEY MASK MODE ===\n");
-    limbsToHex(stegoTarget.value, hexBuf);
-    printf("Target X:   %s\n", hexBuf);
-    limbsToHex(stegoTarget.mask, hexBuf);
-    printf("Mask:       %s\n", hexBuf);
-    printf("Bits:       %d (difficulty 2^%d)\n", stegoTarget.numBits, stegoTarget.numBits);
-    
+    double pMatch = 0.0;
+    for (int i = 0; i < (int)targetHexList.size(); i++) {
+
+      StegoTarget t;
+      memset(&t, 0, sizeof(t));
+
+      // Parse target value (MSB-aligned to match prefix mask)
+      int bytes = parseHexToLimbsMSB(targetHexList[i].c_str(), t.value);
+      if (bytes < 0) {
+        printf("Error: Invalid hex in -tx\n");
+        exit(-1);
+      }
+
+      // Generate or parse mask
+      if (stegoPrefixBytes > 0) {
+        generatePrefixMask(t.mask, stegoPrefixBytes);
+      } else if (!maskHexList.empty()) {
+        parseHexToLimbsMSB(maskHexList[maskHexList.size() == 1 ? 0 : i].c_str(), t.mask);
+      } else {
+        // Default: generate mask for the bytes we have
+        generatePrefixMask(t.mask, bytes);
+      }
+      t.numBits = countMaskBits(t.mask);
+      stegoTargets.push_back(t);
+      pMatch += pow(2.0, -t.numBits);
+
+      limbsToHex(t.value, hexBuf);
+      printf("Target X:   %s\n", hexBuf);
+      limbsToHex(t.mask, hexBuf);
+      printf("Mask:       %s (%d bits)\n", hexBuf, t.numBits);
+
+    }
+    stegoTarget = stegoTargets[0];
+
+    // A key matching any of the targets counts, the match probabilities add
+    double difficulty = 1.0 / pMatch;
+    printf("Difficulty: 2^%.1f (%d target%s)\n", log(difficulty) / log(2.0),
+           (int)stegoTargets.size(), stegoTargets.size() > 1 ? "s" : "");
+
     // Estimate time at 8.5 GKeys/s
-    double difficulty = pow(2.0, stegoTarget.numBits);
     double seconds = difficulty / 8.5e9;
     if (seconds < 60) printf("Estimate:   %.1f seconds @ 8.5 GKeys/s\n", seconds);
     else if (seconds < 3600) printf("Estimate:   %.1f minutes @ 8.5 GKeys/s\n", seconds / 60.0);
@@ -935,11 +1129,16 @@ int main(int argc, char* argv[]) {
 
   VanitySearch *v = new VanitySearch(secp, prefix, seed, searchMode, gpuEnable, stop, outputFile, sse,
     maxFound, rekey, caseSensitive, startPuKey, paranoiacSeed,
-    (stegoMode || sigMode || txidMode || taprootMode) ? &stegoTarget : NULL,
+    stegoMode ? stegoTargets.data() : ((sigMode || txidMode || taprootMode) ? &stegoTarget : NULL),
+    stegoMode ? (int)stegoTargets.size() : 1,
     sigMode, schnorrMode, sigMode ? &sigMsgHash : NULL, sigMode ? &sigPrivKey : NULL,
     (sigMode && schnorrMode) ? &sigPubKeyX : NULL,
     txidMode, rawTxBytes, nonceOffset, nonceLen,
-    taprootMode);
+    taprootMode, persistentKernel, resumeFile, classMask);
+
+  if (workerPort > 0)
+    v->SetClusterWorker(new ClusterWorker(workerHost, workerPort));
+
   v->Search(nbCPUThread,gpuId,gridSize);
 
   return 0;